@@ -0,0 +1,88 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+
+namespace {
+	std::atomic<uint64_t> allocationCount{ 0 };
+
+	void* countedAllocate(size_t size) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		void* memory = std::malloc(size > 0 ? size : 1); // new has to return a unique pointer even for 0 bytes
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	// for types aligned past what malloc guarantees (past __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+	void* countedAllocateAligned(size_t size, std::align_val_t alignment) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		size_t bytes = size > 0 ? size : 1;
+		size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+		void* memory = _aligned_malloc(bytes, align);
+#else
+		void* memory = std::aligned_alloc(align, (bytes + align - 1) / align * align); // the size has to be a multiple of the alignment
+#endif
+		if (memory == nullptr)
+			throw std::bad_alloc();
+		return memory;
+	}
+
+	void alignedFree(void* memory) {
+#ifdef _WIN32
+		_aligned_free(memory); // _aligned_malloc's memory can't go to free()
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+// every form is replaced, plain, array, sized, nothrow and aligned. the aligned ones matter most: their default versions allocate on their own
+// instead of going through operator new(size_t), so over-aligned types (alignas(64) members, eg JobSystem's deques) would go uncounted
+void* operator new(size_t size) { return countedAllocate(size); }
+void* operator new[](size_t size) { return countedAllocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+
+void* operator new(size_t size, std::align_val_t alignment) { return countedAllocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedAllocateAligned(size, alignment); }
+void operator delete(void* memory, std::align_val_t) noexcept { alignedFree(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { alignedFree(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { alignedFree(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { alignedFree(memory); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try { return countedAllocate(size); } catch (const std::bad_alloc&) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	try { return countedAllocate(size); } catch (const std::bad_alloc&) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return countedAllocateAligned(size, alignment); } catch (const std::bad_alloc&) { return nullptr; }
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+	try { return countedAllocateAligned(size, alignment); } catch (const std::bad_alloc&) { return nullptr; }
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(memory); }
+
+bool allocationCountingEnabled() { return true; }
+uint64_t heapAllocationCount() { return allocationCount.load(std::memory_order_relaxed); }
+
+#else
+
+bool allocationCountingEnabled() { return false; }
+uint64_t heapAllocationCount() { return 0; }
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocation counting, to keep the per frame path allocation free. AllocationCounter.cpp replaces the global operator new/delete with versions
+// that count every allocation made through them (all threads), so a frame's allocations are the difference of two heapAllocationCount() reads.
+// Compiled in when ENGINE_COUNT_ALLOCATIONS is defined, which debug builds do by default. Allocations made directly with malloc (eg inside the
+// Vulkan driver) aren't seen.
+#if !defined(NDEBUG) && !defined(ENGINE_COUNT_ALLOCATIONS)
+#define ENGINE_COUNT_ALLOCATIONS
+#endif
+
+bool allocationCountingEnabled();
+uint64_t heapAllocationCount(); // since startup, 0 when counting isn't compiled in
@@ -0,0 +1,214 @@
+#include "AsyncCompute.h"
+
+#include <stdexcept>
+
+void AsyncCompute::init(VkDevice device, VkQueue computeQueue, uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, const GpuTimeline& graphicsTimeline) {
+	this->device = device;
+	this->queue = computeQueue;
+	this->computeFamily = computeFamily;
+	this->graphicsFamily = graphicsFamily;
+	this->graphicsTimeline = &graphicsTimeline;
+	computeTimeline.init(device, computeQueue);
+	frames.resize(framesInFlight);
+
+	for (Frame& frame : frames) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = computeFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // one pool per frame, reset as a whole every time the frame comes round
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create compute command pool!");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = frame.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate compute command buffer!");
+		}
+	}
+}
+
+void AsyncCompute::destroy() {
+	computeTimeline.destroy(); // waits for all compute work first
+	for (Frame& frame : frames) {
+		vkDestroyCommandPool(device, frame.commandPool, nullptr); // frees the command buffer too
+	}
+	frames.clear();
+}
+
+void AsyncCompute::addBufferHandoff(uint32_t frame, VkBuffer buffer, VkPipelineStageFlags2 computeStage, VkAccessFlags2 computeAccess, VkPipelineStageFlags2 graphicsStage, VkAccessFlags2 graphicsAccess) {
+	Handoff handoff{};
+	handoff.isImage = false;
+	handoff.buffer = buffer;
+	handoff.computeStage = computeStage;
+	handoff.computeAccess = computeAccess;
+	handoff.graphicsStage = graphicsStage;
+	handoff.graphicsAccess = graphicsAccess;
+	frames[frame].handoffs.push_back(handoff);
+}
+
+void AsyncCompute::addImageHandoff(uint32_t frame, VkImage image, const VkImageSubresourceRange& range, VkImageLayout computeLayout, VkImageLayout graphicsLayout,
+	VkPipelineStageFlags2 computeStage, VkAccessFlags2 computeAccess, VkPipelineStageFlags2 graphicsStage, VkAccessFlags2 graphicsAccess)
+{
+	Handoff handoff{};
+	handoff.isImage = true;
+	handoff.image = image;
+	handoff.range = range;
+	handoff.computeLayout = computeLayout;
+	handoff.graphicsLayout = graphicsLayout;
+	handoff.computeStage = computeStage;
+	handoff.computeAccess = computeAccess;
+	handoff.graphicsStage = graphicsStage;
+	handoff.graphicsAccess = graphicsAccess;
+	frames[frame].handoffs.push_back(handoff);
+}
+
+void AsyncCompute::clearHandoffs() {
+	for (Frame& frame : frames) {
+		frame.handoffs.clear();
+		frame.ownedByGraphics = false; // the new resources start out with no owner. waiting on graphicsReleaseValue is harmless, it's already reached
+	}
+}
+
+// a queue family ownership transfer is a release barrier on the old family's queue plus a matching acquire barrier on the new one's, with the
+// semaphore wait in between. without a dedicated family there's no ownership to move, only the layout change has to happen once, on the release side
+void AsyncCompute::recordTransfers(VkCommandBuffer commandBuffer, const Frame& frame, TransferSide side) {
+	bool release = side == TransferSide::ComputeRelease || side == TransferSide::GraphicsRelease;
+	if (!isDedicated() && !release)
+		return;
+
+	bool toGraphics = side == TransferSide::ComputeRelease || side == TransferSide::GraphicsAcquire;
+	imageBarrierScratch.clear();
+	bufferBarrierScratch.clear();
+	for (const Handoff& handoff : frame.handoffs) {
+		VkImageLayout oldLayout = toGraphics ? handoff.computeLayout : handoff.graphicsLayout;
+		VkImageLayout newLayout = toGraphics ? handoff.graphicsLayout : handoff.computeLayout;
+		if (!isDedicated() && (!handoff.isImage || oldLayout == newLayout))
+			continue;
+
+		VkPipelineStageFlags2 srcStage = VK_PIPELINE_STAGE_2_NONE, dstStage = VK_PIPELINE_STAGE_2_NONE; // the other half of the transfer ignores these, the semaphore orders it
+		VkAccessFlags2 srcAccess = VK_ACCESS_2_NONE, dstAccess = VK_ACCESS_2_NONE;
+		switch (side) {
+		case TransferSide::ComputeRelease: srcStage = handoff.computeStage; srcAccess = handoff.computeAccess; break;
+		case TransferSide::GraphicsRelease: srcStage = handoff.graphicsStage; srcAccess = handoff.graphicsAccess; break;
+		case TransferSide::ComputeAcquire: dstStage = handoff.computeStage; dstAccess = handoff.computeAccess; break;
+		case TransferSide::GraphicsAcquire: dstStage = handoff.graphicsStage; dstAccess = handoff.graphicsAccess; break;
+		}
+		uint32_t srcFamily = isDedicated() ? (toGraphics ? computeFamily : graphicsFamily) : VK_QUEUE_FAMILY_IGNORED;
+		uint32_t dstFamily = isDedicated() ? (toGraphics ? graphicsFamily : computeFamily) : VK_QUEUE_FAMILY_IGNORED;
+
+		if (handoff.isImage) {
+			VkImageMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStage;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dstStage;
+			barrier.dstAccessMask = dstAccess;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.image = handoff.image;
+			barrier.subresourceRange = handoff.range;
+			imageBarrierScratch.push_back(barrier);
+		} else {
+			VkBufferMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			barrier.srcStageMask = srcStage;
+			barrier.srcAccessMask = srcAccess;
+			barrier.dstStageMask = dstStage;
+			barrier.dstAccessMask = dstAccess;
+			barrier.srcQueueFamilyIndex = srcFamily;
+			barrier.dstQueueFamilyIndex = dstFamily;
+			barrier.buffer = handoff.buffer;
+			barrier.offset = 0;
+			barrier.size = VK_WHOLE_SIZE;
+			bufferBarrierScratch.push_back(barrier);
+		}
+	}
+
+	if (imageBarrierScratch.empty() && bufferBarrierScratch.empty())
+		return;
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarrierScratch.size());
+	dependencyInfo.pImageMemoryBarriers = imageBarrierScratch.data();
+	dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarrierScratch.size());
+	dependencyInfo.pBufferMemoryBarriers = bufferBarrierScratch.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+VkCommandBuffer AsyncCompute::begin(uint32_t frameIndex) {
+	Frame& frame = frames[frameIndex];
+	computeTimeline.wait(frame.computeValue); // normally already done, the graphics side waited on a later frame that depends on it
+	vkResetCommandPool(device, frame.commandPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording compute command buffer!");
+	}
+
+	if (frame.ownedByGraphics) {
+		recordTransfers(frame.commandBuffer, frame, TransferSide::ComputeAcquire);
+		frame.ownedByGraphics = false;
+	}
+	frame.active = true;
+	frame.submitted = false;
+	return frame.commandBuffer;
+}
+
+void AsyncCompute::submit(uint32_t frameIndex) {
+	Frame& frame = frames[frameIndex];
+	recordTransfers(frame.commandBuffer, frame, TransferSide::ComputeRelease);
+	if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record compute command buffer!");
+	}
+
+	TimelineSubmit submit;
+	if (frame.graphicsReleaseValue != 0) { // graphics released the handoffs last time, the acquire barriers can't run before that
+		submit.waitFor(graphicsTimeline->semaphore(), frame.graphicsReleaseValue, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT);
+	}
+	submit.addCommandBuffer(frame.commandBuffer);
+	frame.computeValue = computeTimeline.submit(submit);
+	frame.submitted = true;
+}
+
+void AsyncCompute::recordGraphicsAcquire(VkCommandBuffer commandBuffer, uint32_t frame) {
+	if (frames[frame].active)
+		recordTransfers(commandBuffer, frames[frame], TransferSide::GraphicsAcquire);
+}
+
+void AsyncCompute::recordGraphicsRelease(VkCommandBuffer commandBuffer, uint32_t frame) {
+	if (frames[frame].active)
+		recordTransfers(commandBuffer, frames[frame], TransferSide::GraphicsRelease);
+}
+
+AsyncCompute::GraphicsSync AsyncCompute::graphicsSubmit(uint32_t frameIndex) {
+	Frame& frame = frames[frameIndex];
+	GraphicsSync sync;
+	if (!frame.active)
+		return sync;
+	if (!frame.submitted) {
+		throw std::runtime_error("Compute work was recorded but never submitted!");
+	}
+
+	VkPipelineStageFlags2 waitStage = VK_PIPELINE_STAGE_2_NONE;
+	for (const Handoff& handoff : frame.handoffs)
+		waitStage |= handoff.graphicsStage;
+	sync.waitStage = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+	if (waitStage != VK_PIPELINE_STAGE_2_NONE)
+		sync.waitStage = waitStage;
+	sync.waitSemaphore = computeTimeline.semaphore();
+	sync.waitValue = frame.computeValue;
+
+	frame.graphicsReleaseValue = graphicsTimeline->nextValue();
+	frame.ownedByGraphics = true;
+	frame.active = false;
+	return sync;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "GpuTimeline.h"
+
+#include <cstdint>
+#include <vector>
+
+// Async compute: compute work (culling, particles, post processing...) is recorded into its own command buffer and submitted to a second queue - from a
+// compute-only queue family when the GPU has one - so it runs alongside the graphics queue instead of waiting in line behind the raster work.
+// Resources that compute produces and graphics consumes are registered as handoffs. With a dedicated family they're exclusively owned by one family at a
+// time, so every frame they're released by compute, acquired by graphics, and handed back again (queue family ownership transfers), with the queues'
+// timelines ordering each side. When there's no dedicated family the same code runs on the graphics family and the transfers are skipped, the timeline waits alone
+// are enough there.
+// Everything is per frame in flight: a handoff resource should be one copy per frame, so compute can already be working on the next frame while graphics
+// is still reading the previous one.
+class AsyncCompute {
+public:
+	// graphicsTimeline is the one the graphics queue's submissions signal, compute waits on it before taking the handoffs back
+	void init(VkDevice device, VkQueue computeQueue, uint32_t computeFamily, uint32_t graphicsFamily, uint32_t framesInFlight, const GpuTimeline& graphicsTimeline);
+	void destroy();
+
+	bool isDedicated() const { return computeFamily != graphicsFamily; }
+	uint32_t queueFamily() const { return computeFamily; }
+	GpuTimeline& timeline() { return computeTimeline; } // signaled by every compute submission
+
+	// compute writes the resource with computeStage/computeAccess, graphics then reads it with graphicsStage/graphicsAccess
+	void addBufferHandoff(uint32_t frame, VkBuffer buffer, VkPipelineStageFlags2 computeStage, VkAccessFlags2 computeAccess, VkPipelineStageFlags2 graphicsStage, VkAccessFlags2 graphicsAccess);
+	void addImageHandoff(uint32_t frame, VkImage image, const VkImageSubresourceRange& range, VkImageLayout computeLayout, VkImageLayout graphicsLayout,
+		VkPipelineStageFlags2 computeStage, VkAccessFlags2 computeAccess, VkPipelineStageFlags2 graphicsStage, VkAccessFlags2 graphicsAccess);
+	void clearHandoffs(); // device must be idle, eg when the resources are recreated
+
+	// compute side. begin() waits for the frame's previous compute submission to finish (normally long done), and takes the handoffs back from graphics
+	VkCommandBuffer begin(uint32_t frame);
+	void submit(uint32_t frame); // releases the handoffs to graphics and submits
+	bool isActive(uint32_t frame) const { return frames[frame].active; } // begin() was called and graphics hasn't been submitted yet
+
+	// graphics side, only does anything for frames where compute is active. acquire at the start of the frame's graphics commands, release at the end.
+	// not thread safe against begin()/submit(), record graphics after compute
+	void recordGraphicsAcquire(VkCommandBuffer commandBuffer, uint32_t frame);
+	void recordGraphicsRelease(VkCommandBuffer commandBuffer, uint32_t frame);
+
+	struct GraphicsSync {
+		VkSemaphore waitSemaphore = VK_NULL_HANDLE; // the compute timeline, wait for waitValue before the stages reading the handoffs
+		uint64_t waitValue = 0;
+		VkPipelineStageFlags2 waitStage = VK_PIPELINE_STAGE_2_NONE;
+	};
+	// call right before the frame's graphics submission, on the graphics timeline. ends the frame's compute work. the submission's timeline value
+	// is what the next compute submission of the frame waits for, so graphics doesn't signal anything extra
+	GraphicsSync graphicsSubmit(uint32_t frame);
+
+private:
+	struct Handoff {
+		bool isImage;
+		VkBuffer buffer;
+		VkImage image;
+		VkImageSubresourceRange range;
+		VkImageLayout computeLayout;
+		VkImageLayout graphicsLayout;
+		VkPipelineStageFlags2 computeStage;
+		VkAccessFlags2 computeAccess;
+		VkPipelineStageFlags2 graphicsStage;
+		VkAccessFlags2 graphicsAccess;
+	};
+	struct Frame {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		uint64_t computeValue = 0; // compute timeline value of the frame's last submission
+		uint64_t graphicsReleaseValue = 0; // graphics timeline value of the submission that released the handoffs back, the next compute submission waits on it
+		bool active = false;
+		bool submitted = false;
+		bool ownedByGraphics = false; // graphics acquired the handoffs last time round and released them back, compute has to acquire them again
+		std::vector<Handoff> handoffs;
+	};
+
+	enum class TransferSide { ComputeRelease, ComputeAcquire, GraphicsAcquire, GraphicsRelease };
+	void recordTransfers(VkCommandBuffer commandBuffer, const Frame& frame, TransferSide side);
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	GpuTimeline computeTimeline;
+	const GpuTimeline* graphicsTimeline = nullptr;
+	uint32_t computeFamily = 0;
+	uint32_t graphicsFamily = 0;
+	std::vector<Frame> frames;
+
+	std::vector<VkImageMemoryBarrier2> imageBarrierScratch;
+	std::vector<VkBufferMemoryBarrier2> bufferBarrierScratch;
+};
@@ -0,0 +1,366 @@
+#include "Benchmark.h"
+
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	const double ABSOLUTE_SLACK_MS = 0.05;
+
+	// just enough JSON for reading our own output back: objects, arrays, strings without escapes beyond \" and \\, numbers, true/false/null
+	struct JsonValue {
+		enum class Type { Null, Bool, Number, String, Array, Object };
+		Type type = Type::Null;
+		double number = 0.0;
+		bool boolean = false;
+		std::string string;
+		std::vector<JsonValue> array;
+		std::vector<std::pair<std::string, JsonValue>> object;
+
+		const JsonValue* find(const std::string& key) const {
+			for (const auto& member : object)
+				if (member.first == key)
+					return &member.second;
+			return nullptr;
+		}
+		double numberOr(const std::string& key, double fallback) const {
+			const JsonValue* value = find(key);
+			return value != nullptr && value->type == Type::Number ? value->number : fallback;
+		}
+	};
+
+	class JsonParser {
+	public:
+		explicit JsonParser(const std::string& text) : text(text) {}
+
+		JsonValue parseDocument() {
+			JsonValue value = parseValue();
+			skipWhitespace();
+			if (position != text.size())
+				fail("trailing characters");
+			return value;
+		}
+
+	private:
+		const std::string& text;
+		size_t position = 0;
+
+		[[noreturn]] void fail(const char* what) {
+			throw std::runtime_error(std::string("malformed benchmark JSON: ") + what + " at offset " + std::to_string(position) + "!");
+		}
+
+		void skipWhitespace() {
+			while (position < text.size() && std::isspace(static_cast<unsigned char>(text[position])))
+				++position;
+		}
+
+		void expect(char c) {
+			skipWhitespace();
+			if (position >= text.size() || text[position] != c)
+				fail("unexpected character");
+			++position;
+		}
+
+		bool consume(char c) {
+			skipWhitespace();
+			if (position < text.size() && text[position] == c) {
+				++position;
+				return true;
+			}
+			return false;
+		}
+
+		std::string parseString() {
+			expect('"');
+			std::string result;
+			while (position < text.size() && text[position] != '"') {
+				if (text[position] == '\\' && position + 1 < text.size())
+					++position;
+				result += text[position++];
+			}
+			if (position >= text.size())
+				fail("unterminated string");
+			++position;
+			return result;
+		}
+
+		JsonValue parseValue() {
+			skipWhitespace();
+			if (position >= text.size())
+				fail("unexpected end");
+			JsonValue value;
+			char c = text[position];
+			if (c == '{') {
+				value.type = JsonValue::Type::Object;
+				++position;
+				if (consume('}'))
+					return value;
+				do {
+					std::string key = parseString();
+					expect(':');
+					value.object.emplace_back(std::move(key), parseValue());
+				} while (consume(','));
+				expect('}');
+			} else if (c == '[') {
+				value.type = JsonValue::Type::Array;
+				++position;
+				if (consume(']'))
+					return value;
+				do {
+					value.array.push_back(parseValue());
+				} while (consume(','));
+				expect(']');
+			} else if (c == '"') {
+				value.type = JsonValue::Type::String;
+				value.string = parseString();
+			} else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+				value.type = JsonValue::Type::Bool;
+				value.boolean = c == 't';
+				position += value.boolean ? 4 : 5;
+			} else if (text.compare(position, 4, "null") == 0) {
+				position += 4;
+			} else {
+				const char* start = text.c_str() + position;
+				char* end = nullptr;
+				value.type = JsonValue::Type::Number;
+				value.number = std::strtod(start, &end);
+				if (end == start)
+					fail("expected a value");
+				position += end - start;
+			}
+			return value;
+		}
+	};
+
+	void writePercentiles(const BenchmarkPercentiles& percentiles, std::ostream& out) {
+		out << "{ \"mean\": " << percentiles.mean << ", \"p50\": " << percentiles.p50 << ", \"p90\": " << percentiles.p90 << ", \"p99\": " << percentiles.p99
+			<< ", \"max\": " << percentiles.max << " }";
+	}
+
+	BenchmarkPercentiles readPercentiles(const JsonValue* value) {
+		BenchmarkPercentiles percentiles;
+		if (value == nullptr || value->type != JsonValue::Type::Object)
+			return percentiles;
+		percentiles.mean = value->numberOr("mean", 0.0);
+		percentiles.p50 = value->numberOr("p50", 0.0);
+		percentiles.p90 = value->numberOr("p90", 0.0);
+		percentiles.p99 = value->numberOr("p99", 0.0);
+		percentiles.max = value->numberOr("max", 0.0);
+		return percentiles;
+	}
+
+	std::string escaped(const std::string& text) {
+		std::string result;
+		for (char c : text) {
+			if (c == '"' || c == '\\')
+				result += '\\';
+			result += c;
+		}
+		return result;
+	}
+
+	// one line of the comparison table, true if it regressed
+	bool compareMetric(const std::string& scene, const std::string& metric, double current, double baseline, double tolerance, std::ostream& out) {
+		bool regressed = current > baseline * (1.0 + tolerance) + ABSOLUTE_SLACK_MS;
+		double change = baseline > 0.0 ? (current - baseline) / baseline * 100.0 : 0.0;
+		out << "  " << std::left << std::setw(14) << scene << std::setw(30) << metric << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(10) << baseline << " -> " << std::setw(10) << current << " ms  " << std::showpos << std::setprecision(1) << std::setw(7) << change
+			<< std::noshowpos << "%" << (regressed ? "  REGRESSION" : "") << std::defaultfloat << std::endl;
+		return regressed;
+	}
+}
+
+std::vector<BenchmarkScene> builtinBenchmarkScenes() {
+	std::vector<BenchmarkScene> scenes;
+
+	BenchmarkScene baseline; // the engine as it runs normally, one object
+	baseline.name = "baseline";
+	scenes.push_back(baseline);
+
+	BenchmarkScene manyDraws; // draw list sorting and command recording on the CPU, vertex throughput on the GPU
+	manyDraws.name = "many-draws";
+	manyDraws.objectCount = 1000;
+	scenes.push_back(manyDraws);
+
+	BenchmarkScene uploads; // the staging path, 4MB a frame
+	uploads.name = "uploads";
+	uploads.uploadBytesPerFrame = 4 * 1024 * 1024;
+	scenes.push_back(uploads);
+
+	BenchmarkScene resizeStorm; // swap chain recreation and the deletion queue, a resize every few frames
+	resizeStorm.name = "resize-storm";
+	resizeStorm.resizeInterval = 5;
+	scenes.push_back(resizeStorm);
+
+	return scenes;
+}
+
+BenchmarkPercentiles computePercentiles(std::vector<double> samples) {
+	BenchmarkPercentiles percentiles;
+	if (samples.empty())
+		return percentiles;
+	std::sort(samples.begin(), samples.end());
+	auto rank = [&](double fraction) { // nearest rank
+		size_t index = static_cast<size_t>(std::ceil(fraction * samples.size()));
+		return samples[std::min(std::max<size_t>(index, 1), samples.size()) - 1];
+	};
+	double sum = 0.0;
+	for (double sample : samples)
+		sum += sample;
+	percentiles.mean = sum / samples.size();
+	percentiles.p50 = rank(0.50);
+	percentiles.p90 = rank(0.90);
+	percentiles.p99 = rank(0.99);
+	percentiles.max = samples.back();
+	return percentiles;
+}
+
+void BenchmarkRecorder::begin(const std::vector<std::string>& subsystemNames, uint32_t frames) {
+	names = subsystemNames;
+	frameTimes.clear();
+	frameTimes.reserve(frames);
+	subsystemTimes.assign(names.size(), std::vector<double>());
+	for (std::vector<double>& times : subsystemTimes)
+		times.reserve(frames);
+	allocationTotal = 0;
+	allocationMax = 0;
+	allocatingFrameCount = 0;
+}
+
+void BenchmarkRecorder::recordFrame(double frameMs, uint64_t allocations, bool hotPathAllocated) {
+	frameTimes.push_back(frameMs);
+	allocationTotal += allocations;
+	allocationMax = std::max(allocationMax, allocations);
+	if (hotPathAllocated)
+		++allocatingFrameCount;
+}
+
+void BenchmarkRecorder::recordSubsystem(uint32_t subsystem, double cpuMs) {
+	subsystemTimes[subsystem].push_back(cpuMs);
+}
+
+BenchmarkResult BenchmarkRecorder::finish(const std::string& scene, uint32_t width, uint32_t height, uint64_t swapChainRecreations) const {
+	BenchmarkResult result;
+	result.scene = scene;
+	result.frames = static_cast<uint32_t>(frameTimes.size());
+	result.width = width;
+	result.height = height;
+	result.frameMs = computePercentiles(frameTimes);
+	for (size_t i = 0; i < names.size(); ++i)
+		result.subsystems.push_back({ names[i], computePercentiles(subsystemTimes[i]) });
+	result.allocationsCounted = allocationCountingEnabled();
+	result.allocations = allocationTotal;
+	result.maxFrameAllocations = allocationMax;
+	result.allocatingFrames = allocatingFrameCount;
+	result.swapChainRecreations = swapChainRecreations;
+	return result;
+}
+
+void writeBenchmarkJson(const std::vector<BenchmarkResult>& results, const std::string& deviceName, std::ostream& out) {
+	out << std::setprecision(6);
+	out << "{\n  \"device\": \"" << escaped(deviceName) << "\",\n  \"scenes\": [";
+	for (size_t i = 0; i < results.size(); ++i) {
+		const BenchmarkResult& result = results[i];
+		out << (i > 0 ? "," : "") << "\n    {\n";
+		out << "      \"name\": \"" << escaped(result.scene) << "\",\n";
+		out << "      \"frames\": " << result.frames << ",\n";
+		out << "      \"width\": " << result.width << ",\n";
+		out << "      \"height\": " << result.height << ",\n";
+		out << "      \"frameMs\": ";
+		writePercentiles(result.frameMs, out);
+		out << ",\n      \"cpuMs\": {";
+		for (size_t s = 0; s < result.subsystems.size(); ++s) {
+			out << (s > 0 ? "," : "") << "\n        \"" << escaped(result.subsystems[s].name) << "\": ";
+			writePercentiles(result.subsystems[s].cpuMs, out);
+		}
+		out << "\n      },\n";
+		out << "      \"allocations\": { \"counted\": " << (result.allocationsCounted ? "true" : "false") << ", \"total\": " << result.allocations
+			<< ", \"maxPerFrame\": " << result.maxFrameAllocations << ", \"allocatingFrames\": " << result.allocatingFrames << " },\n";
+		out << "      \"swapChainRecreations\": " << result.swapChainRecreations << "\n    }";
+	}
+	out << "\n  ]\n}\n";
+}
+
+std::vector<BenchmarkResult> readBenchmarkJson(std::istream& in) {
+	std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	JsonValue document = JsonParser(text).parseDocument();
+	const JsonValue* scenes = document.find("scenes");
+	if (scenes == nullptr || scenes->type != JsonValue::Type::Array) {
+		throw std::runtime_error("benchmark JSON has no scenes!");
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (const JsonValue& scene : scenes->array) {
+		BenchmarkResult result;
+		const JsonValue* name = scene.find("name");
+		if (name == nullptr || name->type != JsonValue::Type::String) {
+			throw std::runtime_error("benchmark JSON has a scene without a name!");
+		}
+		result.scene = name->string;
+		result.frames = static_cast<uint32_t>(scene.numberOr("frames", 0.0));
+		result.width = static_cast<uint32_t>(scene.numberOr("width", 0.0));
+		result.height = static_cast<uint32_t>(scene.numberOr("height", 0.0));
+		result.frameMs = readPercentiles(scene.find("frameMs"));
+		if (const JsonValue* cpu = scene.find("cpuMs")) {
+			for (const auto& subsystem : cpu->object)
+				result.subsystems.push_back({ subsystem.first, readPercentiles(&subsystem.second) });
+		}
+		if (const JsonValue* allocations = scene.find("allocations")) {
+			const JsonValue* counted = allocations->find("counted");
+			result.allocationsCounted = counted != nullptr && counted->type == JsonValue::Type::Bool && counted->boolean;
+			result.allocations = static_cast<uint64_t>(allocations->numberOr("total", 0.0));
+			result.maxFrameAllocations = static_cast<uint64_t>(allocations->numberOr("maxPerFrame", 0.0));
+			result.allocatingFrames = static_cast<uint64_t>(allocations->numberOr("allocatingFrames", 0.0));
+		}
+		result.swapChainRecreations = static_cast<uint64_t>(scene.numberOr("swapChainRecreations", 0.0));
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+bool checkHotPathAllocations(const std::vector<BenchmarkResult>& results, std::ostream& out) {
+	bool clean = true;
+	for (const BenchmarkResult& result : results) {
+		if (!result.allocationsCounted || result.allocatingFrames == 0)
+			continue;
+		out << result.scene << ": " << result.allocatingFrames << " of " << result.frames << " frames made heap allocations in drawFrame(), the frame loop has to be"
+			<< " allocation free once it is warm" << std::endl;
+		clean = false;
+	}
+	return clean;
+}
+
+bool compareWithBaseline(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double tolerance, std::ostream& out) {
+	bool regressed = false;
+	out << "against the baseline (" << tolerance * 100.0 << "% tolerance):" << std::endl;
+	for (const BenchmarkResult& result : results) {
+		auto previous = std::find_if(baseline.begin(), baseline.end(), [&](const BenchmarkResult& candidate) { return candidate.scene == result.scene; });
+		if (previous == baseline.end()) {
+			out << "  " << result.scene << ": not in the baseline, skipped" << std::endl;
+			continue;
+		}
+		regressed |= compareMetric(result.scene, "frame p50", result.frameMs.p50, previous->frameMs.p50, tolerance, out);
+		regressed |= compareMetric(result.scene, "frame p99", result.frameMs.p99, previous->frameMs.p99, tolerance, out);
+		for (const BenchmarkSubsystem& subsystem : result.subsystems) {
+			auto previousSubsystem = std::find_if(previous->subsystems.begin(), previous->subsystems.end(),
+				[&](const BenchmarkSubsystem& candidate) { return candidate.name == subsystem.name; });
+			if (previousSubsystem != previous->subsystems.end())
+				regressed |= compareMetric(result.scene, subsystem.name + " mean", subsystem.cpuMs.mean, previousSubsystem->cpuMs.mean, tolerance, out);
+		}
+		if (result.allocationsCounted && previous->allocationsCounted) {
+			bool allocationsRegressed = result.maxFrameAllocations > previous->maxFrameAllocations;
+			out << "  " << std::left << std::setw(14) << result.scene << std::setw(30) << "heap allocs/frame (max)" << std::right << std::setw(10)
+				<< previous->maxFrameAllocations << " -> " << std::setw(10) << result.maxFrameAllocations << (allocationsRegressed ? "     REGRESSION" : "") << std::endl;
+			regressed |= allocationsRegressed;
+		}
+	}
+	return !regressed;
+}
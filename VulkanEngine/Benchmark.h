@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Rendering benchmarks, to catch performance regressions. A scene is a script the engine runs headless for a fixed number of frames (see
+// MainApplication::benchmarkLoop), the recorder collects every frame's wall time, the CPU time of each frame task and the heap allocations made,
+// and the results are written as JSON. A previous run's JSON is the baseline the next run is compared against.
+
+struct BenchmarkScene {
+	std::string name;
+	uint32_t objectCount = 1; // copies of the scene object, sorted through the main pass's draw list and drawn as one instanced batch (at most MAX_SCENE_INSTANCES)
+	uint64_t uploadBytesPerFrame = 0; // pushed through the engine's staging upload every frame
+	uint32_t resizeInterval = 0; // frames between swap chain resizes, 0 never resizes
+	uint32_t warmupFrames = 30; // run but not recorded, pipelines/caches/allocations settle during these
+	uint32_t frames = 300;
+};
+
+std::vector<BenchmarkScene> builtinBenchmarkScenes(); // "baseline", "many-draws", "uploads", "resize-storm"
+
+struct BenchmarkPercentiles {
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p90 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+BenchmarkPercentiles computePercentiles(std::vector<double> samples); // nearest rank, all 0 for no samples
+
+struct BenchmarkSubsystem {
+	std::string name;
+	BenchmarkPercentiles cpuMs;
+};
+
+struct BenchmarkResult {
+	std::string scene;
+	uint32_t frames = 0;
+	uint32_t width = 0; // swap chain size at the end of the run
+	uint32_t height = 0;
+	BenchmarkPercentiles frameMs;
+	std::vector<BenchmarkSubsystem> subsystems;
+	bool allocationsCounted = false; // false when the build has no allocation counting (see AllocationCounter.h), the counts are 0 then
+	uint64_t allocations = 0; // over all recorded frames
+	uint64_t maxFrameAllocations = 0;
+	uint64_t allocatingFrames = 0; // recorded frames whose drawFrame() allocated without recreating the swap chain. the hot path has to stay at 0
+	uint64_t swapChainRecreations = 0;
+};
+
+// collects one scene's samples. everything is reserved up front, recording a frame doesn't allocate, so it doesn't show up in the allocation counts
+class BenchmarkRecorder {
+public:
+	void begin(const std::vector<std::string>& subsystemNames, uint32_t frames);
+	void recordFrame(double frameMs, uint64_t allocations, bool hotPathAllocated = false); // allocations of the whole frame, scripted work included
+	void recordSubsystem(uint32_t subsystem, double cpuMs); // index into the names passed to begin(), for the frame being recorded
+	BenchmarkResult finish(const std::string& scene, uint32_t width, uint32_t height, uint64_t swapChainRecreations) const;
+
+private:
+	std::vector<std::string> names;
+	std::vector<double> frameTimes;
+	std::vector<std::vector<double>> subsystemTimes;
+	uint64_t allocationTotal = 0;
+	uint64_t allocationMax = 0;
+	uint64_t allocatingFrameCount = 0;
+};
+
+void writeBenchmarkJson(const std::vector<BenchmarkResult>& results, const std::string& deviceName, std::ostream& out);
+std::vector<BenchmarkResult> readBenchmarkJson(std::istream& in); // the subset writeBenchmarkJson produces, throws on anything malformed
+
+// prints the scenes with frames that allocated on the hot path (BenchmarkResult::allocatingFrames), returns false if there are any. allocations
+// per frame only ever creep up, so this fails on its own, without a baseline
+bool checkHotPathAllocations(const std::vector<BenchmarkResult>& results, std::ostream& out);
+
+// prints every scene's metrics against the baseline's. a metric regresses when it is more than tolerance (a fraction) slower than the baseline,
+// plus a little absolute slack so sub-millisecond noise doesn't count. any increase in allocations per frame is a regression. scenes missing from
+// either side are skipped. returns false if anything regressed
+bool compareWithBaseline(const std::vector<BenchmarkResult>& results, const std::vector<BenchmarkResult>& baseline, double tolerance, std::ostream& out);
@@ -0,0 +1,233 @@
+#include "ClusteredLighting.h"
+
+#include "AsyncCompute.h"
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+void ClusteredLighting::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t maxLights, uint32_t framesInFlight, VkShaderModule cullShader) {
+	if (maxLights == 0) {
+		throw std::runtime_error("Clustered lighting needs room for at least one light!");
+	}
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	lightCapacity = maxLights;
+	indexCapacity = CLUSTER_COUNT * AVERAGE_LIGHTS_PER_CLUSTER;
+
+	// the CPU rewrites the lights and parameters every frame, so they're host visible and stay mapped. the froxel ranges and the index list are
+	// only ever touched by the GPU. everything is per frame in flight, the previous frame's fragment shaders may still be reading theirs
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	frames.resize(framesInFlight);
+	for (Frame& frame : frames) {
+		createBuffer(sizeof(GpuClusterParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, frame.paramsBuffer, frame.paramsMemory);
+		createBuffer(sizeof(GpuLight) * static_cast<VkDeviceSize>(lightCapacity), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, frame.lightBuffer, frame.lightMemory);
+		createBuffer(clusterBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.clusterBuffer, frame.clusterMemory);
+		createBuffer(lightIndexBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			frame.indexBuffer, frame.indexMemory);
+		vkMapMemory(device, frame.paramsMemory, 0, VK_WHOLE_SIZE, 0, &frame.params);
+		vkMapMemory(device, frame.lightMemory, 0, VK_WHOLE_SIZE, 0, &frame.lights);
+		std::memset(frame.params, 0, sizeof(GpuClusterParams)); // no lights until the first update()
+	}
+
+	createDescriptors();
+	createCullPipeline(cullShader);
+}
+
+void ClusteredLighting::destroy() {
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	freeDescriptorPool(device, descriptorPool); // frees the sets too
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+	for (Frame& frame : frames) {
+		vkUnmapMemory(device, frame.paramsMemory);
+		vkUnmapMemory(device, frame.lightMemory);
+		vkDestroyBuffer(device, frame.paramsBuffer, nullptr);
+		freeDeviceMemory(device, frame.paramsMemory);
+		vkDestroyBuffer(device, frame.lightBuffer, nullptr);
+		freeDeviceMemory(device, frame.lightMemory);
+		vkDestroyBuffer(device, frame.clusterBuffer, nullptr);
+		freeDeviceMemory(device, frame.clusterMemory);
+		vkDestroyBuffer(device, frame.indexBuffer, nullptr);
+		freeDeviceMemory(device, frame.indexMemory);
+	}
+	frames.clear();
+}
+
+void ClusteredLighting::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light buffer!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device, outBuffer, &memReqs);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
+	if (allocateDeviceMemory(device, allocInfo, bufferMemoryCategory(usage), outMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate light buffer memory!");
+	}
+
+	vkBindBufferMemory(device, outBuffer, outMemory, 0);
+}
+
+uint32_t ClusteredLighting::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void ClusteredLighting::createDescriptors() {
+	// 0 params, 1 lights, 2 froxel ranges, 3 index list. the same set is bound by the cull shader, which writes 2 and 3, and the fragment shaders
+	const uint32_t BINDINGS = 4;
+	VkDescriptorSetLayoutBinding bindings[BINDINGS]{};
+	for (uint32_t i = 0; i < BINDINGS; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = BINDINGS;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create lighting descriptor set layout!");
+
+	uint32_t frameCount = static_cast<uint32_t>(frames.size());
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = frameCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = frameCount * (BINDINGS - 1);
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	poolInfo.maxSets = frameCount;
+	if (allocateDescriptorPool(device, poolInfo, descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create lighting descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(frameCount);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate lighting descriptor sets!");
+
+	for (uint32_t f = 0; f < frameCount; ++f) {
+		Frame& frame = frames[f];
+		frame.set = sets[f];
+		VkBuffer buffers[BINDINGS] = { frame.paramsBuffer, frame.lightBuffer, frame.clusterBuffer, frame.indexBuffer };
+
+		VkDescriptorBufferInfo bufferInfos[BINDINGS]{};
+		VkWriteDescriptorSet writes[BINDINGS]{};
+		for (uint32_t i = 0; i < BINDINGS; ++i) {
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.set;
+			writes[i].dstBinding = i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = bindings[i].descriptorType;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, BINDINGS, writes, 0, nullptr);
+	}
+}
+
+void ClusteredLighting::createCullPipeline(VkShaderModule cullShader) {
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light cull pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = cullPipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create light cull pipeline!");
+	}
+}
+
+void ClusteredLighting::update(uint32_t frame, const glm::mat4& view, const glm::mat4& projection, VkExtent2D renderExtent, const GpuLight* lights, uint32_t lightCount) {
+	Frame& target = frames[frame];
+	activeLights = std::min(lightCount, lightCapacity);
+	std::memcpy(target.lights, lights, sizeof(GpuLight) * activeLights);
+
+	// the clip planes straight out of the projection. glm::perspective has [2][2] = -(f+n)/(f-n) and [3][2] = -2fn/(f-n), the y flip doesn't touch either
+	GpuClusterParams params{};
+	params.nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	params.farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	// slice k starts at near * (far/near)^(k/CLUSTER_Z), so the slice of a depth is log(depth/near) / log(far/near) * CLUSTER_Z
+	float logDepthRange = std::log(params.farPlane / params.nearPlane);
+	params.depthScale = CLUSTER_Z / logDepthRange;
+	params.depthBias = -CLUSTER_Z * std::log(params.nearPlane) / logDepthRange;
+	params.view = view;
+	params.inverseProjection = glm::inverse(projection);
+	params.cameraPosition = glm::inverse(view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	params.screenSize = glm::vec2(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+	params.lightCount = activeLights;
+	params.indexCapacity = indexCapacity;
+	std::memcpy(target.params, &params, sizeof(params));
+}
+
+void ClusteredLighting::recordCull(VkCommandBuffer commandBuffer, uint32_t frame) {
+	const Frame& target = frames[frame];
+
+	// the workgroups reserve their part of the index list with an atomic on its first uint, so that starts from 0 every frame
+	vkCmdFillBuffer(commandBuffer, target.indexBuffer, 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &target.set, 0, nullptr);
+	vkCmdDispatch(commandBuffer, CLUSTER_X, CLUSTER_Y, CLUSTER_Z); // one workgroup per froxel
+}
+
+void ClusteredLighting::registerHandoffs(AsyncCompute& asyncCompute) const {
+	for (uint32_t i = 0; i < frames.size(); ++i) {
+		asyncCompute.addBufferHandoff(i, frames[i].clusterBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+		// the counter at its start is filled first and then bumped atomically, so the transfer is part of the compute side too
+		asyncCompute.addBufferHandoff(i, frames[i].indexBuffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+	}
+}
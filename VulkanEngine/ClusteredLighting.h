@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class AsyncCompute;
+
+// Clustered forward lighting. The view frustum is cut into a CLUSTER_X x CLUSTER_Y x CLUSTER_Z grid of froxels: screen tiles, and depth slices
+// that grow exponentially with the distance (so a froxel is roughly as deep as it is wide everywhere). Every frame:
+//  update()     - the CPU writes the frame's lights and the grid parameters, taken from the camera's view and projection
+//  recordCull() - Shaders/light_cull.comp runs one workgroup per froxel, tests every light's sphere against the froxel's view space box and
+//                 appends the ones touching it to a shared index list. each froxel gets an (offset, count) range into that list
+// The scene's fragment shader (Shaders/shader.frag) finds its froxel from gl_FragCoord and its view depth and only loops over that range, so a
+// pixel pays for the lights that can reach it, not for all of them.
+// The lights, the froxel ranges and the index list are one descriptor set per frame in flight, shared by the cull shader (set 0 of its layout)
+// and the lit graphics pipelines (LIGHTING_SET next to the camera UBO). Layouts mirror Shaders/clustered_common.glsl.
+// The cull only needs what update() wrote, so it's recorded on the async compute queue and overlaps the shadow cascades on graphics.
+
+struct GpuLight {
+	glm::vec4 positionRadius; // xyz world space, w the radius the light reaches zero at
+	glm::vec4 color; // rgb, w unused
+};
+
+class ClusteredLighting {
+public:
+	static const uint32_t CLUSTER_X = 16;
+	static const uint32_t CLUSTER_Y = 9;
+	static const uint32_t CLUSTER_Z = 24;
+	static const uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+	static const uint32_t AVERAGE_LIGHTS_PER_CLUSTER = 64; // sizes the index list. past it the froxels that come last lose lights, see clustered_common.glsl
+	static const uint32_t LIGHTING_SET = 1; // where the graphics pipelines bind set()
+
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t maxLights, uint32_t framesInFlight, VkShaderModule cullShader);
+	void destroy();
+
+	// the frame's previous submission has to be done. projection is a perspective one (glm::perspective, y flipped or not), renderExtent what
+	// the lit pass renders at, its gl_FragCoord range. lights past maxLights are dropped
+	void update(uint32_t frame, const glm::mat4& view, const glm::mat4& projection, VkExtent2D renderExtent, const GpuLight* lights, uint32_t lightCount);
+	// resets the frame's index list and bins the lights. compute command buffer, the froxel ranges and the index list are handoffs to graphics
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frame);
+	// the per frame froxel ranges and index list are written by the cull and read by the lit fragment shaders
+	void registerHandoffs(AsyncCompute& asyncCompute) const;
+
+	VkDescriptorSetLayout setLayout() const { return descriptorSetLayout; } // fragment stage too, for LIGHTING_SET of the graphics pipelines
+	VkDescriptorSet set(uint32_t frame) const { return frames[frame].set; }
+	// written by recordCull, read by the fragment shaders
+	VkBuffer clusterBuffer(uint32_t frame) const { return frames[frame].clusterBuffer; }
+	VkBuffer lightIndexBuffer(uint32_t frame) const { return frames[frame].indexBuffer; }
+	VkDeviceSize clusterBufferSize() const { return sizeof(uint32_t) * 2 * CLUSTER_COUNT; }
+	VkDeviceSize lightIndexBufferSize() const { return sizeof(uint32_t) * (1 + static_cast<VkDeviceSize>(indexCapacity)); }
+	uint32_t lightCount() const { return activeLights; }
+
+private:
+	// mirrors ClusterParams in Shaders/clustered_common.glsl (std140)
+	struct GpuClusterParams {
+		glm::mat4 view;
+		glm::mat4 inverseProjection;
+		glm::vec4 cameraPosition; // world space, w unused
+		glm::vec2 screenSize; // the render extent in pixels
+		float depthScale; // slice = log(view depth) * depthScale + depthBias
+		float depthBias;
+		float nearPlane; // view depth of the first slice's front and the last one's back
+		float farPlane;
+		uint32_t lightCount;
+		uint32_t indexCapacity;
+	};
+	struct Frame {
+		VkBuffer paramsBuffer = VK_NULL_HANDLE; // GpuClusterParams, host visible and persistently mapped like the lights
+		VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+		void* params = nullptr;
+		VkBuffer lightBuffer = VK_NULL_HANDLE; // GpuLight[maxLights]
+		VkDeviceMemory lightMemory = VK_NULL_HANDLE;
+		void* lights = nullptr;
+		VkBuffer clusterBuffer = VK_NULL_HANDLE; // uvec2(offset, count) per froxel
+		VkDeviceMemory clusterMemory = VK_NULL_HANDLE;
+		VkBuffer indexBuffer = VK_NULL_HANDLE; // uint counter, then the light indices of every froxel back to back
+		VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+	};
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	void createDescriptors();
+	void createCullPipeline(VkShaderModule cullShader);
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	uint32_t lightCapacity = 0;
+	uint32_t indexCapacity = 0;
+	uint32_t activeLights = 0;
+	std::vector<Frame> frames;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+};
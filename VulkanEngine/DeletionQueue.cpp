@@ -0,0 +1,122 @@
+#include "DeletionQueue.h"
+
+#include "GpuTimeline.h"
+#include "MemoryTelemetry.h"
+
+void DeletionQueue::init(VkDevice device, GpuTimeline& graphicsTimeline, GpuTimeline& computeTimeline) {
+	this->device = device;
+	this->graphicsTimeline = &graphicsTimeline;
+	this->computeTimeline = &computeTimeline;
+}
+
+void DeletionQueue::destroy() {
+	flush();
+}
+
+DeletionQueue::RetirePoint DeletionQueue::currentRetirePoint() const {
+	RetirePoint retire;
+	retire.graphicsValue = graphicsTimeline->nextValue(); // the frame being recorded might use it too
+	retire.computeValue = computeTimeline->lastSubmitted(); // compute isn't submitted every frame necessarily, nextValue() could keep it alive indefinitely
+	return retire;
+}
+
+void DeletionQueue::push(Type type, uint64_t handle, VkCommandPool pool, const RetirePoint* retire) {
+	if (handle == 0)
+		return; // same as vkDestroy* with VK_NULL_HANDLE
+	Entry entry{};
+	entry.type = type;
+	entry.handle = handle;
+	entry.pool = pool;
+	entry.retireKnown = true;
+	std::lock_guard<std::mutex> lock(mutex);
+	entry.retire = retire != nullptr ? *retire : currentRetirePoint();
+	entries.push_back(entry);
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain, VkFence lastPresentFence) {
+	Entry entry{};
+	entry.type = Type::Swapchain;
+	entry.handle = handleBits(swapchain);
+	entry.fence = lastPresentFence;
+	entry.retireKnown = true; // the retire point stays 0, only the fence matters
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(entry);
+}
+
+void DeletionQueue::destroySwapchain(VkSwapchainKHR swapchain) {
+	Entry entry{};
+	entry.type = Type::Swapchain;
+	entry.handle = handleBits(swapchain);
+	entry.retireKnown = false;
+	std::lock_guard<std::mutex> lock(mutex);
+	entries.push_back(entry);
+}
+
+void DeletionQueue::retireSwapchains(const RetirePoint& retire) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Entry& entry : entries) {
+		if (!entry.retireKnown) {
+			entry.retire = retire;
+			entry.retireKnown = true;
+		}
+	}
+}
+
+bool DeletionQueue::isRetired(const Entry& entry) const {
+	if (!entry.retireKnown)
+		return false;
+	if (entry.fence != VK_NULL_HANDLE && vkGetFenceStatus(device, entry.fence) != VK_SUCCESS)
+		return false;
+	return graphicsTimeline->isComplete(entry.retire.graphicsValue) && computeTimeline->isComplete(entry.retire.computeValue);
+}
+
+void DeletionQueue::collect() {
+	std::lock_guard<std::mutex> lock(mutex);
+	// compacts in place, so an entry that retires late (a swap chain, or something queued with a later point) doesn't hold up the ones behind it
+	size_t kept = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		if (isRetired(entries[i])) {
+			destroyEntry(entries[i]);
+		} else {
+			if (kept != i)
+				entries[kept] = entries[i];
+			++kept;
+		}
+	}
+	entries.resize(kept); // only shrinks, doesn't allocate
+}
+
+void DeletionQueue::flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const Entry& entry : entries)
+		destroyEntry(entry);
+	entries.clear();
+}
+
+size_t DeletionQueue::pending() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return entries.size();
+}
+
+void DeletionQueue::destroyEntry(const Entry& entry) {
+	switch (entry.type) {
+	case Type::Buffer: vkDestroyBuffer(device, fromBits<VkBuffer>(entry.handle), nullptr); break;
+	case Type::Image: vkDestroyImage(device, fromBits<VkImage>(entry.handle), nullptr); break;
+	case Type::ImageView: vkDestroyImageView(device, fromBits<VkImageView>(entry.handle), nullptr); break;
+	case Type::Memory: freeDeviceMemory(device, fromBits<VkDeviceMemory>(entry.handle)); break;
+	case Type::Pipeline: vkDestroyPipeline(device, fromBits<VkPipeline>(entry.handle), nullptr); break;
+	case Type::PipelineLayout: vkDestroyPipelineLayout(device, fromBits<VkPipelineLayout>(entry.handle), nullptr); break;
+	case Type::RenderPass: vkDestroyRenderPass(device, fromBits<VkRenderPass>(entry.handle), nullptr); break;
+	case Type::Framebuffer: vkDestroyFramebuffer(device, fromBits<VkFramebuffer>(entry.handle), nullptr); break;
+	case Type::DescriptorPool: freeDescriptorPool(device, fromBits<VkDescriptorPool>(entry.handle)); break;
+	case Type::CommandBuffer: {
+		VkCommandBuffer commandBuffer = fromBits<VkCommandBuffer>(entry.handle);
+		vkFreeCommandBuffers(device, entry.pool, 1, &commandBuffer);
+		break;
+	}
+	case Type::Swapchain:
+		vkDestroySwapchainKHR(device, fromBits<VkSwapchainKHR>(entry.handle), nullptr);
+		vkDestroyFence(device, entry.fence, nullptr); // VK_NULL_HANDLE without the present fences
+		break;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+class GpuTimeline;
+
+// Deferred destruction. Instead of draining the GPU before destroying something it might still be using, the object is queued together with the
+// timeline values of the submissions that could have used it, and it's only destroyed once both timelines have passed them. collect() is called
+// once per frame and only polls the (cached) timeline counters, so replacing resources at runtime never stalls.
+// A retire point covers the graphics submission currently being recorded and every compute submission made so far - queue compute resources after
+// the compute submission that last used them (drawFrame submits compute before graphics, so between frames or during graphics recording is fine).
+// Swap chains are the exception: presents aren't on either timeline. One is retired by the fence of its last present (VK_EXT_swapchain_maintenance1),
+// or it waits until retireSwapchains() gives it a retire point, once the caller knows the presentation engine has moved on to the new swap chain.
+class DeletionQueue {
+public:
+	struct RetirePoint {
+		uint64_t graphicsValue = 0;
+		uint64_t computeValue = 0;
+	};
+
+	void init(VkDevice device, GpuTimeline& graphicsTimeline, GpuTimeline& computeTimeline);
+	void destroy(); // device must be idle, destroys everything still queued
+
+	RetirePoint currentRetirePoint() const;
+
+	void destroyBuffer(VkBuffer buffer) { push(Type::Buffer, handleBits(buffer)); }
+	void destroyImage(VkImage image) { push(Type::Image, handleBits(image)); }
+	void destroyImageView(VkImageView imageView) { push(Type::ImageView, handleBits(imageView)); }
+	void freeMemory(VkDeviceMemory memory) { push(Type::Memory, handleBits(memory)); }
+	void destroyPipeline(VkPipeline pipeline) { push(Type::Pipeline, handleBits(pipeline)); }
+	void destroyPipelineLayout(VkPipelineLayout pipelineLayout) { push(Type::PipelineLayout, handleBits(pipelineLayout)); }
+	void destroyRenderPass(VkRenderPass renderPass) { push(Type::RenderPass, handleBits(renderPass)); }
+	void destroyFramebuffer(VkFramebuffer framebuffer) { push(Type::Framebuffer, handleBits(framebuffer)); }
+	void destroyDescriptorPool(VkDescriptorPool descriptorPool) { push(Type::DescriptorPool, handleBits(descriptorPool)); } // frees its sets too
+	void freeCommandBuffer(VkCommandPool pool, VkCommandBuffer commandBuffer) { push(Type::CommandBuffer, handleBits(commandBuffer), pool); }
+	// the queue takes the fence over, the swap chain and the fence are destroyed once it's signaled
+	void destroySwapchain(VkSwapchainKHR swapchain, VkFence lastPresentFence);
+	void destroySwapchain(VkSwapchainKHR swapchain); // held back until the next retireSwapchains()
+	void retireSwapchains(const RetirePoint& retire); // gives the held back swap chains their retire point
+
+	void collect(); // destroys everything whose retire point has been reached, whatever is queued around it. never blocks
+	void flush(); // destroys everything, device must be idle
+	size_t pending() const;
+
+private:
+	enum class Type { Buffer, Image, ImageView, Memory, Pipeline, PipelineLayout, RenderPass, Framebuffer, DescriptorPool, CommandBuffer, Swapchain };
+	struct Entry {
+		RetirePoint retire;
+		Type type;
+		uint64_t handle; // dispatchable handles are pointers and non-dispatchable ones are 64 bit on 64 bit builds, both fit
+		VkCommandPool pool; // only for command buffers
+		VkFence fence; // only for swap chains, its last present's. has to be signaled too
+		bool retireKnown; // false for swap chains waiting on retireSwapchains()
+	};
+
+	template<typename T>
+	static uint64_t handleBits(T handle) {
+		static_assert(sizeof(T) <= sizeof(uint64_t), "handle doesn't fit");
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(T));
+		return bits;
+	}
+	template<typename T>
+	static T fromBits(uint64_t bits) {
+		T handle;
+		std::memcpy(&handle, &bits, sizeof(T));
+		return handle;
+	}
+
+	void push(Type type, uint64_t handle, VkCommandPool pool = VK_NULL_HANDLE, const RetirePoint* retire = nullptr); // null retire = currentRetirePoint()
+	bool isRetired(const Entry& entry) const;
+	void destroyEntry(const Entry& entry);
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuTimeline* graphicsTimeline = nullptr;
+	GpuTimeline* computeTimeline = nullptr;
+	mutable std::mutex mutex; // frame tasks can queue things too
+	std::deque<Entry> entries; // mostly in retire order, but swap chains and the odd later retire point are skipped over, not waited for
+};
@@ -0,0 +1,259 @@
+#include "DepthPyramid.h"
+
+#include "DeletionQueue.h"
+#include "DescriptorAllocator.h"
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+	const uint32_t GROUP_SIZE = 8; // 8x8 workgroups, one thread per texel of the level written
+
+	uint32_t previousPowerOfTwo(uint32_t value) {
+		uint32_t result = 1;
+		while (result * 2 <= value)
+			result *= 2;
+		return result;
+	}
+}
+
+void DepthPyramid::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DescriptorSetCache& descriptorCache, VkShaderModule buildShader, VkShaderModule multisampledShader) {
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	this->descriptorCache = &descriptorCache;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid sampler!");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	for (uint32_t i = 0; i < 2; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &buildSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid descriptor set layout!");
+	layoutInfo.bindingCount = 1; // the sampler only
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create depth pyramid descriptor set layout!");
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(BuildParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &buildSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &buildPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid pipeline layout!");
+	}
+
+	buildPipeline = createBuildPipeline(buildShader);
+	multisampledPipeline = createBuildPipeline(multisampledShader);
+}
+
+void DepthPyramid::destroy() {
+	vkDestroyPipeline(device, multisampledPipeline, nullptr);
+	vkDestroyPipeline(device, buildPipeline, nullptr);
+	vkDestroyPipelineLayout(device, buildPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, buildSetLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+}
+
+VkPipeline DepthPyramid::createBuildPipeline(VkShaderModule shader) {
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = buildPipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid pipeline!");
+	}
+	return pipeline;
+}
+
+uint32_t DepthPyramid::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void DepthPyramid::createTargets(VkExtent2D swapChainExtent, VkImageView depth, VkSampleCountFlagBits depthSamples) {
+	// less than 2 depth texels per level 0 texel in either direction, so the first reduction reads at most 3x3 of them
+	levelZeroExtent = { previousPowerOfTwo(swapChainExtent.width), previousPowerOfTwo(swapChainExtent.height) };
+	levels = 1;
+	while (levels < MAX_LEVELS && (levelZeroExtent.width >> levels | levelZeroExtent.height >> levels) != 0)
+		++levels;
+	multisampledDepth = depthSamples != VK_SAMPLE_COUNT_1_BIT;
+	hasContents = false;
+	imageInitialized = false;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = FORMAT;
+	imageInfo.extent = { levelZeroExtent.width, levelZeroExtent.height, 1 };
+	imageInfo.mipLevels = levels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // every level is written by one dispatch and read by the next one and the culling
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &pyramidImage) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid image!");
+	}
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, pyramidImage, &memRequirements);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (allocateDeviceMemory(device, allocInfo, MemoryCategory::Images, pyramidMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate depth pyramid memory!");
+	}
+	vkBindImageMemory(device, pyramidImage, pyramidMemory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = pyramidImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = FORMAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+	if (vkCreateImageView(device, &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create depth pyramid image view!");
+	}
+	for (uint32_t level = 0; level < levels; ++level) { // storage images are bound one level at a time
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create depth pyramid image view!");
+		}
+	}
+
+	// level 0 reads the depth buffer (shader readable, the render graph transitions it), the others the level before them, which is still in GENERAL
+	// from being written. without a depth buffer there's nothing to build from, there are no build sets then. every set binds a view of the
+	// pyramid, so destroyTargets() forgetting those retires them all
+	for (uint32_t level = 0; level < levels && depth != VK_NULL_HANDLE; ++level) {
+		DescriptorBinding bindings[2] = {
+			level == 0 ? DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, depth, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+				: DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levelViews[level - 1], sampler, VK_IMAGE_LAYOUT_GENERAL),
+			DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levelViews[level], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL),
+		};
+		buildSets[level] = descriptorCache->get(buildSetLayout, bindings, 2);
+	}
+
+	DescriptorBinding pyramidBinding = DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramidView, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	cullSet = descriptorCache->get(cullSetLayout, &pyramidBinding, 1);
+}
+
+void DepthPyramid::destroyTargets(DeletionQueue& deletionQueue) {
+	if (!hasTargets())
+		return;
+	for (uint32_t level = 0; level < levels; ++level) {
+		descriptorCache->forget(levelViews[level]); // the build sets, reused for the next swap chain's once the previous frames are done with them
+		deletionQueue.destroyImageView(levelViews[level]);
+		levelViews[level] = VK_NULL_HANDLE;
+	}
+	descriptorCache->forget(pyramidView); // the cull set
+	deletionQueue.destroyImageView(pyramidView);
+	deletionQueue.destroyImage(pyramidImage);
+	deletionQueue.freeMemory(pyramidMemory);
+	pyramidView = VK_NULL_HANDLE;
+	pyramidImage = VK_NULL_HANDLE;
+	pyramidMemory = VK_NULL_HANDLE;
+	cullSet = VK_NULL_HANDLE;
+	hasContents = false;
+}
+
+void DepthPyramid::recordInitialTransition(VkCommandBuffer commandBuffer) {
+	if (imageInitialized)
+		return;
+	imageInitialized = true;
+
+	// the contents don't matter, nothing tests against the pyramid before the first build (built())
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+	barrier.srcAccessMask = VK_ACCESS_2_NONE;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = pyramidImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void DepthPyramid::recordBuild(VkCommandBuffer commandBuffer, VkExtent2D renderExtent) {
+	BuildParams params{};
+	params.sourceWidth = renderExtent.width;
+	params.sourceHeight = renderExtent.height;
+	for (uint32_t level = 0; level < levels; ++level) {
+		params.width = std::max(levelZeroExtent.width >> level, 1u);
+		params.height = std::max(levelZeroExtent.height >> level, 1u);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, level == 0 && multisampledDepth ? multisampledPipeline : buildPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, buildPipelineLayout, 0, 1, &buildSets[level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, buildPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+		vkCmdDispatch(commandBuffer, (params.width + GROUP_SIZE - 1) / GROUP_SIZE, (params.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+		// the next level reads this one. the last one is left to the render graph's barrier before the culling
+		if (level + 1 < levels) {
+			VkImageMemoryBarrier2 barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+			barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.image = pyramidImage;
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			VkDependencyInfo dependencyInfo{};
+			dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+			dependencyInfo.imageMemoryBarrierCount = 1;
+			dependencyInfo.pImageMemoryBarriers = &barrier;
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+
+		params.sourceWidth = params.width;
+		params.sourceHeight = params.height;
+	}
+	hasContents = true;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+class DeletionQueue;
+class DescriptorSetCache;
+
+// Hierarchical depth (Hi-Z) for occlusion culling. A mip chain of the scene depth where every texel holds the farthest depth of the area it covers:
+// an object whose nearest depth is behind the farthest depth of the pyramid texels its screen rectangle touches is hidden by what was drawn there.
+// recordBuild() fills it with Shaders/depth_pyramid.comp, one dispatch per level, each reducing the one above it (the first one the depth buffer,
+// through the MULTISAMPLED variant with MSAA). Level 0 is the largest power of two that fits the swap chain, so every level after it halves exactly,
+// and it always covers the rendered part of the depth (the dynamic resolution's render extent), whatever size that has this frame.
+// Between frames and outside the build the whole chain is left shader readable: the culling samples it, and the render graph imports it with that
+// state. Sized for the swap chain and recreated with it (createTargets/destroyTargets), the pipelines live as long as the pyramid (init/destroy).
+// The descriptor sets come from the DescriptorSetCache, a recreation reuses the old ones.
+
+class DepthPyramid {
+public:
+	static const uint32_t MAX_LEVELS = 16; // up to 32768 texels across
+	static const VkFormat FORMAT = VK_FORMAT_R32_SFLOAT;
+
+	// buildShader reduces a single sampled source, multisampledShader a multisampled depth buffer
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DescriptorSetCache& descriptorCache, VkShaderModule buildShader, VkShaderModule multisampledShader);
+	void destroy(); // destroyTargets() first
+
+	// depth is the main pass's depth buffer (swap chain sized, depthSamples samples), the pyramid starts out empty. a null depth leaves it sample only:
+	// the culling still has a valid set to bind, but recordBuild() can't be used
+	void createTargets(VkExtent2D swapChainExtent, VkImageView depth, VkSampleCountFlagBits depthSamples);
+	void destroyTargets(DeletionQueue& deletionQueue); // the previous frames may still be using it. no-op without targets
+	bool hasTargets() const { return pyramidImage != VK_NULL_HANDLE; }
+	void recordInitialTransition(VkCommandBuffer commandBuffer); // once after createTargets(), before the first render graph that imports the pyramid
+
+	// recording, outside any render pass: the depth shader readable, the pyramid in GENERAL. renderExtent is the part of the depth that was rendered.
+	// needs the targets created with a depth buffer
+	void recordBuild(VkCommandBuffer commandBuffer, VkExtent2D renderExtent);
+	bool built() const { return hasContents; } // a build has been recorded since createTargets(), so the next frame can test against it
+
+	VkImage image() const { return pyramidImage; }
+	VkImageView view() const { return pyramidView; } // all levels
+	VkExtent2D extent() const { return levelZeroExtent; }
+	uint32_t levelCount() const { return levels; }
+
+	// the set the culling shaders sample the pyramid through: binding 0, a combined image sampler (nearest, all levels), shader readable layout
+	VkDescriptorSetLayout sampleSetLayout() const { return cullSetLayout; }
+	VkDescriptorSet sampleSet() const { return cullSet; }
+
+private:
+	// mirrors the push constants of Shaders/depth_pyramid.comp
+	struct BuildParams {
+		uint32_t sourceWidth; // the part of the source that holds depth
+		uint32_t sourceHeight;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	VkPipeline createBuildPipeline(VkShaderModule shader);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	DescriptorSetCache* descriptorCache = nullptr;
+	VkSampler sampler = VK_NULL_HANDLE; // nearest, clamped to the edge. the shaders only texelFetch
+	VkDescriptorSetLayout buildSetLayout = VK_NULL_HANDLE; // 0 source, 1 the level written (storage)
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout buildPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline buildPipeline = VK_NULL_HANDLE;
+	VkPipeline multisampledPipeline = VK_NULL_HANDLE;
+
+	// per swap chain
+	VkExtent2D levelZeroExtent = { 0, 0 };
+	uint32_t levels = 0;
+	bool multisampledDepth = false;
+	VkImage pyramidImage = VK_NULL_HANDLE;
+	VkDeviceMemory pyramidMemory = VK_NULL_HANDLE;
+	VkImageView pyramidView = VK_NULL_HANDLE;
+	VkImageView levelViews[MAX_LEVELS] = {};
+	VkDescriptorSet buildSets[MAX_LEVELS] = {}; // by the level written
+	VkDescriptorSet cullSet = VK_NULL_HANDLE;
+	bool hasContents = false;
+	bool imageInitialized = false;
+};
@@ -0,0 +1,252 @@
+#include "DescriptorAllocator.h"
+
+#include "GpuTimeline.h"
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<DescriptorAllocator::PoolRatio> DescriptorAllocator::defaultRatios() {
+	return {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+	};
+}
+
+void DescriptorAllocator::init(VkDevice device, uint32_t firstPoolSets, const std::vector<PoolRatio>& ratios) {
+	this->device = device;
+	this->ratios = ratios;
+	nextPoolSets = std::max(firstPoolSets, 1u);
+}
+
+void DescriptorAllocator::destroy() {
+	for (VkDescriptorPool pool : readyPools)
+		freeDescriptorPool(device, pool); // frees the sets too
+	for (VkDescriptorPool pool : fullPools)
+		freeDescriptorPool(device, pool);
+	readyPools.clear();
+	fullPools.clear();
+	used = false;
+	allocatedSets = 0;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool(uint32_t sets) {
+	VkDescriptorPoolSize sizes[8];
+	uint32_t sizeCount = std::min(static_cast<uint32_t>(ratios.size()), 8u);
+	for (uint32_t i = 0; i < sizeCount; ++i)
+		sizes[i] = { ratios[i].type, std::max(static_cast<uint32_t>(ratios[i].perSet * sets), 1u) };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = sets;
+	poolInfo.poolSizeCount = sizeCount;
+	poolInfo.pPoolSizes = sizes;
+	VkDescriptorPool pool;
+	if (allocateDescriptorPool(device, poolInfo, pool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create descriptor pool!");
+	return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::readyPool() {
+	if (readyPools.empty()) {
+		readyPools.push_back(createPool(nextPoolSets));
+		nextPoolSets = std::min(nextPoolSets * 2, static_cast<uint32_t>(MAX_POOL_SETS)); // the more pools it took, the more sets there probably are to come. the cast makes a copy, std::min would take the constant by reference and it has no definition
+	}
+	return readyPools.back();
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	// a full pool is only known to be full when an allocation from it fails, then the set goes to a fresh one. failing there too means the set
+	// needs more than a whole pool holds (the ratios don't fit its layout)
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	for (int attempt = 0; attempt < 2; ++attempt) {
+		allocInfo.descriptorPool = readyPool();
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+		if (result == VK_SUCCESS) {
+			used = true;
+			++allocatedSets;
+			return set;
+		}
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+			break;
+		fullPools.push_back(readyPools.back());
+		readyPools.pop_back();
+	}
+	throw std::runtime_error("Failed to allocate descriptor set!");
+}
+
+void DescriptorAllocator::reset() {
+	if (!used)
+		return;
+	for (VkDescriptorPool pool : readyPools)
+		vkResetDescriptorPool(device, pool, 0);
+	for (VkDescriptorPool pool : fullPools) {
+		vkResetDescriptorPool(device, pool, 0);
+		readyPools.push_back(pool);
+	}
+	fullPools.clear();
+	used = false;
+	allocatedSets = 0;
+}
+
+DescriptorBinding DescriptorBinding::buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	DescriptorBinding result;
+	result.binding = binding;
+	result.type = type;
+	result.resource = DescriptorSetCache::handleBits(buffer);
+	result.offset = offset;
+	result.range = range;
+	return result;
+}
+
+DescriptorBinding DescriptorBinding::image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout imageLayout) {
+	DescriptorBinding result;
+	result.binding = binding;
+	result.type = type;
+	result.resource = DescriptorSetCache::handleBits(view);
+	result.sampler = DescriptorSetCache::handleBits(sampler);
+	result.imageLayout = imageLayout;
+	return result;
+}
+
+bool DescriptorBinding::operator==(const DescriptorBinding& other) const {
+	return binding == other.binding && type == other.type && resource == other.resource && sampler == other.sampler && offset == other.offset &&
+		range == other.range && imageLayout == other.imageLayout;
+}
+
+void DescriptorSetCache::init(VkDevice device, GpuTimeline& timeline) {
+	this->device = device;
+	this->timeline = &timeline;
+	allocator.init(device);
+}
+
+void DescriptorSetCache::destroy() {
+	allocator.destroy(); // all the sets, cached, retired and free, came from it
+	entries.clear();
+	retired.clear();
+	freeSets.clear();
+	cacheStats.cached = 0;
+}
+
+uint64_t DescriptorSetCache::hashKey(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count) {
+	// FNV-1a over the fields, not the struct's bytes, the padding isn't guaranteed to be zero
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](uint64_t value) {
+		for (int i = 0; i < 8; ++i) {
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= 1099511628211ull;
+		}
+	};
+	mix(handleBits(layout));
+	for (uint32_t i = 0; i < count; ++i) {
+		mix(bindings[i].binding | (static_cast<uint64_t>(bindings[i].type) << 32));
+		mix(bindings[i].resource);
+		mix(bindings[i].sampler);
+		mix(bindings[i].offset);
+		mix(bindings[i].range);
+		mix(static_cast<uint64_t>(bindings[i].imageLayout));
+	}
+	return hash;
+}
+
+VkDescriptorSet DescriptorSetCache::get(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count) {
+	if (count > MAX_BINDINGS)
+		throw std::runtime_error("Too many bindings for a cached descriptor set!");
+	uint64_t hash = hashKey(layout, bindings, count);
+	auto range = entries.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it) {
+		const Entry& entry = it->second;
+		if (entry.layout == layout && entry.bindings.size() == count && std::equal(bindings, bindings + count, entry.bindings.begin())) {
+			++cacheStats.hits;
+			return entry.set;
+		}
+	}
+
+	// a miss: a set the GPU is done with if there is one for the layout, a new one otherwise
+	++cacheStats.misses;
+	VkDescriptorSet set;
+	auto free = freeSets.find(layout);
+	if (free != freeSets.end() && !free->second.empty()) {
+		set = free->second.back();
+		free->second.pop_back();
+		++cacheStats.reused;
+	} else {
+		set = allocator.allocate(layout);
+	}
+	write(set, bindings, count);
+	entries.emplace(hash, Entry{ layout, std::vector<DescriptorBinding>(bindings, bindings + count), set });
+	cacheStats.cached = entries.size();
+	return set;
+}
+
+void DescriptorSetCache::write(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t count) {
+	VkDescriptorBufferInfo bufferInfos[MAX_BINDINGS];
+	VkDescriptorImageInfo imageInfos[MAX_BINDINGS];
+	VkWriteDescriptorSet writes[MAX_BINDINGS]{};
+	for (uint32_t i = 0; i < count; ++i) {
+		const DescriptorBinding& binding = bindings[i];
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = binding.binding;
+		writes[i].dstArrayElement = 0;
+		writes[i].descriptorType = binding.type;
+		writes[i].descriptorCount = 1;
+		switch (binding.type) {
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+		case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+		case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
+			VkBuffer buffer;
+			std::memcpy(&buffer, &binding.resource, sizeof(buffer));
+			bufferInfos[i] = { buffer, binding.offset, binding.range };
+			writes[i].pBufferInfo = &bufferInfos[i];
+			break;
+		}
+		default: {
+			VkImageView view;
+			VkSampler sampler;
+			std::memcpy(&view, &binding.resource, sizeof(view));
+			std::memcpy(&sampler, &binding.sampler, sizeof(sampler));
+			imageInfos[i] = { sampler, view, binding.imageLayout };
+			writes[i].pImageInfo = &imageInfos[i];
+			break;
+		}
+		}
+	}
+	vkUpdateDescriptorSets(device, count, writes, 0, nullptr);
+}
+
+void DescriptorSetCache::forgetResource(uint64_t resource) {
+	uint64_t retireValue = timeline->nextValue(); // the frame being recorded might use the set too
+	for (auto it = entries.begin(); it != entries.end();) {
+		const Entry& entry = it->second;
+		bool references = std::any_of(entry.bindings.begin(), entry.bindings.end(), [resource](const DescriptorBinding& binding) { return binding.resource == resource; });
+		if (references) {
+			retired.push_back({ entry.layout, entry.set, retireValue });
+			// room on the free list now, collect() runs in the frame, where nothing should allocate
+			std::vector<VkDescriptorSet>& free = freeSets[entry.layout];
+			VkDescriptorSetLayout layout = entry.layout;
+			free.reserve(free.size() + std::count_if(retired.begin(), retired.end(), [layout](const RetiredSet& set) { return set.layout == layout; }));
+			it = entries.erase(it);
+		} else {
+			++it;
+		}
+	}
+	cacheStats.cached = entries.size();
+}
+
+void DescriptorSetCache::collect() {
+	if (retired.empty())
+		return;
+	auto reached = std::stable_partition(retired.begin(), retired.end(), [this](const RetiredSet& set) { return !timeline->isComplete(set.retireValue); });
+	for (auto it = reached; it != retired.end(); ++it)
+		freeSets[it->layout].push_back(it->set); // rewritten by the get() that takes it
+	retired.erase(reached, retired.end());
+}
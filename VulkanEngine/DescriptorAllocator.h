@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+class GpuTimeline;
+
+// Descriptor sets without sizing a pool for each use up front.
+// DescriptorAllocator hands out sets of any layout from a list of pools. When a pool runs out (VK_ERROR_OUT_OF_POOL_MEMORY/FRAGMENTED_POOL) the next
+// one is started, each twice the size of the one before, so a few pools cover however many sets end up being needed. reset() returns every set at
+// once with vkResetDescriptorPool and keeps the pools for reuse - one allocator per frame in flight, reset when the frame's previous submission has
+// finished, gives sets that live for one frame without ever freeing them one by one.
+// DescriptorSetCache keeps sets that don't change. A set is looked up by its layout and what is bound to it, hashed; the first get() allocates and
+// writes it, every later one is a hash lookup, so a frame that draws the same materials as the last one does no descriptor work at all. When a
+// bound resource goes away, forget() drops the sets that reference it. They go back to a free list for their layout once the GPU is done with them,
+// so replacing resources (a swap chain recreation) reuses the sets instead of growing the pools.
+
+class DescriptorAllocator {
+public:
+	struct PoolRatio {
+		VkDescriptorType type;
+		float perSet; // descriptors of the type in a pool, per set the pool is sized for
+	};
+
+	// the default ratios cover the layouts in the engine, a set that needs more of a type than its pool has left just goes to the next pool
+	void init(VkDevice device, uint32_t firstPoolSets = 64, const std::vector<PoolRatio>& ratios = defaultRatios());
+	void destroy(); // the sets mustn't be in use anymore
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout); // throws if even a fresh pool can't hold the set
+	void reset(); // every set allocated since the last reset is invalid after this. pools that weren't used are skipped, an idle reset costs nothing
+
+	uint32_t poolCount() const { return static_cast<uint32_t>(readyPools.size() + fullPools.size()); }
+	uint64_t setCount() const { return allocatedSets; } // since the last reset
+
+	static std::vector<PoolRatio> defaultRatios();
+
+private:
+	static const uint32_t MAX_POOL_SETS = 4096;
+	VkDescriptorPool createPool(uint32_t sets);
+	VkDescriptorPool readyPool(); // the pool to allocate from, a new one if there is none with room left
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::vector<PoolRatio> ratios;
+	uint32_t nextPoolSets = 0;
+	std::vector<VkDescriptorPool> readyPools; // might have room, the back one is allocated from
+	std::vector<VkDescriptorPool> fullPools; // ran out since the last reset
+	bool used = false; // anything allocated since the last reset
+	uint64_t allocatedSets = 0;
+};
+
+// what is bound to one binding of a cached set. only the fields of its kind are set, the rest stay zero so the key compares and hashes the same
+struct DescriptorBinding {
+	uint32_t binding = 0;
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uint64_t resource = 0; // VkBuffer or VkImageView
+	uint64_t sampler = 0;
+	VkDeviceSize offset = 0;
+	VkDeviceSize range = 0;
+	VkImageLayout imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	static DescriptorBinding buffer(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	static DescriptorBinding image(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout imageLayout);
+	bool operator==(const DescriptorBinding& other) const;
+};
+
+class DescriptorSetCache {
+public:
+	struct Stats {
+		uint64_t hits = 0; // since init
+		uint64_t misses = 0; // sets written
+		uint64_t reused = 0; // of the misses, the ones that got a forgotten set instead of a new one
+		size_t cached = 0;
+	};
+
+	static const uint32_t MAX_BINDINGS = 16; // per set
+
+	// the cached sets are used by submissions on timeline, forgotten ones are reused once it has passed them
+	void init(VkDevice device, GpuTimeline& timeline);
+	void destroy(); // the sets mustn't be in use anymore
+
+	// the set with exactly these bindings, written on the first call. the bindings don't need to be sorted but have to come in the same order every time
+	VkDescriptorSet get(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+	// drops the sets that bind the resource (a VkBuffer or VkImageView), before it is destroyed. the sets can be in flight still
+	template<typename T>
+	void forget(T resource) { forgetResource(handleBits(resource)); }
+	void collect(); // once per frame, puts the forgotten sets the GPU is done with on the free lists. never blocks
+
+	const Stats& stats() const { return cacheStats; }
+
+	template<typename T>
+	static uint64_t handleBits(T handle) { // like DeletionQueue's, non dispatchable handles are plain integers on 32 bit builds
+		static_assert(sizeof(T) <= sizeof(uint64_t), "handle doesn't fit");
+		uint64_t bits = 0;
+		std::memcpy(&bits, &handle, sizeof(T));
+		return bits;
+	}
+
+private:
+	struct Entry {
+		VkDescriptorSetLayout layout;
+		std::vector<DescriptorBinding> bindings; // allocated on a miss only, a hit compares against it in place
+		VkDescriptorSet set;
+	};
+	struct RetiredSet {
+		VkDescriptorSetLayout layout;
+		VkDescriptorSet set;
+		uint64_t retireValue;
+	};
+
+	static uint64_t hashKey(VkDescriptorSetLayout layout, const DescriptorBinding* bindings, uint32_t count);
+	void forgetResource(uint64_t resource);
+	void write(VkDescriptorSet set, const DescriptorBinding* bindings, uint32_t count);
+
+	VkDevice device = VK_NULL_HANDLE;
+	GpuTimeline* timeline = nullptr;
+	DescriptorAllocator allocator; // never reset, the sets are recycled through the free lists instead
+	std::unordered_multimap<uint64_t, Entry> entries; // by hashKey()
+	std::vector<RetiredSet> retired;
+	std::unordered_map<VkDescriptorSetLayout, std::vector<VkDescriptorSet>> freeSets;
+	Stats cacheStats;
+};
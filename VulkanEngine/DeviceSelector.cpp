@@ -0,0 +1,161 @@
+#include "DeviceSelector.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+	const uint64_t TYPE_TIER_POINTS = 1000000; // more than the VRAM cap plus every queue/feature bonus
+	const uint64_t POINTS_PER_GIB = 100;
+	const uint64_t MAX_VRAM_GIB = 1024;
+	const uint64_t ASYNC_COMPUTE_POINTS = 500;
+	const uint64_t DEDICATED_TRANSFER_POINTS = 250;
+	const uint64_t MESH_SHADER_POINTS = 250;
+
+	uint64_t typeTier(VkPhysicalDeviceType type) {
+		switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1; // software rasterizers like lavapipe/SwiftShader, only if there is nothing else
+		default: return 0;
+		}
+	}
+
+	bool hasExtension(VkPhysicalDevice device, const char* name) {
+		uint32_t extensionCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+		return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+	}
+
+	bool hasMeshShaders(VkPhysicalDevice device, uint32_t apiVersion) {
+		if (apiVersion < VK_API_VERSION_1_1) // vkGetPhysicalDeviceFeatures2 is core from 1.1
+			return false;
+		if (!hasExtension(device, VK_EXT_MESH_SHADER_EXTENSION_NAME))
+			return false;
+
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &meshShaderFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+		return meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+	}
+
+	bool hasSwapchainMaintenance(VkPhysicalDevice device, uint32_t apiVersion) {
+		if (apiVersion < VK_API_VERSION_1_1 || !hasExtension(device, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME))
+			return false;
+
+		VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT maintenanceFeatures{};
+		maintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &maintenanceFeatures;
+		vkGetPhysicalDeviceFeatures2(device, &features);
+		return maintenanceFeatures.swapchainMaintenance1 == VK_TRUE;
+	}
+
+	std::string toLower(std::string text) {
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	}
+}
+
+DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device, uint32_t index) {
+	DeviceCapabilities capabilities;
+	capabilities.device = device;
+	capabilities.index = index;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	capabilities.name = properties.deviceName;
+	capabilities.type = properties.deviceType;
+	capabilities.apiVersion = properties.apiVersion;
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			capabilities.deviceLocalMemory = std::max(capabilities.deviceLocalMemory, memoryProperties.memoryHeaps[i].size);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	for (const VkQueueFamilyProperties& family : queueFamilies) {
+		bool graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		bool compute = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		if (compute && !graphics)
+			capabilities.asyncCompute = true;
+		if ((family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute)
+			capabilities.dedicatedTransfer = true;
+	}
+
+	capabilities.meshShaders = hasMeshShaders(device, properties.apiVersion);
+	capabilities.memoryBudget = properties.apiVersion >= VK_API_VERSION_1_1 && hasExtension(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME); // read through vkGetPhysicalDeviceMemoryProperties2
+	capabilities.swapchainMaintenance = hasSwapchainMaintenance(device, properties.apiVersion); // also needs VK_EXT_surface_maintenance1 on the instance, the caller checks
+	capabilities.score = scoreDevice(capabilities);
+	return capabilities;
+}
+
+uint64_t scoreDevice(const DeviceCapabilities& capabilities) {
+	uint64_t score = typeTier(capabilities.type) * TYPE_TIER_POINTS;
+	uint64_t vramGib = std::min<uint64_t>(capabilities.deviceLocalMemory >> 30, MAX_VRAM_GIB);
+	score += vramGib * POINTS_PER_GIB;
+	if (capabilities.asyncCompute)
+		score += ASYNC_COMPUTE_POINTS;
+	if (capabilities.dedicatedTransfer)
+		score += DEDICATED_TRANSFER_POINTS;
+	if (capabilities.meshShaders)
+		score += MESH_SHADER_POINTS;
+	return score;
+}
+
+void rankDevices(std::vector<DeviceCapabilities>& devices) {
+	std::stable_sort(devices.begin(), devices.end(), [](const DeviceCapabilities& a, const DeviceCapabilities& b) { return a.score > b.score; });
+}
+
+bool matchesDeviceSelector(const DeviceCapabilities& capabilities, const std::string& selector) {
+	if (selector.empty())
+		return true;
+	bool numeric = std::all_of(selector.begin(), selector.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+	if (numeric)
+		return capabilities.index == static_cast<uint32_t>(std::strtoul(selector.c_str(), nullptr, 10));
+	return toLower(capabilities.name).find(toLower(selector)) != std::string::npos;
+}
+
+std::string deviceSelectorFromCommandLine(int argc, char** argv) {
+	for (int i = 1; i + 1 < argc; ++i)
+		if (strcmp(argv[i], "--device") == 0)
+			return argv[i + 1];
+	const char* environment = std::getenv("VULKAN_ENGINE_DEVICE");
+	return environment != nullptr ? environment : "";
+}
+
+const char* deviceTypeName(VkPhysicalDeviceType type) {
+	switch (type) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: return "CPU";
+	default: return "other";
+	}
+}
+
+void printDeviceRanking(const std::vector<DeviceCapabilities>& devices, const DeviceCapabilities* chosen, std::ostream& out) {
+	for (const DeviceCapabilities& device : devices) {
+		out << (&device == chosen ? " * " : "   ") << "[" << device.index << "] " << device.name << " (" << deviceTypeName(device.type) << ", "
+			<< (device.deviceLocalMemory >> 20) << " MiB";
+		if (device.asyncCompute)
+			out << ", async compute";
+		if (device.dedicatedTransfer)
+			out << ", transfer queue";
+		if (device.meshShaders)
+			out << ", mesh shaders";
+		out << ") score " << device.score << std::endl;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Physical device ranking. Every device that passes the hard requirements (the caller checks those, eg isDeviceSuitable) gets a score, and the
+// highest one is used unless the user asked for a specific device. The score, most significant first:
+//  device type   - discrete > integrated > virtual > CPU, a tier is worth more than everything below it put together
+//  VRAM          - the largest DEVICE_LOCAL heap, 100 points per GiB
+//  queues        - a compute only family (async compute) and a transfer only family (copy engine)
+//  features      - optional ones the engine makes use of (mesh shaders)
+//
+// A device can be picked by hand with --device <index or name> on the command line, or the VULKAN_ENGINE_DEVICE environment variable. A number is
+// the index vkEnumeratePhysicalDevices gives the device, anything else matches a case insensitive substring of the device name.
+
+struct DeviceCapabilities {
+	VkPhysicalDevice device = VK_NULL_HANDLE;
+	uint32_t index = 0; // in vkEnumeratePhysicalDevices order, what a numeric override refers to
+	std::string name;
+	VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+	uint32_t apiVersion = 0;
+	VkDeviceSize deviceLocalMemory = 0; // size of the largest DEVICE_LOCAL heap. integrated GPUs report (part of) system memory here
+	bool asyncCompute = false; // has a queue family with compute but no graphics
+	bool dedicatedTransfer = false; // has a queue family with transfer only
+	bool meshShaders = false; // VK_EXT_mesh_shader with task and mesh shaders
+	bool memoryBudget = false; // VK_EXT_memory_budget, not scored, only the memory telemetry's budgets get better with it
+	bool swapchainMaintenance = false; // VK_EXT_swapchain_maintenance1, not scored either, old swap chains are retired by a present fence with it
+	uint64_t score = 0;
+};
+
+DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device, uint32_t index); // fills in the score too
+uint64_t scoreDevice(const DeviceCapabilities& capabilities);
+void rankDevices(std::vector<DeviceCapabilities>& devices); // best first, ties keep the enumeration order
+
+bool matchesDeviceSelector(const DeviceCapabilities& capabilities, const std::string& selector);
+std::string deviceSelectorFromCommandLine(int argc, char** argv); // --device wins over VULKAN_ENGINE_DEVICE, empty when neither is set
+
+const char* deviceTypeName(VkPhysicalDeviceType type);
+void printDeviceRanking(const std::vector<DeviceCapabilities>& devices, const DeviceCapabilities* chosen, std::ostream& out);
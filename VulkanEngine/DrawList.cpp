@@ -0,0 +1,218 @@
+#include "DrawList.h"
+
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <stdexcept>
+
+namespace {
+	const uint32_t STATE_BITS = DrawList::PIPELINE_BITS + DrawList::DESCRIPTOR_SET_BITS + DrawList::MATERIAL_BITS + DrawList::MESH_BITS;
+	const uint64_t STATE_MASK = (uint64_t(1) << STATE_BITS) - 1;
+	const uint64_t DEPTH_MAX = (uint64_t(1) << DrawList::DEPTH_BITS) - 1;
+	const uint32_t RADIX_BITS = 8;
+	const uint32_t RADIX_BUCKETS = 1 << RADIX_BITS;
+
+	bool fits(uint32_t id, uint32_t bits) { return id < (uint32_t(1) << bits); }
+}
+
+void DrawList::setBlendedLayer(uint32_t layer, bool blended) {
+	if (!fits(layer, LAYER_BITS)) {
+		throw std::runtime_error("Draw list layer out of range!");
+	}
+	if (blended)
+		blendedLayers |= 1u << layer;
+	else
+		blendedLayers &= ~(1u << layer);
+}
+
+void DrawList::clear() {
+	keys.clear();
+	values.clear();
+	drawBatches.clear();
+	sortedValues.clear();
+	listStats = DrawListStats{};
+}
+
+void DrawList::add(const DrawState& state, float depth, uint32_t value) {
+	keys.push_back(makeKey(state, depth));
+	values.push_back(value);
+}
+
+uint64_t DrawList::makeKey(const DrawState& state, float depth) const {
+	if (!fits(state.layer, LAYER_BITS) || !fits(state.pipeline, PIPELINE_BITS) || !fits(state.descriptorSet, DESCRIPTOR_SET_BITS) ||
+		!fits(state.material, MATERIAL_BITS) || !fits(state.mesh, MESH_BITS)) {
+		throw std::runtime_error("Draw state id doesn't fit its sort key field!");
+	}
+	uint64_t stateBits = (uint64_t(state.pipeline) << (DESCRIPTOR_SET_BITS + MATERIAL_BITS + MESH_BITS)) | (uint64_t(state.descriptorSet) << (MATERIAL_BITS + MESH_BITS)) |
+		(uint64_t(state.material) << MESH_BITS) | uint64_t(state.mesh);
+	uint64_t depthBits = static_cast<uint64_t>(std::min(std::max(depth, 0.0f), 1.0f) * DEPTH_MAX + 0.5f);
+	uint64_t layerBits = uint64_t(state.layer) << (64 - LAYER_BITS);
+
+	if (blendedLayers & (1u << state.layer))
+		return layerBits | ((DEPTH_MAX - depthBits) << STATE_BITS) | stateBits; // far first
+	return layerBits | (stateBits << DEPTH_BITS) | depthBits; // near first inside a state group, the cheapest order for depth testing
+}
+
+DrawState DrawList::stateOf(uint64_t key) const {
+	DrawState state;
+	state.layer = static_cast<uint32_t>(key >> (64 - LAYER_BITS));
+	uint64_t stateBits = (blendedLayers & (1u << state.layer)) ? key & STATE_MASK : (key >> DEPTH_BITS) & STATE_MASK;
+	state.mesh = static_cast<uint32_t>(stateBits & ((1u << MESH_BITS) - 1));
+	state.material = static_cast<uint32_t>((stateBits >> MESH_BITS) & ((1u << MATERIAL_BITS) - 1));
+	state.descriptorSet = static_cast<uint32_t>((stateBits >> (MESH_BITS + MATERIAL_BITS)) & ((1u << DESCRIPTOR_SET_BITS) - 1));
+	state.pipeline = static_cast<uint32_t>(stateBits >> (MESH_BITS + MATERIAL_BITS + DESCRIPTOR_SET_BITS));
+	return state;
+}
+
+void DrawList::sort(JobSystem* jobSystem) {
+	radixSort(jobSystem);
+	buildBatches();
+}
+
+// LSD radix sort, 8 bits per pass. each pass is a histogram, a prefix sum and a stable scatter. in parallel every chunk of the list gets its own
+// histogram, and the prefix sum runs bucket by bucket over the chunks in order, so each chunk scatters into its own slots and the sort stays stable
+void DrawList::radixSort(JobSystem* jobSystem) {
+	uint32_t count = static_cast<uint32_t>(keys.size());
+	entries.resize(count);
+	scratch.resize(count);
+	if (count == 0)
+		return;
+
+	bool parallel = jobSystem != nullptr && count >= PARALLEL_SORT_THRESHOLD && jobSystem->workerCount() > 1;
+	uint32_t chunkCount = parallel ? jobSystem->workerCount() : 1;
+	uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	chunkHistograms.resize(static_cast<size_t>(chunkCount) * RADIX_BUCKETS);
+	chunkVarying.resize(chunkCount); // every chunk writes its own
+
+	auto forEachChunk = [&](const auto& function) { // function(chunk, begin, end)
+		auto runChunks = [&](uint32_t firstChunk, uint32_t lastChunk) {
+			for (uint32_t chunk = firstChunk; chunk < lastChunk; ++chunk)
+				function(chunk, std::min(count, chunk * chunkSize), std::min(count, (chunk + 1) * chunkSize));
+		};
+		if (parallel)
+			jobSystem->parallelFor(chunkCount, 1, runChunks);
+		else
+			runChunks(0, 1);
+	};
+
+	// gather the keys, and find the bytes that differ between any of them. a pass over a byte every key shares would only copy the list
+	forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+		uint64_t varying = 0;
+		for (uint32_t i = begin; i < end; ++i) {
+			entries[i] = SortEntry{ keys[i], values[i] };
+			varying |= keys[i] ^ keys[0];
+		}
+		chunkVarying[chunk] = varying;
+	});
+	uint64_t varying = 0;
+	for (uint64_t chunkBits : chunkVarying)
+		varying |= chunkBits;
+
+	for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+		if (((varying >> shift) & (RADIX_BUCKETS - 1)) == 0)
+			continue;
+
+		forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* histogram = &chunkHistograms[static_cast<size_t>(chunk) * RADIX_BUCKETS];
+			std::fill(histogram, histogram + RADIX_BUCKETS, 0u);
+			for (uint32_t i = begin; i < end; ++i)
+				++histogram[(entries[i].key >> shift) & (RADIX_BUCKETS - 1)];
+		});
+
+		uint32_t offset = 0;
+		for (uint32_t bucket = 0; bucket < RADIX_BUCKETS; ++bucket) {
+			for (uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+				uint32_t& slot = chunkHistograms[static_cast<size_t>(chunk) * RADIX_BUCKETS + bucket];
+				uint32_t bucketCount = slot;
+				slot = offset;
+				offset += bucketCount;
+			}
+		}
+
+		forEachChunk([&](uint32_t chunk, uint32_t begin, uint32_t end) {
+			uint32_t* offsets = &chunkHistograms[static_cast<size_t>(chunk) * RADIX_BUCKETS];
+			for (uint32_t i = begin; i < end; ++i)
+				scratch[offsets[(entries[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = entries[i];
+		});
+		entries.swap(scratch);
+	}
+}
+
+void DrawList::buildBatches() {
+	sortedValues.resize(entries.size());
+	drawBatches.clear();
+	listStats = DrawListStats{};
+	listStats.draws = static_cast<uint32_t>(entries.size());
+
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		sortedValues[i] = entries[i].value;
+		DrawState state = stateOf(entries[i].key);
+		if (!drawBatches.empty() && drawBatches.back().state == state) {
+			++drawBatches.back().instanceCount;
+			continue;
+		}
+
+		const DrawState* previous = drawBatches.empty() ? nullptr : &drawBatches.back().state;
+		bool pipelineChange = previous == nullptr || previous->pipeline != state.pipeline;
+		listStats.pipelineChanges += pipelineChange ? 1 : 0;
+		listStats.descriptorSetChanges += pipelineChange || previous->descriptorSet != state.descriptorSet ? 1 : 0;
+		listStats.materialChanges += previous == nullptr || previous->material != state.material ? 1 : 0;
+		listStats.meshChanges += previous == nullptr || previous->mesh != state.mesh ? 1 : 0;
+		drawBatches.push_back(DrawBatch{ state, i, 1 });
+	}
+	listStats.batches = static_cast<uint32_t>(drawBatches.size());
+}
+
+void benchmarkDrawList(JobSystem& jobSystem, std::ostream& out) {
+	using Clock = std::chrono::steady_clock;
+	const uint32_t sizes[] = { 1000, 10000, 100000, 1000000 };
+
+	out << "draw list sort, " << jobSystem.workerCount() << " workers. best of several runs, batch building included" << std::endl;
+	std::mt19937 random(1234); // fixed seed, runs are comparable
+	for (uint32_t size : sizes) {
+		// a scene-like spread: 256 kinds of object (a pipeline, set, material and mesh each) drawn many times over, a tenth of them blended
+		std::vector<DrawState> kinds(256);
+		for (DrawState& kind : kinds) {
+			kind.layer = random() % 10 == 0 ? 1 : 0;
+			kind.pipeline = random() % 8;
+			kind.descriptorSet = random() % 64;
+			kind.material = random() % 256;
+			kind.mesh = random() % 1024;
+		}
+		DrawList list;
+		list.setBlendedLayer(1, true);
+		std::vector<uint64_t> keys(size); // the same keys again for the std::sort comparison
+		for (uint32_t i = 0; i < size; ++i) {
+			const DrawState& state = kinds[random() % kinds.size()];
+			float depth = std::uniform_real_distribution<float>(0.0f, 1.0f)(random);
+			list.add(state, depth, i);
+			keys[i] = list.makeKey(state, depth);
+		}
+
+		uint32_t runs = std::max(3u, 2000000u / size);
+		auto bestOf = [&](const auto& function) {
+			double best = 1e30;
+			for (uint32_t run = 0; run < runs; ++run) {
+				Clock::time_point start = Clock::now();
+				function();
+				best = std::min(best, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+			}
+			return best;
+		};
+		double serialMs = bestOf([&]() { list.sort(nullptr); });
+		double parallelMs = bestOf([&]() { list.sort(&jobSystem); });
+		std::vector<uint64_t> sorted;
+		double stdSortMs = bestOf([&]() { sorted = keys; std::sort(sorted.begin(), sorted.end()); });
+
+		const DrawListStats& stats = list.stats();
+		auto rate = [size](double ms) { return size / (ms * 1000.0); }; // millions of draws per second
+		out << std::fixed << std::setprecision(3) << std::setw(8) << size << " draws: radix " << serialMs << " ms (" << std::setprecision(1) << rate(serialMs) << " M/s), "
+			<< std::setprecision(3) << "parallel radix " << parallelMs << " ms (" << std::setprecision(1) << rate(parallelMs) << " M/s), "
+			<< std::setprecision(3) << "std::sort " << stdSortMs << " ms (" << std::setprecision(1) << rate(stdSortMs) << " M/s) - "
+			<< stats.batches << " batches, " << stats.stateChanges() << " state changes (" << stats.pipelineChanges << " pipeline, " << stats.descriptorSetChanges
+			<< " set, " << stats.materialChanges << " material, " << stats.meshChanges << " mesh)" << std::endl;
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+class JobSystem;
+
+// Draw list: every draw of a pass is reduced to a 64 bit sort key plus a user value (an object/instance index), the keys are radix sorted, and runs
+// of draws with identical state come out as instanced batches. Walking the batches in order binds each pipeline, descriptor set, material and mesh
+// as few times as the sort allows instead of once per draw in whatever order the draws were submitted.
+//
+// Key layout, most significant bits first:
+//  default layers: layer 4 | pipeline 8 | descriptor set 12 | material 12 | mesh 12 | depth 16   - grouped by state, front to back inside a group
+//  blended layers: layer 4 | depth 16 (inverted) | pipeline 8 | descriptor set 12 | material 12 | mesh 12 - back to front, state only breaks ties
+// Layers are drawn in increasing order, so eg opaque geometry can be layer 0 and blended effects layer 1. Ids must fit their fields, add() throws otherwise.
+
+struct DrawState {
+	uint32_t layer = 0;
+	uint32_t pipeline = 0;
+	uint32_t descriptorSet = 0;
+	uint32_t material = 0;
+	uint32_t mesh = 0;
+
+	bool operator==(const DrawState& other) const {
+		return layer == other.layer && pipeline == other.pipeline && descriptorSet == other.descriptorSet && material == other.material && mesh == other.mesh;
+	}
+	bool operator!=(const DrawState& other) const { return !(*this == other); }
+};
+
+// consecutive draws with the same state, drawn as one instanced draw. the instances are instances()[firstInstance .. firstInstance + instanceCount)
+struct DrawBatch {
+	DrawState state;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+};
+
+// what walking the batches costs. a pipeline change rebinds the descriptor set as well, the layouts of two pipelines aren't necessarily compatible
+struct DrawListStats {
+	uint32_t draws = 0;
+	uint32_t batches = 0;
+	uint32_t pipelineChanges = 0;
+	uint32_t descriptorSetChanges = 0;
+	uint32_t materialChanges = 0;
+	uint32_t meshChanges = 0;
+
+	uint32_t stateChanges() const { return pipelineChanges + descriptorSetChanges + materialChanges + meshChanges; }
+};
+
+class DrawList {
+public:
+	static const uint32_t LAYER_BITS = 4;
+	static const uint32_t PIPELINE_BITS = 8;
+	static const uint32_t DESCRIPTOR_SET_BITS = 12;
+	static const uint32_t MATERIAL_BITS = 12;
+	static const uint32_t MESH_BITS = 12;
+	static const uint32_t DEPTH_BITS = 16;
+	static const uint32_t PARALLEL_SORT_THRESHOLD = 16384; // below this the job overhead outweighs the win
+
+	void setBlendedLayer(uint32_t layer, bool blended); // blended layers sort back to front first, see above
+
+	void clear(); // keeps the allocations, call at the start of every frame
+	// depth is the draw's view depth normalized to [0, 1] (clamped), value is handed back through instances()
+	void add(const DrawState& state, float depth, uint32_t value);
+	size_t size() const { return keys.size(); }
+
+	// sorts the draws and builds the batches. with a job system, lists past PARALLEL_SORT_THRESHOLD are sorted on all workers
+	void sort(JobSystem* jobSystem = nullptr);
+
+	const std::vector<DrawBatch>& batches() const { return drawBatches; }
+	const std::vector<uint32_t>& instances() const { return sortedValues; } // the draws' values in sorted order
+	const DrawListStats& stats() const { return listStats; }
+
+	uint64_t makeKey(const DrawState& state, float depth) const;
+	DrawState stateOf(uint64_t key) const;
+
+private:
+	struct SortEntry {
+		uint64_t key;
+		uint32_t value;
+	};
+
+	void radixSort(JobSystem* jobSystem);
+	void buildBatches();
+
+	uint32_t blendedLayers = 0; // bit per layer
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> values;
+	std::vector<SortEntry> entries; // sort ping-pong buffers, kept between frames
+	std::vector<SortEntry> scratch;
+	std::vector<uint32_t> chunkHistograms; // 256 buckets per chunk of the parallel sort
+	std::vector<uint64_t> chunkVarying; // key bits that differ, per chunk
+
+	std::vector<uint32_t> sortedValues;
+	std::vector<DrawBatch> drawBatches;
+	DrawListStats listStats;
+};
+
+// sorts random draw lists of a few sizes serially, on the job system and with std::sort, and prints the throughput and the batches/state changes
+// the sort leaves. runs from the command line with --benchmark-draw-list
+void benchmarkDrawList(JobSystem& jobSystem, std::ostream& out);
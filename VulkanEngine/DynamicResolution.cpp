@@ -0,0 +1,91 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void DynamicResolution::init(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t framesInFlight) {
+	this->device = device;
+	this->timestampPeriod = timestampPeriod;
+	currentScale = controllerSettings.maxScale;
+	written.assign(framesInFlight, false);
+	if (timestampValidBits == 0)
+		return; // no timestamps on this queue, nothing to drive the controller with
+
+	timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+
+	VkQueryPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = 2 * framesInFlight;
+	if (vkCreateQueryPool(device, &poolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timestamp query pool!");
+	}
+}
+
+void DynamicResolution::destroy() {
+	if (queryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(device, queryPool, nullptr);
+	queryPool = VK_NULL_HANDLE;
+}
+
+void DynamicResolution::setMaxScale(float maxScale) {
+	controllerSettings.maxScale = maxScale;
+	if (forcedScale < 0.0f)
+		currentScale = queryPool == VK_NULL_HANDLE ? maxScale : std::clamp(currentScale, controllerSettings.minScale, maxScale);
+}
+
+void DynamicResolution::forceScale(float scale) {
+	forcedScale = scale;
+	if (scale >= 0.0f)
+		currentScale = scale;
+}
+
+void DynamicResolution::update(uint32_t frame) {
+	if (queryPool == VK_NULL_HANDLE || !written[frame])
+		return;
+
+	uint64_t timestamps[2];
+	// no WAIT bit: the frame is known to be finished, and if the results still aren't there for some reason just skip this sample
+	VkResult result = vkGetQueryPoolResults(device, queryPool, 2 * frame, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+		return;
+
+	uint64_t ticks = (timestamps[1] - timestamps[0]) & timestampMask; // the counter can wrap
+	float gpuMs = static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-6);
+	smoothedGpuMs = smoothedGpuMs == 0.0f ? gpuMs : smoothedGpuMs + (gpuMs - smoothedGpuMs) * 0.25f;
+
+	const Settings& s = controllerSettings;
+	// GPU time is roughly proportional to the pixel count, so the scale that would hit the target goes with the square root of the ratio
+	if (gpuMs > s.targetGpuMs) {
+		float fit = currentScale * std::sqrt(s.targetGpuMs / gpuMs);
+		currentScale = fit; // over budget: react to the raw sample straight away
+	} else if (smoothedGpuMs < s.targetGpuMs * s.raiseHeadroom) {
+		float fit = currentScale * std::sqrt(s.targetGpuMs * s.raiseHeadroom / smoothedGpuMs);
+		currentScale = std::min(fit, currentScale + s.maxRaisePerFrame); // under budget: creep back up on the smoothed time
+	}
+	currentScale = forcedScale >= 0.0f ? forcedScale : std::clamp(currentScale, s.minScale, s.maxScale);
+}
+
+void DynamicResolution::writeFrameStart(VkCommandBuffer commandBuffer, uint32_t frame) {
+	if (queryPool == VK_NULL_HANDLE)
+		return;
+	vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frame, 2);
+	vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, queryPool, 2 * frame);
+}
+
+void DynamicResolution::writeFrameEnd(VkCommandBuffer commandBuffer, uint32_t frame) {
+	if (queryPool == VK_NULL_HANDLE)
+		return;
+	vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frame + 1);
+	written[frame] = true;
+}
+
+VkExtent2D DynamicResolution::renderExtent(VkExtent2D fullExtent) const {
+	VkExtent2D extent;
+	extent.width = std::max(1u, static_cast<uint32_t>(fullExtent.width * currentScale + 0.5f));
+	extent.height = std::max(1u, static_cast<uint32_t>(fullExtent.height * currentScale + 0.5f));
+	extent.width = std::min(extent.width, fullExtent.width);
+	extent.height = std::min(extent.height, fullExtent.height);
+	return extent;
+}
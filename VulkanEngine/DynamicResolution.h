@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+// Dynamic resolution: the scene is rendered into an offscreen target at a fraction of the swap chain's size and blitted up to it, and the fraction is
+// adjusted every frame from the GPU time of the frame (timestamp queries around the whole graphics command buffer) so it stays inside a budget.
+// The target is allocated at full size and only the rendered area changes, so a new scale never reallocates anything or touches the swap chain.
+// The controller drops the scale straight away when a frame goes over budget and only raises it slowly once there's clear headroom, so load spikes
+// cost resolution for a moment instead of frame rate.
+class DynamicResolution {
+public:
+	struct Settings {
+		float targetGpuMs = 14.0f; // leaves some headroom under a 60Hz frame
+		float minScale = 0.5f; // per axis
+		float maxScale = 1.0f;
+		float raiseHeadroom = 0.85f; // only raise the scale while the GPU time is below this fraction of the target
+		float maxRaisePerFrame = 0.02f;
+	};
+
+	// timestampValidBits of the graphics queue family, 0 means no timestamps and the scale stays at maxScale
+	void init(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t framesInFlight);
+	void destroy();
+
+	Settings& settings() { return controllerSettings; }
+	void setMaxScale(float maxScale); // takes effect straight away, also without timestamps (where the scale always sits at maxScale)
+	// pins the scale, update() still reads the timestamps but no longer moves it. for replaying a capture, which has the scale of every frame. a
+	// negative scale hands it back to the controller
+	void forceScale(float scale);
+
+	// call once the frame's previous submission has finished (after the timeline wait). reads its timestamps back without waiting and updates the scale
+	void update(uint32_t frame);
+
+	void writeFrameStart(VkCommandBuffer commandBuffer, uint32_t frame); // first thing in the frame's graphics commands
+	void writeFrameEnd(VkCommandBuffer commandBuffer, uint32_t frame); // last thing
+
+	float scale() const { return currentScale; }
+	float gpuTimeMs() const { return smoothedGpuMs; }
+	VkExtent2D renderExtent(VkExtent2D fullExtent) const; // the part of the offscreen target to render into this frame
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueryPool queryPool = VK_NULL_HANDLE; // two timestamps per frame in flight
+	float timestampPeriod = 1.0f; // nanoseconds per tick
+	uint64_t timestampMask = 0;
+	std::vector<bool> written; // the frame's queries have been submitted at least once
+
+	Settings controllerSettings;
+	float currentScale = 1.0f;
+	float forcedScale = -1.0f;
+	float smoothedGpuMs = 0.0f;
+};
@@ -0,0 +1,231 @@
+#include "FrameCapture.h"
+
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+const uint32_t CAPTURE_VERSION = 1;
+
+// walks the decompressed frames. every read is bounds checked, a capture is as untrusted as any other file
+class CaptureReader {
+public:
+	explicit CaptureReader(const std::vector<unsigned char>& bytes) : bytes(bytes) {}
+
+	void get(void* data, size_t size) {
+		if (size > bytes.size() - position)
+			throw std::runtime_error("Truncated frame capture!");
+		if (size > 0) // an empty array's data() can be null
+			std::memcpy(data, bytes.data() + position, size);
+		position += size;
+	}
+	bool atEnd() const { return position == bytes.size(); }
+	template <typename T> T get() {
+		T value;
+		get(&value, sizeof(value));
+		return value;
+	}
+	template <typename T> void getArray(std::vector<T>& out) {
+		uint32_t count = get<uint32_t>();
+		if (count > (bytes.size() - position) / sizeof(T))
+			throw std::runtime_error("Truncated frame capture!");
+		out.resize(count);
+		get(out.data(), count * sizeof(T));
+	}
+
+private:
+	const std::vector<unsigned char>& bytes;
+	size_t position = 0;
+};
+
+} // namespace
+
+FrameCaptureWriter::~FrameCaptureWriter() {
+	try {
+		close();
+	} catch (const std::exception&) {
+	}
+}
+
+void FrameCaptureWriter::open(const std::string& path, const std::string& deviceName) {
+	close();
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		throw std::runtime_error("Failed to create " + path + "!");
+	filePath = path;
+	frames = 0;
+	block.clear();
+	block.reserve(CAPTURE_BLOCK_SIZE);
+	compressed.resize(lz4CompressBound(CAPTURE_BLOCK_SIZE));
+
+	CaptureHeader header{};
+	std::memcpy(header.magic, "VCAP", 4);
+	header.version = CAPTURE_VERSION;
+	header.deviceNameLength = static_cast<uint32_t>(deviceName.size());
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(deviceName.data(), deviceName.size());
+	if (!file)
+		throw std::runtime_error("Failed to write " + path + "!");
+}
+
+void FrameCaptureWriter::write(const CapturedFrame& frame) {
+	auto putArray = [this](const auto& values) {
+		uint32_t count = static_cast<uint32_t>(values.size());
+		put(&count, sizeof(count));
+		put(values.data(), values.size() * sizeof(values[0]));
+	};
+	put(&frame.width, sizeof(frame.width));
+	put(&frame.height, sizeof(frame.height));
+	put(&frame.msaaSamples, sizeof(frame.msaaSamples));
+	put(&frame.presentPolicy, sizeof(frame.presentPolicy));
+	put(&frame.meshShaders, sizeof(frame.meshShaders));
+	put(&frame.temporalUpscaling, sizeof(frame.temporalUpscaling));
+	put(&frame.occlusionCulling, sizeof(frame.occlusionCulling));
+	put(&frame.lodPixelThreshold, sizeof(frame.lodPixelThreshold));
+	put(&frame.time, sizeof(frame.time));
+	put(&frame.simulationStep, sizeof(frame.simulationStep));
+	put(&frame.renderScale, sizeof(frame.renderScale));
+	put(frame.cameraTarget, sizeof(frame.cameraTarget));
+	put(frame.sunDirection, sizeof(frame.sunDirection));
+	putArray(frame.streamedChunks);
+	putArray(frame.uniforms);
+	putArray(frame.draws);
+	++frames;
+}
+
+void FrameCaptureWriter::put(const void* data, size_t size) {
+	const unsigned char* source = static_cast<const unsigned char*>(data);
+	while (size > 0) {
+		size_t part = std::min(size, CAPTURE_BLOCK_SIZE - block.size());
+		block.insert(block.end(), source, source + part);
+		source += part;
+		size -= part;
+		if (block.size() == CAPTURE_BLOCK_SIZE)
+			flushBlock();
+	}
+}
+
+void FrameCaptureWriter::flushBlock() {
+	if (block.empty())
+		return;
+	CaptureBlock header{};
+	header.size = static_cast<uint32_t>(block.size());
+	size_t compressedSize = lz4Compress(block.data(), block.size(), compressed.data(), compressed.size());
+	const unsigned char* payload = compressed.data();
+	if (compressedSize == 0 || compressedSize >= block.size()) { // didn't get smaller
+		compressedSize = block.size();
+		payload = block.data();
+		header.storedSize = static_cast<uint32_t>(compressedSize) | CAPTURE_BLOCK_STORED;
+	} else {
+		header.storedSize = static_cast<uint32_t>(compressedSize);
+	}
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(payload), compressedSize);
+	block.clear();
+	if (!file)
+		throw std::runtime_error("Failed to write " + filePath + "!");
+}
+
+void FrameCaptureWriter::close() {
+	if (!file.is_open())
+		return;
+	flushBlock();
+	file.seekp(offsetof(CaptureHeader, frameCount));
+	file.write(reinterpret_cast<const char*>(&frames), sizeof(frames));
+	bool failed = !file;
+	file.close();
+	if (failed)
+		throw std::runtime_error("Failed to write " + filePath + "!");
+}
+
+FrameCapture readFrameCapture(const std::string& path) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file)
+		throw std::runtime_error("Failed to open " + path + "!");
+	std::vector<unsigned char> contents(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+	const std::runtime_error invalid("Not a valid frame capture: " + path + "!");
+
+	CaptureHeader header;
+	if (!file || contents.size() < sizeof(header))
+		throw invalid;
+	std::memcpy(&header, contents.data(), sizeof(header));
+	if (std::memcmp(header.magic, "VCAP", 4) != 0 || header.version != CAPTURE_VERSION || header.deviceNameLength > contents.size() - sizeof(header))
+		throw invalid;
+	FrameCapture capture;
+	capture.deviceName.assign(reinterpret_cast<const char*>(contents.data()) + sizeof(header), header.deviceNameLength);
+
+	std::vector<unsigned char> stream;
+	size_t position = sizeof(header) + header.deviceNameLength;
+	while (position < contents.size()) {
+		CaptureBlock block;
+		if (contents.size() - position < sizeof(block))
+			throw invalid;
+		std::memcpy(&block, contents.data() + position, sizeof(block));
+		position += sizeof(block);
+		uint32_t storedSize = block.storedSize & ~CAPTURE_BLOCK_STORED;
+		if (block.size > CAPTURE_BLOCK_SIZE || storedSize > contents.size() - position)
+			throw invalid;
+		size_t offset = stream.size();
+		stream.resize(offset + block.size);
+		if (block.storedSize & CAPTURE_BLOCK_STORED) {
+			if (storedSize != block.size)
+				throw invalid;
+			std::memcpy(stream.data() + offset, contents.data() + position, storedSize);
+		} else if (!lz4Decompress(contents.data() + position, storedSize, stream.data() + offset, block.size)) {
+			throw invalid;
+		}
+		position += storedSize;
+	}
+
+	// a capture that was never closed (the session crashed) has no frame count, it holds whatever made it into a block, the last frame maybe cut off
+	CaptureReader reader(stream);
+	while (!reader.atEnd()) {
+		CapturedFrame frame;
+		try {
+			frame.width = reader.get<uint32_t>();
+			frame.height = reader.get<uint32_t>();
+			frame.msaaSamples = reader.get<uint32_t>();
+			frame.presentPolicy = reader.get<uint32_t>();
+			frame.meshShaders = reader.get<uint32_t>();
+			frame.temporalUpscaling = reader.get<uint32_t>();
+			frame.occlusionCulling = reader.get<uint32_t>();
+			frame.lodPixelThreshold = reader.get<float>();
+			frame.time = reader.get<float>();
+			frame.simulationStep = reader.get<float>();
+			frame.renderScale = reader.get<float>();
+			reader.get(frame.cameraTarget, sizeof(frame.cameraTarget));
+			reader.get(frame.sunDirection, sizeof(frame.sunDirection));
+			reader.getArray(frame.streamedChunks);
+			reader.getArray(frame.uniforms);
+			reader.getArray(frame.draws);
+		} catch (const std::runtime_error&) {
+			if (header.frameCount != 0)
+				throw;
+			break;
+		}
+		capture.frames.push_back(std::move(frame));
+	}
+	if (header.frameCount != 0 && capture.frames.size() != header.frameCount)
+		throw invalid;
+	return capture;
+}
+
+std::string compareCapturedFrames(const CapturedFrame& captured, const CapturedFrame& replayed) {
+	if (captured.streamedChunks != replayed.streamedChunks)
+		return "different terrain uploads (" + std::to_string(replayed.streamedChunks.size()) + " chunks, captured " + std::to_string(captured.streamedChunks.size()) + ")";
+	if (captured.uniforms != replayed.uniforms)
+		return "different uniform data";
+	if (captured.draws.size() != replayed.draws.size())
+		return std::to_string(replayed.draws.size()) + " draw batches instead of " + std::to_string(captured.draws.size());
+	for (size_t i = 0; i < captured.draws.size(); ++i)
+		if (std::memcmp(&captured.draws[i], &replayed.draws[i], sizeof(CapturedDraw)) != 0)
+			return "draw batch " + std::to_string(i) + " differs";
+	return {};
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Frame capture and deterministic replay, to get a slow frame from a real session onto a machine where it can be bisected. The engine's frames are a
+// function of a handful of inputs - the clock, the camera, the settings the keys toggle, the swap chain size, the dynamic resolution's pick and the
+// order the terrain chunks finish streaming in - so a capture records those per frame, plus what the frame came out as (the uniform data and the
+// main pass's draw list) to check the replay against. Replaying (MainApplication::replayLoop) runs the engine headless and feeds it the captured
+// inputs instead of the clock, the window and the I/O threads' timing, so every replay of a capture records the same command streams.
+// Recording the Vulkan calls themselves would tie a capture to the driver and the handles of the session it came from; the inputs replay on any device.
+// File layout (.vcap): CaptureHeader | device name | blocks, each a CaptureBlock and its LZ4 compressed (or stored) bytes. The blocks' contents
+// concatenated are the frames, each serialized field by field in the order of CapturedFrame.
+
+struct CaptureHeader {
+	char magic[4]; // "VCAP"
+	uint32_t version;
+	uint32_t frameCount; // patched when the capture is closed, 0 until then
+	uint32_t deviceNameLength;
+};
+
+struct CaptureBlock {
+	uint32_t size; // bytes once decompressed
+	uint32_t storedSize; // bytes that follow, CAPTURE_BLOCK_STORED set when they are the raw bytes
+};
+
+const uint32_t CAPTURE_BLOCK_SIZE = 64 * 1024; // uncompressed bytes per block, the last one can be shorter
+const uint32_t CAPTURE_BLOCK_STORED = 0x80000000u;
+
+// one main pass draw batch, see DrawList
+struct CapturedDraw {
+	uint32_t layer;
+	uint32_t pipeline;
+	uint32_t descriptorSet;
+	uint32_t material;
+	uint32_t mesh;
+	uint32_t instanceCount;
+};
+
+struct CapturedFrame {
+	// the settings, as requested when the frame was drawn. the ones that rebuild the swap chain take effect after it, in the replay as well
+	uint32_t width = 0; // swap chain extent the frame was drawn at
+	uint32_t height = 0;
+	uint32_t msaaSamples = 1;
+	uint32_t presentPolicy = 0;
+	uint32_t meshShaders = 0;
+	uint32_t temporalUpscaling = 0;
+	uint32_t occlusionCulling = 0;
+	float lodPixelThreshold = 0.0f;
+
+	// inputs
+	float time = 0.0f; // what the transforms and lights were animated with, seconds
+	float simulationStep = 0.0f; // the particle simulation's
+	float renderScale = 1.0f; // the dynamic resolution's
+	float cameraTarget[3] = {};
+	float sunDirection[3] = {};
+	std::vector<uint32_t> streamedChunks; // the terrain chunks uploaded this frame, in upload order
+
+	// results, compared by compareCapturedFrames()
+	std::vector<unsigned char> uniforms; // the frame's uniform buffer object, unjittered
+	std::vector<CapturedDraw> draws;
+
+	void clear() { streamedChunks.clear(); uniforms.clear(); draws.clear(); } // keeps the allocations
+};
+
+// appends frames to a capture file. the frames go through a block sized buffer that is compressed and written whenever it fills, so a long session
+// costs disk, not memory, and writing a frame doesn't allocate
+class FrameCaptureWriter {
+public:
+	~FrameCaptureWriter(); // closes, a failure to write the rest is lost then
+
+	void open(const std::string& path, const std::string& deviceName); // throws if the file can't be created
+	void write(const CapturedFrame& frame); // throws if the file can't be written
+	void close(); // flushes the last block and patches the frame count. no-op when not open
+	bool isOpen() const { return file.is_open(); }
+	uint32_t frameCount() const { return frames; }
+
+private:
+	void put(const void* data, size_t size);
+	void flushBlock();
+
+	std::ofstream file;
+	std::string filePath;
+	std::vector<unsigned char> block; // raw bytes of the block being filled
+	std::vector<unsigned char> compressed;
+	uint32_t frames = 0;
+};
+
+struct FrameCapture {
+	std::string deviceName; // what it was captured on
+	std::vector<CapturedFrame> frames;
+};
+
+FrameCapture readFrameCapture(const std::string& path); // throws if it can't be read or anything in it is malformed
+
+// what differs between a captured frame's results and the replay's, empty when they match
+std::string compareCapturedFrames(const CapturedFrame& captured, const CapturedFrame& replayed);
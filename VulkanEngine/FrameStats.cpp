@@ -0,0 +1,65 @@
+#include "FrameStats.h"
+
+#include "GpuTimeline.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	double toMs(FrameStats::Clock::duration duration) {
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+}
+
+void FrameStats::beginFrame() {
+	previousFrameStart = frameStart;
+	frameStart = Clock::now();
+	if (previousFrameStart != Clock::time_point{}) {
+		frameTimeSum += toMs(frameStart - previousFrameStart);
+		++frameCount;
+	}
+}
+
+void FrameStats::frameSubmitted(uint64_t timelineValue) {
+	if (pendingCount == MAX_PENDING) {
+		pendingFirst = (pendingFirst + 1) % MAX_PENDING;
+		--pendingCount;
+	}
+	pending[(pendingFirst + pendingCount) % MAX_PENDING] = { timelineValue, frameStart };
+	++pendingCount;
+}
+
+void FrameStats::poll(GpuTimeline& graphicsTimeline) {
+	Clock::time_point now = Clock::now();
+	while (pendingCount > 0 && graphicsTimeline.isComplete(pending[pendingFirst].timelineValue)) {
+		double latency = toMs(now - pending[pendingFirst].start);
+		latencySum += latency;
+		latencyMax = std::max(latencyMax, latency);
+		++latencyCount;
+		pendingFirst = (pendingFirst + 1) % MAX_PENDING;
+		--pendingCount;
+	}
+}
+
+bool FrameStats::intervalElapsed(float intervalSeconds) {
+	Clock::time_point now = Clock::now();
+	if (std::chrono::duration<float>(now - intervalStart).count() < intervalSeconds)
+		return false;
+
+	reportedFrameTimeMs = frameCount > 0 ? static_cast<float>(frameTimeSum / frameCount) : 0.0f;
+	reportedLatencyMs = latencyCount > 0 ? static_cast<float>(latencySum / latencyCount) : 0.0f;
+	reportedMaxLatencyMs = static_cast<float>(latencyMax);
+	frameCount = 0;
+	frameTimeSum = 0.0;
+	latencyCount = 0;
+	latencySum = 0.0;
+	latencyMax = 0.0;
+	intervalStart = now;
+	return true;
+}
+
+std::string FrameStats::summary() const {
+	char text[128];
+	std::snprintf(text, sizeof(text), "%.1f ms/frame, latency %.1f ms avg, %.1f ms max", reportedFrameTimeMs, reportedLatencyMs, reportedMaxLatencyMs);
+	return text;
+}
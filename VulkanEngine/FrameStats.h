@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+class GpuTimeline;
+
+// Engine frame statistics, averaged over a reporting interval:
+//  frame time - CPU time between consecutive frames, so also the rate frames are being presented at once the swap chain throttles
+//  latency    - from the start of a frame (right after input was polled) until the GPU finished rendering it, read off the graphics timeline. the
+//               display scan out after that isn't visible to Vulkan without present timing extensions, so this is the part the engine controls
+// Completion is only polled, never waited on, so a sample can be late by up to the time between two polls (one frame at most).
+class FrameStats {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	void beginFrame();
+	void frameSubmitted(uint64_t timelineValue); // the graphics timeline value the frame's submission signals
+	void poll(GpuTimeline& graphicsTimeline); // collects latency samples for the frames that have finished
+
+	// true once per interval, then the averages below describe the interval that just ended
+	bool intervalElapsed(float intervalSeconds = 1.0f);
+	float averageFrameTimeMs() const { return reportedFrameTimeMs; }
+	float averageLatencyMs() const { return reportedLatencyMs; }
+	float maxLatencyMs() const { return reportedMaxLatencyMs; }
+	std::string summary() const; // "16.7 ms/frame, latency 21.3 ms avg, 25.0 ms max"
+
+private:
+	struct PendingFrame {
+		uint64_t timelineValue;
+		Clock::time_point start;
+	};
+
+	Clock::time_point frameStart{};
+	Clock::time_point previousFrameStart{};
+	Clock::time_point intervalStart = Clock::now();
+	// submitted, not seen finished yet. a ring rather than a deque, which would allocate a block every few dozen frames. a few frames at most, the
+	// oldest sample is dropped if it ever fills up
+	static const uint32_t MAX_PENDING = 16;
+	PendingFrame pending[MAX_PENDING];
+	uint32_t pendingFirst = 0;
+	uint32_t pendingCount = 0;
+
+	uint32_t frameCount = 0;
+	double frameTimeSum = 0.0;
+	uint32_t latencyCount = 0;
+	double latencySum = 0.0;
+	double latencyMax = 0.0;
+
+	float reportedFrameTimeMs = 0.0f;
+	float reportedLatencyMs = 0.0f;
+	float reportedMaxLatencyMs = 0.0f;
+};
@@ -0,0 +1,110 @@
+#include "GpuTimeline.h"
+
+#include <stdexcept>
+
+void TimelineSubmit::waitFor(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags2 stage) {
+	VkSemaphoreSubmitInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	info.semaphore = semaphore;
+	info.value = value;
+	info.stageMask = stage;
+	if (waitCount == MAX_ENTRIES) {
+		throw std::runtime_error("Too many semaphore waits in one submit!");
+	}
+	waits[waitCount++] = info;
+}
+
+void TimelineSubmit::signal(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags2 stage) {
+	VkSemaphoreSubmitInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+	info.semaphore = semaphore;
+	info.value = value;
+	info.stageMask = stage;
+	if (signalCount == MAX_ENTRIES) {
+		throw std::runtime_error("Too many semaphore signals in one submit!");
+	}
+	signals[signalCount++] = info;
+}
+
+void TimelineSubmit::addCommandBuffer(VkCommandBuffer commandBuffer) {
+	VkCommandBufferSubmitInfo info{};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+	info.commandBuffer = commandBuffer;
+	if (commandBufferCount == MAX_ENTRIES) {
+		throw std::runtime_error("Too many command buffers in one submit!");
+	}
+	commandBuffers[commandBufferCount++] = info;
+}
+
+void GpuTimeline::init(VkDevice device, VkQueue queue) {
+	this->device = device;
+	this->queue = queue;
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0; // nothing submitted yet, so waiting for 0 returns straight away
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timelineSemaphore) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create timeline semaphore!");
+	}
+	lastSubmittedValue = 0;
+	completedValue.store(0, std::memory_order_relaxed);
+}
+
+void GpuTimeline::destroy() {
+	if (timelineSemaphore == VK_NULL_HANDLE)
+		return;
+	waitIdle();
+	vkDestroySemaphore(device, timelineSemaphore, nullptr);
+	timelineSemaphore = VK_NULL_HANDLE;
+}
+
+uint64_t GpuTimeline::submit(TimelineSubmit& submit, VkFence fence) {
+	uint64_t value = lastSubmittedValue + 1;
+	submit.signal(timelineSemaphore, value, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT); // all of the submission's work has to be done before the value counts as reached
+
+	VkSubmitInfo2 submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+	submitInfo.waitSemaphoreInfoCount = submit.waitCount;
+	submitInfo.pWaitSemaphoreInfos = submit.waits;
+	submitInfo.commandBufferInfoCount = submit.commandBufferCount;
+	submitInfo.pCommandBufferInfos = submit.commandBuffers;
+	submitInfo.signalSemaphoreInfoCount = submit.signalCount;
+	submitInfo.pSignalSemaphoreInfos = submit.signals;
+	if (vkQueueSubmit2(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit to queue!");
+	}
+	lastSubmittedValue = value; // only after the submit succeeded, a value that was never submitted would make wait() hang
+	return value;
+}
+
+uint64_t GpuTimeline::completed() {
+	uint64_t value = 0;
+	if (vkGetSemaphoreCounterValue(device, timelineSemaphore, &value) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to read timeline semaphore!");
+	}
+	// several threads can poll at once, keep whichever read was newest
+	uint64_t cached = completedValue.load(std::memory_order_relaxed);
+	while (cached < value && !completedValue.compare_exchange_weak(cached, value, std::memory_order_relaxed)) {
+	}
+	return value;
+}
+
+void GpuTimeline::wait(uint64_t value) {
+	if (isComplete(value))
+		return;
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &timelineSemaphore;
+	waitInfo.pValues = &value;
+	if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to wait for timeline semaphore!");
+	}
+	completed(); // refresh the cache, so the isComplete() calls after this don't have to ask the driver
+}
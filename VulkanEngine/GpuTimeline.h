@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// One timeline semaphore per queue. Every submission to the queue signals the next value of its timeline, so "is this work done" becomes a single
+// integer compare: a frame, an upload or a resource's last use is just remembered as the value of the submission that touched it, and it's finished
+// once the timeline's counter has reached that value. Checking that is a cheap poll (vkGetSemaphoreCounterValue, cached), nothing has to be reset or
+// recycled the way fences do, and other queues can wait on any value of it directly.
+// Only the swap chain still needs binary semaphores, acquire and present can't use timelines.
+
+// the wait/signal lists and command buffers of one vkQueueSubmit2. fixed size arrays, a submit is built every frame and mustn't touch the heap
+struct TimelineSubmit {
+	static const uint32_t MAX_ENTRIES = 8; // per list, submissions here use two or three at most. going over throws
+
+	void waitFor(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags2 stage); // value is ignored for binary semaphores, pass 0
+	void signal(VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags2 stage);
+	void addCommandBuffer(VkCommandBuffer commandBuffer);
+
+	VkSemaphoreSubmitInfo waits[MAX_ENTRIES];
+	uint32_t waitCount = 0;
+	VkSemaphoreSubmitInfo signals[MAX_ENTRIES];
+	uint32_t signalCount = 0;
+	VkCommandBufferSubmitInfo commandBuffers[MAX_ENTRIES];
+	uint32_t commandBufferCount = 0;
+};
+
+class GpuTimeline {
+public:
+	void init(VkDevice device, VkQueue queue);
+	void destroy(); // waits for everything submitted through it first
+
+	VkSemaphore semaphore() const { return timelineSemaphore; }
+
+	// submits to the queue, additionally signaling the timeline's next value, and returns that value. not thread safe, submit from one thread
+	uint64_t submit(TimelineSubmit& submit, VkFence fence = VK_NULL_HANDLE);
+	uint64_t lastSubmitted() const { return lastSubmittedValue; }
+	uint64_t nextValue() const { return lastSubmittedValue + 1; } // what the next submit() will signal
+
+	// polling, never blocks. safe from any thread
+	uint64_t completed();
+	bool isComplete(uint64_t value) { return value <= completedValue.load(std::memory_order_relaxed) || value <= completed(); }
+
+	void wait(uint64_t value); // blocks until the GPU reaches value. 0 is always complete
+	void waitIdle() { wait(lastSubmittedValue); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+	uint64_t lastSubmittedValue = 0;
+	std::atomic<uint64_t> completedValue{ 0 }; // last value read back from the semaphore, only ever grows
+};
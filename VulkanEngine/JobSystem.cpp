@@ -0,0 +1,335 @@
+#include "JobSystem.h"
+
+#include <chrono>
+#include <stdexcept>
+
+WorkStealingDeque::WorkStealingDeque(size_t capacity) {
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		throw std::runtime_error("Work stealing deque capacity must be a power of two!");
+	}
+	buffer.reset(new std::atomic<Job*>[capacity]);
+	mask = static_cast<int64_t>(capacity) - 1;
+}
+
+bool WorkStealingDeque::push(Job* job) {
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t > mask) // full
+		return false;
+
+	buffer[b & mask].store(job, std::memory_order_relaxed);
+	bottom.store(b + 1, std::memory_order_release); // the job has to be visible before a thief can see the new bottom
+	return true;
+}
+
+Job* WorkStealingDeque::pop() {
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst); // reserve the bottom slot before looking at top, pairs with the fence in steal()
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) { // was already empty
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = buffer[b & mask].load(std::memory_order_relaxed);
+	if (t == b) { // last job left, race the thieves for it
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr; // a thief got it first
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+Job* WorkStealingDeque::steal() {
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+
+	if (t >= b)
+		return nullptr;
+
+	Job* job = buffer[t & mask].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr; // lost the race against the owner or another thief, the caller just tries somewhere else
+	return job;
+}
+
+
+namespace {
+	thread_local void* tlsWorker = nullptr; // the JobSystem::Worker the current thread belongs to (if any)
+}
+
+uint32_t JobSystem::defaultWorkerThreadCount() {
+	uint32_t hardwareThreads = std::thread::hardware_concurrency(); // can be 0 if it can't be determined
+	return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+JobSystem::JobSystem(uint32_t workerThreadCount) {
+	workers.reserve(workerThreadCount + 1);
+	for (uint32_t i = 0; i < workerThreadCount + 1; ++i) {
+		std::unique_ptr<Worker> worker = std::make_unique<Worker>();
+		worker->system = this;
+		worker->index = i;
+		worker->jobPool.reset(new Job[JOB_POOL_SIZE]);
+		worker->randomState = 0x9E3779B9u * (i + 1);
+		workers.push_back(std::move(worker));
+	}
+
+	tlsWorker = workers[0].get(); // the constructing thread is worker 0
+	for (uint32_t i = 1; i < workers.size(); ++i) {
+		Worker* worker = workers[i].get();
+		worker->thread = std::thread([this, worker]() { workerMain(worker); });
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping.store(true);
+	}
+	wakeCondition.notify_all();
+
+	for (size_t i = 1; i < workers.size(); ++i) {
+		workers[i]->thread.join();
+	}
+
+	if (tlsWorker == workers[0].get()) {
+		tlsWorker = nullptr;
+	}
+	for (Job* job : injectionQueue) { // jobs that were never run
+		if (job->heapAllocated)
+			delete job;
+	}
+}
+
+JobSystem::Worker* JobSystem::currentWorker() const {
+	Worker* worker = static_cast<Worker*>(tlsWorker);
+	return (worker != nullptr && worker->system == this) ? worker : nullptr;
+}
+
+Job* JobSystem::allocateJob(JobCounter* counter) {
+	Job* job = nullptr;
+	Worker* worker = currentWorker();
+	if (worker != nullptr) {
+		Job* pooled = &worker->jobPool[worker->nextPoolJob & (JOB_POOL_SIZE - 1)]; // ring, by the time we wrap around the oldest job has almost always finished
+		if (!pooled->inFlight.load(std::memory_order_acquire)) {
+			job = pooled;
+			job->heapAllocated = false;
+			++worker->nextPoolJob;
+		}
+	}
+	if (job == nullptr) {
+		job = new Job();
+		job->heapAllocated = true;
+	}
+
+	job->function = nullptr;
+	job->counter = counter;
+	job->unfinishedDependencies.store(1, std::memory_order_relaxed); // released by run()
+	job->continuationCount = 0;
+	job->inFlight.store(true, std::memory_order_relaxed);
+
+	if (counter != nullptr) {
+		counter->value.fetch_add(1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+void JobSystem::addDependency(Job* job, Job* prerequisite) {
+	if (prerequisite->continuationCount >= Job::MAX_CONTINUATIONS) {
+		throw std::runtime_error("Too many jobs depend on the same job!");
+	}
+	prerequisite->continuations[prerequisite->continuationCount++] = job;
+	job->unfinishedDependencies.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::run(Job* job) {
+	if (job->unfinishedDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) { // no prerequisites left, it can start right away
+		push(job);
+	}
+}
+
+void JobSystem::push(Job* job) {
+	Worker* worker = currentWorker();
+	if (worker != nullptr) {
+		if (!worker->deque.push(job)) { // deque is full - just run it here rather than failing
+			execute(job);
+			return;
+		}
+	} else {
+		std::lock_guard<std::mutex> lock(injectionMutex);
+		injectionQueue.push_back(job);
+	}
+
+	// wake a sleeping worker. queuedJobs and sleepingWorkers are both seq_cst so either we see the sleeper, or the sleeper sees the job before it waits
+	queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+	if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeCondition.notify_one();
+	}
+}
+
+Job* JobSystem::findJob(Worker* worker) {
+	Job* job = nullptr;
+	if (worker != nullptr) {
+		job = worker->deque.pop(); // own work first, it's the most likely to still be in cache
+	}
+
+	if (job == nullptr && queuedJobs.load(std::memory_order_relaxed) > 0) {
+		{
+			std::unique_lock<std::mutex> lock(injectionMutex, std::try_to_lock); // don't queue up behind other thieves on the lock
+			if (lock.owns_lock() && !injectionQueue.empty()) {
+				job = injectionQueue.front();
+				injectionQueue.pop_front();
+			}
+		}
+
+		if (job == nullptr) { // steal, starting from a random victim so workers don't all hammer the same deque
+			uint32_t start = 0;
+			if (worker != nullptr) {
+				worker->randomState ^= worker->randomState << 13;
+				worker->randomState ^= worker->randomState >> 17;
+				worker->randomState ^= worker->randomState << 5;
+				start = worker->randomState;
+			}
+			for (size_t i = 0; i < workers.size() && job == nullptr; ++i) {
+				Worker* victim = workers[(start + i) % workers.size()].get();
+				if (victim != worker)
+					job = victim->deque.steal();
+			}
+		}
+	}
+
+	if (job != nullptr) {
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+	}
+	return job;
+}
+
+void JobSystem::execute(Job* job) {
+	job->function(job);
+
+	for (uint32_t i = 0; i < job->continuationCount; ++i) {
+		run(job->continuations[i]); // releases the dependency this job was holding
+	}
+
+	JobCounter* counter = job->counter;
+	if (job->heapAllocated) {
+		delete job;
+	} else {
+		job->inFlight.store(false, std::memory_order_release); // the pool slot can be reused now
+	}
+	if (counter != nullptr) {
+		counter->value.fetch_sub(1, std::memory_order_release); // last, the counter may be destroyed by the waiter the moment it hits 0
+	}
+}
+
+void JobSystem::wait(const JobCounter& counter) {
+	Worker* worker = currentWorker();
+	while (!counter.isDone()) {
+		Job* job = findJob(worker);
+		if (job != nullptr) {
+			execute(job);
+		} else {
+			std::this_thread::yield(); // the jobs we're waiting on are running on other workers
+		}
+	}
+}
+
+void JobSystem::workerMain(Worker* worker) {
+	tlsWorker = worker;
+
+	uint32_t idleSpins = 0;
+	while (!stopping.load(std::memory_order_relaxed)) {
+		Job* job = findJob(worker);
+		if (job != nullptr) {
+			execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < 64) { // spin briefly, jobs usually come in bursts within a frame
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+		wakeCondition.wait(lock, [this]() { return stopping.load() || queuedJobs.load(std::memory_order_seq_cst) > 0; });
+		sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+		idleSpins = 0;
+	}
+
+	tlsWorker = nullptr;
+}
+
+
+FrameTaskList::TaskId FrameTaskList::addTask(const std::string& name, std::function<void()> function, std::initializer_list<TaskId> dependencies) {
+	TaskId id = static_cast<TaskId>(tasks.size());
+	for (TaskId dependency : dependencies) {
+		if (dependency >= id) {
+			throw std::runtime_error("Frame task '" + name + "' depends on a task that hasn't been added yet!");
+		}
+		uint32_t dependents = 1;
+		for (const Task& task : tasks)
+			for (TaskId other : task.dependencies)
+				dependents += (other == dependency);
+		if (dependents > Job::MAX_CONTINUATIONS) {
+			throw std::runtime_error("Too many frame tasks depend on '" + tasks[dependency].name + "'!");
+		}
+	}
+
+	Task task;
+	task.name = name;
+	task.function = std::move(function);
+	task.dependencies.assign(dependencies.begin(), dependencies.end());
+	tasks.push_back(std::move(task));
+	jobs.resize(tasks.size());
+	return id;
+}
+
+void FrameTaskList::execute(JobSystem& jobSystem) {
+	failed.store(false, std::memory_order_relaxed);
+
+	JobCounter counter;
+	for (size_t i = 0; i < tasks.size(); ++i) {
+		Task* task = &tasks[i];
+		std::atomic<bool>* listFailed = &failed;
+		jobs[i] = jobSystem.createJob([task, listFailed]() {
+			task->lastMilliseconds = 0.0;
+			if (listFailed->load(std::memory_order_acquire)) // an earlier task threw, its results can't be trusted
+				return;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			try {
+				task->function();
+			} catch (...) { // exceptions can't cross threads by themselves, hand it back to execute()
+				task->error = std::current_exception();
+				listFailed->store(true, std::memory_order_release);
+			}
+			task->lastMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}, &counter);
+
+		for (TaskId dependency : task->dependencies) {
+			jobSystem.addDependency(jobs[i], jobs[dependency]);
+		}
+	}
+
+	for (Job* job : jobs) {
+		jobSystem.run(job);
+	}
+	jobSystem.wait(counter);
+
+	if (failed.load(std::memory_order_acquire)) {
+		for (Task& task : tasks) {
+			if (task.error) {
+				std::exception_ptr error = task.error;
+				for (Task& other : tasks)
+					other.error = nullptr;
+				std::rethrow_exception(error);
+			}
+		}
+	}
+}
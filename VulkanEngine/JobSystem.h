@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing job system. There is one worker per hardware thread: the thread that constructs the JobSystem is worker 0 (it only runs jobs while it is inside
+// wait()), the others are background threads. Every worker owns a Chase-Lev deque - the owner pushes and pops at the bottom, idle workers steal from the top,
+// so the common case (a worker running the jobs it spawned itself) never touches a shared lock.
+// Threads that are not workers (eg I/O threads) can still submit jobs, they just go through a small mutex protected injection queue instead.
+
+class JobSystem;
+
+// counts outstanding jobs. every job created with a counter increments it, and decrements it once it has finished running, so a counter reaching 0 means the whole batch is done
+struct JobCounter {
+	std::atomic<int32_t> value{ 0 };
+
+	bool isDone() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job {
+	static const uint32_t MAX_CONTINUATIONS = 8; // jobs that depend on this one, started as soon as it finishes
+	static const size_t PAYLOAD_SIZE = 64; // inline storage for the callable, so creating a job never touches the heap
+
+	void (*function)(Job*) = nullptr;
+	JobCounter* counter = nullptr;
+	std::atomic<int32_t> unfinishedDependencies{ 0 }; // +1 for every prerequisite, +1 that is released by JobSystem::run()
+	uint32_t continuationCount = 0;
+	Job* continuations[MAX_CONTINUATIONS];
+	bool heapAllocated = false; // jobs created from non-worker threads (or when the pool is exhausted) don't come from a job pool
+	std::atomic<bool> inFlight{ false }; // created but not finished yet, so its pool slot can't be handed out again
+	alignas(16) unsigned char payload[PAYLOAD_SIZE];
+};
+
+// fixed capacity Chase-Lev deque (Le, Pop, Cohen, Nardelli - "Correct and Efficient Work-Stealing for Weak Memory Models"). the capacity doesn't grow,
+// push() returns false when full and the caller runs the job inline instead
+class WorkStealingDeque {
+public:
+	explicit WorkStealingDeque(size_t capacity);
+
+	bool push(Job* job); // owner thread only
+	Job* pop(); // owner thread only, LIFO
+	Job* steal(); // any thread, FIFO
+
+	int64_t size() const { return bottom.load(std::memory_order_relaxed) - top.load(std::memory_order_relaxed); }
+
+private:
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::unique_ptr<std::atomic<Job*>[]> buffer;
+	int64_t mask;
+};
+
+class JobSystem {
+public:
+	static const size_t JOB_POOL_SIZE = 4096; // per worker ring of jobs. if a worker has more than this many of its own jobs alive at once the rest come from the heap
+	static const size_t DEQUE_CAPACITY = 4096;
+
+	explicit JobSystem(uint32_t workerThreadCount = defaultWorkerThreadCount());
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	static uint32_t defaultWorkerThreadCount(); // one less than the hardware threads, the constructing thread is a worker too
+	uint32_t workerCount() const { return static_cast<uint32_t>(workers.size()); } // including the constructing thread
+
+	// creates a job for any callable that fits in Job::PAYLOAD_SIZE. the job isn't started until run() is called on it
+	template<typename Function>
+	Job* createJob(Function&& function, JobCounter* counter = nullptr) {
+		using Callable = typename std::decay<Function>::type;
+		static_assert(sizeof(Callable) <= Job::PAYLOAD_SIZE, "job callable captures too much state, capture a pointer to it instead");
+		static_assert(alignof(Callable) <= 16, "job callable is over-aligned");
+		static_assert(std::is_trivially_destructible<Callable>::value, "job callables must be trivially destructible (capture pointers/references/PODs)");
+
+		Job* job = allocateJob(counter);
+		new (job->payload) Callable(std::forward<Function>(function));
+		job->function = [](Job* self) { (*std::launder(reinterpret_cast<Callable*>(self->payload)))(); };
+		return job;
+	}
+
+	// job won't start before prerequisite has finished. must be called before either of the two jobs are passed to run()
+	void addDependency(Job* job, Job* prerequisite);
+
+	void run(Job* job); // submit a job, it starts as soon as all of its dependencies have finished
+	void wait(const JobCounter& counter); // runs other jobs on the calling thread until the counter reaches 0
+
+	// splits [0, count) into chunks of at most grainSize and calls function(begin, end) for each of them across all workers. blocks until every chunk is done
+	template<typename Function>
+	void parallelFor(uint32_t count, uint32_t grainSize, const Function& function) {
+		if (count == 0)
+			return;
+		if (grainSize == 0)
+			grainSize = 1;
+		if (count <= grainSize || workers.size() == 1) { // not worth the overhead of a job
+			function(0u, count);
+			return;
+		}
+
+		JobCounter counter;
+		for (uint32_t begin = 0; begin < count; begin += grainSize) {
+			uint32_t end = std::min(count, begin + grainSize);
+			const Function* fn = &function;
+			run(createJob([fn, begin, end]() { (*fn)(begin, end); }, &counter));
+		}
+		wait(counter);
+	}
+
+private:
+	struct Worker {
+		JobSystem* system = nullptr;
+		uint32_t index = 0;
+		WorkStealingDeque deque{ DEQUE_CAPACITY };
+		std::unique_ptr<Job[]> jobPool;
+		size_t nextPoolJob = 0;
+		uint32_t randomState = 0; // xorshift state for picking steal victims
+		std::thread thread;
+	};
+
+	Job* allocateJob(JobCounter* counter);
+	void push(Job* job);
+	Job* findJob(Worker* worker);
+	void execute(Job* job);
+	void workerMain(Worker* worker);
+	Worker* currentWorker() const;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+
+	std::mutex injectionMutex; // for jobs submitted by threads that aren't workers
+	std::deque<Job*> injectionQueue;
+
+	std::atomic<int32_t> queuedJobs{ 0 }; // approximate number of jobs sitting in queues, lets idle workers sleep instead of spin
+	std::atomic<int32_t> sleepingWorkers{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wakeCondition;
+	std::atomic<bool> stopping{ false };
+};
+
+// frame-graph style list of named engine tasks (transform update, culling, command recording, upload...). the list is set up once, then execute() runs it as
+// jobs every frame: independent tasks run in parallel, and a task only starts once all of the tasks it depends on have finished
+class FrameTaskList {
+public:
+	using TaskId = uint32_t;
+
+	// dependencies must refer to tasks that were added before this one, so the list is always a valid DAG in submission order
+	TaskId addTask(const std::string& name, std::function<void()> function, std::initializer_list<TaskId> dependencies = {});
+
+	void execute(JobSystem& jobSystem); // blocks until every task has run. if a task throws, the tasks that haven't started yet are skipped and the exception is rethrown here
+
+	size_t taskCount() const { return tasks.size(); }
+	const std::string& taskName(TaskId task) const { return tasks[task].name; }
+	double taskMilliseconds(TaskId task) const { return tasks[task].lastMilliseconds; } // CPU time the task took during the last execute()
+
+private:
+	struct Task {
+		std::string name;
+		std::function<void()> function;
+		std::vector<TaskId> dependencies;
+		double lastMilliseconds = 0.0;
+		std::exception_ptr error;
+	};
+
+	std::vector<Task> tasks;
+	std::vector<Job*> jobs; // reused each frame so executing the list doesn't allocate
+	std::atomic<bool> failed{ false };
+};
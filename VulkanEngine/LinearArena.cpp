@@ -0,0 +1,41 @@
+#include "LinearArena.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+void LinearArena::init(size_t capacity) {
+	memory.reset(new unsigned char[capacity]);
+	size = capacity;
+	offset = 0;
+	peak = 0;
+}
+
+void* LinearArena::allocate(size_t bytes, size_t alignment) {
+	uintptr_t base = reinterpret_cast<uintptr_t>(memory.get());
+	uintptr_t aligned = (base + offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1); // alignment is a power of two
+	size_t end = static_cast<size_t>(aligned - base) + bytes;
+	if (memory == nullptr || end > size) {
+		throw std::runtime_error("Linear arena out of memory!");
+	}
+	offset = end;
+	peak = std::max(peak, offset);
+	return reinterpret_cast<void*>(aligned);
+}
+
+void FrameArenas::init(uint32_t framesInFlight, size_t capacityPerFrame) {
+	arenas.clear();
+	for (uint32_t i = 0; i < framesInFlight; ++i)
+		arenas.push_back(std::make_unique<LinearArena>(capacityPerFrame));
+	currentFrame = 0;
+}
+
+LinearArena& FrameArenas::beginFrame(uint32_t frame) {
+	currentFrame = frame;
+	arenas[frame]->reset();
+	return *arenas[frame];
+}
+
+LinearArena& scratchArena() {
+	thread_local LinearArena arena(SCRATCH_ARENA_CAPACITY);
+	return arena;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Linear (bump) allocators for short lived CPU data. An arena grabs one block up front, hands out memory by moving an offset forward, and frees
+// everything at once by moving it back, so a frame's worth of temporary arrays costs a few adds instead of a trip through the general heap each.
+//  FrameArenas  - one arena per frame in flight, reset once the GPU has finished that frame's previous submission. data can live for the whole frame
+//  scratch      - one arena per thread (scratchArena()), for data that only lives inside a function. ScratchScope rewinds it on the way out
+// Nothing allocated from an arena is destructed, so it's for trivially destructible data (ArenaVector<T> of Vulkan structs, handles, indices...).
+// ArenaVector frees nothing when it grows, the old storage stays used until the arena is reset - reserve() it up front.
+
+class LinearArena {
+public:
+	using Marker = size_t;
+
+	LinearArena() = default;
+	explicit LinearArena(size_t capacity) { init(capacity); }
+	LinearArena(const LinearArena&) = delete;
+	LinearArena& operator=(const LinearArena&) = delete;
+
+	void init(size_t capacity); // the only heap allocation the arena makes
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)); // throws when the arena is full
+	template<typename T>
+	T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+		return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	void reset() { offset = 0; }
+	Marker mark() const { return offset; }
+	void rewind(Marker marker) { offset = marker; } // frees everything allocated since mark()
+
+	size_t used() const { return offset; }
+	size_t capacity() const { return size; }
+	size_t highWater() const { return peak; } // most that was ever in use, for sizing the arena
+
+private:
+	std::unique_ptr<unsigned char[]> memory;
+	size_t size = 0;
+	size_t offset = 0;
+	size_t peak = 0;
+};
+
+// std allocator over an arena, deallocate() is a no-op
+template<typename T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	ArenaAllocator(LinearArena& arena) noexcept : arena(&arena) {}
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(arena->allocate(sizeof(T) * count, alignof(T))); }
+	void deallocate(T*, size_t) noexcept {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const noexcept { return arena != other.arena; }
+
+private:
+	template<typename U>
+	friend class ArenaAllocator;
+	LinearArena* arena;
+};
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+class FrameArenas {
+public:
+	void init(uint32_t framesInFlight, size_t capacityPerFrame);
+
+	// call once the frame's previous submission has finished (after the timeline wait), everything allocated from its arena last time round is freed
+	LinearArena& beginFrame(uint32_t frame);
+	LinearArena& current() { return *arenas[currentFrame]; }
+
+private:
+	std::vector<std::unique_ptr<LinearArena>> arenas;
+	uint32_t currentFrame = 0;
+};
+
+const size_t SCRATCH_ARENA_CAPACITY = 256 * 1024;
+
+LinearArena& scratchArena(); // the calling thread's, allocated on its first use
+
+// scratch allocations that are freed when the scope ends. scopes nest, inner ones have to end first
+class ScratchScope {
+public:
+	ScratchScope() : scratch(scratchArena()), marker(scratch.mark()) {}
+	~ScratchScope() { scratch.rewind(marker); }
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+	LinearArena& arena() { return scratch; }
+	template<typename T>
+	ArenaVector<T> vector(size_t count) { return ArenaVector<T>(count, T(), ArenaAllocator<T>(scratch)); } // count value initialized elements
+
+private:
+	LinearArena& scratch;
+	LinearArena::Marker marker;
+};
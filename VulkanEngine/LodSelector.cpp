@@ -0,0 +1,34 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+float LodSelector::projectedSize(float size, float distance, const glm::mat4& projection, uint32_t viewportHeight) {
+	// projection[1][1] is cot(fovy / 2), so a length at distance d covers projection[1][1] * size / d of the [-1, 1] clip range. abs since the y flip makes it negative
+	return size * std::abs(projection[1][1]) * 0.5f * static_cast<float>(viewportHeight) / distance;
+}
+
+uint32_t LodSelector::select(const std::vector<float>& lodErrors, const glm::vec3& cameraPosition, const glm::vec3& boundsCenter, float boundsRadius,
+	const glm::mat4& projection, uint32_t viewportHeight) {
+	if (lodErrors.empty())
+		return 0;
+	currentLod = std::min(currentLod, static_cast<uint32_t>(lodErrors.size() - 1));
+
+	// the nearest point of the bounds, errors are largest there. a camera inside the bounds gets the finest LOD
+	float distance = std::max(glm::length(boundsCenter - cameraPosition) - boundsRadius, 1e-4f);
+
+	// coarsest LOD under the threshold. errors grow along the chain, so the first one over it ends the search
+	auto coarsestWithin = [&](float threshold) {
+		uint32_t lod = 0;
+		while (lod + 1 < lodErrors.size() && projectedSize(lodErrors[lod + 1], distance, projection, viewportHeight) <= threshold)
+			++lod;
+		return lod;
+	};
+
+	uint32_t coarser = coarsestWithin(selectorSettings.pixelThreshold * (1.0f - selectorSettings.hysteresis));
+	if (coarser > currentLod)
+		currentLod = coarser; // clearly small enough now
+	else if (projectedSize(lodErrors[currentLod], distance, projection, viewportHeight) > selectorSettings.pixelThreshold)
+		currentLod = coarsestWithin(selectorSettings.pixelThreshold); // the current one is visibly off, refine straight away
+	return currentLod;
+}
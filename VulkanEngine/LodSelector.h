@@ -0,0 +1,37 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Runtime LOD selection for one object. Each LOD's error (how far its surface can be from the original, in mesh units) is projected to pixels at the
+// object's distance, and the coarsest LOD whose error stays under the threshold is drawn, so the vertex count follows the object's size on screen
+// rather than the asset's detail.
+// Hysteresis: a coarser LOD has to fit under a tightened threshold before it's switched to, while the current one is kept until it goes over the
+// plain threshold. An object sitting right at a boundary doesn't flicker between two LODs every frame.
+class LodSelector {
+public:
+	struct Settings {
+		float pixelThreshold = 1.0f; // largest acceptable error on screen
+		float hysteresis = 0.25f; // a coarser LOD has to be under (1 - hysteresis) * pixelThreshold
+	};
+
+	Settings& settings() { return selectorSettings; }
+
+	// lodErrors finest first (ascending). boundsCenter/boundsRadius are the object's bounding sphere in world space, projection the frame's
+	// projection matrix and viewportHeight the height of the image it ends up on. returns the LOD to draw
+	uint32_t select(const std::vector<float>& lodErrors, const glm::vec3& cameraPosition, const glm::vec3& boundsCenter, float boundsRadius,
+		const glm::mat4& projection, uint32_t viewportHeight);
+
+	uint32_t current() const { return currentLod; }
+
+	// pixels covered by a world space length at the given distance from the camera
+	static float projectedSize(float size, float distance, const glm::mat4& projection, uint32_t viewportHeight);
+
+private:
+	Settings selectorSettings;
+	uint32_t currentLod = 0;
+};
@@ -0,0 +1,157 @@
+#include "Lz4.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t LAST_LITERALS = 5; // the block has to end with at least this many literals
+const size_t MATCH_FIND_LIMIT = 12; // and its last match has to start at least this far from the end
+const size_t MAX_OFFSET = 65535;
+const uint32_t HASH_BITS = 12;
+
+uint32_t read32(const unsigned char* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint32_t hash4(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HASH_BITS); }
+
+// length past the 4 bit token field: 255 bytes until the remainder fits in one
+bool writeLength(size_t length, unsigned char*& out, const unsigned char* end) {
+	for (; length >= 255; length -= 255) {
+		if (out >= end)
+			return false;
+		*out++ = 255;
+	}
+	if (out >= end)
+		return false;
+	*out++ = static_cast<unsigned char>(length);
+	return true;
+}
+
+bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length) {
+	unsigned char byte;
+	do {
+		if (in >= end)
+			return false;
+		byte = *in++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+bool writeSequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength, unsigned char*& out, const unsigned char* end) {
+	if (out >= end)
+		return false;
+	unsigned char* token = out++;
+	*token = static_cast<unsigned char>((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15 && !writeLength(literalLength - 15, out, end))
+		return false;
+	if (static_cast<size_t>(end - out) < literalLength)
+		return false;
+	if (literalLength > 0) // literals is null for an empty source, and memcpy wants a valid pointer even for 0 bytes
+		std::memcpy(out, literals, literalLength);
+	out += literalLength;
+	if (matchLength == 0) // the last sequence, literals only
+		return true;
+
+	if (end - out < 2)
+		return false;
+	*out++ = static_cast<unsigned char>(offset);
+	*out++ = static_cast<unsigned char>(offset >> 8);
+	size_t matchCode = matchLength - MIN_MATCH;
+	*token |= static_cast<unsigned char>(matchCode >= 15 ? 15 : matchCode);
+	return matchCode < 15 || writeLength(matchCode - 15, out, end);
+}
+
+} // namespace
+
+size_t lz4CompressBound(size_t size) { return size + size / 255 + 16; }
+
+size_t lz4Compress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationCapacity) {
+	unsigned char* out = destination;
+	const unsigned char* end = destination + destinationCapacity;
+	size_t anchor = 0; // first literal not written yet
+
+	if (sourceSize > MATCH_FIND_LIMIT) {
+		std::unique_ptr<uint32_t[]> table(new uint32_t[size_t(1) << HASH_BITS]()); // last position seen per hash
+		const size_t matchLimit = sourceSize - LAST_LITERALS;
+		size_t position = 0;
+		while (position + MATCH_FIND_LIMIT <= sourceSize) {
+			uint32_t sequence = read32(source + position);
+			uint32_t& slot = table[hash4(sequence)];
+			size_t candidate = slot;
+			slot = static_cast<uint32_t>(position);
+			if (candidate >= position || position - candidate > MAX_OFFSET || read32(source + candidate) != sequence) {
+				++position;
+				continue;
+			}
+
+			while (position > anchor && candidate > 0 && source[position - 1] == source[candidate - 1]) { // grow the match backwards into the literals
+				--position;
+				--candidate;
+			}
+			size_t length = MIN_MATCH;
+			while (position + length < matchLimit && source[candidate + length] == source[position + length])
+				++length;
+
+			if (!writeSequence(source + anchor, position - anchor, position - candidate, length, out, end))
+				return 0;
+			position += length;
+			anchor = position;
+		}
+	}
+	if (!writeSequence(source + anchor, sourceSize - anchor, 0, 0, out, end))
+		return 0;
+	return static_cast<size_t>(out - destination);
+}
+
+bool lz4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize) {
+	const unsigned char* in = source;
+	const unsigned char* inEnd = source + sourceSize;
+	size_t written = 0;
+	for (;;) {
+		if (in >= inEnd)
+			return false;
+		unsigned char token = *in++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(in, inEnd, literalLength))
+			return false;
+		if (literalLength > static_cast<size_t>(inEnd - in) || literalLength > destinationSize - written)
+			return false;
+		if (literalLength > 0) // destination may be null when nothing is expected
+			std::memcpy(destination + written, in, literalLength);
+		in += literalLength;
+		written += literalLength;
+		if (in == inEnd) // the last sequence has no match
+			return written == destinationSize;
+
+		if (inEnd - in < 2)
+			return false;
+		size_t offset = in[0] | (static_cast<size_t>(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > written)
+			return false;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(in, inEnd, matchLength))
+			return false;
+		matchLength += MIN_MATCH;
+		if (matchLength > destinationSize - written)
+			return false;
+
+		unsigned char* out = destination + written;
+		const unsigned char* match = out - offset;
+		if (offset >= matchLength) {
+			std::memcpy(out, match, matchLength);
+		} else {
+			for (size_t i = 0; i < matchLength; ++i) // overlapping, repeats the last offset bytes
+				out[i] = match[i];
+		}
+		written += matchLength;
+	}
+}
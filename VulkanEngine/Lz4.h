@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), written from the spec so the engine doesn't pull in the library.
+// Blocks are interchangeable with the reference implementation's LZ4_compress_default/LZ4_decompress_safe. The compressor is the simple greedy
+// one (a single hash probe per position): the archives are packed offline, it's decompression speed that matters, and that is the format's.
+
+size_t lz4CompressBound(size_t size); // worst case compressed size, for incompressible input
+size_t lz4Compress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationCapacity); // compressed size, 0 if it didn't fit
+
+// bounds checked, safe on corrupt or hostile input. false unless the block decodes to exactly destinationSize bytes
+bool lz4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t destinationSize);
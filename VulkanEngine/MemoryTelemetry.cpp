@@ -0,0 +1,237 @@
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t NO_HEAP = UINT32_MAX;
+const VkDeviceSize DESCRIPTOR_BYTES = 64; // a guess at what a descriptor costs the driver, pools have no size to query
+
+// the telemetry of every device that has one. few devices and lookups only when something is allocated, a vector does
+std::mutex registryMutex;
+std::vector<std::pair<VkDevice, MemoryTelemetry*>> registry;
+
+double toMiB(uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+// non dispatchable handles are pointers on 64 bit and plain integers on 32 bit
+template <typename Handle> uint64_t handleKey(Handle handle) { return (uint64_t)handle; }
+
+} // namespace
+
+const char* memoryCategoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Buffers: return "buffers";
+	case MemoryCategory::Images: return "images";
+	case MemoryCategory::Staging: return "staging";
+	case MemoryCategory::Descriptors: return "descriptors";
+	case MemoryCategory::CpuArenas: return "cpu arenas";
+	default: return "?";
+	}
+}
+
+MemoryCategory bufferMemoryCategory(VkBufferUsageFlags usage) {
+	return (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) ? MemoryCategory::Staging : MemoryCategory::Buffers;
+}
+
+void MemoryTelemetry::init(VkPhysicalDevice physicalDevice, VkDevice device, bool budgetExtension) {
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	hasBudgetExtension = budgetExtension;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties); // the only query, the properties don't change
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+		heaps[i] = {};
+		heaps[i].size = memoryProperties.memoryHeaps[i].size;
+		heaps[i].deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		registry.emplace_back(device, this);
+	}
+	update();
+}
+
+void MemoryTelemetry::destroy() {
+	if (device == VK_NULL_HANDLE)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		registry.erase(std::remove(registry.begin(), registry.end(), std::make_pair(device, this)), registry.end());
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!allocations.empty()) {
+		VkDeviceSize leaked = 0;
+		for (auto& [handle, allocation] : allocations)
+			leaked += allocation.size;
+		std::cerr << "Memory telemetry: " << allocations.size() << " allocations (" << std::fixed << std::setprecision(1) << toMiB(leaked) << " MiB) never freed" << std::endl;
+	}
+	allocations.clear();
+	callbacks.clear();
+	device = VK_NULL_HANDLE;
+}
+
+uint32_t MemoryTelemetry::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return i;
+	throw std::runtime_error("Failed to find a suitable memory type!");
+}
+
+void MemoryTelemetry::update() {
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	if (hasBudgetExtension) {
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
+	}
+
+	std::vector<MemoryBudgetEvent> events;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+			MemoryHeapStats& heap = heaps[i];
+			if (hasBudgetExtension) {
+				heap.budget = budgetProperties.heapBudget[i];
+				heap.usage = budgetProperties.heapUsage[i];
+			} else {
+				heap.budget = heap.size / 5 * 4;
+				heap.usage = heap.engineBytes;
+			}
+			heap.highWater = std::max(heap.highWater, heap.usage);
+			bool over = heap.budget > 0 && heap.usage > static_cast<VkDeviceSize>(heap.budget * static_cast<double>(budgetFraction));
+			if (over != heap.overBudget) {
+				heap.overBudget = over;
+				events.push_back({ i, heap.deviceLocal, over, heap.usage, heap.budget });
+			}
+		}
+	}
+	for (const MemoryBudgetEvent& event : events) // outside the lock, a callback may well free something
+		for (const BudgetCallback& callback : callbacks)
+			callback(event);
+}
+
+void MemoryTelemetry::add(MemoryCategory category, uint32_t heap, int64_t bytes) {
+	MemoryCategoryStats& stats = categories[static_cast<uint32_t>(category)];
+	stats.bytes += bytes;
+	stats.highWater = std::max(stats.highWater, stats.bytes);
+	if (heap != NO_HEAP)
+		heaps[heap].engineBytes += bytes;
+}
+
+void MemoryTelemetry::trackAllocation(uint64_t handle, MemoryCategory category, uint32_t heap, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	allocations[handle] = { category, heap, size };
+	add(category, heap, static_cast<int64_t>(size));
+	++categories[static_cast<uint32_t>(category)].allocations;
+}
+
+void MemoryTelemetry::trackFree(uint64_t handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = allocations.find(handle);
+	if (it == allocations.end())
+		return; // allocated before the telemetry was, or not through it
+	add(it->second.category, it->second.heap, -static_cast<int64_t>(it->second.size));
+	--categories[static_cast<uint32_t>(it->second.category)].allocations;
+	allocations.erase(it);
+}
+
+void MemoryTelemetry::trackCpu(MemoryCategory category, int64_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	add(category, NO_HEAP, bytes);
+}
+
+MemoryCategoryStats MemoryTelemetry::categoryStats(MemoryCategory category) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return categories[static_cast<uint32_t>(category)];
+}
+
+MemoryHeapStats MemoryTelemetry::heapStats(uint32_t heap) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return heaps[heap];
+}
+
+void MemoryTelemetry::dumpStats(std::ostream& out) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	out << std::fixed << std::setprecision(1);
+	out << "Memory" << (hasBudgetExtension ? "" : " (no VK_EXT_memory_budget, budgets are estimates)") << ":\n";
+	out << "  heap             size MiB  budget MiB   usage MiB    peak MiB  engine MiB\n";
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+		const MemoryHeapStats& heap = heaps[i];
+		out << "  " << std::setw(2) << i << (heap.deviceLocal ? " device " : " host   ") << std::setw(14) << toMiB(heap.size) << std::setw(12) << toMiB(heap.budget)
+			<< std::setw(12) << toMiB(heap.usage) << std::setw(12) << toMiB(heap.highWater) << std::setw(12) << toMiB(heap.engineBytes)
+			<< (heap.overBudget ? "  over budget" : "") << "\n";
+	}
+	out << "  category           MiB    peak MiB  allocations\n";
+	for (uint32_t i = 0; i < static_cast<uint32_t>(MemoryCategory::Count); ++i) {
+		const MemoryCategoryStats& stats = categories[i];
+		out << "  " << std::left << std::setw(12) << memoryCategoryName(static_cast<MemoryCategory>(i)) << std::right << std::setw(10) << toMiB(stats.bytes)
+			<< std::setw(12) << toMiB(stats.highWater) << std::setw(13) << stats.allocations << "\n";
+	}
+	out << std::flush;
+}
+
+std::string MemoryTelemetry::summary() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	VkDeviceSize usage = 0, budget = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+		if (heaps[i].deviceLocal) {
+			usage += heaps[i].usage;
+			budget += heaps[i].budget;
+		}
+	char text[64];
+	std::snprintf(text, sizeof(text), "VRAM %.0f/%.0f MiB", toMiB(usage), toMiB(budget));
+	return text;
+}
+
+MemoryTelemetry* MemoryTelemetry::forDevice(VkDevice device) {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (auto& [registered, telemetry] : registry)
+		if (registered == device)
+			return telemetry;
+	return nullptr;
+}
+
+VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, VkDeviceMemory& outMemory) {
+	VkResult result = vkAllocateMemory(device, &allocateInfo, nullptr, &outMemory);
+	if (result != VK_SUCCESS)
+		return result;
+	if (MemoryTelemetry* telemetry = MemoryTelemetry::forDevice(device)) {
+		uint32_t heap = telemetry->properties().memoryTypes[allocateInfo.memoryTypeIndex].heapIndex;
+		telemetry->trackAllocation(handleKey(outMemory), category, heap, allocateInfo.allocationSize);
+	}
+	return result;
+}
+
+void freeDeviceMemory(VkDevice device, VkDeviceMemory memory) {
+	if (memory == VK_NULL_HANDLE)
+		return;
+	if (MemoryTelemetry* telemetry = MemoryTelemetry::forDevice(device))
+		telemetry->trackFree(handleKey(memory));
+	vkFreeMemory(device, memory, nullptr);
+}
+
+VkResult allocateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo& createInfo, VkDescriptorPool& outPool) {
+	VkResult result = vkCreateDescriptorPool(device, &createInfo, nullptr, &outPool);
+	if (result != VK_SUCCESS)
+		return result;
+	if (MemoryTelemetry* telemetry = MemoryTelemetry::forDevice(device)) {
+		VkDeviceSize descriptors = 0;
+		for (uint32_t i = 0; i < createInfo.poolSizeCount; ++i)
+			descriptors += createInfo.pPoolSizes[i].descriptorCount;
+		telemetry->trackAllocation(handleKey(outPool), MemoryCategory::Descriptors, NO_HEAP, descriptors * DESCRIPTOR_BYTES);
+	}
+	return result;
+}
+
+void freeDescriptorPool(VkDevice device, VkDescriptorPool pool) {
+	if (pool == VK_NULL_HANDLE)
+		return;
+	if (MemoryTelemetry* telemetry = MemoryTelemetry::forDevice(device))
+		telemetry->trackFree(handleKey(pool));
+	vkDestroyDescriptorPool(device, pool, nullptr);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What memory the engine holds, and how close the device is to running out of it. The telemetry caches the memory properties once (findMemoryType
+// goes through the cache instead of querying the device every call), accounts every device memory allocation and descriptor pool to a category,
+// and update() reads the driver's budget and usage per heap once a frame through VK_EXT_memory_budget. Without the extension the budget is 80% of
+// the heap and the usage is what the engine itself has allocated from it, which misses other processes and the driver's own allocations.
+// High watermarks are kept for every category and heap. Budget callbacks fire when a heap's usage goes past budgetFraction of its budget and again
+// once it is back under, so systems that can hold less (the terrain streaming) back off before allocations start failing.
+// The modules allocate through allocateDeviceMemory()/freeDeviceMemory() and allocateDescriptorPool()/freeDescriptorPool(), which account to the
+// telemetry initialized for the device, if there is one. Devices without one (the multi GPU offscreen jobs) just aren't tracked.
+
+enum class MemoryCategory : uint32_t { Buffers, Images, Staging, Descriptors, CpuArenas, Count };
+
+const char* memoryCategoryName(MemoryCategory category);
+MemoryCategory bufferMemoryCategory(VkBufferUsageFlags usage); // transfer sources are staging, everything else a buffer
+
+struct MemoryCategoryStats {
+	uint64_t bytes = 0; // descriptors are estimated, the API doesn't tell how much a pool takes
+	uint64_t highWater = 0;
+	uint64_t allocations = 0; // live
+};
+
+struct MemoryHeapStats {
+	VkDeviceSize size = 0;
+	VkDeviceSize budget = 0; // what this process can use without the driver having to page, as of the last update()
+	VkDeviceSize usage = 0; // what this process uses of it, as of the last update()
+	VkDeviceSize highWater = 0; // of usage
+	VkDeviceSize engineBytes = 0; // the part of it the engine allocated itself, up to date
+	bool deviceLocal = false;
+	bool overBudget = false; // past budgetFraction as of the last update()
+};
+
+struct MemoryBudgetEvent {
+	uint32_t heap;
+	bool deviceLocal;
+	bool exceeded; // false: back under
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+};
+
+class MemoryTelemetry {
+public:
+	using BudgetCallback = std::function<void(const MemoryBudgetEvent& event)>;
+
+	// budgetExtension: VK_EXT_memory_budget is enabled on the device. registers the telemetry for the device's allocations
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, bool budgetExtension);
+	void destroy(); // everything should have been freed by now, anything still accounted is reported as leaked
+
+	const VkPhysicalDeviceMemoryProperties& properties() const { return memoryProperties; }
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const; // throws if there is none
+
+	// once per frame, on one thread: reads the budgets, moves the watermarks, fires the callbacks
+	void update();
+	// on the thread that calls update(), which is where they're called from. a callback fires for every heap that crosses
+	void addBudgetCallback(const BudgetCallback& callback) { callbacks.push_back(callback); }
+	void setBudgetFraction(float fraction) { budgetFraction = fraction; }
+
+	// called by the allocation functions below. any thread
+	void trackAllocation(uint64_t handle, MemoryCategory category, uint32_t heap, VkDeviceSize size);
+	void trackFree(uint64_t handle);
+	void trackCpu(MemoryCategory category, int64_t bytes); // CPU memory the engine holds in bulk (arenas, pools), negative when it's released
+
+	MemoryCategoryStats categoryStats(MemoryCategory category) const;
+	uint32_t heapCount() const { return memoryProperties.memoryHeapCount; }
+	MemoryHeapStats heapStats(uint32_t heap) const;
+	void dumpStats(std::ostream& out) const; // a table of every heap and category
+	std::string summary() const; // device local usage and budget, for the window title
+
+	static MemoryTelemetry* forDevice(VkDevice device); // nullptr for a device without telemetry
+
+private:
+	struct Allocation {
+		MemoryCategory category;
+		uint32_t heap; // UINT32_MAX for descriptors and CPU memory, which aren't in a device heap
+		VkDeviceSize size;
+	};
+	void add(MemoryCategory category, uint32_t heap, int64_t bytes);
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkDevice device = VK_NULL_HANDLE;
+	bool hasBudgetExtension = false;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	float budgetFraction = 0.9f;
+	std::vector<BudgetCallback> callbacks;
+
+	mutable std::mutex mutex; // the tracking can come from any thread
+	std::unordered_map<uint64_t, Allocation> allocations; // by handle
+	MemoryCategoryStats categories[static_cast<uint32_t>(MemoryCategory::Count)];
+	MemoryHeapStats heaps[VK_MAX_MEMORY_HEAPS];
+};
+
+// vkAllocateMemory/vkFreeMemory and vkCreateDescriptorPool/vkDestroyDescriptorPool, accounted to the device's telemetry
+VkResult allocateDeviceMemory(VkDevice device, const VkMemoryAllocateInfo& allocateInfo, MemoryCategory category, VkDeviceMemory& outMemory);
+void freeDeviceMemory(VkDevice device, VkDeviceMemory memory); // null is fine
+VkResult allocateDescriptorPool(VkDevice device, const VkDescriptorPoolCreateInfo& createInfo, VkDescriptorPool& outPool);
+void freeDescriptorPool(VkDevice device, VkDescriptorPool pool); // null is fine
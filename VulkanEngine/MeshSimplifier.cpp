@@ -0,0 +1,277 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+	// weighted sum of squared distances to a set of planes, as the symmetric 4x4 matrix of the plane equations: p^T A p + 2 b.p + c. divided by the
+	// total weight that's the mean squared distance, so the error comes out in mesh units whatever the triangle sizes
+	struct Quadric {
+		double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+		double b0 = 0, b1 = 0, b2 = 0;
+		double c = 0;
+		double weight = 0;
+
+		void addPlane(const glm::vec3& normal, float distance, double weight) { // normal.p + distance = 0, normal normalized
+			double x = normal.x, y = normal.y, z = normal.z, d = distance;
+			a00 += weight * x * x; a01 += weight * x * y; a02 += weight * x * z;
+			a11 += weight * y * y; a12 += weight * y * z; a22 += weight * z * z;
+			b0 += weight * x * d; b1 += weight * y * d; b2 += weight * z * d;
+			c += weight * d * d;
+			this->weight += weight;
+		}
+		void add(const Quadric& other) {
+			a00 += other.a00; a01 += other.a01; a02 += other.a02; a11 += other.a11; a12 += other.a12; a22 += other.a22;
+			b0 += other.b0; b1 += other.b1; b2 += other.b2;
+			c += other.c;
+			weight += other.weight;
+		}
+		double evaluate(const glm::vec3& p) const {
+			double x = p.x, y = p.y, z = p.z;
+			double result = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+			return result > 0.0 && weight > 0.0 ? result / weight : 0.0; // rounding can dip just under
+		}
+	};
+
+	struct Collapse {
+		uint32_t from; // merged into `to`
+		uint32_t to;
+		float error;
+	};
+
+	// the simplification state, kept between calls so buildLodChain() can carry on from the previous LOD instead of starting over
+	class Simplifier {
+	public:
+		Simplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, const SimplifyOptions& options)
+			: positions(positions), options(options), triangles(indices), quadrics(positions.size()), displacement(positions.size(), 0.0f) {
+			if (indices.size() % 3 != 0) {
+				throw std::runtime_error("Mesh simplifier needs a triangle list!");
+			}
+			for (uint32_t index : indices) {
+				if (index >= positions.size())
+					throw std::runtime_error("Mesh simplifier got an index past the end of the vertices!");
+			}
+			buildQuadrics();
+		}
+
+		// collapses edges until there are at most targetIndexCount indices left or nothing more can go within maxError
+		void simplifyTo(size_t targetIndexCount) {
+			while (triangles.size() > targetIndexCount) {
+				if (runPass(targetIndexCount) == 0)
+					break;
+			}
+		}
+
+		const std::vector<uint32_t>& indices() const { return triangles; }
+		float error() const { return currentError; }
+
+	private:
+		void buildQuadrics() {
+			// every triangle's plane, weighted by its area so a few slivers can't outvote the big triangles around a vertex
+			std::vector<std::pair<uint64_t, uint32_t>> edges; // (undirected edge, triangle) to find the borders
+			edges.reserve(triangles.size());
+			for (size_t t = 0; t < triangles.size(); t += 3) {
+				glm::vec3 normal;
+				double area;
+				if (!triangleNormal(t, normal, area))
+					continue;
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					quadrics[triangles[t + corner]].addPlane(normal, -glm::dot(normal, positions[triangles[t]]), area);
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					edges.push_back({ edgeKey(triangles[t + corner], triangles[t + (corner + 1) % 3]), static_cast<uint32_t>(t) });
+			}
+
+			// an edge only one triangle uses is on an open border. a plane standing up along it (perpendicular to the triangle) keeps the border
+			// vertices from sliding inwards
+			std::sort(edges.begin(), edges.end());
+			for (size_t i = 0; i < edges.size(); ++i) {
+				bool shared = (i > 0 && edges[i - 1].first == edges[i].first) || (i + 1 < edges.size() && edges[i + 1].first == edges[i].first);
+				if (shared)
+					continue;
+				uint32_t a = static_cast<uint32_t>(edges[i].first >> 32);
+				uint32_t b = static_cast<uint32_t>(edges[i].first & 0xFFFFFFFF);
+				glm::vec3 normal;
+				double area;
+				triangleNormal(edges[i].second, normal, area);
+				glm::vec3 edge = positions[b] - positions[a];
+				glm::vec3 borderNormal = glm::cross(edge, normal);
+				float length = glm::length(borderNormal);
+				if (length <= 0.0f)
+					continue;
+				borderNormal /= length;
+				double weight = options.borderWeight * glm::dot(edge, edge);
+				float distance = -glm::dot(borderNormal, positions[a]);
+				quadrics[a].addPlane(borderNormal, distance, weight);
+				quadrics[b].addPlane(borderNormal, distance, weight);
+			}
+		}
+
+		bool triangleNormal(size_t t, glm::vec3& outNormal, double& outArea) const {
+			const glm::vec3& p0 = positions[triangles[t]];
+			glm::vec3 normal = glm::cross(positions[triangles[t + 1]] - p0, positions[triangles[t + 2]] - p0);
+			float length = glm::length(normal);
+			if (length <= 0.0f)
+				return false; // degenerate, has no plane
+			outNormal = normal / length;
+			outArea = 0.5 * length;
+			return true;
+		}
+
+		static uint64_t edgeKey(uint32_t a, uint32_t b) {
+			return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+		}
+
+		float collapseError(uint32_t from, uint32_t to) const {
+			Quadric merged = quadrics[from];
+			merged.add(quadrics[to]);
+			float geometric = static_cast<float>(std::sqrt(merged.evaluate(positions[to])));
+			float slide = std::max(displacement[from] + glm::length(positions[to] - positions[from]), displacement[to]);
+			return std::max(geometric, options.attributeWeight * slide);
+		}
+
+		// moving `from` onto `to` must not turn any of the triangles around it over (or squash them flat)
+		bool flipsTriangles(uint32_t from, uint32_t to) const {
+			for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a) {
+				size_t t = adjacentTriangles[a];
+				uint32_t corners[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+				if (corners[0] == to || corners[1] == to || corners[2] == to)
+					continue; // collapses away with the edge
+				glm::vec3 before = glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+				for (uint32_t& corner : corners)
+					if (corner == from)
+						corner = to;
+				glm::vec3 after = glm::cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+				float lengths = glm::length(before) * glm::length(after);
+				if (lengths <= 0.0f || glm::dot(before, after) < 0.25f * lengths) // more than ~75 degrees of turn
+					return true;
+			}
+			return false;
+		}
+
+		// one round of collapses over the current triangles, cheapest first. a collapse locks everything around it for the rest of the pass, so the
+		// adjacency and the flip tests stay valid without being updated. returns how many collapses were done
+		size_t runPass(size_t targetIndexCount) {
+			buildAdjacency();
+
+			std::vector<uint64_t> edges;
+			edges.reserve(triangles.size());
+			for (size_t t = 0; t < triangles.size(); t += 3)
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					edges.push_back(edgeKey(triangles[t + corner], triangles[t + (corner + 1) % 3]));
+			std::sort(edges.begin(), edges.end());
+			edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+			std::vector<Collapse> collapses;
+			collapses.reserve(edges.size());
+			for (uint64_t edge : edges) {
+				uint32_t a = static_cast<uint32_t>(edge >> 32);
+				uint32_t b = static_cast<uint32_t>(edge & 0xFFFFFFFF);
+				float errorAB = collapseError(a, b);
+				float errorBA = collapseError(b, a);
+				collapses.push_back(errorAB <= errorBA ? Collapse{ a, b, errorAB } : Collapse{ b, a, errorBA });
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.error < rhs.error; });
+
+			std::vector<bool> locked(positions.size(), false);
+			std::vector<uint32_t> remap(positions.size());
+			for (size_t v = 0; v < remap.size(); ++v)
+				remap[v] = static_cast<uint32_t>(v);
+
+			size_t indexCount = triangles.size();
+			size_t collapsed = 0;
+			for (const Collapse& collapse : collapses) {
+				if (indexCount <= targetIndexCount || collapse.error > options.maxError)
+					break; // sorted, so nothing after it fits either
+				if (locked[collapse.from] || locked[collapse.to] || flipsTriangles(collapse.from, collapse.to))
+					continue;
+
+				remap[collapse.from] = collapse.to;
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				displacement[collapse.to] = std::max(displacement[collapse.from] + glm::length(positions[collapse.to] - positions[collapse.from]), displacement[collapse.to]);
+				currentError = std::max(currentError, collapse.error);
+				++collapsed;
+
+				for (uint32_t vertex : { collapse.from, collapse.to }) {
+					for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+						size_t t = adjacentTriangles[a];
+						bool removed = vertex == collapse.from && (triangles[t] == collapse.to || triangles[t + 1] == collapse.to || triangles[t + 2] == collapse.to);
+						if (removed)
+							indexCount -= 3;
+						for (uint32_t corner = 0; corner < 3; ++corner)
+							locked[triangles[t + corner]] = true;
+					}
+				}
+			}
+
+			// apply the collapses and drop the triangles that lost an edge
+			size_t write = 0;
+			for (size_t t = 0; t < triangles.size(); t += 3) {
+				uint32_t a = remap[triangles[t]], b = remap[triangles[t + 1]], c = remap[triangles[t + 2]];
+				if (a == b || b == c || c == a)
+					continue;
+				triangles[write++] = a;
+				triangles[write++] = b;
+				triangles[write++] = c;
+			}
+			triangles.resize(write);
+			return collapsed;
+		}
+
+		void buildAdjacency() { // which triangles use each vertex, flattened like the meshlet builder's
+			adjacencyOffsets.assign(positions.size() + 1, 0);
+			for (uint32_t index : triangles)
+				++adjacencyOffsets[index + 1];
+			for (size_t v = 0; v < positions.size(); ++v)
+				adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+			adjacentTriangles.resize(triangles.size());
+			std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < triangles.size(); ++i)
+				adjacentTriangles[cursor[triangles[i]]++] = static_cast<uint32_t>(i - i % 3); // first index of the triangle
+		}
+
+		const std::vector<glm::vec3>& positions;
+		SimplifyOptions options;
+		std::vector<uint32_t> triangles;
+		std::vector<Quadric> quadrics;
+		std::vector<float> displacement; // furthest any vertex merged into this one has slid
+		float currentError = 0.0f;
+
+		std::vector<uint32_t> adjacencyOffsets;
+		std::vector<uint32_t> adjacentTriangles;
+	};
+}
+
+std::vector<uint32_t> simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+	const SimplifyOptions& options, float* outError) {
+	Simplifier simplifier(positions, indices, options);
+	simplifier.simplifyTo(targetIndexCount);
+	if (outError != nullptr)
+		*outError = simplifier.error();
+	return simplifier.indices();
+}
+
+std::vector<MeshLod> buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxLodCount,
+	float reduction, const SimplifyOptions& options) {
+	if (maxLodCount == 0 || reduction <= 0.0f || reduction >= 1.0f) {
+		throw std::runtime_error("LOD chain settings out of range!");
+	}
+
+	std::vector<MeshLod> lods;
+	lods.push_back({ indices, 0.0f });
+
+	Simplifier simplifier(positions, indices, options);
+	while (lods.size() < maxLodCount) {
+		size_t previousCount = lods.back().indices.size();
+		size_t target = static_cast<size_t>(previousCount / 3 * reduction) * 3;
+		if (target == 0)
+			break;
+		simplifier.simplifyTo(target);
+		if (simplifier.indices().size() * 10 > previousCount * 9)
+			break; // less than 10% smaller, maxError (or the mesh's shape) doesn't let it go further
+		lods.push_back({ simplifier.indices(), simplifier.error() });
+	}
+	return lods;
+}
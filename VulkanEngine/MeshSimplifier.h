@@ -0,0 +1,36 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// Mesh simplifier: quadric error edge collapse (Garland/Heckbert). Every vertex carries the sum of the squared distances to the planes of the
+// triangles around it (its quadric), and edges are collapsed cheapest first, merging one end into the other, until the mesh is small enough or the
+// next collapse would move the surface further than allowed. Open borders get extra planes standing up along their edges so they don't shrink.
+// Collapses only ever move a vertex onto an existing one, so the result is a new index list over the same vertices - every LOD shares the mesh's
+// vertex buffer. Plain CPU code like MeshletBuilder, meant to run offline (here at load time, the tree has no asset pipeline).
+
+struct SimplifyOptions {
+	float maxError = 1e30f; // mesh space distance the surface may move, collapses past it aren't done
+	// how much sliding a vertex along the surface counts as error. a flat surface simplifies without any geometric error, but its attributes
+	// (colors, uvs) still slide with the vertices. 0 = purely geometric
+	float attributeWeight = 0.0f;
+	float borderWeight = 10.0f; // how strongly open borders keep their shape, relative to the surface
+};
+
+struct MeshLod {
+	std::vector<uint32_t> indices; // triangle list over the original vertices
+	float error = 0.0f; // how far (mesh space) this LOD's surface can be from the original, 0 for the original itself
+};
+
+// simplifies down to targetIndexCount indices or as far as maxError allows. outError (optional) gets the error of the result
+std::vector<uint32_t> simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount,
+	const SimplifyOptions& options = SimplifyOptions(), float* outError = nullptr);
+
+// the original mesh followed by successively simplified versions, each with about `reduction` of the previous one's triangles. stops at maxLodCount
+// LODs or when the simplifier can't get meaningfully further. errors only ever grow along the chain
+std::vector<MeshLod> buildLodChain(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxLodCount,
+	float reduction = 0.5f, const SimplifyOptions& options = SimplifyOptions());
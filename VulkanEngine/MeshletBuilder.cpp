@@ -0,0 +1,228 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+	const uint32_t NO_INDEX = UINT32_MAX;
+
+	// which triangles use each vertex, flattened: triangles of vertex v are triangleIds[offsets[v] .. offsets[v + 1])
+	struct VertexAdjacency {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangleIds;
+	};
+
+	VertexAdjacency buildAdjacency(size_t vertexCount, const std::vector<uint32_t>& indices) {
+		VertexAdjacency adjacency;
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		for (uint32_t index : indices)
+			++adjacency.offsets[index + 1];
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		adjacency.triangleIds.resize(indices.size());
+		std::vector<uint32_t> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i)
+			adjacency.triangleIds[cursor[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		return adjacency;
+	}
+}
+
+MeshletData buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxVertices, uint32_t maxTriangles) {
+	if (indices.size() % 3 != 0) {
+		throw std::runtime_error("Meshlet builder needs a triangle list!");
+	}
+	if (maxVertices < 3 || maxVertices > 256 || maxTriangles == 0) {
+		throw std::runtime_error("Meshlet limits out of range!");
+	}
+	for (uint32_t index : indices) {
+		if (index >= positions.size())
+			throw std::runtime_error("Meshlet builder got an index past the end of the vertices!");
+	}
+
+	MeshletData data;
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0)
+		return data;
+
+	VertexAdjacency adjacency = buildAdjacency(positions.size(), indices);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> localIndex(positions.size(), NO_INDEX); // the current meshlet's local index of each mesh vertex
+
+	Meshlet current{};
+	glm::vec3 centroidSum(0.0f); // of the current meshlet's triangle centers, the tie breaker between equally cheap candidates
+	uint32_t scanCursor = 0; // everything before this has been emitted, where a new meshlet starts when there's no neighbour to grow into
+
+	auto triangleCenter = [&](uint32_t triangle) {
+		return (positions[indices[triangle * 3]] + positions[indices[triangle * 3 + 1]] + positions[indices[triangle * 3 + 2]]) / 3.0f;
+	};
+	auto newVertexCount = [&](uint32_t triangle) {
+		uint32_t count = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+			count += localIndex[indices[triangle * 3 + corner]] == NO_INDEX ? 1 : 0;
+		return count;
+	};
+
+	auto finishMeshlet = [&]() {
+		if (current.triangleCount == 0)
+			return;
+		current.bounds = computeMeshletBounds(positions, data, current);
+		for (uint32_t i = 0; i < current.vertexCount; ++i)
+			localIndex[data.vertices[current.vertexOffset + i]] = NO_INDEX;
+		data.meshlets.push_back(current);
+
+		current = Meshlet{};
+		current.vertexOffset = static_cast<uint32_t>(data.vertices.size());
+		current.triangleOffset = static_cast<uint32_t>(data.triangles.size() / 3);
+		centroidSum = glm::vec3(0.0f);
+	};
+
+	for (uint32_t remaining = triangleCount; remaining > 0; --remaining) {
+		// best unused triangle touching the current meshlet: fewest new vertices first, then closest to the meshlet's centroid
+		uint32_t best = NO_INDEX;
+		uint32_t bestNewVertices = 4;
+		float bestDistance = 0.0f;
+		if (current.triangleCount > 0) {
+			glm::vec3 centroid = centroidSum / static_cast<float>(current.triangleCount);
+			for (uint32_t i = 0; i < current.vertexCount; ++i) {
+				uint32_t vertex = data.vertices[current.vertexOffset + i];
+				for (uint32_t a = adjacency.offsets[vertex]; a < adjacency.offsets[vertex + 1]; ++a) {
+					uint32_t triangle = adjacency.triangleIds[a];
+					if (emitted[triangle])
+						continue;
+					uint32_t newVertices = newVertexCount(triangle);
+					if (newVertices > bestNewVertices)
+						continue;
+					glm::vec3 offset = triangleCenter(triangle) - centroid;
+					float distance = glm::dot(offset, offset);
+					if (newVertices < bestNewVertices || distance < bestDistance) {
+						best = triangle;
+						bestNewVertices = newVertices;
+						bestDistance = distance;
+					}
+				}
+			}
+		}
+
+		if (best == NO_INDEX) { // nothing connected left (or a fresh meshlet), carry on in index order
+			while (emitted[scanCursor])
+				++scanCursor;
+			best = scanCursor;
+			bestNewVertices = newVertexCount(best);
+		}
+
+		if (current.vertexCount + bestNewVertices > maxVertices || current.triangleCount + 1 > maxTriangles) {
+			finishMeshlet(); // the best candidate is next to the finished meshlet, so it's still a good seed for the next one
+			bestNewVertices = 3;
+		}
+
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			uint32_t vertex = indices[best * 3 + corner];
+			if (localIndex[vertex] == NO_INDEX) {
+				localIndex[vertex] = current.vertexCount++;
+				data.vertices.push_back(vertex);
+			}
+			data.triangles.push_back(static_cast<uint8_t>(localIndex[vertex]));
+		}
+		++current.triangleCount;
+		centroidSum += triangleCenter(best);
+		emitted[best] = true;
+	}
+	finishMeshlet();
+
+	MeshletLod lod;
+	lod.meshletCount = static_cast<uint32_t>(data.meshlets.size());
+	lod.triangleCount = triangleCount;
+	data.lods.push_back(lod);
+	return data;
+}
+
+MeshletData buildMeshletLods(const std::vector<glm::vec3>& positions, const std::vector<MeshLod>& lods, uint32_t maxVertices, uint32_t maxTriangles) {
+	MeshletData data;
+	for (const MeshLod& lod : lods) {
+		MeshletData lodData = buildMeshlets(positions, lod.indices, maxVertices, maxTriangles);
+		uint32_t vertexBase = static_cast<uint32_t>(data.vertices.size());
+		uint32_t triangleBase = static_cast<uint32_t>(data.triangles.size() / 3);
+
+		MeshletLod range;
+		range.meshletOffset = static_cast<uint32_t>(data.meshlets.size());
+		range.meshletCount = static_cast<uint32_t>(lodData.meshlets.size());
+		range.triangleCount = static_cast<uint32_t>(lod.indices.size() / 3);
+		range.error = lod.error;
+		data.lods.push_back(range);
+
+		for (Meshlet meshlet : lodData.meshlets) { // offsets are relative to the LOD's own lists until they're appended
+			meshlet.vertexOffset += vertexBase;
+			meshlet.triangleOffset += triangleBase;
+			data.meshlets.push_back(meshlet);
+		}
+		data.vertices.insert(data.vertices.end(), lodData.vertices.begin(), lodData.vertices.end());
+		data.triangles.insert(data.triangles.end(), lodData.triangles.begin(), lodData.triangles.end());
+	}
+	return data;
+}
+
+MeshletBounds computeMeshletBounds(const std::vector<glm::vec3>& positions, const MeshletData& data, const Meshlet& meshlet) {
+	MeshletBounds bounds;
+	if (meshlet.vertexCount == 0)
+		return bounds;
+
+	// sphere around the center of the bounding box. not the tightest possible, but cheap and never far off for a compact cluster
+	glm::vec3 minimum = positions[data.vertices[meshlet.vertexOffset]];
+	glm::vec3 maximum = minimum;
+	for (uint32_t i = 1; i < meshlet.vertexCount; ++i) {
+		const glm::vec3& position = positions[data.vertices[meshlet.vertexOffset + i]];
+		minimum = glm::min(minimum, position);
+		maximum = glm::max(maximum, position);
+	}
+	bounds.center = (minimum + maximum) * 0.5f;
+	for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+		bounds.radius = std::max(bounds.radius, glm::length(positions[data.vertices[meshlet.vertexOffset + i]] - bounds.center));
+
+	// normal cone: the axis is the average facing direction, and the cone has to contain every triangle's normal
+	std::vector<glm::vec3> corners(meshlet.triangleCount * 3);
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangleCount);
+	glm::vec3 normalSum(0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+		for (uint32_t corner = 0; corner < 3; ++corner) {
+			uint8_t local = data.triangles[(meshlet.triangleOffset + t) * 3 + corner];
+			corners[t * 3 + corner] = positions[data.vertices[meshlet.vertexOffset + local]];
+		}
+		glm::vec3 normal = glm::cross(corners[t * 3 + 1] - corners[t * 3], corners[t * 3 + 2] - corners[t * 3]); // counter clockwise is front facing, same as the pipelines
+		float length = glm::length(normal);
+		if (length <= 1e-12f) { // degenerate, doesn't face anywhere
+			normals.push_back(glm::vec3(0.0f));
+			continue;
+		}
+		normals.push_back(normal / length);
+		normalSum += normal / length;
+	}
+
+	float axisLength = glm::length(normalSum);
+	if (axisLength <= 1e-6f)
+		return bounds; // the normals cancel out, keep the never culled cone
+	glm::vec3 axis = normalSum / axisLength;
+
+	float minDot = 1.0f;
+	for (const glm::vec3& normal : normals)
+		if (glm::dot(normal, normal) > 0.0f) // skips the degenerate ones
+			minDot = std::min(minDot, glm::dot(normal, axis));
+	if (minDot <= 0.1f)
+		return bounds; // wider than ~170 degrees, the test would almost never pass
+
+	// the apex is pushed back along the axis until every triangle's plane is in front of it, so a camera inside the cone is behind all of them.
+	// the cone of back facing view directions is the normal cone widened by 90 degrees, its cosine is the sine of the normal cone's half angle
+	float maxT = 0.0f;
+	for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+		if (glm::dot(normals[t], normals[t]) == 0.0f)
+			continue;
+		float distance = glm::dot(bounds.center - corners[t * 3], normals[t]);
+		maxT = std::max(maxT, distance / glm::dot(axis, normals[t]));
+	}
+	bounds.coneApex = bounds.center - axis * maxT;
+	bounds.coneAxis = axis;
+	bounds.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+	return bounds;
+}
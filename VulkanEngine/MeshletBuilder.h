@@ -0,0 +1,61 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include "MeshSimplifier.h"
+
+#include <cstdint>
+#include <vector>
+
+// Meshlet builder: splits an indexed triangle mesh into meshlets, small clusters of at most 64 vertices and 124 triangles that the GPU culls and
+// draws as a unit (see MeshletRenderer). Each meshlet has its own vertex list (indices into the mesh's vertices) and a triangle list of local,
+// one byte indices into that vertex list, plus the bounds used for culling: a bounding sphere for the frustum test and a normal cone for
+// rejecting clusters that face away from the camera entirely.
+// Plain CPU code with no Vulkan in it, so it can run in an offline tool or a test just as well as at load time.
+
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124; // 124 rather than 126/128 keeps the 3 byte triangle lists 4 byte aligned
+
+struct MeshletBounds {
+	glm::vec3 center = glm::vec3(0.0f); // bounding sphere
+	float radius = 0.0f;
+	glm::vec3 coneApex = glm::vec3(0.0f); // normal cone: the cluster faces away from any camera with dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+	glm::vec3 coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float coneCutoff = 2.0f; // > 1 means the normals spread too far for the test, never culled
+};
+
+struct Meshlet {
+	uint32_t vertexOffset = 0; // first entry in MeshletData::vertices
+	uint32_t triangleOffset = 0; // first triangle in MeshletData::triangles (3 bytes each)
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	MeshletBounds bounds;
+};
+
+// one level of detail: a run of meshlets that together cover the whole mesh
+struct MeshletLod {
+	uint32_t meshletOffset = 0;
+	uint32_t meshletCount = 0;
+	uint32_t triangleCount = 0;
+	float error = 0.0f; // MeshLod::error, mesh space
+};
+
+struct MeshletData {
+	std::vector<MeshletLod> lods; // finest first, a single one from buildMeshlets()
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices; // meshlet local vertex -> mesh vertex, every meshlet's list back to back
+	std::vector<uint8_t> triangles; // 3 meshlet local vertex indices per triangle, same winding as the source indices
+};
+
+// grows each meshlet from its neighbouring triangles, preferring the ones that add the fewest new vertices, so meshlets come out compact (tight
+// spheres and cones) and with little vertex duplication between them. indices is a triangle list. throws if maxVertices is over 256 (local indices are bytes)
+MeshletData buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// every LOD of a chain (see MeshSimplifier.h) split into meshlets, all stored back to back in the same buffers and listed in MeshletData::lods. the LODs
+// share the mesh's vertices, so switching between them only changes which meshlets are drawn
+MeshletData buildMeshletLods(const std::vector<glm::vec3>& positions, const std::vector<MeshLod>& lods, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// bounds of a single meshlet, buildMeshlets() already fills them in
+MeshletBounds computeMeshletBounds(const std::vector<glm::vec3>& positions, const MeshletData& data, const Meshlet& meshlet);
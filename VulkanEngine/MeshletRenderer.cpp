@@ -0,0 +1,314 @@
+#include "MeshletRenderer.h"
+
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void MeshletRenderer::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const MeshletData& data, VkBuffer vertexBuffer, uint32_t framesInFlight,
+	VkShaderModule cullShader, VkDescriptorSetLayout depthPyramidSetLayout, bool meshShaders, const UploadFunction& upload) {
+	if (data.meshlets.empty() || data.lods.empty()) {
+		throw std::runtime_error("No meshlets to render!");
+	}
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	meshletTotal = data.meshlets.size();
+	lodRanges = data.lods;
+
+	std::vector<GpuMeshlet> gpuMeshlets(data.meshlets.size());
+	for (size_t i = 0; i < data.meshlets.size(); ++i) {
+		const Meshlet& meshlet = data.meshlets[i];
+		gpuMeshlets[i].sphere = glm::vec4(meshlet.bounds.center, meshlet.bounds.radius);
+		gpuMeshlets[i].coneApex = glm::vec4(meshlet.bounds.coneApex, meshlet.bounds.coneCutoff);
+		gpuMeshlets[i].coneAxis = glm::vec4(meshlet.bounds.coneAxis, 0.0f);
+		gpuMeshlets[i].vertexOffset = meshlet.vertexOffset;
+		gpuMeshlets[i].triangleOffset = meshlet.triangleOffset;
+		gpuMeshlets[i].vertexCount = meshlet.vertexCount;
+		gpuMeshlets[i].triangleCount = meshlet.triangleCount;
+	}
+	std::vector<uint32_t> packedTriangles(data.triangles.size() / 3); // storage buffers can't be read bytewise without extra features
+	for (size_t t = 0; t < packedTriangles.size(); ++t)
+		packedTriangles[t] = data.triangles[t * 3] | (data.triangles[t * 3 + 1] << 8) | (data.triangles[t * 3 + 2] << 16);
+
+	// the meshlet data never changes, so device local and uploaded once
+	VkBufferUsageFlags staticUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkDeviceSize meshletsSize = sizeof(GpuMeshlet) * gpuMeshlets.size();
+	VkDeviceSize verticesSize = sizeof(uint32_t) * data.vertices.size();
+	VkDeviceSize trianglesSize = sizeof(uint32_t) * packedTriangles.size();
+	createBuffer(meshletsSize, staticUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshlets.buffer, meshlets.memory);
+	createBuffer(verticesSize, staticUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletVertices.buffer, meshletVertices.memory);
+	createBuffer(trianglesSize, staticUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletTriangles.buffer, meshletTriangles.memory);
+	upload(meshlets.buffer, gpuMeshlets.data(), meshletsSize);
+	upload(meshletVertices.buffer, data.vertices.data(), verticesSize);
+	upload(meshletTriangles.buffer, packedTriangles.data(), trianglesSize);
+
+	// worst case every meshlet of the finest LOD is visible, drawn by one phase or the other. the cull passes rewrite all of it every frame, so one per
+	// frame in flight. same for the occlusion flags, which only the late phase of the frame that wrote them reads
+	uint32_t maxLodTriangles = 0;
+	uint32_t maxLodMeshlets = 0;
+	for (const MeshletLod& lod : data.lods) {
+		maxLodTriangles = std::max(maxLodTriangles, lod.triangleCount);
+		maxLodMeshlets = std::max(maxLodMeshlets, lod.meshletCount);
+	}
+	indexBufferSize = sizeof(uint32_t) * 3 * static_cast<VkDeviceSize>(maxLodTriangles);
+	occludedSize = sizeof(uint32_t) * static_cast<VkDeviceSize>(maxLodMeshlets);
+	frames.resize(framesInFlight);
+	for (Frame& frame : frames) {
+		createBuffer(indexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.indexBuffer, frame.indexMemory);
+		createBuffer(drawArgsBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawArgsBuffer, frame.drawArgsMemory);
+		createBuffer(occludedSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.occludedBuffer, frame.occludedMemory);
+		createBuffer(sizeof(MeshletOcclusionParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.paramsBuffer, frame.paramsMemory);
+		vkMapMemory(device, frame.paramsMemory, 0, sizeof(MeshletOcclusionParams), 0, &frame.params);
+		MeshletOcclusionParams noOcclusion{}; // until the first setOcclusionParams()
+		memcpy(frame.params, &noOcclusion, sizeof(noOcclusion));
+	}
+
+	createDescriptors(vertexBuffer, meshShaders);
+	createCullPipeline(cullShader, depthPyramidSetLayout);
+
+	if (meshShaders) {
+		drawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(device, "vkCmdDrawMeshTasksEXT");
+		if (drawMeshTasks == nullptr) {
+			throw std::runtime_error("Failed to load vkCmdDrawMeshTasksEXT!");
+		}
+	}
+}
+
+void MeshletRenderer::destroy() {
+	vkDestroyPipeline(device, cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	freeDescriptorPool(device, descriptorPool); // frees the sets too
+	vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, meshDescriptorSetLayout, nullptr); // null without mesh shaders, which is fine
+
+	for (Frame& frame : frames) {
+		vkDestroyBuffer(device, frame.indexBuffer, nullptr);
+		freeDeviceMemory(device, frame.indexMemory);
+		vkDestroyBuffer(device, frame.drawArgsBuffer, nullptr);
+		freeDeviceMemory(device, frame.drawArgsMemory);
+		vkDestroyBuffer(device, frame.occludedBuffer, nullptr);
+		freeDeviceMemory(device, frame.occludedMemory);
+		vkDestroyBuffer(device, frame.paramsBuffer, nullptr);
+		freeDeviceMemory(device, frame.paramsMemory); // unmaps it too
+	}
+	frames.clear();
+
+	for (StorageBuffer* storage : { &meshlets, &meshletVertices, &meshletTriangles }) {
+		vkDestroyBuffer(device, storage->buffer, nullptr);
+		freeDeviceMemory(device, storage->memory);
+		*storage = StorageBuffer{};
+	}
+}
+
+void MeshletRenderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create meshlet buffer!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device, outBuffer, &memReqs);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
+	if (allocateDeviceMemory(device, allocInfo, bufferMemoryCategory(usage), outMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate meshlet buffer memory!");
+	}
+
+	vkBindBufferMemory(device, outBuffer, outMemory, 0);
+}
+
+uint32_t MeshletRenderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void MeshletRenderer::createDescriptors(VkBuffer vertexBuffer, bool meshShaders) {
+	// cull: 0 meshlets, 1 meshlet vertices, 2 meshlet triangles, 3 visible indices, 4 draw args, 5 occlusion flags, 6 occlusion parameters (uniform).
+	// mesh: 0-2 the same, 3 the mesh's vertices
+	const uint32_t BINDINGS = 7;
+	const uint32_t PARAMS_BINDING = 6;
+	VkDescriptorSetLayoutBinding bindings[BINDINGS]{};
+	for (uint32_t i = 0; i < BINDINGS; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == PARAMS_BINDING ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = BINDINGS;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet descriptor set layout!");
+
+	uint32_t frameCount = static_cast<uint32_t>(frames.size());
+	uint32_t setCount = frameCount + (meshShaders ? 1 : 0);
+	if (meshShaders) {
+		for (uint32_t i = 0; i < 4; ++i)
+			bindings[i].stageFlags = i == 3 ? VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+		layoutInfo.bindingCount = 4;
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &meshDescriptorSetLayout) != VK_SUCCESS)
+			throw std::runtime_error("Failed to create meshlet descriptor set layout!");
+	}
+
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = frameCount * (BINDINGS - 1) + (meshShaders ? 4 : 0);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[1].descriptorCount = frameCount;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	poolInfo.maxSets = setCount;
+	if (allocateDescriptorPool(device, poolInfo, descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create meshlet descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, cullDescriptorSetLayout);
+	if (meshShaders)
+		layouts.push_back(meshDescriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(setCount);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate meshlet descriptor sets!");
+
+	for (uint32_t s = 0; s < setCount; ++s) {
+		bool mesh = s == frameCount;
+		VkBuffer buffers[BINDINGS] = { meshlets.buffer, meshletVertices.buffer, meshletTriangles.buffer, mesh ? vertexBuffer : frames[s].indexBuffer,
+			mesh ? VK_NULL_HANDLE : frames[s].drawArgsBuffer, mesh ? VK_NULL_HANDLE : frames[s].occludedBuffer, mesh ? VK_NULL_HANDLE : frames[s].paramsBuffer };
+		uint32_t bindingCount = mesh ? 4 : BINDINGS;
+
+		VkDescriptorBufferInfo bufferInfos[BINDINGS]{};
+		VkWriteDescriptorSet writes[BINDINGS]{};
+		for (uint32_t i = 0; i < bindingCount; ++i) {
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = sets[s];
+			writes[i].dstBinding = i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = bindings[i].descriptorType;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, bindingCount, writes, 0, nullptr);
+
+		if (mesh)
+			meshSet = sets[s];
+		else
+			frames[s].cullSet = sets[s];
+	}
+}
+
+void MeshletRenderer::createCullPipeline(VkShaderModule cullShader, VkDescriptorSetLayout depthPyramidSetLayout) {
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(MeshletCullParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	VkDescriptorSetLayout setLayouts[2] = { cullDescriptorSetLayout, depthPyramidSetLayout };
+	pipelineLayoutInfo.setLayoutCount = 2;
+	pipelineLayoutInfo.pSetLayouts = setLayouts;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create meshlet cull pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = cullPipelineLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create meshlet cull pipeline!");
+	}
+}
+
+void MeshletRenderer::groupCounts(uint32_t groups, uint32_t& x, uint32_t& y) const {
+	const uint32_t MAX_GROUPS_X = 65535;
+	x = groups < MAX_GROUPS_X ? groups : MAX_GROUPS_X;
+	y = (groups + MAX_GROUPS_X - 1) / MAX_GROUPS_X; // the shaders flatten the id and skip the overhang
+}
+
+void MeshletRenderer::setOcclusionParams(uint32_t frameIndex, const MeshletOcclusionParams& params) {
+	memcpy(frames[frameIndex].params, &params, sizeof(params));
+}
+
+void MeshletRenderer::recordCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const MeshletCullParams& params, uint32_t instanceCount, bool latePhase, VkDescriptorSet depthPyramidSet) {
+	const Frame& frame = frames[frameIndex];
+
+	// the workgroups append to indexCount, so both commands start from 0 every frame. the early phase resets them both, the late one still needs
+	// the early count (its firstIndex is written by the shader). the instance range is the frame's, the same for both
+	if (!latePhase) {
+		VkDrawIndexedIndirectCommand drawArgs[2] = {};
+		for (VkDrawIndexedIndirectCommand& args : drawArgs) {
+			args.instanceCount = instanceCount;
+			args.firstInstance = params.firstInstance;
+		}
+		vkCmdUpdateBuffer(commandBuffer, frame.drawArgsBuffer, 0, sizeof(drawArgs), drawArgs);
+
+		VkMemoryBarrier2 barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+		VkDependencyInfo dependencyInfo{};
+		dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependencyInfo.memoryBarrierCount = 1;
+		dependencyInfo.pMemoryBarriers = &barrier;
+		vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+	}
+
+	MeshletCullParams phaseParams = params;
+	phaseParams.occlusionPhase = latePhase ? 1 : 0;
+	VkDescriptorSet sets[2] = { frame.cullSet, depthPyramidSet };
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 2, sets, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullParams), &phaseParams);
+	uint32_t groupsX, groupsY;
+	groupCounts(params.meshletCount, groupsX, groupsY); // one workgroup per meshlet. in the late phase most of them only read their flag and leave
+	vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+}
+
+void MeshletRenderer::recordDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool latePhase) {
+	const Frame& frame = frames[frameIndex];
+	vkCmdBindIndexBuffer(commandBuffer, frame.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	VkDeviceSize offset = latePhase ? sizeof(VkDrawIndexedIndirectCommand) : 0;
+	vkCmdDrawIndexedIndirect(commandBuffer, frame.drawArgsBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand)); // index count comes from the cull pass
+}
+
+void MeshletRenderer::recordMeshShaderDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const MeshletCullParams& params, uint32_t instanceCount) {
+	if (instanceCount == 0)
+		return;
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, MESH_SET, 1, &meshSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(MeshletCullParams), &params);
+	uint32_t groupsX, groupsY;
+	groupCounts((params.meshletCount + TASK_WORKGROUP_SIZE - 1) / TASK_WORKGROUP_SIZE, groupsX, groupsY);
+	drawMeshTasks(commandBuffer, groupsX, groupsY, instanceCount); // meshlet.task takes the instance from gl_WorkGroupID.z
+}
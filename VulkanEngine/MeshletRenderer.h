@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "MeshletBuilder.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// GPU side of the meshlets (see MeshletBuilder.h). Two ways of drawing them:
+//  compute culling - Shaders/meshlet_cull.comp runs one workgroup per meshlet, tests its sphere against the frustum and its cone against the
+//                    camera, and the survivors append their triangles to a per frame index buffer and bump the indexCount of a
+//                    VkDrawIndexedIndirectCommand. The scene is then a single vkCmdDrawIndexedIndirect over the normal vertex buffer.
+//                    It runs in two phases around a Hi-Z depth pyramid (see DepthPyramid.h), for occlusion culling:
+//                     early - the meshlets in the frustum are also tested against last frame's pyramid, with last frame's transforms. the ones
+//                             that pass are drawn by the first half of the main pass, the ones that don't are flagged for the late phase
+//                     late  - after the pyramid has been rebuilt from what the early draw put in the depth buffer, the flagged meshlets are tested
+//                             again, with this frame's transforms, and the ones that turn out visible after all are drawn by the second half.
+//                             something that comes into view is only ever a frame late for the early draw, never missing
+//                    Both append to the same index buffer (the late triangles after the early ones) and each has its own draw command
+//  mesh shaders    - with VK_EXT_mesh_shader, Shaders/meshlet.task does the same test per meshlet and only launches Shaders/meshlet.mesh
+//                    workgroups for the visible ones, which read the vertices and local triangles straight from the meshlet buffers.
+//                    nothing is written out in between
+// With several LODs (MeshletData::lods) all of them are uploaded, and the caller picks one per frame through the meshlet range in MeshletCullParams.
+// Culling happens in the mesh's own space: the caller transforms the frustum planes and camera position into it (MeshletCullParams). The sphere
+// radii aren't scaled, so the model matrix must not scale.
+
+// push constants of the cull/task shaders, mirrors Shaders/meshlet_common.glsl. exactly the 128 bytes every device guarantees
+struct MeshletCullParams {
+	glm::vec4 frustumPlanes[6]; // xyz normal pointing into the frustum, normalized, w distance. in mesh space
+	glm::vec4 cameraPosition; // xyz in mesh space, w unused
+	uint32_t meshletCount; // the range of meshlets to cull and draw, the selected LOD's
+	uint32_t meshletOffset;
+	uint32_t occlusionPhase; // compute culling only, recordCull() sets it
+	uint32_t firstInstance; // the draw's instances are firstInstance.. in the caller's instance data, they all share the culled transform
+};
+
+// the occlusion test's parameters, a uniform buffer per frame in flight. mirrors OcclusionParams in Shaders/meshlet_cull.comp (std140)
+struct MeshletOcclusionParams {
+	glm::mat4 previousMeshToClip; // last frame's model-view-projection, what the pyramid the early phase tests against was rendered with
+	glm::mat4 meshToClip; // this frame's, without the jitter
+	glm::vec2 pyramidSize; // level 0 of the depth pyramid, in texels
+	uint32_t pyramidLevels;
+	uint32_t earlyOcclusion; // 0 = there's no previous pyramid to test against: the early phase draws everything in the frustum, the late one nothing
+};
+
+class MeshletRenderer {
+public:
+	static const uint32_t TASK_WORKGROUP_SIZE = 32; // meshlets per meshlet.task workgroup
+
+	using UploadFunction = std::function<void(VkBuffer dstBuffer, const void* data, VkDeviceSize size)>; // fills a device local buffer (transfer dst)
+
+	// vertexBuffer needs STORAGE_BUFFER usage for the mesh shader path. meshShaders = the device has VK_EXT_mesh_shader enabled. depthPyramidSetLayout
+	// is set 1 of the cull shader, the pyramid it tests occlusion against (DepthPyramid::sampleSetLayout())
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const MeshletData& data, VkBuffer vertexBuffer, uint32_t framesInFlight,
+		VkShaderModule cullShader, VkDescriptorSetLayout depthPyramidSetLayout, bool meshShaders, const UploadFunction& upload);
+	void destroy();
+
+	// compute path. recordCull writes the frame's index buffer and the phase's draw arguments, recordDraw binds the index buffer and draws the phase's
+	// meshlets indirectly (the caller binds the pipeline, the vertex buffer and set 0). the early phase has to be recorded before the late one, and the
+	// frame's occlusion parameters set before either runs. the frame's previous submission has to be done for setOcclusionParams().
+	// the draw is instanced: the early phase sets both phases' instance range, params.firstInstance and instanceCount (0 draws nothing). the cull
+	// runs once for all of them, so they all have to have the transform params was computed for
+	void setOcclusionParams(uint32_t frame, const MeshletOcclusionParams& params);
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frame, const MeshletCullParams& params, uint32_t instanceCount, bool latePhase, VkDescriptorSet depthPyramidSet);
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, bool latePhase);
+	VkBuffer visibleIndexBuffer(uint32_t frame) const { return frames[frame].indexBuffer; }
+	VkBuffer drawArgsBuffer(uint32_t frame) const { return frames[frame].drawArgsBuffer; }
+	VkBuffer occludedBuffer(uint32_t frame) const { return frames[frame].occludedBuffer; }
+	VkDeviceSize visibleIndexBufferSize() const { return indexBufferSize; }
+	static VkDeviceSize drawArgsBufferSize() { return 2 * sizeof(VkDrawIndexedIndirectCommand); } // early, late
+	VkDeviceSize occludedBufferSize() const { return occludedSize; }
+
+	// mesh shader path. binds MESH_SET and pushes the cull parameters (task and mesh stages), the caller binds the pipeline and the sets before it.
+	// instanceCount instances from params.firstInstance, a z layer of task workgroups each
+	static const uint32_t MESH_SET = 3; // MESHLET_SET in meshlet.task/meshlet.mesh, after the camera UBO, the lighting and the shadow sets
+	void recordMeshShaderDraw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const MeshletCullParams& params, uint32_t instanceCount);
+	VkDescriptorSetLayout meshSetLayout() const { return meshDescriptorSetLayout; } // MESH_SET of the mesh shader pipeline, null without mesh shaders
+
+	uint32_t meshletCount() const { return static_cast<uint32_t>(meshletTotal); }
+	const std::vector<MeshletLod>& lods() const { return lodRanges; }
+
+private:
+	// mirrors Meshlet in Shaders/meshlet_common.glsl
+	struct GpuMeshlet {
+		glm::vec4 sphere; // xyz center, w radius
+		glm::vec4 coneApex; // xyz apex, w cutoff
+		glm::vec4 coneAxis; // xyz axis, w unused
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+	struct Frame {
+		VkBuffer indexBuffer = VK_NULL_HANDLE; // compacted triangles of the visible meshlets, mesh vertex indices
+		VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+		VkBuffer drawArgsBuffer = VK_NULL_HANDLE; // a VkDrawIndexedIndirectCommand per phase
+		VkDeviceMemory drawArgsMemory = VK_NULL_HANDLE;
+		VkBuffer occludedBuffer = VK_NULL_HANDLE; // a uint per meshlet of the LOD, set where the early phase found it occluded
+		VkDeviceMemory occludedMemory = VK_NULL_HANDLE;
+		VkBuffer paramsBuffer = VK_NULL_HANDLE; // MeshletOcclusionParams, host visible and persistently mapped
+		VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+		void* params = nullptr;
+		VkDescriptorSet cullSet = VK_NULL_HANDLE;
+	};
+	struct StorageBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+	};
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	void createDescriptors(VkBuffer vertexBuffer, bool meshShaders);
+	void createCullPipeline(VkShaderModule cullShader, VkDescriptorSetLayout depthPyramidSetLayout);
+	void groupCounts(uint32_t groups, uint32_t& x, uint32_t& y) const; // splits over y past maxComputeWorkGroupCount[0]'s guaranteed 65535
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	size_t meshletTotal = 0;
+	std::vector<MeshletLod> lodRanges;
+	VkDeviceSize indexBufferSize = 0; // sized for the largest LOD
+	VkDeviceSize occludedSize = 0; // same
+
+	StorageBuffer meshlets; // GpuMeshlet per meshlet
+	StorageBuffer meshletVertices; // MeshletData::vertices
+	StorageBuffer meshletTriangles; // one uint per triangle, the 3 local indices packed in the low 24 bits
+	std::vector<Frame> frames;
+
+	VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout meshDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet meshSet = VK_NULL_HANDLE;
+	VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = nullptr; // extension function, loaded in init()
+};
@@ -0,0 +1,461 @@
+#include "MultiGpuOffscreen.h"
+
+#include "DeviceSelector.h"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iomanip>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	const VkFormat OFFSCREEN_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// the colour a job clears to, every job gets a different one so a readback of the wrong image (or a stale one) is caught
+	void jobColor(uint32_t job, uint32_t deviceIndex, uint8_t rgba[4]) {
+		rgba[0] = static_cast<uint8_t>(job & 0xFF);
+		rgba[1] = static_cast<uint8_t>((job >> 8) & 0xFF);
+		rgba[2] = static_cast<uint8_t>(deviceIndex & 0xFF);
+		rgba[3] = 0xFF;
+	}
+
+	std::optional<uint32_t> findGraphicsFamily(VkPhysicalDevice device) {
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+		for (uint32_t i = 0; i < queueFamilyCount; ++i)
+			if (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				return i;
+		return std::nullopt;
+	}
+
+	// one GPU's share of the work: its own logical device, render pass and a small ring of offscreen targets
+	class OffscreenDevice {
+	public:
+		OffscreenDevice(const DeviceCapabilities& capabilities, uint32_t graphicsFamily, const OffscreenSettings& settings);
+		~OffscreenDevice();
+		OffscreenDevice(const OffscreenDevice&) = delete;
+		OffscreenDevice& operator=(const OffscreenDevice&) = delete;
+
+		// pulls jobs until nextJob passes the job count, then waits for the last ones to finish
+		void run(std::atomic<uint32_t>& nextJob, uint32_t jobCount);
+
+		const DeviceCapabilities& capabilities() const { return info; }
+		uint32_t jobsCompleted() const { return completed; }
+		uint32_t jobsFailed() const { return failed; }
+		double seconds() const { return elapsed; }
+
+	private:
+		struct Target {
+			VkImage image = VK_NULL_HANDLE;
+			VkDeviceMemory imageMemory = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkFramebuffer framebuffer = VK_NULL_HANDLE;
+			VkBuffer readback = VK_NULL_HANDLE;
+			VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+			const uint8_t* mapped = nullptr;
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			std::optional<uint32_t> job; // the job in flight on this target
+		};
+
+		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+		void createRenderPass();
+		void createTarget(Target& target);
+		void recordJob(Target& target, uint32_t job);
+		void finishJob(Target& target); // waits for the target's job and checks what came back
+
+		DeviceCapabilities info;
+		OffscreenSettings settings;
+		VkDevice device = VK_NULL_HANDLE;
+		VkQueue queue = VK_NULL_HANDLE;
+		uint32_t queueFamily = 0;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<Target> targets;
+
+		uint32_t completed = 0;
+		uint32_t failed = 0;
+		double elapsed = 0.0;
+	};
+
+	OffscreenDevice::OffscreenDevice(const DeviceCapabilities& capabilities, uint32_t graphicsFamily, const OffscreenSettings& settings)
+		: info(capabilities), settings(settings), queueFamily(graphicsFamily) {
+		float queuePriority = 1.0f;
+		VkDeviceQueueCreateInfo queueCreateInfo{};
+		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+		queueCreateInfo.queueFamilyIndex = queueFamily;
+		queueCreateInfo.queueCount = 1;
+		queueCreateInfo.pQueuePriorities = &queuePriority;
+
+		VkDeviceCreateInfo createInfo{}; // no extensions or features, the jobs only use core 1.0
+		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		createInfo.queueCreateInfoCount = 1;
+		createInfo.pQueueCreateInfos = &queueCreateInfo;
+		if (vkCreateDevice(info.device, &createInfo, nullptr, &device) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen logical device!");
+		}
+		vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+		createRenderPass();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // every target re-records its command buffer per job
+		poolInfo.queueFamilyIndex = queueFamily;
+		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen command pool!");
+		}
+
+		targets.resize(std::max(1u, settings.jobsInFlight));
+		for (Target& target : targets)
+			createTarget(target);
+	}
+
+	OffscreenDevice::~OffscreenDevice() {
+		if (device == VK_NULL_HANDLE)
+			return;
+		vkDeviceWaitIdle(device);
+		for (Target& target : targets) {
+			vkDestroyFence(device, target.fence, nullptr);
+			vkDestroyFramebuffer(device, target.framebuffer, nullptr);
+			vkDestroyImageView(device, target.view, nullptr);
+			vkDestroyImage(device, target.image, nullptr);
+			vkFreeMemory(device, target.imageMemory, nullptr);
+			vkDestroyBuffer(device, target.readback, nullptr);
+			vkFreeMemory(device, target.readbackMemory, nullptr); // implicitly unmapped
+		}
+		vkDestroyCommandPool(device, commandPool, nullptr); // frees the command buffers
+		vkDestroyRenderPass(device, renderPass, nullptr);
+		vkDestroyDevice(device, nullptr);
+	}
+
+	uint32_t OffscreenDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(info.device, &memProperties);
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
+			if ((typeFilter & (1 << i)) && ((memProperties.memoryTypes[i].propertyFlags & properties) == properties))
+				return i;
+
+		throw std::runtime_error("Failed to find suitable memory type!");
+	}
+
+	void OffscreenDevice::createRenderPass() {
+		VkAttachmentDescription colorAttachment{};
+		colorAttachment.format = OFFSCREEN_FORMAT;
+		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // the previous job's contents are already read back
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // ready for the copy to the readback buffer
+
+		VkAttachmentReference colorAttachmentRef{};
+		colorAttachmentRef.attachment = 0;
+		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorAttachmentRef;
+
+		VkSubpassDependency dependency{}; // the copy after the pass reads what the pass wrote
+		dependency.srcSubpass = 0;
+		dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = 1;
+		renderPassInfo.pAttachments = &colorAttachment;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+		renderPassInfo.dependencyCount = 1;
+		renderPassInfo.pDependencies = &dependency;
+		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen render pass!");
+		}
+	}
+
+	void OffscreenDevice::createTarget(Target& target) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = OFFSCREEN_FORMAT;
+		imageInfo.extent = { settings.width, settings.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(device, &imageInfo, nullptr, &target.image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image!");
+		}
+		VkMemoryRequirements imageRequirements;
+		vkGetImageMemoryRequirements(device, target.image, &imageRequirements);
+		VkMemoryAllocateInfo imageAllocInfo{};
+		imageAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		imageAllocInfo.allocationSize = imageRequirements.size;
+		imageAllocInfo.memoryTypeIndex = findMemoryType(imageRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (vkAllocateMemory(device, &imageAllocInfo, nullptr, &target.imageMemory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate offscreen image memory!");
+		}
+		vkBindImageMemory(device, target.image, target.imageMemory, 0);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = target.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = OFFSCREEN_FORMAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &target.view) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen image view!");
+		}
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = renderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &target.view;
+		framebufferInfo.width = settings.width;
+		framebufferInfo.height = settings.height;
+		framebufferInfo.layers = 1;
+		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &target.framebuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen framebuffer!");
+		}
+
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = static_cast<VkDeviceSize>(settings.width) * settings.height * 4;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &target.readback) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen readback buffer!");
+		}
+		VkMemoryRequirements bufferRequirements;
+		vkGetBufferMemoryRequirements(device, target.readback, &bufferRequirements);
+		VkMemoryAllocateInfo bufferAllocInfo{};
+		bufferAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		bufferAllocInfo.allocationSize = bufferRequirements.size;
+		bufferAllocInfo.memoryTypeIndex = findMemoryType(bufferRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (vkAllocateMemory(device, &bufferAllocInfo, nullptr, &target.readbackMemory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate offscreen readback memory!");
+		}
+		vkBindBufferMemory(device, target.readback, target.readbackMemory, 0);
+		void* mapped = nullptr;
+		vkMapMemory(device, target.readbackMemory, 0, VK_WHOLE_SIZE, 0, &mapped); // stays mapped, persistent mapping is fine in Vulkan
+		target.mapped = static_cast<const uint8_t*>(mapped);
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		if (vkAllocateCommandBuffers(device, &allocInfo, &target.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate offscreen command buffer!");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &target.fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create offscreen fence!");
+		}
+	}
+
+	void OffscreenDevice::recordJob(Target& target, uint32_t job) {
+		vkResetCommandBuffer(target.commandBuffer, 0);
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(target.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording offscreen command buffer!");
+		}
+
+		uint8_t rgba[4];
+		jobColor(job, info.index, rgba);
+		VkClearValue clearColor{};
+		for (int i = 0; i < 4; ++i)
+			clearColor.color.float32[i] = rgba[i] / 255.0f; // UNORM, comes back as exactly rgba
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = renderPass;
+		renderPassInfo.framebuffer = target.framebuffer;
+		renderPassInfo.renderArea.extent = { settings.width, settings.height };
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearColor;
+		vkCmdBeginRenderPass(target.commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdEndRenderPass(target.commandBuffer);
+
+		VkBufferImageCopy region{};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { settings.width, settings.height, 1 };
+		vkCmdCopyImageToBuffer(target.commandBuffer, target.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target.readback, 1, &region);
+
+		VkBufferMemoryBarrier hostBarrier{}; // makes the copy visible to the host reads in finishJob
+		hostBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.buffer = target.readback;
+		hostBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(target.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+		if (vkEndCommandBuffer(target.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record offscreen command buffer!");
+		}
+	}
+
+	void OffscreenDevice::finishJob(Target& target) {
+		if (!target.job.has_value())
+			return;
+		vkWaitForFences(device, 1, &target.fence, VK_TRUE, UINT64_MAX);
+		vkResetFences(device, 1, &target.fence);
+
+		// the first and last pixel are enough to tell the job ran and the copy covered the whole image
+		uint8_t expected[4];
+		jobColor(*target.job, info.index, expected);
+		size_t lastPixel = (static_cast<size_t>(settings.width) * settings.height - 1) * 4;
+		if (memcmp(target.mapped, expected, 4) == 0 && memcmp(target.mapped + lastPixel, expected, 4) == 0)
+			++completed;
+		else
+			++failed;
+		target.job.reset();
+	}
+
+	void OffscreenDevice::run(std::atomic<uint32_t>& nextJob, uint32_t jobCount) {
+		Clock::time_point start = Clock::now();
+		for (size_t slot = 0;; slot = (slot + 1) % targets.size()) {
+			Target& target = targets[slot];
+			finishJob(target); // the oldest job in flight, the others keep the GPU busy meanwhile
+
+			uint32_t job = nextJob.fetch_add(1, std::memory_order_relaxed);
+			if (job >= jobCount)
+				break;
+			recordJob(target, job);
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &target.commandBuffer;
+			if (vkQueueSubmit(queue, 1, &submitInfo, target.fence) != VK_SUCCESS) {
+				throw std::runtime_error("failed to submit offscreen job!");
+			}
+			target.job = job;
+		}
+		for (Target& target : targets)
+			finishJob(target);
+		elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
+
+void runMultiGpuOffscreen(const OffscreenSettings& settings, std::ostream& out) {
+	VkApplicationInfo appInfo{};
+	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+	appInfo.pApplicationName = "Offscreen Jobs";
+	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.pEngineName = "No Engine";
+	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+	appInfo.apiVersion = VK_API_VERSION_1_1; // for vkGetPhysicalDeviceFeatures2 in the device scoring
+
+	VkInstanceCreateInfo createInfo{}; // no surface extensions, nothing is presented
+	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+	createInfo.pApplicationInfo = &appInfo;
+	VkInstance instance;
+	if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create offscreen instance!");
+	}
+
+	std::vector<std::unique_ptr<OffscreenDevice>> devices;
+	try {
+		uint32_t deviceCount = 0;
+		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+		std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+		vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+
+		std::vector<DeviceCapabilities> candidates;
+		for (uint32_t i = 0; i < deviceCount; ++i) {
+			DeviceCapabilities capabilities = queryDeviceCapabilities(physicalDevices[i], i);
+			if (findGraphicsFamily(physicalDevices[i]).has_value() && matchesDeviceSelector(capabilities, settings.deviceSelector))
+				candidates.push_back(capabilities);
+		}
+		if (candidates.empty()) {
+			throw std::runtime_error("failed to find any suitable GPU for offscreen rendering!");
+		}
+		rankDevices(candidates);
+		out << "offscreen jobs: " << settings.jobCount << " frames of " << settings.width << "x" << settings.height << " over " << candidates.size() << " devices" << std::endl;
+		printDeviceRanking(candidates, nullptr, out);
+
+		for (const DeviceCapabilities& candidate : candidates)
+			devices.push_back(std::make_unique<OffscreenDevice>(candidate, *findGraphicsFamily(candidate.device), settings));
+
+		// a thread per device rather than the job system, the workers spend most of their time blocked on fences
+		std::atomic<uint32_t> nextJob{ 0 };
+		std::vector<std::exception_ptr> errors(devices.size());
+		std::vector<std::thread> workers;
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < devices.size(); ++i) {
+			workers.emplace_back([&, i]() {
+				try {
+					devices[i]->run(nextJob, settings.jobCount);
+				} catch (...) {
+					errors[i] = std::current_exception();
+					nextJob.store(settings.jobCount, std::memory_order_relaxed); // the others stop pulling jobs too
+				}
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+		double totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+		for (const std::exception_ptr& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+
+		double pixelsPerJob = static_cast<double>(settings.width) * settings.height;
+		uint32_t totalCompleted = 0;
+		uint32_t totalFailed = 0;
+		out << std::fixed << std::setprecision(1);
+		for (const std::unique_ptr<OffscreenDevice>& device : devices) {
+			double seconds = std::max(device->seconds(), 1e-9);
+			uint32_t jobs = device->jobsCompleted();
+			out << "  [" << device->capabilities().index << "] " << device->capabilities().name << ": " << jobs << " jobs ("
+				<< 100.0 * jobs / std::max(1u, settings.jobCount) << "%) in " << seconds << " s, " << jobs / seconds << " jobs/s, "
+				<< jobs * pixelsPerJob / seconds / 1e6 << " Mpixels/s";
+			if (device->jobsFailed() > 0)
+				out << ", " << device->jobsFailed() << " FAILED";
+			out << std::endl;
+			totalCompleted += jobs;
+			totalFailed += device->jobsFailed();
+		}
+		out << "  total: " << totalCompleted << " jobs in " << totalSeconds << " s, " << totalCompleted / std::max(totalSeconds, 1e-9) << " jobs/s" << std::endl;
+		out << std::defaultfloat;
+		if (totalFailed > 0) {
+			throw std::runtime_error("offscreen jobs read back the wrong image!");
+		}
+	} catch (...) {
+		devices.clear(); // the logical devices go before the instance
+		vkDestroyInstance(instance, nullptr);
+		throw;
+	}
+	devices.clear();
+	vkDestroyInstance(instance, nullptr);
+}
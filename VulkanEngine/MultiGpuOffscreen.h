@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Headless offscreen rendering spread over every suitable GPU in the machine, for servers with several adapters. Each device gets its own logical
+// device and a worker thread, and the workers pull independent jobs (render a frame into an offscreen image, copy it back to the host) from one
+// shared counter, so a faster device simply ends up doing more of them. The results are checked on the CPU and the throughput of every device is
+// reported at the end.
+// Nothing here touches the window or the swap chain, it runs with its own instance. --device/VULKAN_ENGINE_DEVICE limits it to the matching devices.
+
+struct OffscreenSettings {
+	uint32_t jobCount = 2000;
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	uint32_t jobsInFlight = 2; // per device, so a device is recording the next job while the GPU renders the previous one
+	std::string deviceSelector; // empty uses every suitable device
+};
+
+void runMultiGpuOffscreen(const OffscreenSettings& settings, std::ostream& out); // throws when there is no suitable device or a job fails
@@ -0,0 +1,326 @@
+#include "ParticleSystem.h"
+#include "AsyncCompute.h"
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void ParticleSystem::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t capacity, uint32_t framesInFlight, const Shaders& shaders) {
+	if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+		throw std::runtime_error("Particle capacity must be a power of two!");
+	}
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	particleCapacity = capacity;
+	initialized = false;
+	parity = 0;
+
+	// particle state is only ever used by the compute queue, so exclusive sharing without any ownership transfers
+	VkBufferUsageFlags storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	createBuffer(COUNTERS_SIZE, storage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, counters.buffer, counters.memory);
+	createBuffer(sizeof(float) * 4 * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, positionAge.buffer, positionAge.memory);
+	createBuffer(sizeof(float) * 4 * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, velocityLifetime.buffer, velocityLifetime.memory);
+	createBuffer(sizeof(uint32_t) * 4 * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, appearance.buffer, appearance.memory);
+	createBuffer(sizeof(uint32_t) * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, deadList.buffer, deadList.memory);
+	createBuffer(sizeof(uint32_t) * 2 * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, aliveLists.buffer, aliveLists.memory);
+
+	frames.resize(framesInFlight);
+	for (Frame& frame : frames) {
+		createBuffer(sizeof(GpuEmitter) * MAX_EMITTERS, storage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.emitterBuffer, frame.emitterMemory);
+		vkMapMemory(device, frame.emitterMemory, 0, sizeof(GpuEmitter) * MAX_EMITTERS, 0, reinterpret_cast<void**>(&frame.mappedEmitters)); // stays mapped
+		createBuffer(INSTANCE_SIZE * capacity, storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.instanceBuffer, frame.instanceMemory);
+		createBuffer(sizeof(VkDrawIndirectCommand), storage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.drawArgsBuffer, frame.drawArgsMemory);
+	}
+
+	createDescriptors();
+	createPipelines(shaders);
+}
+
+void ParticleSystem::destroy() {
+	vkDestroyPipeline(device, beginPipeline, nullptr);
+	vkDestroyPipeline(device, emitPipeline, nullptr);
+	vkDestroyPipeline(device, simulatePipeline, nullptr);
+	vkDestroyPipeline(device, compactPipeline, nullptr);
+	vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
+	freeDescriptorPool(device, descriptorPool); // frees the sets too
+	vkDestroyDescriptorSetLayout(device, computeDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, renderDescriptorSetLayout, nullptr);
+
+	for (Frame& frame : frames) {
+		vkDestroyBuffer(device, frame.emitterBuffer, nullptr);
+		freeDeviceMemory(device, frame.emitterMemory); // implicitly unmapped
+		vkDestroyBuffer(device, frame.instanceBuffer, nullptr);
+		freeDeviceMemory(device, frame.instanceMemory);
+		vkDestroyBuffer(device, frame.drawArgsBuffer, nullptr);
+		freeDeviceMemory(device, frame.drawArgsMemory);
+	}
+	frames.clear();
+
+	for (StorageBuffer* storage : { &counters, &positionAge, &velocityLifetime, &appearance, &deadList, &aliveLists }) {
+		vkDestroyBuffer(device, storage->buffer, nullptr);
+		freeDeviceMemory(device, storage->memory);
+		*storage = StorageBuffer{};
+	}
+}
+
+uint32_t ParticleSystem::addEmitter(const ParticleEmitter& emitter) {
+	if (emitters.size() >= MAX_EMITTERS) {
+		throw std::runtime_error("Too many particle emitters!");
+	}
+	emitters.push_back(emitter);
+	spawnAccumulators.push_back(0.0f);
+	return static_cast<uint32_t>(emitters.size() - 1);
+}
+
+void ParticleSystem::registerHandoffs(AsyncCompute& asyncCompute) const {
+	for (uint32_t i = 0; i < frames.size(); ++i) {
+		asyncCompute.addBufferHandoff(i, frames[i].instanceBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+		asyncCompute.addBufferHandoff(i, frames[i].drawArgsBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+	}
+}
+
+void ParticleSystem::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle buffer!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device, outBuffer, &memReqs);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
+	if (allocateDeviceMemory(device, allocInfo, bufferMemoryCategory(usage), outMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate particle buffer memory!");
+	}
+
+	vkBindBufferMemory(device, outBuffer, outMemory, 0);
+}
+
+uint32_t ParticleSystem::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void ParticleSystem::createDescriptors() {
+	// compute: 0 counters, 1 positionAge, 2 velocityLifetime, 3 appearance, 4 dead list, 5 alive lists, 6 emitters, 7 instances, 8 draw args
+	const uint32_t COMPUTE_BINDINGS = 9;
+	VkDescriptorSetLayoutBinding computeBindings[COMPUTE_BINDINGS]{};
+	for (uint32_t i = 0; i < COMPUTE_BINDINGS; ++i) {
+		computeBindings[i].binding = i;
+		computeBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		computeBindings[i].descriptorCount = 1;
+		computeBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = COMPUTE_BINDINGS;
+	layoutInfo.pBindings = computeBindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &computeDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create particle descriptor set layout!");
+
+	// render: 0 instances
+	VkDescriptorSetLayoutBinding renderBinding{};
+	renderBinding.binding = 0;
+	renderBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	renderBinding.descriptorCount = 1;
+	renderBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &renderBinding;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &renderDescriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create particle descriptor set layout!");
+
+	uint32_t frameCount = static_cast<uint32_t>(frames.size());
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = frameCount * (COMPUTE_BINDINGS + 1);
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = frameCount * 2;
+	if (allocateDescriptorPool(device, poolInfo, descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create particle descriptor pool!");
+
+	for (Frame& frame : frames) {
+		VkDescriptorSetLayout layouts[2] = { computeDescriptorSetLayout, renderDescriptorSetLayout };
+		VkDescriptorSet sets[2];
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 2;
+		allocInfo.pSetLayouts = layouts;
+		if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS)
+			throw std::runtime_error("Failed to allocate particle descriptor sets!");
+		frame.computeSet = sets[0];
+		frame.renderSet = sets[1];
+
+		VkBuffer computeBuffers[COMPUTE_BINDINGS] = { counters.buffer, positionAge.buffer, velocityLifetime.buffer, appearance.buffer, deadList.buffer, aliveLists.buffer,
+			frame.emitterBuffer, frame.instanceBuffer, frame.drawArgsBuffer };
+		VkDescriptorBufferInfo bufferInfos[COMPUTE_BINDINGS + 1]{};
+		VkWriteDescriptorSet writes[COMPUTE_BINDINGS + 1]{};
+		for (uint32_t i = 0; i < COMPUTE_BINDINGS + 1; ++i) {
+			bool render = i == COMPUTE_BINDINGS;
+			bufferInfos[i].buffer = render ? frame.instanceBuffer : computeBuffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = render ? frame.renderSet : frame.computeSet;
+			writes[i].dstBinding = render ? 0 : i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].descriptorCount = 1;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+		vkUpdateDescriptorSets(device, COMPUTE_BINDINGS + 1, writes, 0, nullptr);
+	}
+}
+
+void ParticleSystem::createPipelines(const Shaders& shaders) {
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &computeDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &computePipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle pipeline layout!");
+	}
+
+	VkShaderModule modules[4] = { shaders.begin, shaders.emit, shaders.simulate, shaders.compact };
+	VkComputePipelineCreateInfo pipelineInfos[4]{};
+	for (uint32_t i = 0; i < 4; ++i) {
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfos[i].stage.module = modules[i];
+		pipelineInfos[i].stage.pName = "main";
+		pipelineInfos[i].layout = computePipelineLayout;
+		pipelineInfos[i].basePipelineIndex = -1;
+	}
+	VkPipeline pipelines[4];
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 4, pipelineInfos, nullptr, pipelines) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create particle compute pipelines!");
+	}
+	beginPipeline = pipelines[0];
+	emitPipeline = pipelines[1];
+	simulatePipeline = pipelines[2];
+	compactPipeline = pipelines[3];
+}
+
+// every pass reads what the previous one wrote, and the particle buffers are small enough in number that a global memory barrier is the simplest fit
+void ParticleSystem::computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 extraDstStage, VkAccessFlags2 extraDstAccess) {
+	VkMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+	barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | extraDstStage;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | extraDstAccess;
+
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.memoryBarrierCount = 1;
+	dependencyInfo.pMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void ParticleSystem::dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, const PushConstants& pushConstants, uint32_t groupCount) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+}
+
+void ParticleSystem::dispatchIndirect(VkCommandBuffer commandBuffer, VkPipeline pipeline, const PushConstants& pushConstants) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdPushConstants(commandBuffer, computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+	vkCmdDispatchIndirect(commandBuffer, counters.buffer, SIMULATE_ARGS_OFFSET);
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, uint32_t frameIndex, float deltaTime) {
+	Frame& frame = frames[frameIndex];
+
+	// the only CPU work, and it only depends on the number of emitters: turn their rates into spawn counts and upload them
+	uint32_t spawnTotal = 0;
+	uint32_t emitterCount = 0;
+	for (size_t i = 0; i < emitters.size(); ++i) {
+		const ParticleEmitter& emitter = emitters[i];
+		if (!emitter.enabled)
+			continue;
+
+		spawnAccumulators[i] += emitter.rate * deltaTime;
+		uint32_t spawnCount = static_cast<uint32_t>(std::min(spawnAccumulators[i], static_cast<float>(particleCapacity)));
+		spawnAccumulators[i] -= static_cast<float>(spawnCount);
+		spawnCount = std::min(spawnCount, particleCapacity - spawnTotal); // the dead list can't hand out more than the capacity anyway
+
+		GpuEmitter& gpuEmitter = frame.mappedEmitters[emitterCount++];
+		gpuEmitter.positionRadius = glm::vec4(emitter.position, emitter.radius);
+		gpuEmitter.velocitySpread = glm::vec4(emitter.velocity, emitter.velocitySpread);
+		gpuEmitter.colorStart = emitter.colorStart;
+		gpuEmitter.colorEnd = emitter.colorEnd;
+		gpuEmitter.params = glm::vec4(emitter.lifetime, emitter.size, 0.0f, 0.0f);
+		gpuEmitter.firstSpawn = spawnTotal;
+		gpuEmitter.spawnCount = spawnCount;
+		spawnTotal += spawnCount;
+	}
+
+	VkDescriptorSet computeSet = frame.computeSet;
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipelineLayout, 0, 1, &computeSet, 0, nullptr);
+
+	PushConstants pushConstants{};
+	pushConstants.deltaTime = deltaTime;
+	pushConstants.capacity = particleCapacity;
+	pushConstants.spawnTotal = spawnTotal;
+	pushConstants.emitterCount = emitterCount;
+	pushConstants.parity = parity;
+	pushConstants.seed = frameSeed++;
+	pushConstants.gravity = 9.81f;
+
+	computeBarrier(commandBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE); // against the previous frame's passes, that's a different submission but the same queue
+
+	if (!initialized) { // every slot starts out on the dead list
+		pushConstants.initialize = 1;
+		dispatch(commandBuffer, beginPipeline, pushConstants, (particleCapacity + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+		pushConstants.initialize = 0;
+		initialized = true;
+	}
+
+	dispatch(commandBuffer, beginPipeline, pushConstants, 1);
+	computeBarrier(commandBuffer, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+
+	if (spawnTotal > 0) {
+		dispatch(commandBuffer, emitPipeline, pushConstants, (spawnTotal + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+		computeBarrier(commandBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+	}
+
+	dispatchIndirect(commandBuffer, simulatePipeline, pushConstants);
+	computeBarrier(commandBuffer, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE);
+
+	dispatchIndirect(commandBuffer, compactPipeline, pushConstants); // same group count as simulate, an upper bound on the survivors
+
+	parity ^= 1; // this frame's survivors are next frame's current list
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineLayout pipelineLayout) {
+	const Frame& frame = frames[frameIndex];
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &frame.renderSet, 0, nullptr);
+	vkCmdDrawIndirect(commandBuffer, frame.drawArgsBuffer, 0, 1, sizeof(VkDrawIndirectCommand)); // instance count comes from the compact pass
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class AsyncCompute;
+
+// GPU particles. All particle state lives in structure-of-arrays storage buffers and is only ever touched by compute shaders (see Shaders/particle_*.comp):
+//  begin    - one thread, takes as many free slots off the dead list as the emitters asked for and sizes the indirect dispatches below
+//  emit     - initializes the new particles and appends them to this frame's alive list
+//  simulate - ages/integrates every alive particle. dead ones go back on the dead list, survivors are appended to the other alive list
+//  compact  - packs the survivors into a dense per frame instance buffer and writes the vkCmdDrawIndirect arguments for it
+// The dead list is a ring (head/tail counters) and the alive lists ping-pong between frames, so nothing is ever read back to the CPU. The CPU only
+// uploads the emitters, so the cost per frame is O(emitters) no matter how many particles are alive.
+// Rendered as camera facing billboards, 6 vertices per instance generated in Shaders/particle.vert.
+
+struct ParticleEmitter {
+	glm::vec3 position = glm::vec3(0.0f);
+	float radius = 0.0f; // particles spawn anywhere inside this sphere
+	glm::vec3 velocity = glm::vec3(0.0f);
+	float velocitySpread = 0.0f; // random extra velocity, in any direction
+	glm::vec4 colorStart = glm::vec4(1.0f);
+	glm::vec4 colorEnd = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f); // color is blended from start to end over the particle's life
+	float lifetime = 1.0f; // seconds, each particle gets +-25%
+	float size = 0.02f; // billboard half size, in world units
+	float rate = 0.0f; // particles per second
+	bool enabled = true;
+};
+
+class ParticleSystem {
+public:
+	static const uint32_t MAX_EMITTERS = 256;
+	static const uint32_t WORKGROUP_SIZE = 64; // has to match local_size_x in the compute shaders
+
+	struct Shaders {
+		VkShaderModule begin;
+		VkShaderModule emit;
+		VkShaderModule simulate;
+		VkShaderModule compact;
+	};
+
+	// capacity has to be a power of two (the dead list ring wraps with a mask). the shader modules can be destroyed once this returns
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t capacity, uint32_t framesInFlight, const Shaders& shaders);
+	void destroy();
+
+	uint32_t addEmitter(const ParticleEmitter& emitter);
+	ParticleEmitter& emitter(uint32_t index) { return emitters[index]; }
+
+	// the per frame instance and draw argument buffers are written by compute and read by graphics
+	void registerHandoffs(AsyncCompute& asyncCompute) const;
+
+	void recordSimulation(VkCommandBuffer commandBuffer, uint32_t frame, float deltaTime); // compute command buffer
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frame, VkPipelineLayout pipelineLayout); // binds set 1 and draws, the caller binds the pipeline and set 0 (the camera)
+
+	VkDescriptorSetLayout renderSetLayout() const { return renderDescriptorSetLayout; } // set 1 of the billboard pipeline
+	uint32_t capacity() const { return particleCapacity; }
+
+private:
+	// mirror the layouts in Shaders/particle_common.glsl
+	struct GpuEmitter {
+		glm::vec4 positionRadius;
+		glm::vec4 velocitySpread;
+		glm::vec4 colorStart;
+		glm::vec4 colorEnd;
+		glm::vec4 params; // x lifetime, y size
+		uint32_t firstSpawn; // exclusive prefix sum of the spawn counts, the emit shader binary searches it
+		uint32_t spawnCount;
+		uint32_t padding[2];
+	};
+	struct PushConstants {
+		float deltaTime;
+		uint32_t capacity;
+		uint32_t spawnTotal;
+		uint32_t emitterCount;
+		uint32_t parity; // which alive list is the current one
+		uint32_t seed;
+		uint32_t initialize;
+		float gravity;
+	};
+	static const VkDeviceSize COUNTERS_SIZE = 48;
+	static const VkDeviceSize SIMULATE_ARGS_OFFSET = 32; // VkDispatchIndirectCommand inside the counters buffer
+	static const VkDeviceSize INSTANCE_SIZE = 32; // vec4 position + size, vec4 color
+
+	struct Frame {
+		VkBuffer emitterBuffer = VK_NULL_HANDLE; // host visible, rewritten every frame
+		VkDeviceMemory emitterMemory = VK_NULL_HANDLE;
+		GpuEmitter* mappedEmitters = nullptr;
+		VkBuffer instanceBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory instanceMemory = VK_NULL_HANDLE;
+		VkBuffer drawArgsBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory drawArgsMemory = VK_NULL_HANDLE;
+		VkDescriptorSet computeSet = VK_NULL_HANDLE;
+		VkDescriptorSet renderSet = VK_NULL_HANDLE;
+	};
+	struct StorageBuffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+	};
+
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	void createDescriptors();
+	void createPipelines(const Shaders& shaders);
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags2 extraDstStage, VkAccessFlags2 extraDstAccess);
+	void dispatch(VkCommandBuffer commandBuffer, VkPipeline pipeline, const PushConstants& pushConstants, uint32_t groupCount);
+	void dispatchIndirect(VkCommandBuffer commandBuffer, VkPipeline pipeline, const PushConstants& pushConstants);
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	uint32_t particleCapacity = 0;
+	bool initialized = false; // dead list filled, done by the first recordSimulation()
+	uint32_t parity = 0;
+	uint32_t frameSeed = 0;
+
+	StorageBuffer counters; // alive counts, dead ring head/tail, indirect dispatch args
+	StorageBuffer positionAge; // vec4 per particle
+	StorageBuffer velocityLifetime; // vec4
+	StorageBuffer appearance; // uvec4: packed start color, packed end color, size
+	StorageBuffer deadList; // uint ring
+	StorageBuffer aliveLists; // 2 * capacity uints
+	std::vector<Frame> frames;
+
+	std::vector<ParticleEmitter> emitters;
+	std::vector<float> spawnAccumulators; // fractional particles carried over to the next frame
+
+	VkDescriptorSetLayout computeDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout renderDescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout computePipelineLayout = VK_NULL_HANDLE;
+	VkPipeline beginPipeline = VK_NULL_HANDLE;
+	VkPipeline emitPipeline = VK_NULL_HANDLE;
+	VkPipeline simulatePipeline = VK_NULL_HANDLE;
+	VkPipeline compactPipeline = VK_NULL_HANDLE;
+};
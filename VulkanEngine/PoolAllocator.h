@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+// Fixed size pool for engine objects that come and go at runtime. All the slots are allocated up front, free ones are chained through a free list, so
+// create() and destroy() are a couple of pointer moves and never touch the general heap. The capacity doesn't grow, create() throws once it's used up.
+// Not thread safe. Objects still alive when the pool is destroyed aren't destructed, destroy() them first.
+template<typename T>
+class PoolAllocator {
+public:
+	explicit PoolAllocator(size_t capacity) : slots(new Slot[capacity]), slotCount(capacity) {
+		for (size_t i = 0; i < capacity; ++i)
+			slots[i].next = i + 1 < capacity ? &slots[i + 1] : nullptr;
+		freeList = capacity > 0 ? &slots[0] : nullptr;
+	}
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	template<typename... Args>
+	T* create(Args&&... args) {
+		if (freeList == nullptr) {
+			throw std::runtime_error("Pool allocator is full!");
+		}
+		Slot* slot = freeList;
+		T* object = new (slot->storage) T(std::forward<Args>(args)...); // if the constructor throws the slot is still on the free list
+		freeList = slot->next;
+		++liveCount;
+		return object;
+	}
+
+	void destroy(T* object) {
+		if (object == nullptr)
+			return;
+		object->~T();
+		Slot* slot = reinterpret_cast<Slot*>(object);
+		slot->next = freeList;
+		freeList = slot;
+		--liveCount;
+	}
+
+	bool owns(const T* object) const {
+		const Slot* slot = reinterpret_cast<const Slot*>(object);
+		return slot >= &slots[0] && slot < &slots[0] + slotCount;
+	}
+
+	size_t size() const { return liveCount; }
+	size_t capacity() const { return slotCount; }
+
+private:
+	union Slot {
+		Slot* next; // while free
+		alignas(T) unsigned char storage[sizeof(T)]; // while in use
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t slotCount;
+	Slot* freeList = nullptr;
+	size_t liveCount = 0;
+};
@@ -0,0 +1,68 @@
+#include "PresentPolicy.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace {
+	bool hasMode(const VkPresentModeKHR* availablePresentModes, uint32_t availableCount, VkPresentModeKHR presentMode) {
+		return std::find(availablePresentModes, availablePresentModes + availableCount, presentMode) != availablePresentModes + availableCount;
+	}
+
+	VkPresentModeKHR firstAvailable(const VkPresentModeKHR* availablePresentModes, uint32_t availableCount, std::initializer_list<VkPresentModeKHR> preferred) {
+		for (VkPresentModeKHR presentMode : preferred)
+			if (hasMode(availablePresentModes, availableCount, presentMode))
+				return presentMode;
+		return VK_PRESENT_MODE_FIFO_KHR; // the only mode guaranteed to be available
+	}
+}
+
+PresentConfig choosePresentConfig(PresentPolicy policy, const VkPresentModeKHR* availablePresentModes, uint32_t availableCount, const VkSurfaceCapabilitiesKHR& capabilities) {
+	/* possible values are:
+	* VK_PRESENT_MODE_IMMEDIATE_KHR - images submitted to app are transferred to the screen right away. may cause tearing
+	* VK_PRESENT_MODE_FIFO_KHR - this is v sync, when the display is refreshed it takes an image from the front of the queue and the program inserts rendered images at the back of the queue (if queue is full, program must wait)
+	* VK_PRESENT_MODE_FIFO_RELAXED_KHR - similar to FIFO, but if the application was late and the queue is empty at the last v blank, the image is transferred when it finally arrives. may cause tearing
+	* VK_PRESENT_MODE_MAILBOX_KHR - similar to FIFO, but instead of blocking the app when the queue is full, the images that are already queued are replaced with the newer ones. can be used to implement triple buffering
+	*/
+	PresentConfig config{};
+	uint32_t imageCount = capabilities.minImageCount;
+	switch (policy) {
+	case PresentPolicy::LatencyFirst:
+		config.presentMode = firstAvailable(availablePresentModes, availableCount, { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR });
+		if (config.presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
+			imageCount = std::max(capabilities.minImageCount + 1, 3u); // one on screen, one queued, one to render into, or mailbox can't replace anything
+		else
+			imageCount = std::max(capabilities.minImageCount, 2u); // every queued image is a frame of latency with FIFO
+		break;
+	case PresentPolicy::ThroughputFirst:
+		config.presentMode = firstAvailable(availablePresentModes, availableCount, { VK_PRESENT_MODE_FIFO_RELAXED_KHR });
+		imageCount = capabilities.minImageCount + 2;
+		break;
+	case PresentPolicy::PowerSaving:
+		config.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		imageCount = std::max(capabilities.minImageCount, 2u);
+		break;
+	}
+	if (capabilities.maxImageCount > 0) // 0 means there is no maximum
+		imageCount = std::min(imageCount, capabilities.maxImageCount);
+	config.imageCount = imageCount;
+	return config;
+}
+
+const char* presentPolicyName(PresentPolicy policy) {
+	switch (policy) {
+	case PresentPolicy::LatencyFirst: return "latency first";
+	case PresentPolicy::ThroughputFirst: return "throughput first";
+	case PresentPolicy::PowerSaving: return "power saving";
+	}
+	return "unknown";
+}
+
+const char* presentModeName(VkPresentModeKHR presentMode) {
+	switch (presentMode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+	default: return "other";
+	}
+}
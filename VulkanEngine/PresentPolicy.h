@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// How the swap chain trades latency, smoothness and power. Picks the present mode and how many images to ask for, switching is a swap chain
+// recreation (which doesn't stall, see recreateSwapChain()).
+//  LatencyFirst    - MAILBOX (newest image wins at vblank, no tearing), else IMMEDIATE, else FIFO with the shortest queue the surface allows
+//  ThroughputFirst - FIFO_RELAXED (vsync, but a late frame goes out straight away instead of waiting a whole refresh), else FIFO, with an extra
+//                    image queued so a slow frame doesn't starve the display
+//  PowerSaving     - plain FIFO with as few images as possible, the GPU never renders frames that won't be shown
+enum class PresentPolicy {
+	LatencyFirst,
+	ThroughputFirst,
+	PowerSaving,
+};
+
+struct PresentConfig {
+	VkPresentModeKHR presentMode;
+	uint32_t imageCount;
+};
+
+PresentConfig choosePresentConfig(PresentPolicy policy, const VkPresentModeKHR* availablePresentModes, uint32_t availableCount, const VkSurfaceCapabilitiesKHR& capabilities);
+
+const char* presentPolicyName(PresentPolicy policy);
+const char* presentModeName(VkPresentModeKHR presentMode);
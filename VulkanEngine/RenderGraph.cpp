@@ -0,0 +1,671 @@
+#include "RenderGraph.h"
+
+#include "DeletionQueue.h"
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+	struct AccessInfo {
+		VkPipelineStageFlags2 stage;
+		VkAccessFlags2 access;
+		VkImageLayout layout;
+		VkImageUsageFlags imageUsage; // 0 = not valid for images
+		VkBufferUsageFlags bufferUsage; // 0 = not valid for buffers
+		bool write;
+	};
+
+	AccessInfo getAccessInfo(RenderGraphAccess access) {
+		switch (access) {
+		case RenderGraphAccess::ColorAttachmentWrite:
+			return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0, true };
+		case RenderGraphAccess::DepthAttachmentWrite:
+			return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, true };
+		case RenderGraphAccess::DepthAttachmentRead:
+			return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0, false };
+		case RenderGraphAccess::FragmentSampledRead:
+			return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0, false };
+		case RenderGraphAccess::ComputeSampledRead:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT, 0, false };
+		case RenderGraphAccess::ComputeStorageRead:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false };
+		case RenderGraphAccess::ComputeStorageWrite:
+			return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, true };
+		case RenderGraphAccess::VertexStorageRead:
+			return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false };
+		case RenderGraphAccess::FragmentStorageRead:
+			return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, false };
+		case RenderGraphAccess::TransferRead:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, false };
+		case RenderGraphAccess::TransferWrite:
+			return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT, true };
+		case RenderGraphAccess::VertexBufferRead:
+			return { VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, false };
+		case RenderGraphAccess::IndexBufferRead:
+			return { VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, false };
+		case RenderGraphAccess::IndirectBufferRead:
+			return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false };
+		case RenderGraphAccess::UniformRead:
+			return { VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, false };
+		}
+		throw std::runtime_error("Unknown render graph access!");
+	}
+
+	const VkAccessFlags2 WRITE_ACCESS_MASK = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+	// only used to estimate memory before there's a device to ask. real sizes come from vkGet*MemoryRequirements in realize()
+	VkDeviceSize formatBytesPerPixel(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB: case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32: case VK_FORMAT_B10G11R11_UFLOAT_PACK32: case VK_FORMAT_R32_SFLOAT: case VK_FORMAT_R32_UINT:
+		case VK_FORMAT_R16G16_SFLOAT: case VK_FORMAT_D32_SFLOAT: case VK_FORMAT_D24_UNORM_S8_UINT:
+			return 4;
+		case VK_FORMAT_R16_SFLOAT: case VK_FORMAT_D16_UNORM:
+			return 2;
+		case VK_FORMAT_R16G16B16A16_SFLOAT: case VK_FORMAT_R32G32_SFLOAT: case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return 8;
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// tracks what's still in flight for a resource while walking the passes in execution order
+	struct TrackedState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags2 syncStages = VK_PIPELINE_STAGE_2_NONE; // stages the next barrier has to wait on (last writer, or whatever transitioned the layout)
+		VkAccessFlags2 unflushedAccess = VK_ACCESS_2_NONE; // writes that haven't been made available yet
+		VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE; // readers since the last write, a later write has to wait for them (WAR)
+		VkAccessFlags2 readAccess = VK_ACCESS_2_NONE; // accesses the last write has already been made visible to
+	};
+}
+
+RenderGraph::ResourceHandle RenderGraph::createImage(const std::string& name, const RenderGraphImageDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.isImage = true;
+	resource.imageDesc = desc;
+	resources.push_back(resource);
+	compiled = false;
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createBuffer(const std::string& name, VkDeviceSize size, VkBufferUsageFlags extraUsage) {
+	Resource resource;
+	resource.name = name;
+	resource.isImage = false;
+	resource.bufferSize = size;
+	resource.bufferUsage = extraUsage;
+	resources.push_back(resource);
+	compiled = false;
+	return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::importImage(const std::string& name, const RenderGraphImageDesc& desc, const RenderGraphResourceState& initialState, const RenderGraphResourceState& finalState) {
+	ResourceHandle handle = createImage(name, desc);
+	resources[handle].imported = true;
+	resources[handle].initialState = initialState;
+	resources[handle].finalState = finalState;
+	return handle;
+}
+
+RenderGraph::ResourceHandle RenderGraph::importBuffer(const std::string& name, VkDeviceSize size, const RenderGraphResourceState& initialState, const RenderGraphResourceState& finalState) {
+	ResourceHandle handle = createBuffer(name, size);
+	resources[handle].imported = true;
+	resources[handle].initialState = initialState;
+	resources[handle].finalState = finalState;
+	return handle;
+}
+
+void RenderGraph::setImportedImage(ResourceHandle resource, VkImage image, VkImageView view) {
+	if (!resources[resource].imported || !resources[resource].isImage)
+		throw std::runtime_error("Render graph resource '" + resources[resource].name + "' isn't an imported image!");
+	resources[resource].image = image;
+	resources[resource].view = view;
+}
+
+void RenderGraph::setImportedBuffer(ResourceHandle resource, VkBuffer buffer) {
+	if (!resources[resource].imported || resources[resource].isImage)
+		throw std::runtime_error("Render graph resource '" + resources[resource].name + "' isn't an imported buffer!");
+	resources[resource].buffer = buffer;
+}
+
+void RenderGraph::markOutput(ResourceHandle resource) {
+	resources[resource].output = true;
+	compiled = false;
+}
+
+RenderGraph::PassHandle RenderGraph::addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute) {
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	passes.push_back(std::move(pass));
+	compiled = false;
+	return static_cast<PassHandle>(passes.size() - 1);
+}
+
+void RenderGraph::read(PassHandle pass, ResourceHandle resource, RenderGraphAccess access) {
+	addAccess(pass, resource, access, false);
+}
+
+void RenderGraph::write(PassHandle pass, ResourceHandle resource, RenderGraphAccess access) {
+	addAccess(pass, resource, access, true);
+}
+
+void RenderGraph::addAccess(PassHandle pass, ResourceHandle resource, RenderGraphAccess access, bool write) {
+	AccessInfo info = getAccessInfo(access);
+	Resource& target = resources[resource];
+	if (info.write != write) {
+		throw std::runtime_error("Pass '" + passes[pass].name + "' declares a " + (write ? "write" : "read") + " of '" + target.name + "' with a " + (info.write ? "write" : "read") + " access type!");
+	}
+	if ((target.isImage && info.imageUsage == 0) || (!target.isImage && info.bufferUsage == 0)) {
+		throw std::runtime_error("Pass '" + passes[pass].name + "' uses '" + target.name + "' in a way that isn't valid for " + (target.isImage ? "an image" : "a buffer") + "!");
+	}
+
+	target.imageUsage |= info.imageUsage;
+	target.bufferUsage |= info.bufferUsage;
+	passes[pass].accesses.push_back({ resource, access, write });
+	compiled = false;
+}
+
+void RenderGraph::setSideEffects(PassHandle pass) {
+	passes[pass].sideEffects = true;
+	compiled = false;
+}
+
+uint32_t RenderGraph::barrierCount() const {
+	size_t count = endBarriers.size();
+	for (PassHandle pass : order)
+		count += passes[pass].barriers.size();
+	return static_cast<uint32_t>(count);
+}
+
+
+void RenderGraph::compile() {
+	for (Pass& pass : passes) {
+		pass.culled = false;
+		pass.barriers.clear();
+	}
+
+	cullPasses();
+	schedulePasses();
+	computeLifetimes();
+	computeAliasing(false);
+	computeBarriers();
+	compiled = true;
+}
+
+// walks the passes backwards from the outputs (imported resources, markOutput(), side effects). a pass only survives if something that survives
+// consumes what it writes. accesses only ever refer to earlier passes' results, so a single reverse sweep over the declaration order is enough
+void RenderGraph::cullPasses() {
+	std::vector<bool> required(resources.size(), false);
+	for (size_t i = 0; i < resources.size(); ++i)
+		required[i] = resources[i].imported || resources[i].output;
+
+	for (size_t p = passes.size(); p-- > 0;) {
+		Pass& pass = passes[p];
+		bool keep = pass.sideEffects;
+		for (const Access& access : pass.accesses)
+			keep |= access.write && required[access.resource];
+
+		pass.culled = !keep;
+		if (keep) {
+			for (const Access& access : pass.accesses)
+				required[access.resource] = true; // writes too - the pass may only partially overwrite (LOAD_OP_LOAD etc), so the previous writer still matters
+		}
+	}
+}
+
+// topological sort over the hazards between passes (read after write, write after read, write after write, in declaration order). of the passes that are
+// ready, the one whose inputs have been ready the longest goes first, which pushes consumers away from their producers and gives barriers room to breathe
+void RenderGraph::schedulePasses() {
+	std::vector<std::vector<PassHandle>> dependents(passes.size());
+	std::vector<uint32_t> unresolved(passes.size(), 0);
+
+	struct ResourceHistory {
+		PassHandle lastWriter = UINT32_MAX;
+		std::vector<PassHandle> readersSinceWrite;
+	};
+	std::vector<ResourceHistory> history(resources.size());
+	auto addEdge = [&](PassHandle from, PassHandle to) {
+		if (from == to || from == UINT32_MAX)
+			return;
+		if (std::find(dependents[from].begin(), dependents[from].end(), to) != dependents[from].end())
+			return;
+		dependents[from].push_back(to);
+		++unresolved[to];
+	};
+
+	for (PassHandle p = 0; p < passes.size(); ++p) {
+		if (passes[p].culled)
+			continue;
+		for (const Access& access : passes[p].accesses) {
+			ResourceHistory& h = history[access.resource];
+			addEdge(h.lastWriter, p);
+			if (access.write) {
+				for (PassHandle reader : h.readersSinceWrite)
+					addEdge(reader, p);
+				h.readersSinceWrite.clear();
+			}
+		}
+		for (const Access& access : passes[p].accesses) { // second loop so a pass that reads and writes the same resource doesn't depend on itself
+			ResourceHistory& h = history[access.resource];
+			if (access.write)
+				h.lastWriter = p;
+			else
+				h.readersSinceWrite.push_back(p);
+		}
+	}
+
+	order.clear();
+	std::vector<int64_t> readySince(passes.size(), -1); // position of the latest scheduled dependency
+	std::vector<PassHandle> ready;
+	for (PassHandle p = 0; p < passes.size(); ++p)
+		if (!passes[p].culled && unresolved[p] == 0)
+			ready.push_back(p);
+
+	while (!ready.empty()) {
+		size_t best = 0;
+		for (size_t i = 1; i < ready.size(); ++i) {
+			PassHandle a = ready[i], b = ready[best];
+			if (readySince[a] < readySince[b] || (readySince[a] == readySince[b] && a < b))
+				best = i;
+		}
+		PassHandle pass = ready[best];
+		ready.erase(ready.begin() + best);
+
+		int64_t position = static_cast<int64_t>(order.size());
+		order.push_back(pass);
+		for (PassHandle dependent : dependents[pass]) {
+			readySince[dependent] = std::max(readySince[dependent], position);
+			if (--unresolved[dependent] == 0)
+				ready.push_back(dependent);
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes() {
+	for (Resource& resource : resources) {
+		resource.used = false;
+		resource.firstPass = UINT32_MAX;
+		resource.lastPass = 0;
+	}
+
+	for (uint32_t position = 0; position < order.size(); ++position) {
+		for (const Access& access : passes[order[position]].accesses) {
+			Resource& resource = resources[access.resource];
+			if (!resource.used && !resource.imported && !access.write) {
+				throw std::runtime_error("Pass '" + passes[order[position]].name + "' reads transient resource '" + resource.name + "' before anything writes it!");
+			}
+			resource.used = true;
+			resource.firstPass = std::min(resource.firstPass, position);
+			resource.lastPass = std::max(resource.lastPass, position);
+		}
+	}
+}
+
+std::vector<RenderGraph::AliasBlock> RenderGraph::planAliasing(const std::vector<AliasCandidate>& candidates) {
+	std::vector<uint32_t> bySize(candidates.size());
+	for (uint32_t i = 0; i < bySize.size(); ++i)
+		bySize[i] = i;
+	std::stable_sort(bySize.begin(), bySize.end(), [&](uint32_t a, uint32_t b) { return candidates[a].size > candidates[b].size; }); // biggest first so the small ones fill in around them
+
+	std::vector<AliasBlock> blocks;
+	for (uint32_t index : bySize) {
+		const AliasCandidate& candidate = candidates[index];
+		AliasBlock* target = nullptr;
+		for (AliasBlock& block : blocks) {
+			if ((block.memoryTypeBits & candidate.memoryTypeBits) == 0)
+				continue;
+			bool overlaps = false;
+			for (uint32_t other : block.candidates) {
+				if (candidate.firstPass <= candidates[other].lastPass && candidates[other].firstPass <= candidate.lastPass) {
+					overlaps = true;
+					break;
+				}
+			}
+			if (!overlaps) {
+				target = &block;
+				break;
+			}
+		}
+		if (target == nullptr) {
+			blocks.emplace_back();
+			target = &blocks.back();
+		}
+
+		target->candidates.push_back(index);
+		target->size = std::max(target->size, candidate.size);
+		target->alignment = std::max(target->alignment, candidate.alignment);
+		target->memoryTypeBits &= candidate.memoryTypeBits;
+	}
+
+	for (AliasBlock& block : blocks) // in the order they'll occupy the memory
+		std::sort(block.candidates.begin(), block.candidates.end(), [&](uint32_t a, uint32_t b) { return candidates[a].firstPass < candidates[b].firstPass; });
+	return blocks;
+}
+
+void RenderGraph::computeAliasing(bool useRealRequirements) {
+	std::vector<AliasCandidate> candidates;
+	std::vector<ResourceHandle> candidateResources;
+	for (ResourceHandle r = 0; r < resources.size(); ++r) {
+		Resource& resource = resources[r];
+		resource.aliasBlock = -1;
+		resource.aliasPredecessor = UINT32_MAX;
+		if (!resource.used || resource.imported)
+			continue;
+
+		AliasCandidate candidate;
+		candidate.firstPass = resource.firstPass;
+		candidate.lastPass = resource.lastPass;
+		if (useRealRequirements) {
+			candidate.size = resource.memoryRequirements.size;
+			candidate.alignment = resource.memoryRequirements.alignment;
+			candidate.memoryTypeBits = resource.memoryRequirements.memoryTypeBits;
+		} else if (resource.isImage) {
+			const RenderGraphImageDesc& desc = resource.imageDesc;
+			candidate.alignment = 65536; // typical render target alignment
+			candidate.size = alignUp(formatBytesPerPixel(desc.format) * desc.extent.width * desc.extent.height * static_cast<VkDeviceSize>(desc.samples), candidate.alignment);
+			candidate.memoryTypeBits = ~0u;
+		} else {
+			candidate.alignment = 256;
+			candidate.size = alignUp(resource.bufferSize, candidate.alignment);
+			candidate.memoryTypeBits = ~0u;
+		}
+		candidates.push_back(candidate);
+		candidateResources.push_back(r);
+	}
+
+	aliasBlocks = planAliasing(candidates);
+
+	stats = MemoryStats{};
+	for (const AliasCandidate& candidate : candidates)
+		stats.unaliasedBytes += alignUp(candidate.size, candidate.alignment);
+	for (int32_t b = 0; b < static_cast<int32_t>(aliasBlocks.size()); ++b) {
+		AliasBlock& block = aliasBlocks[b];
+		stats.aliasedBytes += alignUp(block.size, block.alignment);
+		for (size_t i = 0; i < block.candidates.size(); ++i) {
+			ResourceHandle r = candidateResources[block.candidates[i]];
+			block.candidates[i] = r; // from here on the block refers to resource handles
+			resources[r].aliasBlock = b;
+			resources[r].aliasPredecessor = i > 0 ? block.candidates[i - 1] : UINT32_MAX;
+		}
+	}
+	stats.memoryBlocks = static_cast<uint32_t>(aliasBlocks.size());
+}
+
+void RenderGraph::computeBarriers() {
+	// the stages still touching each resource when the frame ends: a transient's memory is reused by the next resource in its block, or by itself next frame,
+	// and neither may start writing before those are done
+	std::vector<VkPipelineStageFlags2> lastUseStages(resources.size(), VK_PIPELINE_STAGE_2_NONE);
+	for (PassHandle pass : order) {
+		for (const Access& access : passes[pass].accesses) {
+			AccessInfo info = getAccessInfo(access.access);
+			if (access.write)
+				lastUseStages[access.resource] = info.stage;
+			else
+				lastUseStages[access.resource] |= info.stage;
+		}
+	}
+
+	std::vector<TrackedState> states(resources.size());
+	for (ResourceHandle r = 0; r < resources.size(); ++r) {
+		Resource& resource = resources[r];
+		TrackedState& state = states[r];
+		if (resource.imported) {
+			state.layout = resource.initialState.layout;
+			state.syncStages = resource.initialState.stage;
+			state.unflushedAccess = resource.initialState.access & WRITE_ACCESS_MASK;
+		} else if (resource.used) {
+			state.layout = VK_IMAGE_LAYOUT_UNDEFINED; // contents are never carried over, so the first use can always discard
+			if (resource.aliasPredecessor != UINT32_MAX)
+				state.syncStages = lastUseStages[resource.aliasPredecessor];
+			else if (resource.aliasBlock >= 0)
+				state.syncStages = lastUseStages[aliasBlocks[resource.aliasBlock].candidates.back()]; // last occupant of the previous frame
+		}
+	}
+
+	for (PassHandle pass : order) {
+		std::vector<RenderGraphBarrier>& barriers = passes[pass].barriers;
+		barriers.clear();
+		for (const Access& access : passes[pass].accesses) {
+			AccessInfo info = getAccessInfo(access.access);
+			Resource& resource = resources[access.resource];
+			TrackedState& state = states[access.resource];
+			VkImageLayout layout = resource.isImage ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+			bool layoutChange = resource.isImage && layout != state.layout;
+
+			if (access.write || layoutChange) {
+				RenderGraphBarrier barrier{ access.resource, state.syncStages | state.readStages, state.unflushedAccess, info.stage, info.access, state.layout, layout };
+				if (layoutChange || barrier.srcStage != VK_PIPELINE_STAGE_2_NONE) // a buffer nobody has touched yet needs nothing
+					barriers.push_back(barrier);
+
+				state.layout = layout;
+				state.syncStages = info.stage;
+				if (access.write) {
+					state.unflushedAccess = info.access & WRITE_ACCESS_MASK;
+					state.readStages = VK_PIPELINE_STAGE_2_NONE;
+					state.readAccess = VK_ACCESS_2_NONE;
+				} else { // layout transition for a read, it's visible to this reader now
+					state.unflushedAccess = VK_ACCESS_2_NONE;
+					state.readStages = info.stage;
+					state.readAccess = info.access;
+				}
+			} else {
+				bool alreadyVisible = (info.stage & ~state.readStages) == 0 && (info.access & ~state.readAccess) == 0;
+				if (!alreadyVisible && state.syncStages != VK_PIPELINE_STAGE_2_NONE) {
+					barriers.push_back({ access.resource, state.syncStages, state.unflushedAccess, info.stage, info.access, state.layout, state.layout });
+					state.unflushedAccess = VK_ACCESS_2_NONE; // available now, later readers only need visibility
+				}
+				state.readStages |= info.stage;
+				state.readAccess |= info.access;
+			}
+		}
+	}
+
+	endBarriers.clear();
+	for (ResourceHandle r = 0; r < resources.size(); ++r) {
+		const Resource& resource = resources[r];
+		if (!resource.imported)
+			continue;
+		const TrackedState& state = states[r];
+		VkImageLayout finalLayout = resource.finalState.layout == VK_IMAGE_LAYOUT_UNDEFINED ? state.layout : resource.finalState.layout;
+		bool layoutChange = resource.isImage && finalLayout != state.layout;
+		if (layoutChange || resource.finalState.stage != VK_PIPELINE_STAGE_2_NONE)
+			endBarriers.push_back({ r, state.syncStages | state.readStages, state.unflushedAccess, resource.finalState.stage, resource.finalState.access, state.layout, finalLayout });
+	}
+}
+
+
+void RenderGraph::realize(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties) {
+	if (!compiled)
+		compile();
+
+	for (Resource& resource : resources) {
+		if (!resource.used || resource.imported)
+			continue;
+
+		if (resource.isImage) {
+			const RenderGraphImageDesc& desc = resource.imageDesc;
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = desc.format;
+			imageInfo.extent = { desc.extent.width, desc.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = desc.samples;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = resource.imageUsage | desc.extraUsage;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			if (vkCreateImage(device, &imageInfo, nullptr, &resource.image) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph image '" + resource.name + "'!");
+			}
+			vkGetImageMemoryRequirements(device, resource.image, &resource.memoryRequirements);
+		} else {
+			VkBufferCreateInfo bufferInfo{};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = resource.bufferSize;
+			bufferInfo.usage = resource.bufferUsage;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			if (vkCreateBuffer(device, &bufferInfo, nullptr, &resource.buffer) != VK_SUCCESS) {
+				throw std::runtime_error("Failed to create render graph buffer '" + resource.name + "'!");
+			}
+			vkGetBufferMemoryRequirements(device, resource.buffer, &resource.memoryRequirements);
+		}
+	}
+
+	computeAliasing(true); // the estimate from compile() may have grouped things differently than the real requirements allow
+	computeBarriers();
+
+	blockMemory.assign(aliasBlocks.size(), VK_NULL_HANDLE);
+	for (size_t b = 0; b < aliasBlocks.size(); ++b) {
+		const AliasBlock& block = aliasBlocks[b];
+		uint32_t memoryType = UINT32_MAX;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryType == UINT32_MAX; ++i) // prefer device local, but take anything that fits
+			if ((block.memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+				memoryType = i;
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount && memoryType == UINT32_MAX; ++i)
+			if (block.memoryTypeBits & (1u << i))
+				memoryType = i;
+		if (memoryType == UINT32_MAX) {
+			throw std::runtime_error("Failed to find a memory type for a render graph memory block!");
+		}
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = block.size;
+		allocInfo.memoryTypeIndex = memoryType;
+		if (allocateDeviceMemory(device, allocInfo, MemoryCategory::Images, blockMemory[b]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate render graph memory!");
+		}
+
+		for (ResourceHandle r : block.candidates) { // everything in a block starts at offset 0, they're never alive at the same time
+			Resource& resource = resources[r];
+			if (resource.isImage)
+				vkBindImageMemory(device, resource.image, blockMemory[b], 0);
+			else
+				vkBindBufferMemory(device, resource.buffer, blockMemory[b], 0);
+		}
+	}
+
+	for (Resource& resource : resources) {
+		if (!resource.used || resource.imported || !resource.isImage)
+			continue;
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = resource.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = resource.imageDesc.format;
+		viewInfo.subresourceRange.aspectMask = resource.imageDesc.aspect;
+		viewInfo.subresourceRange.baseMipLevel = 0;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.baseArrayLayer = 0;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &resource.view) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render graph image view '" + resource.name + "'!");
+		}
+	}
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphBarrier>& barriers) {
+	if (barriers.empty())
+		return;
+
+	imageBarrierScratch.clear();
+	bufferBarrierScratch.clear();
+	for (const RenderGraphBarrier& barrier : barriers) {
+		const Resource& resource = resources[barrier.resource];
+		if (resource.isImage) {
+			if (resource.image == VK_NULL_HANDLE)
+				throw std::runtime_error("Render graph image '" + resource.name + "' has no VkImage!");
+
+			VkImageMemoryBarrier2 imageBarrier{};
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			imageBarrier.srcStageMask = barrier.srcStage;
+			imageBarrier.srcAccessMask = barrier.srcAccess;
+			imageBarrier.dstStageMask = barrier.dstStage;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = barrier.oldLayout;
+			imageBarrier.newLayout = barrier.newLayout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = resource.image;
+			imageBarrier.subresourceRange = { resource.imageDesc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			imageBarrierScratch.push_back(imageBarrier);
+		} else {
+			if (resource.buffer == VK_NULL_HANDLE)
+				throw std::runtime_error("Render graph buffer '" + resource.name + "' has no VkBuffer!");
+
+			VkBufferMemoryBarrier2 bufferBarrier{};
+			bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+			bufferBarrier.srcStageMask = barrier.srcStage;
+			bufferBarrier.srcAccessMask = barrier.srcAccess;
+			bufferBarrier.dstStageMask = barrier.dstStage;
+			bufferBarrier.dstAccessMask = barrier.dstAccess;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer = resource.buffer;
+			bufferBarrier.offset = 0;
+			bufferBarrier.size = VK_WHOLE_SIZE;
+			bufferBarrierScratch.push_back(bufferBarrier);
+		}
+	}
+
+	VkDependencyInfo dependencyInfo{}; // one call per pass, however many resources it needs synchronized
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarrierScratch.size());
+	dependencyInfo.pImageMemoryBarriers = imageBarrierScratch.data();
+	dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarrierScratch.size());
+	dependencyInfo.pBufferMemoryBarriers = bufferBarrierScratch.data();
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+	if (!compiled)
+		throw std::runtime_error("Render graph has to be compiled before it's executed!");
+
+	for (PassHandle pass : order) {
+		recordBarriers(commandBuffer, passes[pass].barriers);
+		if (passes[pass].execute)
+			passes[pass].execute(commandBuffer);
+	}
+	recordBarriers(commandBuffer, endBarriers);
+}
+
+void RenderGraph::destroy(DeletionQueue& deletionQueue) {
+	for (Resource& resource : resources) {
+		if (resource.imported) {
+			continue;
+		}
+		deletionQueue.destroyImageView(resource.view); // null handles are ignored
+		deletionQueue.destroyImage(resource.image);
+		deletionQueue.destroyBuffer(resource.buffer);
+		resource.view = VK_NULL_HANDLE;
+		resource.image = VK_NULL_HANDLE;
+		resource.buffer = VK_NULL_HANDLE;
+	}
+	for (VkDeviceMemory memory : blockMemory)
+		deletionQueue.freeMemory(memory);
+	blockMemory.clear();
+}
+
+void RenderGraph::reset() {
+	passes.clear();
+	resources.clear();
+	order.clear();
+	endBarriers.clear();
+	aliasBlocks.clear();
+	blockMemory.clear();
+	stats = MemoryStats{};
+	compiled = false;
+}
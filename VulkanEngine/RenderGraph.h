@@ -0,0 +1,186 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class DeletionQueue;
+
+// Render graph: passes declare which resources they read and write, and compile() works out everything that used to be written by hand around
+// vkCmdBeginRenderPass - the order passes run in, which passes can be dropped because nothing consumes their output, the minimal set of
+// synchronization2 barriers (including layout transitions) between them, and which transient attachments can share the same memory because they're
+// never alive at the same time.
+// compile() only looks at the declarations, it doesn't need a device, so the scheduling/barrier/aliasing logic can be checked on the CPU alone.
+// realize() then creates and binds the transient resources, and execute() records the barriers and pass callbacks into a command buffer.
+
+// how a pass uses a resource. each maps to a fixed stage/access/layout triple, see RenderGraph.cpp
+enum class RenderGraphAccess {
+	ColorAttachmentWrite,
+	DepthAttachmentWrite,
+	DepthAttachmentRead,
+	FragmentSampledRead,
+	ComputeSampledRead,
+	ComputeStorageRead,
+	ComputeStorageWrite,
+	VertexStorageRead,
+	FragmentStorageRead,
+	TransferRead,
+	TransferWrite,
+	VertexBufferRead,
+	IndexBufferRead,
+	IndirectBufferRead,
+	UniformRead,
+};
+
+struct RenderGraphImageDesc {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+	VkImageUsageFlags extraUsage = 0; // usage the graph can't infer from the declared accesses
+};
+
+// where a resource is coming from (imported resources) or where it has to end up (finalState of imported resources)
+struct RenderGraphResourceState {
+	VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 access = VK_ACCESS_2_NONE;
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct RenderGraphBarrier {
+	uint32_t resource;
+	VkPipelineStageFlags2 srcStage;
+	VkAccessFlags2 srcAccess;
+	VkPipelineStageFlags2 dstStage;
+	VkAccessFlags2 dstAccess;
+	VkImageLayout oldLayout; // ignored for buffers
+	VkImageLayout newLayout;
+};
+
+class RenderGraph {
+public:
+	using ResourceHandle = uint32_t;
+	using PassHandle = uint32_t;
+
+	// transient resources only live for the duration of a frame and are owned (and possibly aliased) by the graph
+	ResourceHandle createImage(const std::string& name, const RenderGraphImageDesc& desc);
+	ResourceHandle createBuffer(const std::string& name, VkDeviceSize size, VkBufferUsageFlags extraUsage = 0);
+
+	// imported resources are owned by someone else (eg the swap chain). they're always treated as outputs, so passes writing them are never culled
+	ResourceHandle importImage(const std::string& name, const RenderGraphImageDesc& desc, const RenderGraphResourceState& initialState, const RenderGraphResourceState& finalState);
+	ResourceHandle importBuffer(const std::string& name, VkDeviceSize size, const RenderGraphResourceState& initialState, const RenderGraphResourceState& finalState);
+	void setImportedImage(ResourceHandle resource, VkImage image, VkImageView view); // can change every frame, eg the acquired swap chain image
+	void setImportedBuffer(ResourceHandle resource, VkBuffer buffer);
+	void markOutput(ResourceHandle resource); // keep the passes producing a transient resource even though no pass reads it
+
+	PassHandle addPass(const std::string& name, std::function<void(VkCommandBuffer)> execute);
+	void read(PassHandle pass, ResourceHandle resource, RenderGraphAccess access);
+	void write(PassHandle pass, ResourceHandle resource, RenderGraphAccess access);
+	void setSideEffects(PassHandle pass); // never cull this pass (eg it writes to something outside the graph)
+
+	void compile(); // CPU only: culling, ordering, barriers, lifetimes and an estimated aliasing plan
+	void realize(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties); // creates the transient resources and aliases them with their real memory requirements
+	void execute(VkCommandBuffer commandBuffer);
+	void destroy(DeletionQueue& deletionQueue); // frees the transient resources once the GPU is done with them, the declarations are kept so the graph can be realized again
+	void reset(); // forget all passes and resources (call destroy() first if it was realized)
+
+	// compiled results
+	const std::vector<PassHandle>& executionOrder() const { return order; }
+	bool isPassCulled(PassHandle pass) const { return passes[pass].culled; }
+	const std::vector<RenderGraphBarrier>& passBarriers(PassHandle pass) const { return passes[pass].barriers; }
+	const std::vector<RenderGraphBarrier>& finalBarriers() const { return endBarriers; }
+	uint32_t barrierCount() const;
+
+	VkImage image(ResourceHandle resource) const { return resources[resource].image; }
+	VkImageView imageView(ResourceHandle resource) const { return resources[resource].view; }
+	VkBuffer buffer(ResourceHandle resource) const { return resources[resource].buffer; }
+	const RenderGraphImageDesc& imageDesc(ResourceHandle resource) const { return resources[resource].imageDesc; }
+	const std::string& resourceName(ResourceHandle resource) const { return resources[resource].name; }
+	const std::string& passName(PassHandle pass) const { return passes[pass].name; }
+
+	// transient memory aliasing. resources whose lifetimes (first to last pass in execution order) don't overlap share one memory block
+	struct AliasCandidate {
+		uint32_t firstPass; // position in the execution order
+		uint32_t lastPass;
+		VkDeviceSize size;
+		VkDeviceSize alignment;
+		uint32_t memoryTypeBits;
+	};
+	struct AliasBlock {
+		VkDeviceSize size = 0;
+		VkDeviceSize alignment = 1;
+		uint32_t memoryTypeBits = ~0u;
+		std::vector<uint32_t> candidates;
+	};
+	static std::vector<AliasBlock> planAliasing(const std::vector<AliasCandidate>& candidates);
+
+	struct MemoryStats {
+		VkDeviceSize unaliasedBytes = 0; // what the transient resources would take with one allocation each
+		VkDeviceSize aliasedBytes = 0; // what they actually take
+		uint32_t memoryBlocks = 0;
+	};
+	const MemoryStats& memoryStats() const { return stats; } // estimated after compile(), exact after realize()
+
+private:
+	struct Access {
+		ResourceHandle resource;
+		RenderGraphAccess access;
+		bool write;
+	};
+	struct Pass {
+		std::string name;
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<Access> accesses;
+		bool sideEffects = false;
+		bool culled = false;
+		std::vector<RenderGraphBarrier> barriers; // recorded before the pass runs
+	};
+	struct Resource {
+		std::string name;
+		bool isImage = true;
+		bool imported = false;
+		bool output = false;
+		RenderGraphImageDesc imageDesc;
+		VkDeviceSize bufferSize = 0;
+		VkBufferUsageFlags bufferUsage = 0;
+		VkImageUsageFlags imageUsage = 0;
+		RenderGraphResourceState initialState;
+		RenderGraphResourceState finalState;
+
+		// compiled
+		bool used = false;
+		uint32_t firstPass = UINT32_MAX, lastPass = 0; // positions in the execution order
+		int32_t aliasBlock = -1;
+		ResourceHandle aliasPredecessor = UINT32_MAX; // the resource that used the same memory before this one within a frame
+
+		// realized
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkMemoryRequirements memoryRequirements{};
+	};
+
+	void addAccess(PassHandle pass, ResourceHandle resource, RenderGraphAccess access, bool write);
+	void cullPasses();
+	void schedulePasses();
+	void computeLifetimes();
+	void computeAliasing(bool useRealRequirements);
+	void computeBarriers();
+	void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<RenderGraphBarrier>& barriers);
+
+	std::vector<Pass> passes;
+	std::vector<Resource> resources;
+	std::vector<PassHandle> order;
+	std::vector<RenderGraphBarrier> endBarriers;
+	std::vector<AliasBlock> aliasBlocks;
+	std::vector<VkDeviceMemory> blockMemory;
+	MemoryStats stats;
+	bool compiled = false;
+
+	// scratch space for execute(), kept around so recording doesn't allocate every frame
+	std::vector<VkImageMemoryBarrier2> imageBarrierScratch;
+	std::vector<VkBufferMemoryBarrier2> bufferBarrierScratch;
+};
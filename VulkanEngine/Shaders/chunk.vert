@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 projection; // jittered, see TemporalUpscaler.h
+	mat4 previousModel; // last frame's, for the motion vectors
+	mat4 previousViewProjection; // last frame's, without the jitter
+	mat4 viewProjection; // this frame's, without the jitter
+} ubo;
+
+layout(location = 0) in vec3 inPosition; // world space already, the model matrix is the scene object's
+layout(location = 1) in vec3 inColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragWorldPosition;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec4 fragClipPosition;
+layout(location = 4) out vec4 fragPreviousClipPosition;
+
+void main() {
+	gl_Position = ubo.projection * ubo.view * vec4(inPosition, 1.0);
+	fragColor = inColor;
+	fragWorldPosition = inPosition;
+	fragNormal = vec3(0.0, 0.0, 1.0); // the point lights see the ground as level, the sun's lighting of the slopes is in the colors (WorldStreamer::decode)
+	fragClipPosition = ubo.viewProjection * vec4(inPosition, 1.0);
+	fragPreviousClipPosition = ubo.previousViewProjection * vec4(inPosition, 1.0); // the terrain doesn't move, only the camera
+}
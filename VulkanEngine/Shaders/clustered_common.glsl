@@ -0,0 +1,52 @@
+// shared between the light cull shader and the lit fragment shaders. layouts mirror ClusteredLighting.h
+// LIGHTING_SET is the descriptor set the lighting buffers are bound to: 0 in the cull compute shader, 1 next to the camera UBO in the graphics
+// pipelines. only the cull shader (LIGHT_CULL) writes the froxel ranges and the index list
+#ifndef LIGHTING_SET
+#define LIGHTING_SET 0
+#endif
+#ifdef LIGHT_CULL
+#define CLUSTER_ACCESS
+#else
+#define CLUSTER_ACCESS readonly
+#endif
+
+#define CLUSTER_X 16 // ClusteredLighting::CLUSTER_X/Y/Z
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+struct Light {
+	vec4 positionRadius; // xyz world space, w the radius it reaches zero at
+	vec4 color;
+};
+
+layout(std140, set = LIGHTING_SET, binding = 0) uniform ClusterParams {
+	mat4 view;
+	mat4 inverseProjection;
+	vec4 cameraPosition; // world space
+	vec2 screenSize; // the render extent in pixels
+	float depthScale; // slice = log(view depth) * depthScale + depthBias
+	float depthBias;
+	float nearPlane;
+	float farPlane;
+	uint lightCount;
+	uint indexCapacity;
+} clusterParams;
+
+layout(std430, set = LIGHTING_SET, binding = 1) readonly buffer Lights { Light lights[]; };
+layout(std430, set = LIGHTING_SET, binding = 2) CLUSTER_ACCESS buffer Clusters { uvec2 clusters[]; }; // (offset, count) into lightIndices per froxel
+// lightCount is the atomic the froxels reserve their range with. a froxel whose range would run past indexCapacity keeps what fits
+layout(std430, set = LIGHTING_SET, binding = 3) CLUSTER_ACCESS buffer LightIndices {
+	uint lightIndexCount;
+	uint lightIndices[];
+};
+
+uint clusterIndex(uvec3 cluster) {
+	return (cluster.z * CLUSTER_Y + cluster.y) * CLUSTER_X + cluster.x;
+}
+
+// froxel of a fragment: its tile from gl_FragCoord, its slice from the view depth
+uint clusterAt(vec2 fragCoord, float viewDepth) {
+	uvec2 tile = uvec2(clamp(fragCoord / clusterParams.screenSize * vec2(CLUSTER_X, CLUSTER_Y), vec2(0.0), vec2(CLUSTER_X - 1, CLUSTER_Y - 1)));
+	float slice = log(max(viewDepth, clusterParams.nearPlane)) * clusterParams.depthScale + clusterParams.depthBias;
+	return clusterIndex(uvec3(tile, uint(clamp(slice, 0.0, float(CLUSTER_Z - 1)))));
+}
@@ -1,3 +1,19 @@
-C:/VulkanSDK/1.2.148.0/Bin32/glslc.exe shader.vert -o vert.spv
-C:/VulkanSDK/1.2.148.0/Bin32/glslc.exe shader.frag -o frag.spv
+%VULKAN_SDK%/Bin/glslc.exe shader.vert -o vert.spv
+%VULKAN_SDK%/Bin/glslc.exe shader.frag -o frag.spv
+%VULKAN_SDK%/Bin/glslc.exe particle.vert -o particle_vert.spv
+%VULKAN_SDK%/Bin/glslc.exe particle.frag -o particle_frag.spv
+%VULKAN_SDK%/Bin/glslc.exe particle_begin.comp -o particle_begin.spv
+%VULKAN_SDK%/Bin/glslc.exe particle_emit.comp -o particle_emit.spv
+%VULKAN_SDK%/Bin/glslc.exe particle_simulate.comp -o particle_simulate.spv
+%VULKAN_SDK%/Bin/glslc.exe particle_compact.comp -o particle_compact.spv
+%VULKAN_SDK%/Bin/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
+%VULKAN_SDK%/Bin/glslc.exe --target-env=vulkan1.3 meshlet.task -o meshlet_task.spv
+%VULKAN_SDK%/Bin/glslc.exe --target-env=vulkan1.3 meshlet.mesh -o meshlet_mesh.spv
+%VULKAN_SDK%/Bin/glslc.exe chunk.vert -o chunk_vert.spv
+%VULKAN_SDK%/Bin/glslc.exe light_cull.comp -o light_cull.spv
+%VULKAN_SDK%/Bin/glslc.exe shadow.vert -o shadow_vert.spv
+%VULKAN_SDK%/Bin/glslc.exe taa_resolve.comp -o taa_resolve.spv
+%VULKAN_SDK%/Bin/glslc.exe sharpen.comp -o sharpen.spv
+%VULKAN_SDK%/Bin/glslc.exe depth_pyramid.comp -o depth_pyramid.spv
+%VULKAN_SDK%/Bin/glslc.exe -DMULTISAMPLED depth_pyramid.comp -o depth_pyramid_ms.spv
 pause
\ No newline at end of file
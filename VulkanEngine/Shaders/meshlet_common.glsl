@@ -0,0 +1,41 @@
+// shared between the meshlet cull, task and mesh shaders. layouts mirror MeshletRenderer.h
+// MESHLET_SET is the descriptor set the meshlet buffers are bound to: 0 in the cull compute shader, 3 in the mesh pipeline (after the camera UBO, the lighting and the shadows)
+#ifndef MESHLET_SET
+#define MESHLET_SET 0
+#endif
+
+struct Meshlet {
+	vec4 sphere; // xyz center, w radius
+	vec4 coneApex; // xyz apex, w cutoff (> 1 never culls)
+	vec4 coneAxis;
+	uint vertexOffset;
+	uint triangleOffset;
+	uint vertexCount;
+	uint triangleCount;
+};
+
+layout(std430, set = MESHLET_SET, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout(std430, set = MESHLET_SET, binding = 1) readonly buffer MeshletVertices { uint meshletVertices[]; }; // meshlet local -> mesh vertex
+layout(std430, set = MESHLET_SET, binding = 2) readonly buffer MeshletTriangles { uint meshletTriangles[]; }; // 3 local indices, 8 bits each
+
+layout(push_constant) uniform CullParams {
+	vec4 frustumPlanes[6]; // mesh space, normalized, pointing inwards
+	vec4 cameraPosition; // mesh space
+	uint meshletCount; // the selected LOD's meshlets
+	uint meshletOffset;
+	uint occlusionPhase; // the cull compute shader's, 0 early 1 late. unused by the task and mesh shaders
+	uint firstInstance; // the mesh shader path's, the cull compute shader's instances are in its draw arguments
+} pc;
+
+uvec3 unpackTriangle(uint packed) {
+	return uvec3(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF);
+}
+
+bool meshletVisible(Meshlet meshlet) {
+	for (int i = 0; i < 6; ++i) {
+		if (dot(pc.frustumPlanes[i].xyz, meshlet.sphere.xyz) + pc.frustumPlanes[i].w < -meshlet.sphere.w)
+			return false; // entirely outside one of the planes
+	}
+	// every triangle faces away when the camera sits inside the (widened) normal cone behind the apex
+	return dot(normalize(meshlet.coneApex.xyz - pc.cameraPosition.xyz), meshlet.coneAxis.xyz) < meshlet.coneApex.w;
+}
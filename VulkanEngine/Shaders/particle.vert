@@ -0,0 +1,33 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+} ubo;
+
+struct Instance {
+	vec4 positionSize;
+	vec4 color;
+};
+layout(std430, set = 1, binding = 0) readonly buffer Instances { Instance instances[]; };
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 corners[6] = vec2[](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0), vec2(-1.0, -1.0));
+
+void main() {
+	Instance instance = instances[gl_InstanceIndex];
+	vec2 corner = corners[gl_VertexIndex];
+
+	// camera right/up are the first two rows of the view matrix, so the quad always faces the camera
+	vec3 right = vec3(ubo.view[0][0], ubo.view[1][0], ubo.view[2][0]);
+	vec3 up = vec3(ubo.view[0][1], ubo.view[1][1], ubo.view[2][1]);
+	vec3 worldPosition = instance.positionSize.xyz + (right * corner.x + up * corner.y) * instance.positionSize.w;
+
+	gl_Position = ubo.projection * ubo.view * vec4(worldPosition, 1.0); // particles are already in world space, no model matrix
+	fragColor = instance.color;
+	fragCorner = corner;
+}
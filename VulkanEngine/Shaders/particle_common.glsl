@@ -0,0 +1,79 @@
+// shared between the particle compute shaders. layouts mirror ParticleSystem.h
+#define WORKGROUP_SIZE 64
+
+struct Emitter {
+	vec4 positionRadius;
+	vec4 velocitySpread;
+	vec4 colorStart;
+	vec4 colorEnd;
+	vec4 params; // x lifetime, y size
+	uint firstSpawn; // exclusive prefix sum of spawnCount
+	uint spawnCount;
+	uint padding0;
+	uint padding1;
+};
+
+struct Instance {
+	vec4 positionSize;
+	vec4 color;
+};
+
+layout(std430, binding = 0) buffer Counters {
+	uint aliveCount[2];
+	uint deadHead; // dead list ring: slots [deadHead, deadTail) are free
+	uint deadTail;
+	uint emitHead; // deadHead before this frame's emit took its slots
+	uint emitCount;
+	uint padding0;
+	uint padding1;
+	uint simulateGroupsX; // VkDispatchIndirectCommand, at byte offset 32
+	uint simulateGroupsY;
+	uint simulateGroupsZ;
+	uint padding2;
+} counters;
+
+layout(std430, binding = 1) buffer PositionAge { vec4 positionAge[]; };
+layout(std430, binding = 2) buffer VelocityLifetime { vec4 velocityLifetime[]; };
+layout(std430, binding = 3) buffer Appearance { uvec4 appearance[]; }; // packed start color, packed end color, size bits, unused
+layout(std430, binding = 4) buffer DeadList { uint deadList[]; };
+layout(std430, binding = 5) buffer AliveLists { uint aliveLists[]; }; // two lists of capacity entries each
+layout(std430, binding = 6) readonly buffer Emitters { Emitter emitters[]; };
+layout(std430, binding = 7) writeonly buffer Instances { Instance instances[]; };
+layout(std430, binding = 8) writeonly buffer DrawArgs {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+} drawArgs;
+
+layout(push_constant) uniform PushConstants {
+	float deltaTime;
+	uint capacity; // power of two
+	uint spawnTotal;
+	uint emitterCount;
+	uint parity; // the current alive list, survivors go to the other one
+	uint seed;
+	uint initialize;
+	float gravity;
+} pc;
+
+uint hash(uint x) { // lowbias32
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float random(inout uint state) {
+	state = hash(state);
+	return float(state >> 8) * (1.0 / 16777216.0);
+}
+
+vec3 randomInUnitSphere(inout uint state) {
+	float z = random(state) * 2.0 - 1.0;
+	float angle = random(state) * 6.28318531;
+	float radius = sqrt(max(0.0, 1.0 - z * z));
+	return vec3(radius * cos(angle), radius * sin(angle), z) * pow(random(state), 1.0 / 3.0);
+}
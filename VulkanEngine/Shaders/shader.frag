@@ -1,10 +1,67 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#define LIGHTING_SET 1
+#include "clustered_common.glsl"
+
+layout(set = 2, binding = 0) uniform ShadowParams { // ShadowCascades::SHADOW_SET, mirrors GpuShadowParams
+	mat4 lightViewProjection[4];
+	vec4 splitDepths; // view depth each cascade ends at
+	vec4 lightDirection; // xyz where the light travels, w the cascade count
+	vec4 lightColor; // rgb, w one texel in uv
+} shadowParams;
+layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
 
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec3 fragWorldPosition;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec4 fragClipPosition;
+layout(location = 4) in vec4 fragPreviousClipPosition;
 
 layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outVelocity; // uv this frame - uv last frame, for the temporal resolve
+
+const float AMBIENT = 0.3;
+
+// how much of the sun reaches the fragment: the cascade its view depth falls in, 4 bilinear compares around it (PCF)
+float sunShadow(vec3 normal, float viewDepth) {
+	int cascadeCount = int(shadowParams.lightDirection.w);
+	int cascade = 0;
+	while (cascade < cascadeCount - 1 && viewDepth > shadowParams.splitDepths[cascade])
+		++cascade;
 
+	vec4 lightClip = shadowParams.lightViewProjection[cascade] * vec4(fragWorldPosition + normal * 0.01, 1.0); // pushed off the surface against acne
+	vec3 coord = lightClip.xyz / lightClip.w;
+	vec2 uv = coord.xy * 0.5 + 0.5;
+	float texel = shadowParams.lightColor.w;
+	float lit = 0.0;
+	for (int i = 0; i < 4; ++i) {
+		vec2 offset = vec2((i & 1) != 0 ? 0.5 : -0.5, (i & 2) != 0 ? 0.5 : -0.5) * texel;
+		lit += texture(shadowMap, vec4(uv + offset, float(cascade), coord.z));
+	}
+	return lit * 0.25;
+}
+
+// clustered forward shading (see ClusteredLighting.h): only the lights the cull pass put in this fragment's froxel are looked at
 void main() {
-	outColor = vec4(fragColor, 1.0);
+	vec3 normal = normalize(fragNormal);
+	if (dot(normal, clusterParams.cameraPosition.xyz - fragWorldPosition) < 0.0)
+		normal = -normal; // the quad is seen from both sides, light the side facing the camera
+
+	float viewDepth = -(clusterParams.view * vec4(fragWorldPosition, 1.0)).z;
+	vec3 lighting = vec3(AMBIENT);
+	float sun = max(dot(normal, -shadowParams.lightDirection.xyz), 0.0);
+	lighting += shadowParams.lightColor.rgb * sun * sunShadow(normal, viewDepth); // not branched on sun, the shadow lookups want uniform control flow
+
+	uvec2 range = clusters[clusterAt(gl_FragCoord.xy, viewDepth)];
+	for (uint i = 0; i < range.y; ++i) {
+		Light light = lights[lightIndices[range.x + i]];
+		vec3 toLight = light.positionRadius.xyz - fragWorldPosition;
+		float lightDistance = length(toLight);
+		float falloff = clamp(1.0 - lightDistance / light.positionRadius.w, 0.0, 1.0);
+		lighting += light.color.rgb * (falloff * falloff) * max(dot(normal, toLight / max(lightDistance, 1e-4)), 0.0); // smooth falloff to 0 at the radius
+	}
+	outColor = vec4(fragColor * lighting, 1.0);
+	outVelocity = (fragClipPosition.xy / fragClipPosition.w - fragPreviousClipPosition.xy / fragPreviousClipPosition.w) * 0.5; // ndc to uv
 }
@@ -4,16 +4,36 @@
 layout(binding = 0) uniform UniformBufferObject {
 	mat4 model;
 	mat4 view;
-	mat4 projection;
+	mat4 projection; // jittered, see TemporalUpscaler.h
+	mat4 previousModel; // last frame's, for the motion vectors
+	mat4 previousViewProjection; // last frame's, without the jitter
+	mat4 viewProjection; // this frame's, without the jitter
 } ubo;
 
+// the instanced draws' per instance data, indexed by gl_InstanceIndex (which includes the draw's firstInstance). mirrors InstanceData in main.cpp
+struct Instance {
+	mat4 model;
+	mat4 previousModel;
+};
+layout(std430, binding = 1) readonly buffer Instances { Instance instances[]; };
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragWorldPosition; // for the clustered lighting in shader.frag
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec4 fragClipPosition; // both unjittered, shader.frag turns them into the motion vector
+layout(location = 4) out vec4 fragPreviousClipPosition;
 
 void main() {
-	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+	Instance instance = instances[gl_InstanceIndex];
+	vec4 worldPosition = instance.model * vec4(inPosition, 0.0, 1.0);
+	gl_Position = ubo.projection * ubo.view * worldPosition;
 	//gl_Position = vec4(inPosition, 0.0, 1.0); // division by 1.0 to transform clip coords to normalized device coords means we won't change anything
 	fragColor = inColor;
+	fragWorldPosition = worldPosition.xyz;
+	fragNormal = mat3(instance.model) * vec3(0.0, 0.0, 1.0); // the quad lies in the xy plane, the model matrix only rotates it
+	fragClipPosition = ubo.viewProjection * worldPosition;
+	fragPreviousClipPosition = ubo.previousViewProjection * instance.previousModel * vec4(inPosition, 0.0, 1.0);
 }
\ No newline at end of file
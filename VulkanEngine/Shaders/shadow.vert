@@ -0,0 +1,15 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// depth only, for the shadow cascades (see ShadowCascades.h). the pipelines feed it either the scene's vec2 positions (z comes in as 0) or the
+// terrain's vec3 ones
+layout(push_constant) uniform ShadowPush {
+	mat4 lightViewProjection; // the cascade's
+	mat4 model;
+} push;
+
+layout(location = 0) in vec3 inPosition;
+
+void main() {
+	gl_Position = push.lightViewProjection * push.model * vec4(inPosition, 1.0);
+}
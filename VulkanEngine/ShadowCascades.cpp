@@ -0,0 +1,433 @@
+#include "ShadowCascades.h"
+
+#include "MemoryTelemetry.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+void ShadowCascades::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, const Settings& settings) {
+	if (settings.cascadeCount == 0 || settings.cascadeCount > MAX_CASCADES || settings.staticCascades > settings.cascadeCount) {
+		throw std::runtime_error("Invalid shadow cascade settings!");
+	}
+	this->device = device;
+	config = settings;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	// D16 is plenty for an orthographic projection a few dozen units deep, and it's guaranteed as a sampled depth attachment
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, depthFormat, &formatProperties);
+	linearFiltering = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+
+	frames.resize(framesInFlight);
+	createImage();
+	createRenderPass();
+	createDescriptors();
+}
+
+void ShadowCascades::destroy() {
+	freeDescriptorPool(device, descriptorPool); // frees the sets too
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	for (Frame& frame : frames) {
+		vkUnmapMemory(device, frame.paramsMemory);
+		vkDestroyBuffer(device, frame.paramsBuffer, nullptr);
+		freeDeviceMemory(device, frame.paramsMemory);
+	}
+	frames.clear();
+
+	vkDestroySampler(device, sampler, nullptr);
+	for (uint32_t c = 0; c < config.cascadeCount; ++c) {
+		vkDestroyFramebuffer(device, framebuffers[c], nullptr);
+		vkDestroyImageView(device, layerViews[c], nullptr);
+	}
+	vkDestroyRenderPass(device, depthRenderPass, nullptr);
+	vkDestroyImageView(device, depthArrayView, nullptr);
+	vkDestroyImage(device, depthImage, nullptr);
+	freeDeviceMemory(device, depthMemory);
+}
+
+uint32_t ShadowCascades::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void ShadowCascades::createImage() {
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = depthFormat;
+	imageInfo.extent = { config.resolution, config.resolution, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = config.cascadeCount;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	if (vkCreateImage(device, &imageInfo, nullptr, &depthImage) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow map!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetImageMemoryRequirements(device, depthImage, &memReqs);
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (allocateDeviceMemory(device, allocInfo, MemoryCategory::Images, depthMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate shadow map memory!");
+	}
+	vkBindImageMemory(device, depthImage, depthMemory, 0);
+
+	// the whole array for sampling, one view per layer to render a cascade into
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = depthImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+	viewInfo.format = depthFormat;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, config.cascadeCount };
+	if (vkCreateImageView(device, &viewInfo, nullptr, &depthArrayView) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow map view!");
+	}
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	for (uint32_t c = 0; c < config.cascadeCount; ++c) {
+		viewInfo.subresourceRange.baseArrayLayer = c;
+		viewInfo.subresourceRange.layerCount = 1;
+		if (vkCreateImageView(device, &viewInfo, nullptr, &layerViews[c]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shadow map view!");
+		}
+	}
+
+	// hardware depth compare. outside the cascade is lit
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = linearFiltering ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	samplerInfo.minFilter = samplerInfo.magFilter;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.maxLod = 0.0f;
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow map sampler!");
+	}
+}
+
+// depth only, one subpass. the render graph does the layout transitions and barriers around the pass, so the layouts don't change inside it
+void ShadowCascades::createRenderPass() {
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // cached cascades are read frames later
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthReference{};
+	depthReference.attachment = 0;
+	depthReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass{};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 0;
+	subpass.pDepthStencilAttachment = &depthReference;
+
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &depthAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &depthRenderPass) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shadow render pass!");
+	}
+
+	for (uint32_t c = 0; c < config.cascadeCount; ++c) {
+		VkFramebufferCreateInfo frameBufferInfo{};
+		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferInfo.renderPass = depthRenderPass;
+		frameBufferInfo.attachmentCount = 1;
+		frameBufferInfo.pAttachments = &layerViews[c];
+		frameBufferInfo.width = config.resolution;
+		frameBufferInfo.height = config.resolution;
+		frameBufferInfo.layers = 1;
+		if (vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &framebuffers[c]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shadow framebuffer!");
+		}
+	}
+}
+
+void ShadowCascades::createDescriptors() {
+	// 0 the cascade parameters, 1 the shadow map with its compare sampler
+	VkDescriptorSetLayoutBinding bindings[2]{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = bindings;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow descriptor set layout!");
+
+	uint32_t frameCount = static_cast<uint32_t>(frames.size());
+	VkDescriptorPoolSize poolSizes[2]{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = frameCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[1].descriptorCount = frameCount;
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+	poolInfo.maxSets = frameCount;
+	if (allocateDescriptorPool(device, poolInfo, descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create shadow descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, descriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(frameCount);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = descriptorPool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("Failed to allocate shadow descriptor sets!");
+
+	for (uint32_t f = 0; f < frameCount; ++f) {
+		Frame& frame = frames[f];
+		frame.set = sets[f];
+
+		// rewritten by every update() while the previous submission of the frame is done, so host visible and mapped for good
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = sizeof(GpuShadowParams);
+		bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &frame.paramsBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create shadow parameter buffer!");
+		}
+		VkMemoryRequirements memReqs;
+		vkGetBufferMemoryRequirements(device, frame.paramsBuffer, &memReqs);
+		VkMemoryAllocateInfo memoryInfo{};
+		memoryInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		memoryInfo.allocationSize = memReqs.size;
+		memoryInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		if (allocateDeviceMemory(device, memoryInfo, MemoryCategory::Buffers, frame.paramsMemory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate shadow parameter memory!");
+		}
+		vkBindBufferMemory(device, frame.paramsBuffer, frame.paramsMemory, 0);
+		vkMapMemory(device, frame.paramsMemory, 0, VK_WHOLE_SIZE, 0, &frame.params);
+		std::memset(frame.params, 0, sizeof(GpuShadowParams));
+
+		VkDescriptorBufferInfo paramsInfo{};
+		paramsInfo.buffer = frame.paramsBuffer;
+		paramsInfo.offset = 0;
+		paramsInfo.range = sizeof(GpuShadowParams);
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.sampler = sampler;
+		imageInfo.imageView = depthArrayView;
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkWriteDescriptorSet writes[2]{};
+		for (uint32_t i = 0; i < 2; ++i) {
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.set;
+			writes[i].dstBinding = i;
+			writes[i].dstArrayElement = 0;
+			writes[i].descriptorType = bindings[i].descriptorType;
+			writes[i].descriptorCount = 1;
+		}
+		writes[0].pBufferInfo = &paramsInfo;
+		writes[1].pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+	}
+}
+
+void ShadowCascades::recordInitialTransition(VkCommandBuffer commandBuffer) {
+	if (imageInitialized)
+		return;
+	imageInitialized = true;
+
+	// the contents don't matter, every cascade is rendered on the first frame
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+	barrier.srcAccessMask = VK_ACCESS_2_NONE;
+	barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+	barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = depthImage;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS };
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 1;
+	dependencyInfo.pImageMemoryBarriers = &barrier;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+bool ShadowCascades::overlaps(const Cascade& cascade, const glm::vec4& sphere) const {
+	// the box in light space: the fitted square, from the back of the sphere to casterDistance in front of it (+z points at the light)
+	glm::vec4 center = lightRotation * glm::vec4(sphere.x, sphere.y, sphere.z, 1.0f);
+	float dx = std::max(std::abs(center.x - cascade.lightSpaceCenter.x) - cascade.radius, 0.0f);
+	float dy = std::max(std::abs(center.y - cascade.lightSpaceCenter.y) - cascade.radius, 0.0f);
+	float dz = std::max(std::max(cascade.lightSpaceCenter.z - cascade.radius - center.z, center.z - (cascade.lightSpaceCenter.z + cascade.radius + config.casterDistance)), 0.0f);
+	return dx * dx + dy * dy + dz * dz <= sphere.w * sphere.w;
+}
+
+bool ShadowCascades::casterVisible(uint32_t cascade, const glm::vec4& sphere) const {
+	return overlaps(cascades[cascade], sphere);
+}
+
+float ShadowCascades::splitDepth(uint32_t cascade, uint32_t cascadeCount, float nearPlane, float farPlane, float lambda) {
+	// practical split scheme: logarithmic splits keep the texel density even over depth, uniform ones keep the near cascades from getting tiny
+	float t = static_cast<float>(cascade + 1) / cascadeCount;
+	float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+	float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+	return lambda * logSplit + (1.0f - lambda) * uniformSplit;
+}
+
+ShadowCascades::SliceSphere ShadowCascades::sliceSphere(float sliceNear, float sliceFar, float diagonal2) {
+	// the smallest sphere around the slice's 8 corners is centered on the view axis: at the middle pushed back by the diagonal, but not past the far plane
+	SliceSphere sphere;
+	sphere.centerDepth = std::min(sliceFar, 0.5f * (sliceNear + sliceFar) * (1.0f + diagonal2));
+	float nearReach = (sphere.centerDepth - sliceNear) * (sphere.centerDepth - sliceNear) + sliceNear * sliceNear * diagonal2;
+	float farReach = (sliceFar - sphere.centerDepth) * (sliceFar - sphere.centerDepth) + sliceFar * sliceFar * diagonal2;
+	sphere.radius = std::sqrt(std::max(nearReach, farReach));
+	return sphere;
+}
+
+glm::vec3 ShadowCascades::snapToTexels(const glm::vec3& lightSpace, float radius, uint32_t resolution) {
+	float texel = 2.0f * radius / resolution;
+	return glm::floor(lightSpace / texel) * texel;
+}
+
+void ShadowCascades::fit(Cascade& cascade, const glm::vec3& sliceCenter, float sliceRadius, bool staticOnly, bool lightChanged) {
+	float radius = sliceRadius * (staticOnly ? config.staticPadding : 1.0f);
+	bool refit = !cascade.valid || lightChanged || radius != cascade.radius || glm::length(sliceCenter - cascade.fitCenter) + sliceRadius > cascade.radius;
+	if (!refit)
+		return; // the slice is still inside the cached box
+
+	// snapped to whole texels in light space, so the projection only ever moves in texel steps
+	glm::vec3 snapped = snapToTexels(glm::vec3(lightRotation * glm::vec4(sliceCenter, 1.0f)), radius, config.resolution);
+	bool moved = !cascade.valid || lightChanged || radius != cascade.radius || snapped != cascade.lightSpaceCenter;
+	cascade.fitCenter = sliceCenter;
+	if (!moved)
+		return;
+
+	cascade.lightSpaceCenter = snapped;
+	cascade.radius = radius;
+	glm::mat4 ortho = glm::ortho(snapped.x - radius, snapped.x + radius, snapped.y - radius, snapped.y + radius,
+		-(snapped.z + radius + config.casterDistance), -(snapped.z - radius));
+	glm::mat4 clipCorrection(1.0f); // glm's ortho maps depth to -1..1, vulkan clips at 0..1
+	clipCorrection[2][2] = 0.5f;
+	clipCorrection[3][2] = 0.5f;
+	cascade.viewProjection = clipCorrection * ortho * lightRotation;
+	cascade.staticVersion = UINT64_MAX; // new contents, render it
+}
+
+void ShadowCascades::update(uint32_t frame, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection, const glm::vec3& lightColor,
+	uint64_t staticVersion, const glm::vec4* dynamicCasters, uint32_t dynamicCasterCount) {
+	bool lightChanged = lightDirection != light;
+	if (lightChanged) {
+		light = lightDirection;
+		glm::vec3 up = std::abs(lightDirection.z) > 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+		lightRotation = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+	}
+
+	// the frustum out of the projection (glm::perspective): near/far like in ClusteredLighting, the tangents of the half angles from the diagonal
+	float nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	float farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+	float tanHalfY = 1.0f / std::abs(projection[1][1]);
+	float tanHalfX = 1.0f / std::abs(projection[0][0]);
+	float diagonal2 = tanHalfX * tanHalfX + tanHalfY * tanHalfY; // squared, per unit of depth
+	glm::mat4 inverseView = glm::inverse(view);
+
+	frameStats.rendered = 0;
+	frameStats.cached = 0;
+	GpuShadowParams params{};
+	float sliceNear = nearPlane;
+	for (uint32_t c = 0; c < config.cascadeCount; ++c) {
+		float sliceFar = splitDepth(c, config.cascadeCount, nearPlane, farPlane, config.splitLambda);
+		SliceSphere sphere = sliceSphere(sliceNear, sliceFar, diagonal2);
+		glm::vec3 sliceCenter = glm::vec3(inverseView * glm::vec4(0.0f, 0.0f, -sphere.centerDepth, 1.0f));
+
+		Cascade& cascade = cascades[c];
+		bool staticOnly = c >= config.cascadeCount - config.staticCascades;
+		fit(cascade, sliceCenter, sphere.radius, staticOnly, lightChanged);
+		cascade.splitDepth = sliceFar;
+		sliceNear = sliceFar;
+
+		cascade.dynamic = false;
+		for (uint32_t i = 0; i < dynamicCasterCount && !staticOnly && !cascade.dynamic; ++i)
+			cascade.dynamic = overlaps(cascade, dynamicCasters[i]);
+		cascade.render = cascade.staticVersion != staticVersion || cascade.dynamic || cascade.hadDynamic;
+		if (cascade.render) {
+			cascade.valid = true;
+			cascade.staticVersion = staticVersion;
+			cascade.hadDynamic = cascade.dynamic;
+			++frameStats.rendered;
+		} else {
+			++frameStats.cached;
+		}
+
+		params.lightViewProjection[c] = cascade.viewProjection;
+		params.splitDepths[c] = cascade.splitDepth;
+	}
+	frameStats.renderedTotal += frameStats.rendered;
+
+	params.lightDirection = glm::vec4(lightDirection, static_cast<float>(config.cascadeCount));
+	params.lightColor = glm::vec4(lightColor, 1.0f / config.resolution);
+	std::memcpy(frames[frame].params, &params, sizeof(params));
+}
+
+void ShadowCascades::beginCascade(VkCommandBuffer commandBuffer, uint32_t cascade) {
+	VkClearValue clearDepth{};
+	clearDepth.depthStencil = { 1.0f, 0 };
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = depthRenderPass;
+	renderPassInfo.framebuffer = framebuffers[cascade];
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = extent();
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearDepth;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	VkViewport viewport{};
+	viewport.width = static_cast<float>(config.resolution);
+	viewport.height = static_cast<float>(config.resolution);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	VkRect2D scissor{};
+	scissor.extent = extent();
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void ShadowCascades::endCascade(VkCommandBuffer commandBuffer) {
+	vkCmdEndRenderPass(commandBuffer);
+}
+
+std::string ShadowCascades::summary() const {
+	return std::to_string(frameStats.rendered) + "/" + std::to_string(config.cascadeCount) + " shadow cascades drawn";
+}
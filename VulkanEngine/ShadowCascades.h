@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cascaded shadow maps for a directional light. The view frustum is split into slices with the practical split scheme (a blend of uniform and
+// logarithmic splits, splitLambda), and each slice gets one layer of a depth array image, rendered from the light with an orthographic projection.
+// Each cascade is fitted around its slice's bounding sphere rather than the slice itself: the sphere doesn't change with the camera's rotation, so
+// the cascade's size is fixed, and its center is snapped to whole shadow map texels in light space. A moving camera then shifts the projection
+// by whole texels only, and the shadow edges don't crawl.
+// Caching: a cascade is only re-rendered when what it holds could have changed - its snapped projection moved, the light turned, the static
+// casters changed (the caller's staticVersion) or a dynamic caster overlaps it (this frame or when it was last rendered, to erase the old shadow).
+// The farthest staticCascades cascades never get dynamic casters (their shadows would be a few texels there anyway) and are fitted with
+// staticPadding of slack, so they only move once the camera has left that slack: with a still light and still terrain they are rendered once and
+// then kept. A mostly static scene only pays for the near cascades its moving objects are in.
+
+class ShadowCascades {
+public:
+	static const uint32_t MAX_CASCADES = 4;
+	static const uint32_t SHADOW_SET = 2; // where the lit graphics pipelines bind set(), after the camera UBO and the lighting
+
+	struct Settings {
+		uint32_t cascadeCount = 4; // up to MAX_CASCADES
+		uint32_t resolution = 2048; // per cascade
+		float splitLambda = 0.75f; // 0 uniform splits, 1 logarithmic
+		uint32_t staticCascades = 1; // the farthest ones, static casters only and cached
+		float staticPadding = 1.25f; // radius of a static cascade over its slice's, the camera can move by the difference before it's refitted
+		float casterDistance = 20.0f; // world units in front of a cascade (towards the light) that still cast into it
+	};
+
+	struct Stats {
+		uint32_t rendered = 0; // cascades rendered this frame
+		uint32_t cached = 0; // kept from an earlier frame
+		uint64_t renderedTotal = 0; // since init
+	};
+
+	// the image starts out undefined, recordInitialTransition() has to run before the first frame's render graph (which imports it as shader readable)
+	void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t framesInFlight, const Settings& settings);
+	void destroy();
+	void recordInitialTransition(VkCommandBuffer commandBuffer); // no-op after the first time
+
+	// fits the cascades to the camera and decides which ones need rendering, then writes the frame's shader parameters. the frame's previous
+	// submission has to be done. lightDirection is where the light travels, normalized. dynamicCasters are world space spheres (xyz, w radius)
+	void update(uint32_t frame, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& lightDirection, const glm::vec3& lightColor, uint64_t staticVersion,
+		const glm::vec4* dynamicCasters, uint32_t dynamicCasterCount);
+
+	// recording, as of the last update(): for every cascade that needsRender, beginCascade, draw its casters (the dynamic ones only if
+	// includesDynamic) with lightViewProjection, endCascade. outside any render pass, the image in DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+	uint32_t cascadeCount() const { return config.cascadeCount; }
+	bool needsRender(uint32_t cascade) const { return cascades[cascade].render; }
+	bool includesDynamic(uint32_t cascade) const { return cascades[cascade].dynamic; }
+	const glm::mat4& lightViewProjection(uint32_t cascade) const { return cascades[cascade].viewProjection; }
+	bool casterVisible(uint32_t cascade, const glm::vec4& sphere) const; // world space sphere inside the cascade's box or in front of it
+	void beginCascade(VkCommandBuffer commandBuffer, uint32_t cascade); // clears the layer, sets viewport and scissor
+	void endCascade(VkCommandBuffer commandBuffer);
+
+	VkRenderPass renderPass() const { return depthRenderPass; } // for the depth only pipelines
+	VkDescriptorSetLayout setLayout() const { return descriptorSetLayout; }
+	VkDescriptorSet set(uint32_t frame) const { return frames[frame].set; }
+	VkImage image() const { return depthImage; }
+	VkImageView arrayView() const { return depthArrayView; }
+	VkFormat format() const { return depthFormat; }
+	VkExtent2D extent() const { return { config.resolution, config.resolution }; }
+
+	const Stats& stats() const { return frameStats; }
+	std::string summary() const; // for the window title
+
+	// the fitting math on its own, for the tests. splitDepth is the view depth the cascade'th slice ends at (the practical split scheme above),
+	// the last one ends at farPlane
+	static float splitDepth(uint32_t cascade, uint32_t cascadeCount, float nearPlane, float farPlane, float lambda);
+	// the smallest sphere around the frustum slice between two view depths. diagonal2 is the squared tangent of the frustum's half diagonal angle
+	struct SliceSphere {
+		float centerDepth; // on the view axis
+		float radius;
+	};
+	static SliceSphere sliceSphere(float sliceNear, float sliceFar, float diagonal2);
+	// a light space position snapped down to whole texels of a cascade with the given radius (half its side) and resolution
+	static glm::vec3 snapToTexels(const glm::vec3& lightSpace, float radius, uint32_t resolution);
+
+private:
+	// mirrors ShadowParams in Shaders/shader.frag (std140)
+	struct GpuShadowParams {
+		glm::mat4 lightViewProjection[MAX_CASCADES];
+		glm::vec4 splitDepths; // view depth each cascade ends at
+		glm::vec4 lightDirection; // xyz, w the cascade count
+		glm::vec4 lightColor; // rgb, w one texel in uv
+	};
+	struct Cascade {
+		glm::vec3 fitCenter = glm::vec3(0.0f); // world space center of the slice sphere the cascade was last fitted to
+		glm::vec3 lightSpaceCenter = glm::vec3(0.0f); // snapped, in the light's rotation
+		float radius = 0.0f; // half the side of the box
+		float splitDepth = 0.0f;
+		glm::mat4 viewProjection = glm::mat4(1.0f);
+		uint64_t staticVersion = 0;
+		bool valid = false; // has been rendered
+		bool render = false; // this frame
+		bool dynamic = false; // this frame's render includes the dynamic casters
+		bool hadDynamic = false; // the image holds dynamic casters
+	};
+	struct Frame {
+		VkBuffer paramsBuffer = VK_NULL_HANDLE; // GpuShadowParams, host visible and persistently mapped
+		VkDeviceMemory paramsMemory = VK_NULL_HANDLE;
+		void* params = nullptr;
+		VkDescriptorSet set = VK_NULL_HANDLE;
+	};
+
+	void fit(Cascade& cascade, const glm::vec3& sliceCenter, float sliceRadius, bool staticOnly, bool lightChanged);
+	bool overlaps(const Cascade& cascade, const glm::vec4& sphere) const;
+	void createImage();
+	void createRenderPass();
+	void createDescriptors();
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	Settings config;
+	bool linearFiltering = false; // the depth format supports it, then the hardware compare is bilinear PCF
+	bool imageInitialized = false;
+
+	Cascade cascades[MAX_CASCADES];
+	glm::vec3 light = glm::vec3(0.0f);
+	glm::mat4 lightRotation = glm::mat4(1.0f); // world to light space, no translation
+	Stats frameStats;
+	std::vector<Frame> frames;
+
+	VkFormat depthFormat = VK_FORMAT_D16_UNORM;
+	VkImage depthImage = VK_NULL_HANDLE; // a layer per cascade
+	VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+	VkImageView depthArrayView = VK_NULL_HANDLE; // sampled
+	VkImageView layerViews[MAX_CASCADES] = {}; // rendered to
+	VkFramebuffer framebuffers[MAX_CASCADES] = {};
+	VkRenderPass depthRenderPass = VK_NULL_HANDLE;
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+};
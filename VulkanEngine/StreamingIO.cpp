@@ -0,0 +1,160 @@
+#include "StreamingIO.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+
+#ifdef _WIN32
+
+bool StreamFile::open(const std::string& path) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+	handle = file;
+	fileSize = static_cast<uint64_t>(size.QuadPart);
+	return true;
+}
+
+void StreamFile::close() {
+	if (handle != nullptr)
+		CloseHandle(static_cast<HANDLE>(handle));
+	handle = nullptr;
+	fileSize = 0;
+}
+
+bool StreamFile::isOpen() const { return handle != nullptr; }
+
+bool StreamFile::readAt(uint64_t offset, void* destination, size_t size) const {
+	unsigned char* bytes = static_cast<unsigned char*>(destination);
+	while (size > 0) {
+		OVERLAPPED overlapped{}; // on a handle opened without FILE_FLAG_OVERLAPPED this is just the position, the read is synchronous
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD chunk = static_cast<DWORD>(std::min<size_t>(size, 1u << 30));
+		DWORD read = 0;
+		if (!ReadFile(static_cast<HANDLE>(handle), bytes, chunk, &read, &overlapped) || read == 0)
+			return false;
+		bytes += read;
+		offset += read;
+		size -= read;
+	}
+	return true;
+}
+
+#else
+
+bool StreamFile::open(const std::string& path) {
+	close();
+	int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0) {
+		::close(file);
+		return false;
+	}
+#ifdef POSIX_FADV_RANDOM
+	posix_fadvise(file, 0, 0, POSIX_FADV_RANDOM); // chunks are read in camera order, not file order, readahead would mostly be wasted
+#endif
+	descriptor = file;
+	fileSize = static_cast<uint64_t>(status.st_size);
+	return true;
+}
+
+void StreamFile::close() {
+	if (descriptor >= 0)
+		::close(descriptor);
+	descriptor = -1;
+	fileSize = 0;
+}
+
+bool StreamFile::isOpen() const { return descriptor >= 0; }
+
+bool StreamFile::readAt(uint64_t offset, void* destination, size_t size) const {
+	unsigned char* bytes = static_cast<unsigned char*>(destination);
+	while (size > 0) {
+		ssize_t read = pread(descriptor, bytes, size, static_cast<off_t>(offset));
+		if (read < 0 && errno == EINTR)
+			continue;
+		if (read <= 0)
+			return false;
+		bytes += read;
+		offset += static_cast<uint64_t>(read);
+		size -= static_cast<size_t>(read);
+	}
+	return true;
+}
+
+#endif
+
+void IoThreadPool::start(uint32_t threadCount, uint32_t queueCapacity, CompletionFunction onComplete, void* context) {
+	stop();
+	capacity = queueCapacity;
+	queue.clear();
+	queue.reserve(capacity);
+	completion = onComplete;
+	completionContext = context;
+	stopping = false;
+	for (uint32_t i = 0; i < std::max(1u, threadCount); ++i)
+		threads.emplace_back(&IoThreadPool::threadMain, this);
+}
+
+void IoThreadPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		queue.clear();
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+bool IoThreadPool::submit(const Request& request) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (queue.size() >= capacity)
+			return false;
+		queue.push_back(request);
+		std::push_heap(queue.begin(), queue.end(), later);
+	}
+	wake.notify_one();
+	return true;
+}
+
+uint32_t IoThreadPool::queued() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return static_cast<uint32_t>(queue.size());
+}
+
+void IoThreadPool::threadMain() {
+	for (;;) {
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+			std::pop_heap(queue.begin(), queue.end(), later);
+			request = queue.back();
+			queue.pop_back();
+		}
+		bool success = request.file->readAt(request.offset, request.destination, request.size); // the lock isn't held while the disk works
+		completion(completionContext, request.tag, success);
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Background file reads for streaming. Reads are positional (pread, ReadFile with an OVERLAPPED offset on Windows), so any number of threads can
+// read from one open file without sharing a file pointer. The I/O threads are their own threads rather than job system workers: they spend their
+// time blocked in the kernel, and a worker stuck there would stall whatever frame work got queued behind it.
+
+class StreamFile {
+public:
+	StreamFile() = default;
+	~StreamFile() { close(); }
+	StreamFile(const StreamFile&) = delete;
+	StreamFile& operator=(const StreamFile&) = delete;
+
+	bool open(const std::string& path); // read only
+	void close();
+	bool isOpen() const;
+	uint64_t size() const { return fileSize; }
+
+	bool readAt(uint64_t offset, void* destination, size_t size) const; // all or nothing, false on a short read or an error
+
+private:
+#ifdef _WIN32
+	void* handle = nullptr; // HANDLE, kept out of the header so it doesn't pull in windows.h
+#else
+	int descriptor = -1;
+#endif
+	uint64_t fileSize = 0;
+};
+
+// a priority queue of reads served by a few I/O threads. the lowest priority value is read first (the streamer uses the distance to the camera),
+// and the queue can be reprioritized or thinned out while requests are waiting. the queue has a fixed capacity, so submitting never allocates
+class IoThreadPool {
+public:
+	struct Request {
+		uint64_t tag; // handed back on completion
+		const StreamFile* file;
+		uint64_t offset;
+		uint32_t size;
+		void* destination; // has to stay valid until the completion, or until reprioritize() drops the request
+		float priority;
+	};
+	using CompletionFunction = void (*)(void* context, uint64_t tag, bool success); // called on an I/O thread once the read is done
+
+	IoThreadPool() = default;
+	~IoThreadPool() { stop(); }
+	IoThreadPool(const IoThreadPool&) = delete;
+	IoThreadPool& operator=(const IoThreadPool&) = delete;
+
+	void start(uint32_t threadCount, uint32_t queueCapacity, CompletionFunction onComplete, void* context);
+	void stop(); // waits for the reads in progress, the ones still queued are dropped without a completion
+
+	bool submit(const Request& request); // false when the queue is full
+	uint32_t queued() const;
+
+	// priorityOf(tag) gives every waiting request its new priority, a negative one drops it (it won't complete, its destination is free again).
+	// runs under the queue lock, so it must not call back into the pool. reads already in progress aren't affected
+	template<typename PriorityFunction>
+	void reprioritize(PriorityFunction priorityOf) {
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < queue.size();) {
+			float priority = priorityOf(queue[i].tag);
+			if (priority < 0.0f) {
+				queue[i] = queue.back();
+				queue.pop_back();
+				continue;
+			}
+			queue[i++].priority = priority;
+		}
+		std::make_heap(queue.begin(), queue.end(), later);
+	}
+
+private:
+	static bool later(const Request& a, const Request& b) { return a.priority > b.priority; } // makes the heap's top the lowest value
+	void threadMain();
+
+	mutable std::mutex mutex;
+	std::condition_variable wake;
+	std::vector<Request> queue; // a heap, reserved to capacity
+	size_t capacity = 0;
+	bool stopping = false;
+	std::vector<std::thread> threads;
+	CompletionFunction completion = nullptr;
+	void* completionContext = nullptr;
+};
@@ -0,0 +1,248 @@
+#include "TemporalUpscaler.h"
+
+#include "DeletionQueue.h"
+#include "DescriptorAllocator.h"
+#include "MemoryTelemetry.h"
+
+#include <stdexcept>
+
+namespace {
+	float radicalInverse(uint32_t index, uint32_t base) {
+		float result = 0.0f;
+		float fraction = 1.0f / base;
+		while (index > 0) {
+			result += (index % base) * fraction;
+			index /= base;
+			fraction /= base;
+		}
+		return result;
+	}
+
+	const uint32_t GROUP_SIZE = 8; // both shaders run 8x8 workgroups, one thread per output pixel
+}
+
+glm::vec2 TemporalUpscaler::jitter(uint64_t frameIndex) {
+	// Halton(2, 3), starting at 1 since index 0 is the pixel's corner in both bases. well spread over the pixel for any run of consecutive frames
+	uint32_t index = static_cast<uint32_t>(frameIndex % JITTER_PHASES) + 1;
+	return glm::vec2(radicalInverse(index, 2) - 0.5f, radicalInverse(index, 3) - 0.5f);
+}
+
+void TemporalUpscaler::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DescriptorSetCache& descriptorCache, VkShaderModule resolveShader, VkShaderModule sharpenShader, const Settings& settings) {
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	this->descriptorCache = &descriptorCache;
+	config = settings;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = 0.0f;
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create temporal upscaling sampler!");
+	}
+
+	resolveSetLayout = createSetLayout(3); // scene color, velocity, read history. written history
+	sharpenSetLayout = createSetLayout(1); // written history. output
+	createComputePipeline(resolveShader, resolveSetLayout, sizeof(ResolveParams), resolvePipelineLayout, resolvePipeline);
+	createComputePipeline(sharpenShader, sharpenSetLayout, sizeof(SharpenParams), sharpenPipelineLayout, sharpenPipeline);
+}
+
+void TemporalUpscaler::destroy() {
+	vkDestroyPipeline(device, sharpenPipeline, nullptr);
+	vkDestroyPipeline(device, resolvePipeline, nullptr);
+	vkDestroyPipelineLayout(device, sharpenPipelineLayout, nullptr);
+	vkDestroyPipelineLayout(device, resolvePipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, sharpenSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(device, resolveSetLayout, nullptr);
+	vkDestroySampler(device, sampler, nullptr);
+}
+
+VkDescriptorSetLayout TemporalUpscaler::createSetLayout(uint32_t sampledCount) {
+	VkDescriptorSetLayoutBinding bindings[4]{};
+	for (uint32_t i = 0; i <= sampledCount; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i < sampledCount ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = sampledCount + 1;
+	layoutInfo.pBindings = bindings;
+	VkDescriptorSetLayout layout;
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		throw std::runtime_error("Failed to create temporal upscaling descriptor set layout!");
+	return layout;
+}
+
+void TemporalUpscaler::createComputePipeline(VkShaderModule shader, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize, VkPipelineLayout& outLayout, VkPipeline& outPipeline) {
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &outLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create temporal upscaling pipeline layout!");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = outLayout;
+	pipelineInfo.basePipelineIndex = -1;
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &outPipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create temporal upscaling pipeline!");
+	}
+}
+
+uint32_t TemporalUpscaler::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
+
+void TemporalUpscaler::createTargets(VkExtent2D outputExtent, VkImageView sceneColor, VkImageView velocity, VkImageView output) {
+	this->outputExtent = outputExtent;
+	writeIndex = 0;
+	historyValid = false;
+	imagesInitialized = false;
+
+	for (uint32_t i = 0; i < 2; ++i) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = historyFormat();
+		imageInfo.extent = { outputExtent.width, outputExtent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; // written by one frame's resolve, read by its sharpening and the next frame's resolve
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(device, &imageInfo, nullptr, &historyImages[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create temporal history image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, historyImages[i], &memRequirements);
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		if (allocateDeviceMemory(device, allocInfo, MemoryCategory::Images, historyMemory[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate temporal history memory!");
+		}
+		vkBindImageMemory(device, historyImages[i], historyMemory[i], 0);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = historyImages[i];
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = historyFormat();
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &historyViews[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create temporal history image view!");
+		}
+	}
+
+	// the sets never change: one pair per ping-pong direction, indexed by the history that gets written. every one of them binds a history view,
+	// so destroyTargets() forgetting those retires them all
+	for (uint32_t written = 0; written < 2; ++written) {
+		DescriptorBinding resolveBindings[4] = {
+			DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sceneColor, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, velocity, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			DescriptorBinding::image(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, historyViews[written ^ 1], sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			DescriptorBinding::image(3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, historyViews[written], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL),
+		};
+		DescriptorBinding sharpenBindings[2] = {
+			DescriptorBinding::image(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, historyViews[written], sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+			DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, output, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL),
+		};
+		resolveSets[written] = descriptorCache->get(resolveSetLayout, resolveBindings, 4);
+		sharpenSets[written] = descriptorCache->get(sharpenSetLayout, sharpenBindings, 2);
+	}
+}
+
+void TemporalUpscaler::destroyTargets(DeletionQueue& deletionQueue) {
+	if (!hasTargets())
+		return;
+	for (uint32_t i = 0; i < 2; ++i) {
+		descriptorCache->forget(historyViews[i]); // reused for the next swap chain's once the previous frames are done with them
+		deletionQueue.destroyImageView(historyViews[i]);
+		deletionQueue.destroyImage(historyImages[i]);
+		deletionQueue.freeMemory(historyMemory[i]);
+		historyViews[i] = VK_NULL_HANDLE;
+		historyImages[i] = VK_NULL_HANDLE;
+		historyMemory[i] = VK_NULL_HANDLE;
+	}
+}
+
+void TemporalUpscaler::recordInitialTransition(VkCommandBuffer commandBuffer) {
+	if (imagesInitialized)
+		return;
+	imagesInitialized = true;
+
+	// the contents don't matter, the first resolve ignores the history (historyValid)
+	VkImageMemoryBarrier2 barriers[2]{};
+	for (uint32_t i = 0; i < 2; ++i) {
+		barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+		barriers[i].srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+		barriers[i].srcAccessMask = VK_ACCESS_2_NONE;
+		barriers[i].dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+		barriers[i].dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		barriers[i].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[i].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barriers[i].image = historyImages[i];
+		barriers[i].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	}
+	VkDependencyInfo dependencyInfo{};
+	dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependencyInfo.imageMemoryBarrierCount = 2;
+	dependencyInfo.pImageMemoryBarriers = barriers;
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void TemporalUpscaler::recordResolve(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, glm::vec2 jitterPixels) {
+	ResolveParams params{};
+	params.jitter = jitterPixels;
+	params.renderSize = glm::vec2(static_cast<float>(renderExtent.width), static_cast<float>(renderExtent.height));
+	params.outputSize = glm::vec2(static_cast<float>(outputExtent.width), static_cast<float>(outputExtent.height));
+	params.historyWeight = config.historyWeight;
+	params.historyValid = historyValid ? 1 : 0;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolvePipelineLayout, 0, 1, &resolveSets[writeIndex], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, resolvePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(commandBuffer, (outputExtent.width + GROUP_SIZE - 1) / GROUP_SIZE, (outputExtent.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+	historyValid = true; // next frame reads what this one writes
+}
+
+void TemporalUpscaler::recordSharpen(VkCommandBuffer commandBuffer) {
+	SharpenParams params{};
+	params.outputSize = glm::vec2(static_cast<float>(outputExtent.width), static_cast<float>(outputExtent.height));
+	params.sharpness = config.sharpness;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sharpenPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, sharpenPipelineLayout, 0, 1, &sharpenSets[writeIndex], 0, nullptr);
+	vkCmdPushConstants(commandBuffer, sharpenPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+	vkCmdDispatch(commandBuffer, (outputExtent.width + GROUP_SIZE - 1) / GROUP_SIZE, (outputExtent.height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
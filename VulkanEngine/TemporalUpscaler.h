@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+class DeletionQueue;
+class DescriptorSetCache;
+
+// Temporal upscaling and anti-aliasing. The scene is rendered below the output resolution with the projection shifted by a different sub-pixel
+// offset every frame (jitter(), a Halton sequence), and the main pass writes a motion vector per pixel next to the color. Two compute passes run
+// after it, at the output resolution:
+//  recordResolve() - Shaders/taa_resolve.comp reprojects the accumulated history with the motion vectors and blends this frame's samples into it.
+//                    history that doesn't match what's on screen now (disocclusion, lighting changes) is clipped to the color range of the
+//                    current pixel's neighborhood, and history that moved in from off screen is dropped
+//  recordSharpen() - Shaders/sharpen.comp, contrast adaptive sharpening of the result, against the softening the resampling and blending cause
+// Over the jitter cycle every output pixel sees samples from all over its area, so the accumulated image has close to the output resolution's
+// detail while only a fraction of the pixels are shaded every frame.
+// The two history images are ping-ponged: each frame reads the one written last frame and writes the other. Both are left shader readable
+// between frames, so the render graph can import them with the same state whichever one they are this frame.
+// The pipelines live as long as the upscaler (init/destroy), the images are sized for the swap chain and recreated with it (createTargets/
+// destroyTargets). Their descriptor sets come from the DescriptorSetCache, which reuses the old ones for the new images.
+
+class TemporalUpscaler {
+public:
+	static const uint32_t JITTER_PHASES = 8; // the sequence repeats after this many frames
+
+	struct Settings {
+		float historyWeight = 0.9f; // share of a pixel that comes from the history when it's trusted, higher is smoother but slower to converge
+		float sharpness = 0.5f; // 0..1
+	};
+
+	// sub-pixel offset of frame frameIndex, in render pixels (-0.5..0.5). the same for every frame with the same frameIndex % JITTER_PHASES
+	static glm::vec2 jitter(uint64_t frameIndex);
+
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, DescriptorSetCache& descriptorCache, VkShaderModule resolveShader, VkShaderModule sharpenShader, const Settings& settings);
+	void destroy(); // destroyTargets() first
+
+	// outputExtent is the swap chain's. sceneColor and velocity are what the main pass renders, at least renderExtent large (only that part is read),
+	// output what the sharpening writes (R16G16B16A16_SFLOAT storage, outputExtent). the history starts out empty
+	void createTargets(VkExtent2D outputExtent, VkImageView sceneColor, VkImageView velocity, VkImageView output);
+	void destroyTargets(DeletionQueue& deletionQueue); // the previous frames may still be using them. no-op without targets
+	bool hasTargets() const { return historyImages[0] != VK_NULL_HANDLE; }
+	void recordInitialTransition(VkCommandBuffer commandBuffer); // once after createTargets(), before the first render graph that imports the histories
+
+	// call once per frame before importing the histories: the one written last frame becomes the one read
+	void nextFrame() { writeIndex ^= 1; }
+	VkImage historyImage(bool written) const { return historyImages[written ? writeIndex : writeIndex ^ 1]; }
+	VkImageView historyView(bool written) const { return historyViews[written ? writeIndex : writeIndex ^ 1]; }
+	static VkFormat historyFormat() { return VK_FORMAT_R16G16B16A16_SFLOAT; }
+
+	// recording, outside any render pass. the resolve reads the scene color, velocity and the read history (sampled) and writes the written history
+	// (storage). the sharpening reads the written history (sampled) and writes the output (storage). jitterPixels is the frame's jitter()
+	void recordResolve(VkCommandBuffer commandBuffer, VkExtent2D renderExtent, glm::vec2 jitterPixels);
+	void recordSharpen(VkCommandBuffer commandBuffer);
+
+	Settings& settings() { return config; }
+
+private:
+	// mirror the push constants of Shaders/taa_resolve.comp and Shaders/sharpen.comp
+	struct ResolveParams {
+		glm::vec2 jitter;
+		glm::vec2 renderSize;
+		glm::vec2 outputSize;
+		float historyWeight;
+		uint32_t historyValid;
+	};
+	struct SharpenParams {
+		glm::vec2 outputSize;
+		float sharpness;
+	};
+
+	void createComputePipeline(VkShaderModule shader, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize, VkPipelineLayout& outLayout, VkPipeline& outPipeline);
+	VkDescriptorSetLayout createSetLayout(uint32_t sampledCount); // sampledCount combined image samplers, then a storage image
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	DescriptorSetCache* descriptorCache = nullptr;
+	Settings config;
+	VkSampler sampler = VK_NULL_HANDLE; // bilinear, clamped to the edge
+	VkDescriptorSetLayout resolveSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout sharpenSetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout resolvePipelineLayout = VK_NULL_HANDLE;
+	VkPipelineLayout sharpenPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline resolvePipeline = VK_NULL_HANDLE;
+	VkPipeline sharpenPipeline = VK_NULL_HANDLE;
+
+	// per swap chain
+	VkExtent2D outputExtent = { 0, 0 };
+	VkImage historyImages[2] = {};
+	VkDeviceMemory historyMemory[2] = {};
+	VkImageView historyViews[2] = {};
+	VkDescriptorSet resolveSets[2] = {}; // by the history written
+	VkDescriptorSet sharpenSets[2] = {};
+	uint32_t writeIndex = 0;
+	bool historyValid = false; // the read history holds a resolved frame
+	bool imagesInitialized = false;
+};
@@ -0,0 +1,378 @@
+#include "VirtualFileSystem.h"
+
+#include "JobSystem.h"
+#include "Lz4.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const uint32_t ARCHIVE_VERSION = 1;
+
+std::vector<char> readWholeFile(const std::string& path, bool& outOpened) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	outOpened = file.is_open();
+	if (!outOpened)
+		return {};
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(fileSize);
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+	return buffer;
+}
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+} // namespace
+
+std::vector<ArchiveSource> collectArchiveSources(const std::string& root, const std::vector<std::string>& paths) {
+	namespace fs = std::filesystem;
+	std::vector<ArchiveSource> sources;
+	auto add = [&](const fs::path& file) {
+		sources.push_back({ fs::relative(file, root).generic_string(), file.string() });
+	};
+	for (const std::string& path : paths) {
+		fs::path full = fs::path(root) / path;
+		if (fs::is_directory(full)) {
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(full))
+				if (entry.is_regular_file())
+					add(entry.path());
+		} else if (fs::is_regular_file(full)) {
+			add(full);
+		} else {
+			throw std::runtime_error("Nothing to pack at " + full.string() + "!");
+		}
+	}
+	return sources;
+}
+
+void writeArchive(const std::string& archivePath, const std::vector<ArchiveSource>& sources, bool compress) {
+	std::vector<ArchiveSource> sorted = sources;
+	std::sort(sorted.begin(), sorted.end(), [](const ArchiveSource& a, const ArchiveSource& b) { return a.name < b.name; }); // the lookup binary searches
+	for (size_t i = 1; i < sorted.size(); ++i)
+		if (sorted[i].name == sorted[i - 1].name)
+			throw std::runtime_error("Archive has two files named " + sorted[i].name + "!");
+
+	ArchiveHeader header{};
+	std::memcpy(header.magic, "VPAK", 4);
+	header.version = ARCHIVE_VERSION;
+	header.entryCount = static_cast<uint32_t>(sorted.size());
+	std::string names;
+	std::vector<ArchiveEntry> entries(sorted.size());
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		entries[i].nameOffset = static_cast<uint32_t>(names.size());
+		entries[i].nameLength = static_cast<uint32_t>(sorted[i].name.size());
+		names += sorted[i].name;
+	}
+	header.namesSize = static_cast<uint32_t>(names.size());
+
+	std::vector<std::vector<unsigned char>> payloads(sorted.size());
+	uint64_t offset = alignUp(sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry) + names.size(), ARCHIVE_ALIGNMENT);
+	for (size_t i = 0; i < sorted.size(); ++i) {
+		bool opened;
+		std::vector<char> contents = readWholeFile(sorted[i].path, opened);
+		if (!opened)
+			throw std::runtime_error("Failed to read " + sorted[i].path + "!");
+		if (contents.size() > ARCHIVE_MAX_FILE_SIZE)
+			throw std::runtime_error(sorted[i].path + " is too big for an archive!");
+		const unsigned char* source = reinterpret_cast<const unsigned char*>(contents.data());
+		std::vector<unsigned char>& payload = payloads[i];
+		ArchiveEntry& entry = entries[i];
+		entry.size = contents.size();
+		entry.compression = ARCHIVE_STORED;
+
+		if (compress && !contents.empty()) {
+			uint32_t blockCount = static_cast<uint32_t>((contents.size() + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE);
+			std::vector<unsigned char> block(lz4CompressBound(ARCHIVE_BLOCK_SIZE));
+			payload.resize(blockCount * sizeof(uint32_t));
+			for (uint32_t b = 0; b < blockCount; ++b) {
+				size_t begin = static_cast<size_t>(b) * ARCHIVE_BLOCK_SIZE;
+				size_t length = std::min<size_t>(ARCHIVE_BLOCK_SIZE, contents.size() - begin);
+				size_t compressed = lz4Compress(source + begin, length, block.data(), block.size());
+				uint32_t storedSize = static_cast<uint32_t>(compressed);
+				const unsigned char* data = block.data();
+				if (compressed == 0 || compressed >= length) { // keep it as is, copying beats decompressing
+					storedSize = static_cast<uint32_t>(length) | ARCHIVE_BLOCK_STORED;
+					compressed = length;
+					data = source + begin;
+				}
+				std::memcpy(payload.data() + b * sizeof(uint32_t), &storedSize, sizeof(storedSize));
+				payload.insert(payload.end(), data, data + compressed);
+			}
+			if (payload.size() < contents.size()) {
+				entry.compression = ARCHIVE_LZ4;
+				entry.blockCount = blockCount;
+			}
+		}
+		if (entry.compression == ARCHIVE_STORED)
+			payload.assign(source, source + contents.size());
+		entry.storedSize = payload.size();
+		entry.dataOffset = offset;
+		offset = alignUp(offset + payload.size(), ARCHIVE_ALIGNMENT);
+	}
+
+	std::ofstream out(archivePath, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error("Failed to create " + archivePath + "!");
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+	out.write(names.data(), names.size());
+	uint64_t written = sizeof(header) + entries.size() * sizeof(ArchiveEntry) + names.size();
+	const std::vector<char> zeros(ARCHIVE_ALIGNMENT, 0);
+	for (size_t i = 0; i < entries.size(); ++i) {
+		out.write(zeros.data(), static_cast<std::streamsize>(entries[i].dataOffset - written));
+		out.write(reinterpret_cast<const char*>(payloads[i].data()), payloads[i].size());
+		written = entries[i].dataOffset + payloads[i].size();
+	}
+	if (!out)
+		throw std::runtime_error("Failed to write " + archivePath + "!");
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	HANDLE mapping = nullptr;
+	const void* view = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping != nullptr)
+		view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	mappingHandle = mapping;
+	bytes = static_cast<const unsigned char*>(view);
+	byteCount = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes != nullptr)
+		UnmapViewOfFile(bytes);
+	if (mappingHandle != nullptr)
+		CloseHandle(static_cast<HANDLE>(mappingHandle));
+	if (fileHandle != nullptr)
+		CloseHandle(static_cast<HANDLE>(fileHandle));
+	bytes = nullptr;
+	byteCount = 0;
+	fileHandle = mappingHandle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+	int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return false;
+	struct stat status;
+	void* view = MAP_FAILED;
+	if (fstat(file, &status) == 0 && status.st_size > 0)
+		view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // the mapping keeps the file alive
+	if (view == MAP_FAILED)
+		return false;
+	bytes = static_cast<const unsigned char*>(view);
+	byteCount = static_cast<size_t>(status.st_size);
+	return true;
+}
+
+void MappedFile::close() {
+	if (bytes != nullptr)
+		munmap(const_cast<unsigned char*>(bytes), byteCount);
+	bytes = nullptr;
+	byteCount = 0;
+}
+
+#endif
+
+bool VirtualFileSystem::mountArchive(const std::string& path) {
+	unmount();
+	if (!archive.open(path))
+		return false;
+
+	// everything the lookups rely on is checked once here: the table, the names and that every entry's data is inside the file, after the table.
+	// the decompressed sizes are what readFile() allocates, so they're capped, and an LZ4 entry can't claim more than its blocks can decode to
+	auto invalid = [this, &path]() {
+		unmount();
+		return std::runtime_error("Invalid archive " + path + "!");
+	};
+	ArchiveHeader header;
+	if (archive.size() < sizeof(header))
+		throw invalid();
+	std::memcpy(&header, archive.data(), sizeof(header));
+	uint64_t tableEnd = sizeof(header) + uint64_t(header.entryCount) * sizeof(ArchiveEntry) + header.namesSize;
+	if (std::memcmp(header.magic, "VPAK", 4) != 0 || header.version != ARCHIVE_VERSION || tableEnd > archive.size())
+		throw invalid();
+	const ArchiveEntry* table = reinterpret_cast<const ArchiveEntry*>(archive.data() + sizeof(header)); // 16 bytes in, aligned for the 8 byte fields
+	const char* strings = reinterpret_cast<const char*>(table + header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; ++i) {
+		const ArchiveEntry& entry = table[i];
+		bool valid = uint64_t(entry.nameOffset) + entry.nameLength <= header.namesSize && entry.dataOffset % ARCHIVE_ALIGNMENT == 0 &&
+			entry.dataOffset >= tableEnd && entry.dataOffset <= archive.size() && entry.storedSize <= archive.size() - entry.dataOffset &&
+			entry.size <= ARCHIVE_MAX_FILE_SIZE &&
+			(entry.compression == ARCHIVE_STORED ? entry.storedSize == entry.size : entry.compression == ARCHIVE_LZ4 &&
+				entry.blockCount == (entry.size + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE && uint64_t(entry.blockCount) * sizeof(uint32_t) <= entry.storedSize &&
+				entry.size <= (entry.storedSize - uint64_t(entry.blockCount) * sizeof(uint32_t)) * LZ4_MAX_RATIO);
+		if (valid && i > 0) { // sorted, or the binary search misses things
+			std::string_view previous(strings + table[i - 1].nameOffset, table[i - 1].nameLength);
+			valid = previous < std::string_view(strings + entry.nameOffset, entry.nameLength);
+		}
+		if (!valid)
+			throw invalid();
+	}
+
+	entries = table;
+	entryCount = header.entryCount;
+	names = strings;
+	return true;
+}
+
+void VirtualFileSystem::unmount() {
+	archive.close();
+	entries = nullptr;
+	entryCount = 0;
+	names = nullptr;
+}
+
+std::string VirtualFileSystem::normalize(const std::string& path) {
+	std::string normalized = path;
+	std::replace(normalized.begin(), normalized.end(), '\\', '/');
+	while (normalized.compare(0, 2, "./") == 0)
+		normalized.erase(0, 2);
+	return normalized;
+}
+
+const ArchiveEntry* VirtualFileSystem::find(std::string_view name) const {
+	const ArchiveEntry* end = entries + entryCount;
+	const ArchiveEntry* it = std::lower_bound(entries, end, name, [this](const ArchiveEntry& entry, std::string_view key) { return entryName(entry) < key; });
+	return it != end && entryName(*it) == name ? it : nullptr;
+}
+
+const ArchiveEntry* VirtualFileSystem::archived(const std::string& path) const {
+	if (entryCount == 0)
+		return nullptr;
+	if (looseFirst && std::filesystem::is_regular_file(path))
+		return nullptr;
+	return find(normalize(path));
+}
+
+bool VirtualFileSystem::exists(const std::string& path) const {
+	return archived(path) != nullptr || std::filesystem::is_regular_file(path);
+}
+
+std::vector<char> VirtualFileSystem::readLooseFile(const std::string& path) {
+	bool opened;
+	std::vector<char> contents = readWholeFile(path, opened);
+	if (!opened)
+		throw std::runtime_error("failed to open file!");
+	return contents;
+}
+
+bool VirtualFileSystem::decompress(const ArchiveEntry& entry, char* destination, JobSystem* jobSystem) const {
+	const unsigned char* data = archive.data() + entry.dataOffset;
+	if (entry.size == 0)
+		return true;
+	if (entry.compression == ARCHIVE_STORED) {
+		std::memcpy(destination, data, static_cast<size_t>(entry.size));
+		return true;
+	}
+
+	// the block table gives every block's start, so the blocks don't depend on each other. the table was bounds checked at mount, not the sizes in it
+	const uint32_t blockCount = entry.blockCount;
+	std::vector<uint64_t> starts(blockCount + 1);
+	starts[0] = uint64_t(blockCount) * sizeof(uint32_t);
+	for (uint32_t b = 0; b < blockCount; ++b) {
+		uint32_t storedSize;
+		std::memcpy(&storedSize, data + b * sizeof(uint32_t), sizeof(storedSize));
+		starts[b + 1] = starts[b] + (storedSize & ~ARCHIVE_BLOCK_STORED);
+		if (starts[b + 1] > entry.storedSize)
+			return false;
+	}
+
+	std::atomic<bool> failed{ false };
+	auto decodeBlocks = [&](uint32_t begin, uint32_t end) {
+		for (uint32_t b = begin; b < end; ++b) {
+			uint32_t storedSize;
+			std::memcpy(&storedSize, data + b * sizeof(uint32_t), sizeof(storedSize));
+			size_t offset = static_cast<size_t>(b) * ARCHIVE_BLOCK_SIZE;
+			size_t length = std::min<size_t>(ARCHIVE_BLOCK_SIZE, static_cast<size_t>(entry.size) - offset);
+			const unsigned char* source = data + starts[b];
+			unsigned char* target = reinterpret_cast<unsigned char*>(destination) + offset;
+			bool ok = (storedSize & ARCHIVE_BLOCK_STORED) != 0
+				? (storedSize & ~ARCHIVE_BLOCK_STORED) == length && (std::memcpy(target, source, length), true)
+				: lz4Decompress(source, static_cast<size_t>(starts[b + 1] - starts[b]), target, length);
+			if (!ok)
+				failed.store(true, std::memory_order_relaxed);
+		}
+	};
+	if (jobSystem != nullptr)
+		jobSystem->parallelFor(blockCount, 4, decodeBlocks); // 256KB of output per job
+	else
+		decodeBlocks(0, blockCount);
+	return !failed.load(std::memory_order_relaxed);
+}
+
+std::vector<char> VirtualFileSystem::readFile(const std::string& path, JobSystem* jobSystem) const {
+	const ArchiveEntry* entry = archived(path);
+	if (entry == nullptr)
+		return readLooseFile(path);
+	std::vector<char> contents(static_cast<size_t>(entry->size));
+	if (!decompress(*entry, contents.data(), jobSystem))
+		throw std::runtime_error("Corrupt archive entry " + path + "!");
+	return contents;
+}
+
+std::vector<std::vector<char>> VirtualFileSystem::readFiles(const std::vector<std::string>& paths, JobSystem& jobSystem) const {
+	std::vector<std::vector<char>> contents(paths.size());
+	std::vector<const ArchiveEntry*> found(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i) { // loose files and sizing on this thread, only the decompression is spread out
+		found[i] = archived(paths[i]);
+		if (found[i] == nullptr)
+			contents[i] = readLooseFile(paths[i]);
+		else
+			contents[i].resize(static_cast<size_t>(found[i]->size));
+	}
+	std::atomic<bool> failed{ false };
+	jobSystem.parallelFor(static_cast<uint32_t>(paths.size()), 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			if (found[i] != nullptr && !decompress(*found[i], contents[i].data(), nullptr))
+				failed.store(true, std::memory_order_relaxed);
+	});
+	if (failed.load(std::memory_order_relaxed))
+		throw std::runtime_error("Corrupt archive entry!");
+	return contents;
+}
+
+const void* VirtualFileSystem::mappedFile(const std::string& path, size_t& outSize) const {
+	const ArchiveEntry* entry = archived(path);
+	if (entry == nullptr || entry->compression != ARCHIVE_STORED)
+		return nullptr;
+	outSize = static_cast<size_t>(entry->size);
+	return archive.data() + entry->dataOffset;
+}
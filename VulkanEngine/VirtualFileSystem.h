@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class JobSystem;
+
+// Asset files by path ("Shaders/vert.spv"), out of a packed archive when one is mounted and from loose files otherwise. Mounting an archive is
+// one open and one mmap, every file after that is a lookup in memory, so startup no longer opens a file per asset.
+// Archive layout (.vpak, written by writeArchive):
+//   ArchiveHeader | ArchiveEntry[entryCount], sorted by name | name strings | padding | entry data, each entry at a 64KB aligned offset
+// The table of contents is binary searched in place. Entries start on 64KB boundaries, the mapping granularity everywhere (Windows' allocation
+// granularity, a multiple of the page size elsewhere), so an entry can be mapped on its own, and stored entries are read straight out of the
+// mapping. Compressed entries are split into independent ARCHIVE_BLOCK_SIZE LZ4 blocks, which the job system decompresses in parallel.
+
+struct ArchiveHeader {
+	char magic[4]; // "VPAK"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t namesSize; // bytes of name strings after the entries
+};
+
+struct ArchiveEntry {
+	uint32_t nameOffset; // into the name strings, not null terminated
+	uint32_t nameLength;
+	uint64_t dataOffset; // from the start of the archive, 64KB aligned
+	uint64_t storedSize; // bytes in the archive
+	uint64_t size; // bytes once decompressed
+	uint32_t compression; // ArchiveCompression
+	uint32_t blockCount; // LZ4 only: the data starts with a uint32 stored size per block, then the blocks
+};
+
+enum ArchiveCompression : uint32_t { ARCHIVE_STORED = 0, ARCHIVE_LZ4 = 1 };
+
+const uint64_t ARCHIVE_ALIGNMENT = 64 * 1024;
+const uint32_t ARCHIVE_BLOCK_SIZE = 64 * 1024; // uncompressed bytes per LZ4 block, the last one can be shorter
+const uint32_t ARCHIVE_BLOCK_STORED = 0x80000000u; // set on a block's stored size when it didn't compress and is kept as is
+const uint64_t ARCHIVE_MAX_FILE_SIZE = uint64_t(1) << 30; // per entry, decompressed. writeArchive refuses bigger files, mounting rejects bigger entries
+const uint64_t LZ4_MAX_RATIO = 255; // an LZ4 block never decodes to more than this many bytes per stored byte (a length byte adds at most 255)
+
+struct ArchiveSource {
+	std::string name; // path inside the archive, '/' separated
+	std::string path; // the file on disk
+};
+
+// every file under the given files/directories (relative to root), named by their path relative to root
+std::vector<ArchiveSource> collectArchiveSources(const std::string& root, const std::vector<std::string>& paths);
+// entries that don't get smaller are stored. throws if a source can't be read, is bigger than ARCHIVE_MAX_FILE_SIZE or the archive can't be written
+void writeArchive(const std::string& archivePath, const std::vector<ArchiveSource>& sources, bool compress = true);
+
+// read only memory mapping of a whole file
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return byteCount; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t byteCount = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
+
+class VirtualFileSystem {
+public:
+	// false if there is no such file, throws if it isn't a valid archive: the table and every entry's data have to be inside the file, and the
+	// decompressed sizes have to be possible for the stored ones (and within ARCHIVE_MAX_FILE_SIZE). replaces a previously mounted archive
+	bool mountArchive(const std::string& path);
+	void unmount();
+	size_t archivedFileCount() const { return entryCount; }
+
+	// development: a loose file on disk wins over the archive's copy, so eg a recompiled shader shows up without repacking
+	void setLooseFilesFirst(bool enable) { looseFirst = enable; }
+
+	bool exists(const std::string& path) const;
+	// throws if the file is neither archived nor on disk, or if its archived data is corrupt. with a job system a compressed entry's blocks
+	// are decompressed in parallel, the calling thread has to be one of its workers (eg the one that created it)
+	std::vector<char> readFile(const std::string& path, JobSystem* jobSystem = nullptr) const;
+	// several files at once, the files spread over the job system's workers
+	std::vector<std::vector<char>> readFiles(const std::vector<std::string>& paths, JobSystem& jobSystem) const;
+	// zero copy view of a stored archived file, valid while the archive is mounted. nullptr if it's compressed, loose or unknown
+	const void* mappedFile(const std::string& path, size_t& outSize) const;
+
+private:
+	static std::string normalize(const std::string& path); // '/' separators, no leading "./"
+	const ArchiveEntry* find(std::string_view name) const;
+	std::string_view entryName(const ArchiveEntry& entry) const { return std::string_view(names + entry.nameOffset, entry.nameLength); }
+	const ArchiveEntry* archived(const std::string& path) const; // the entry to read it from, or nullptr for a loose read
+	bool decompress(const ArchiveEntry& entry, char* destination, JobSystem* jobSystem) const;
+	static std::vector<char> readLooseFile(const std::string& path);
+
+	MappedFile archive;
+	const ArchiveEntry* entries = nullptr;
+	uint32_t entryCount = 0;
+	const char* names = nullptr;
+	bool looseFirst = false;
+};
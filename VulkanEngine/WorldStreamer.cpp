@@ -0,0 +1,532 @@
+#include "WorldStreamer.h"
+
+#include "MemoryTelemetry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const uint32_t WORLD_FILE_VERSION = 1;
+const float WORLD_HEIGHT_SCALE = 3.0f;
+
+// lattice value noise, smoothstepped between the corners
+float latticeValue(int32_t x, int32_t y, uint32_t seed) {
+	uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return (h & 0xFFFFFFu) / float(0xFFFFFF);
+}
+
+float valueNoise(float x, float y, uint32_t seed) {
+	float fx = std::floor(x), fy = std::floor(y);
+	int32_t ix = static_cast<int32_t>(fx), iy = static_cast<int32_t>(fy);
+	float tx = x - fx, ty = y - fy;
+	tx = tx * tx * (3.0f - 2.0f * tx);
+	ty = ty * ty * (3.0f - 2.0f * ty);
+	float a = latticeValue(ix, iy, seed), b = latticeValue(ix + 1, iy, seed);
+	float c = latticeValue(ix, iy + 1, seed), d = latticeValue(ix + 1, iy + 1, seed);
+	return (a + (b - a) * tx) + ((c + (d - c) * tx) - (a + (b - a) * tx)) * ty;
+}
+
+float terrainHeight(float x, float y, uint32_t seed) { // 0..1
+	float height = 0.0f, amplitude = 0.5f, frequency = 0.15f;
+	for (uint32_t octave = 0; octave < 5; ++octave) {
+		height += amplitude * valueNoise(x * frequency, y * frequency, seed + octave);
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return std::min(1.0f, std::max(0.0f, height / 0.97f));
+}
+
+uint16_t terrainColor(float height) { // RGB565 by height band: water, sand, grass, rock, snow
+	float r, g, b;
+	if (height < 0.38f) { r = 0.10f; g = 0.25f; b = 0.55f; }
+	else if (height < 0.42f) { r = 0.76f; g = 0.70f; b = 0.50f; }
+	else if (height < 0.62f) { r = 0.20f; g = 0.50f; b = 0.18f; }
+	else if (height < 0.78f) { r = 0.45f; g = 0.40f; b = 0.36f; }
+	else { r = 0.92f; g = 0.92f; b = 0.95f; }
+	return static_cast<uint16_t>(static_cast<uint32_t>(r * 31.0f + 0.5f) << 11 | static_cast<uint32_t>(g * 63.0f + 0.5f) << 5 | static_cast<uint32_t>(b * 31.0f + 0.5f));
+}
+
+} // namespace
+
+VkVertexInputBindingDescription ChunkVertex::getBindingDescription() {
+	VkVertexInputBindingDescription bindingDescription{};
+	bindingDescription.binding = 0;
+	bindingDescription.stride = sizeof(ChunkVertex);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 2> ChunkVertex::getAttributeDescriptions() {
+	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+	attributeDescriptions[0].binding = 0;
+	attributeDescriptions[0].location = 0;
+	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[0].offset = offsetof(ChunkVertex, position);
+
+	attributeDescriptions[1].binding = 0;
+	attributeDescriptions[1].location = 1;
+	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+	attributeDescriptions[1].offset = offsetof(ChunkVertex, color);
+	return attributeDescriptions;
+}
+
+void writeProceduralWorld(const std::string& path, uint32_t chunksX, uint32_t chunksY, uint32_t seed) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out)
+		throw std::runtime_error("Failed to create world file!");
+
+	const uint32_t side = WorldStreamer::VERTICES_PER_SIDE;
+	WorldFileHeader header{};
+	std::memcpy(header.magic, "WRLD", 4);
+	header.version = WORLD_FILE_VERSION;
+	header.chunksX = chunksX;
+	header.chunksY = chunksY;
+	header.verticesPerSide = side;
+	header.chunkSize = 1.0f;
+	header.heightScale = WORLD_HEIGHT_SCALE;
+
+	std::vector<WorldFileChunk> table(static_cast<size_t>(chunksX) * chunksY);
+	uint64_t offset = sizeof(WorldFileHeader) + table.size() * sizeof(WorldFileChunk);
+	for (WorldFileChunk& entry : table) {
+		entry.offset = offset;
+		entry.size = WorldStreamer::CHUNK_PAYLOAD_SIZE;
+		offset += entry.size;
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(WorldFileChunk));
+
+	std::vector<uint16_t> payload(side * side * 2);
+	const float spacing = header.chunkSize / (side - 1);
+	for (uint32_t cy = 0; cy < chunksY; ++cy) {
+		for (uint32_t cx = 0; cx < chunksX; ++cx) {
+			for (uint32_t y = 0; y < side; ++y) {
+				for (uint32_t x = 0; x < side; ++x) {
+					float height = terrainHeight(cx * header.chunkSize + x * spacing, cy * header.chunkSize + y * spacing, seed); // world position, so edges match
+					payload[(y * side + x) * 2] = static_cast<uint16_t>(height * 65535.0f + 0.5f);
+					payload[(y * side + x) * 2 + 1] = terrainColor(height);
+				}
+			}
+			out.write(reinterpret_cast<const char*>(payload.data()), payload.size() * sizeof(uint16_t));
+		}
+	}
+	if (!out)
+		throw std::runtime_error("Failed to write world file!");
+}
+
+void WorldStreamer::init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, JobSystem& jobSystem, const std::string& worldPath,
+	uint32_t framesInFlight, const UploadFunction& upload, const Settings& settings) {
+	this->device = device;
+	this->memoryProperties = memoryProperties;
+	jobs = &jobSystem;
+	config = settings;
+
+	if (!file.open(worldPath)) {
+		std::cout << "no " << worldPath << ", generating a procedural world" << std::endl;
+		writeProceduralWorld(worldPath, 32, 32, 1337);
+		if (!file.open(worldPath))
+			throw std::runtime_error("Failed to open world file!");
+	}
+	// the header and the table are small and needed before anything else, so they're read right here. init runs before the first frame
+	if (!file.readAt(0, &header, sizeof(header)) || std::memcmp(header.magic, "WRLD", 4) != 0 || header.version != WORLD_FILE_VERSION)
+		throw std::runtime_error("Invalid world file!");
+	if (header.verticesPerSide != VERTICES_PER_SIDE || header.chunksX == 0 || header.chunksY == 0)
+		throw std::runtime_error("World file chunk layout isn't supported!");
+
+	chunkCount = header.chunksX * header.chunksY;
+	std::vector<WorldFileChunk> table(chunkCount);
+	if (!file.readAt(sizeof(header), table.data(), table.size() * sizeof(WorldFileChunk)))
+		throw std::runtime_error("Failed to read world chunk table!");
+	chunks = std::make_unique<Chunk[]>(chunkCount);
+	worldOrigin = -0.5f * glm::vec2(header.chunksX, header.chunksY) * header.chunkSize;
+	for (uint32_t i = 0; i < chunkCount; ++i) {
+		if (table[i].size != CHUNK_PAYLOAD_SIZE || table[i].offset + table[i].size > file.size())
+			throw std::runtime_error("Invalid world chunk table!");
+		chunks[i].fileOffset = table[i].offset;
+		chunks[i].fileSize = table[i].size;
+		chunks[i].center = worldOrigin + (glm::vec2(i % header.chunksX, i / header.chunksX) + 0.5f) * header.chunkSize;
+	}
+
+	cpuPool = std::make_unique<PoolAllocator<ChunkData>>(config.cpuChunkSlots);
+	uint32_t span = 2 * static_cast<uint32_t>(std::ceil(config.loadRadius / header.chunkSize)) + 2;
+	inFlight.reserve(config.cpuChunkSlots);
+	cancelled.reserve(config.cpuChunkSlots);
+	candidates.reserve(std::max<size_t>(span * span, config.cpuChunkSlots));
+	slotOwner.assign(config.gpuChunkSlots, -1);
+	freeSlots.reserve(config.gpuChunkSlots);
+	for (uint32_t slot = config.gpuChunkSlots; slot-- > 0;)
+		freeSlots.push_back(slot); // handed out lowest first
+	resident.reserve(config.gpuChunkSlots);
+
+	chunkBytes = CHUNK_VERTICES * sizeof(ChunkVertex);
+	uploadBudget = std::max(config.uploadBudgetPerFrame, chunkBytes);
+	copies.reserve(static_cast<size_t>(uploadBudget / chunkBytes));
+	uploaded.reserve(copies.capacity());
+
+	createBuffer(chunkBytes * config.gpuChunkSlots, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexMemory);
+	createBuffer(uploadBudget * framesInFlight, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+	void* mapped = nullptr;
+	vkMapMemory(device, stagingMemory, 0, uploadBudget * framesInFlight, 0, &mapped);
+	stagingData = static_cast<unsigned char*>(mapped);
+	VkDeviceSize drawBytes = sizeof(VkDrawIndexedIndirectCommand) * config.gpuChunkSlots * framesInFlight;
+	createBuffer(drawBytes, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, drawBuffer, drawMemory);
+	vkMapMemory(device, drawMemory, 0, drawBytes, 0, &mapped);
+	drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(mapped);
+
+	std::vector<uint32_t> indices;
+	indices.reserve(CHUNK_INDICES);
+	for (uint32_t y = 0; y + 1 < VERTICES_PER_SIDE; ++y) {
+		for (uint32_t x = 0; x + 1 < VERTICES_PER_SIDE; ++x) {
+			uint32_t corner = y * VERTICES_PER_SIDE + x;
+			indices.insert(indices.end(), { corner, corner + 1, corner + VERTICES_PER_SIDE + 1, corner + VERTICES_PER_SIDE + 1, corner + VERTICES_PER_SIDE, corner });
+		}
+	}
+	createBuffer(CHUNK_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexMemory);
+	upload(indexBuffer, indices.data(), CHUNK_INDICES * sizeof(uint32_t));
+
+	io.start(config.ioThreads, config.cpuChunkSlots, readCompleted, this); // never more reads queued than there are CPU buffers to read into
+}
+
+void WorldStreamer::destroy() {
+	io.stop(); // reads in progress finish first, they write into pool buffers
+	if (jobs != nullptr)
+		jobs->wait(decodeJobs);
+	while (!inFlight.empty())
+		release(inFlight.back(), ChunkState::Unloaded);
+	cpuPool.reset();
+	chunks.reset();
+	file.close();
+
+	if (stagingData != nullptr)
+		vkUnmapMemory(device, stagingMemory);
+	stagingData = nullptr;
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	freeDeviceMemory(device, stagingMemory);
+	if (drawCommands != nullptr)
+		vkUnmapMemory(device, drawMemory);
+	drawCommands = nullptr;
+	vkDestroyBuffer(device, drawBuffer, nullptr);
+	freeDeviceMemory(device, drawMemory);
+	drawBuffer = VK_NULL_HANDLE;
+	drawMemory = VK_NULL_HANDLE;
+	vkDestroyBuffer(device, indexBuffer, nullptr);
+	freeDeviceMemory(device, indexMemory);
+	vkDestroyBuffer(device, vertexBuffer, nullptr);
+	freeDeviceMemory(device, vertexMemory);
+	stagingBuffer = indexBuffer = vertexBuffer = VK_NULL_HANDLE;
+	stagingMemory = indexMemory = vertexMemory = VK_NULL_HANDLE;
+}
+
+void WorldStreamer::readCompleted(void* context, uint64_t tag, bool success) {
+	WorldStreamer* streamer = static_cast<WorldStreamer*>(context);
+	streamer->chunks[tag].state.store(success ? ChunkState::Read : ChunkState::Failed, std::memory_order_release); // publishes the payload
+}
+
+void WorldStreamer::release(uint32_t chunk, ChunkState state) {
+	cpuPool->destroy(chunks[chunk].data);
+	chunks[chunk].data = nullptr;
+	chunks[chunk].state.store(state, std::memory_order_relaxed);
+	auto it = std::find(inFlight.begin(), inFlight.end(), chunk);
+	*it = inFlight.back();
+	inFlight.pop_back();
+}
+
+void WorldStreamer::update(uint32_t frame, glm::vec2 cameraPosition) {
+	camera = cameraPosition;
+	copies.clear();
+	uploaded.clear();
+	frameStats.uploadedBytes = 0;
+
+	// reads still queued: nearest first, and forget the ones the camera has left behind. the dropped ones never complete, so their buffers are free
+	cancelled.clear();
+	io.reprioritize([this](uint64_t tag) {
+		float distance = distanceTo(static_cast<uint32_t>(tag));
+		if (distance > config.cancelRadius) {
+			cancelled.push_back(static_cast<uint32_t>(tag));
+			return -1.0f;
+		}
+		return distance;
+	});
+	for (uint32_t chunk : cancelled)
+		release(chunk, ChunkState::Unloaded);
+
+	// finished reads go to the job system, decoded chunks line up for the upload
+	candidates.clear();
+	for (size_t i = 0; i < inFlight.size();) {
+		uint32_t chunk = inFlight[i];
+		ChunkState state = chunks[chunk].state.load(std::memory_order_acquire);
+		if (state == ChunkState::Failed) {
+			std::cerr << "failed to read world chunk " << chunk << std::endl;
+			++frameStats.failedReads;
+			release(chunk, ChunkState::Failed); // stays failed, it isn't requested again
+			continue;
+		}
+		if ((state == ChunkState::Read || state == ChunkState::Decoded) && distanceTo(chunk) > config.cancelRadius) {
+			release(chunk, ChunkState::Unloaded);
+			continue;
+		}
+		if (state == ChunkState::Read) {
+			startDecode(chunk);
+		} else if (state == ChunkState::Decoded) {
+			candidates.push_back(chunk);
+		}
+		++i;
+	}
+
+	// uploads, nearest first, as long as the frame's staging budget lasts. everything here is on its way to the GPU within this frame's command buffer.
+	// a replay uploads what the captured frame did instead. a scheduled chunk that isn't coming means the replay went its own way, the capture
+	// comparison reports that
+	VkDeviceSize stagingBase = uploadBudget * frame;
+	if (uploadSchedule != nullptr) {
+		for (uint32_t chunk : *uploadSchedule)
+			if (chunk < chunkCount && waitUntilDecoded(chunk))
+				upload(chunk, stagingBase);
+	} else {
+		std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return distanceTo(a) < distanceTo(b); });
+		for (uint32_t chunk : candidates)
+			if (!upload(chunk, stagingBase))
+				break; // the rest waits for the next frame, still decoded
+	}
+
+	// new requests for the nearest unloaded chunks around the camera, while there are CPU buffers for them
+	candidates.clear();
+	glm::vec2 local = (camera - worldOrigin) / header.chunkSize;
+	float loadRadius = memoryPressure ? config.loadRadius * config.pressureRadiusScale : config.loadRadius;
+	int32_t reach = static_cast<int32_t>(std::ceil(loadRadius / header.chunkSize));
+	int32_t minX = std::max(0, static_cast<int32_t>(local.x) - reach), maxX = std::min(static_cast<int32_t>(header.chunksX) - 1, static_cast<int32_t>(local.x) + reach);
+	int32_t minY = std::max(0, static_cast<int32_t>(local.y) - reach), maxY = std::min(static_cast<int32_t>(header.chunksY) - 1, static_cast<int32_t>(local.y) + reach);
+	for (int32_t y = minY; y <= maxY; ++y) {
+		for (int32_t x = minX; x <= maxX; ++x) {
+			uint32_t chunk = static_cast<uint32_t>(y) * header.chunksX + static_cast<uint32_t>(x);
+			if (chunks[chunk].state.load(std::memory_order_relaxed) == ChunkState::Unloaded && distanceTo(chunk) <= loadRadius)
+				candidates.push_back(chunk);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return distanceTo(a) < distanceTo(b); });
+	for (uint32_t chunk : candidates) {
+		if (cpuPool->size() == cpuPool->capacity())
+			break;
+		Chunk& target = chunks[chunk];
+		target.data = cpuPool->create();
+		target.state.store(ChunkState::Reading, std::memory_order_relaxed); // before the submit, the read can complete right away
+		inFlight.push_back(chunk);
+		IoThreadPool::Request request{ chunk, &file, target.fileOffset, target.fileSize, target.data->payload, distanceTo(chunk) };
+		if (!io.submit(request)) {
+			release(chunk, ChunkState::Unloaded);
+			break;
+		}
+	}
+
+	resident.clear();
+	for (uint32_t slot = 0; slot < slotOwner.size(); ++slot)
+		if (slotOwner[slot] >= 0)
+			resident.push_back({ slot, chunks[slotOwner[slot]].center });
+	frameStats.resident = static_cast<uint32_t>(resident.size());
+	frameStats.streaming = static_cast<uint32_t>(inFlight.size());
+}
+
+bool WorldStreamer::upload(uint32_t chunk, VkDeviceSize stagingBase) {
+	uint32_t slot;
+	if (frameStats.uploadedBytes + chunkBytes > uploadBudget || !acquireSlot(distanceTo(chunk), slot))
+		return false;
+	std::memcpy(stagingData + stagingBase + frameStats.uploadedBytes, chunks[chunk].data->vertices, static_cast<size_t>(chunkBytes));
+	VkBufferCopy copy{};
+	copy.srcOffset = stagingBase + frameStats.uploadedBytes;
+	copy.dstOffset = chunkBytes * slot;
+	copy.size = chunkBytes;
+	copies.push_back(copy);
+	uploaded.push_back(chunk);
+	frameStats.uploadedBytes += chunkBytes;
+	++uploads;
+
+	slotOwner[slot] = static_cast<int32_t>(chunk);
+	chunks[chunk].slot = static_cast<int32_t>(slot);
+	release(chunk, ChunkState::Resident);
+	return true;
+}
+
+void WorldStreamer::startDecode(uint32_t chunk) {
+	chunks[chunk].state.store(ChunkState::Decoding, std::memory_order_relaxed);
+	jobs->run(jobs->createJob([this, chunk]() {
+		decode(chunk);
+		chunks[chunk].state.store(ChunkState::Decoded, std::memory_order_release);
+	}, &decodeJobs));
+}
+
+// replays only, the normal path never waits on the disk
+bool WorldStreamer::waitUntilDecoded(uint32_t chunk) {
+	for (;;) {
+		ChunkState state = chunks[chunk].state.load(std::memory_order_acquire);
+		if (state == ChunkState::Decoded)
+			return true;
+		if (state == ChunkState::Read)
+			startDecode(chunk);
+		else if (state == ChunkState::Decoding)
+			jobs->wait(decodeJobs); // runs the decodes on this thread meanwhile
+		else if (state == ChunkState::Reading)
+			std::this_thread::yield();
+		else
+			return false;
+	}
+}
+
+bool WorldStreamer::acquireSlot(float distance, uint32_t& outSlot) {
+	if (!freeSlots.empty()) {
+		outSlot = freeSlots.back();
+		freeSlots.pop_back();
+		return true;
+	}
+	// memory pressure: take the slot of the farthest resident chunk, unless everything resident is nearer than the chunk that wants in
+	int32_t farthest = -1;
+	float farthestDistance = distance;
+	for (uint32_t slot = 0; slot < slotOwner.size(); ++slot) {
+		float residentDistance = distanceTo(static_cast<uint32_t>(slotOwner[slot]));
+		if (residentDistance > farthestDistance) {
+			farthest = static_cast<int32_t>(slot);
+			farthestDistance = residentDistance;
+		}
+	}
+	if (farthest < 0)
+		return false;
+	Chunk& evicted = chunks[slotOwner[farthest]];
+	evicted.state.store(ChunkState::Unloaded, std::memory_order_relaxed);
+	evicted.slot = -1;
+	slotOwner[farthest] = -1;
+	++frameStats.evictions;
+	outSlot = static_cast<uint32_t>(farthest);
+	return true;
+}
+
+// heights to vertices on a job system worker. the heights displace the grid below terrainHeight, the depth buffer sorts the hills out. the sun's
+// lighting from the normals is baked into the colors, the vertices have no normal of their own
+void WorldStreamer::decode(uint32_t chunk) {
+	ChunkData& data = *chunks[chunk].data;
+	const uint32_t side = VERTICES_PER_SIDE;
+	const float spacing = header.chunkSize / (side - 1);
+	const glm::vec2 corner = chunks[chunk].center - 0.5f * header.chunkSize;
+	const glm::vec3 lightDirection = glm::normalize(glm::vec3(0.4f, 0.3f, 0.85f));
+
+	auto heightAt = [&](uint32_t x, uint32_t y) {
+		uint16_t raw;
+		std::memcpy(&raw, data.payload + (y * side + x) * 4, sizeof(raw));
+		return raw / 65535.0f * header.heightScale;
+	};
+	for (uint32_t y = 0; y < side; ++y) {
+		for (uint32_t x = 0; x < side; ++x) {
+			uint32_t x0 = x > 0 ? x - 1 : x, x1 = x + 1 < side ? x + 1 : x; // one sided at the chunk's edges
+			uint32_t y0 = y > 0 ? y - 1 : y, y1 = y + 1 < side ? y + 1 : y;
+			float dx = (heightAt(x1, y) - heightAt(x0, y)) / ((x1 - x0) * spacing);
+			float dy = (heightAt(x, y1) - heightAt(x, y0)) / ((y1 - y0) * spacing);
+			float light = 0.35f + 0.65f * std::max(0.0f, glm::dot(glm::normalize(glm::vec3(-dx, -dy, 1.0f)), lightDirection));
+
+			uint16_t color;
+			std::memcpy(&color, data.payload + (y * side + x) * 4 + 2, sizeof(color));
+			ChunkVertex& vertex = data.vertices[y * side + x];
+			vertex.position[0] = corner.x + x * spacing;
+			vertex.position[1] = corner.y + y * spacing;
+			vertex.position[2] = config.terrainHeight - header.heightScale + heightAt(x, y);
+			vertex.color[0] = (color >> 11) / 31.0f * light;
+			vertex.color[1] = ((color >> 5) & 0x3F) / 63.0f * light;
+			vertex.color[2] = (color & 0x1F) / 31.0f * light;
+		}
+	}
+}
+
+void WorldStreamer::recordUploads(VkCommandBuffer commandBuffer) const {
+	if (copies.empty())
+		return;
+	// an evicted slot may still be drawn by an earlier frame, the copy waits for the vertex fetches before it (write after read)
+	VkMemoryBarrier2 beforeCopy{};
+	beforeCopy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	beforeCopy.srcStageMask = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+	beforeCopy.srcAccessMask = VK_ACCESS_2_NONE;
+	beforeCopy.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	beforeCopy.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	VkDependencyInfo dependency{};
+	dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency.memoryBarrierCount = 1;
+	dependency.pMemoryBarriers = &beforeCopy;
+	vkCmdPipelineBarrier2(commandBuffer, &dependency);
+
+	vkCmdCopyBuffer(commandBuffer, stagingBuffer, vertexBuffer, static_cast<uint32_t>(copies.size()), copies.data());
+
+	VkMemoryBarrier2 afterCopy{};
+	afterCopy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+	afterCopy.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+	afterCopy.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+	afterCopy.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+	afterCopy.dstAccessMask = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT;
+	dependency.pMemoryBarriers = &afterCopy;
+	vkCmdPipelineBarrier2(commandBuffer, &dependency);
+}
+
+void WorldStreamer::recordBindBuffers(VkCommandBuffer commandBuffer) const {
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void WorldStreamer::recordDraw(VkCommandBuffer commandBuffer, uint32_t slot) const {
+	vkCmdDrawIndexed(commandBuffer, CHUNK_INDICES, 1, 0, static_cast<int32_t>(slot * CHUNK_VERTICES), 0); // the slot picks the vertices, the indices are the same grid
+}
+
+void WorldStreamer::recordDraws(VkCommandBuffer commandBuffer, uint32_t frame, const uint32_t* slots, uint32_t count) {
+	if (count == 0)
+		return;
+	count = std::min(count, config.gpuChunkSlots); // a slot is never resident twice, so only a bad caller gets here
+	VkDrawIndexedIndirectCommand* commands = drawCommands + static_cast<size_t>(frame) * config.gpuChunkSlots;
+	for (uint32_t i = 0; i < count; ++i) {
+		commands[i].indexCount = CHUNK_INDICES;
+		commands[i].instanceCount = 1;
+		commands[i].firstIndex = 0;
+		commands[i].vertexOffset = static_cast<int32_t>(slots[i] * CHUNK_VERTICES);
+		commands[i].firstInstance = 0;
+	}
+	VkDeviceSize offset = sizeof(VkDrawIndexedIndirectCommand) * config.gpuChunkSlots * frame;
+	vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+std::string WorldStreamer::summary() const {
+	return std::to_string(frameStats.resident) + "/" + std::to_string(config.gpuChunkSlots) + " chunks resident, " + std::to_string(frameStats.streaming) + " streaming, " +
+		std::to_string(frameStats.evictions) + " evicted" + (memoryPressure ? " (memory pressure)" : "");
+}
+
+void WorldStreamer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(device, &bufferInfo, nullptr, &outBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create world streaming buffer!");
+	}
+
+	VkMemoryRequirements memReqs;
+	vkGetBufferMemoryRequirements(device, outBuffer, &memReqs);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memReqs.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
+	if (allocateDeviceMemory(device, allocInfo, bufferMemoryCategory(usage), outMemory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate world streaming buffer memory!");
+	}
+
+	vkBindBufferMemory(device, outBuffer, outMemory, 0);
+}
+
+uint32_t WorldStreamer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+		if ((typeFilter & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			return i;
+
+	throw std::runtime_error("Failed to find suitable memory type!");
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "PoolAllocator.h"
+#include "StreamingIO.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Streams a terrain that is far bigger than what's kept loaded, in square chunks around the camera. A chunk goes through:
+//  reading   - update() picked it (inside loadRadius, nearest first), gave it a CPU buffer from the pool and queued its read on the I/O threads
+//  read      - an I/O thread has its bytes
+//  decoding  - a job system worker turns the heights and colors into vertices
+//  decoded   - waiting for a GPU slot and for the frame's upload budget
+//  resident  - copied into its slot of the vertex buffer, the CPU buffer went back to the pool
+// update() only checks states and hands the next step off, it never waits on a read or a decode, so the frame never blocks on disk. Reads still
+// waiting in the queue are reprioritized by camera distance every frame, and dropped if the camera has moved away from them.
+// Memory is bounded on both sides: the CPU pool caps the chunks in flight, and the GPU vertex buffer has a fixed number of chunk slots. Resident
+// chunks stay as a cache after the camera leaves, until a nearer chunk needs a slot and none is free - then the farthest one is evicted.
+
+// terrain vertex. plain floats, glm's vec3 is padded to 16 bytes with GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+struct ChunkVertex {
+	float position[3]; // world space
+	float color[3]; // baked shading, the scene's fragment shader adds the dynamic lights on top
+
+	static VkVertexInputBindingDescription getBindingDescription();
+	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+};
+
+// world file: header, chunk table, then each chunk's payload. a payload is VERTICES_PER_SIDE^2 x (uint16 height, uint16 RGB565 color), row major
+struct WorldFileHeader {
+	char magic[4]; // "WRLD"
+	uint32_t version;
+	uint32_t chunksX;
+	uint32_t chunksY;
+	uint32_t verticesPerSide;
+	float chunkSize; // world units
+	float heightScale; // world units at height 65535
+	uint32_t padding;
+};
+struct WorldFileChunk {
+	uint64_t offset; // from the start of the file
+	uint32_t size;
+	uint32_t padding;
+};
+
+void writeProceduralWorld(const std::string& path, uint32_t chunksX, uint32_t chunksY, uint32_t seed); // a value noise landscape, throws if the file can't be written
+
+class WorldStreamer {
+public:
+	static const uint32_t VERTICES_PER_SIDE = 33; // per chunk, 32x32 quads. neighbours share their edge vertices' positions, so there are no cracks
+	static const uint32_t CHUNK_VERTICES = VERTICES_PER_SIDE * VERTICES_PER_SIDE;
+	static const uint32_t CHUNK_INDICES = (VERTICES_PER_SIDE - 1) * (VERTICES_PER_SIDE - 1) * 6;
+	static const uint32_t CHUNK_PAYLOAD_SIZE = CHUNK_VERTICES * 4;
+
+	struct Settings {
+		float loadRadius = 7.0f; // chunks whose center is this close to the camera are streamed in
+		float cancelRadius = 8.0f; // reads and decodes of chunks past this are dropped. bigger than loadRadius, so the edge doesn't flicker
+		uint32_t gpuChunkSlots = 256; // the GPU memory budget, in chunks. has to hold everything inside loadRadius, or the nearest chunks keep evicting each other
+		uint32_t cpuChunkSlots = 48; // chunks being read or decoded or waiting for upload at once
+		VkDeviceSize uploadBudgetPerFrame = 512 * 1024; // staging bytes per frame, at least one chunk
+		uint32_t ioThreads = 2;
+		float terrainHeight = -0.6f; // z of the highest hilltops, the heights go down from here so the scene above stays clear of them
+		float pressureRadiusScale = 0.5f; // of loadRadius, what is still requested while under memory pressure
+	};
+
+	struct Stats {
+		uint32_t resident = 0;
+		uint32_t streaming = 0; // chunks between the read request and the upload
+		uint64_t uploadedBytes = 0; // this frame
+		uint64_t evictions = 0; // since init
+		uint64_t failedReads = 0;
+	};
+
+	struct ResidentChunk {
+		uint32_t slot;
+		glm::vec2 center;
+	};
+
+	using UploadFunction = std::function<void(VkBuffer dstBuffer, const void* data, VkDeviceSize size)>; // fills a device local buffer (transfer dst)
+
+	// opens the world file, writing a procedural one first if there is none. only the header and chunk table are read here
+	void init(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, JobSystem& jobSystem, const std::string& worldPath, uint32_t framesInFlight,
+		const UploadFunction& upload, const Settings& settings);
+	void destroy(); // the device has to be idle
+
+	// on the thread that created the job system (it's worker 0, so the decode jobs come from its pool), once per frame after the frame's previous
+	// submission has finished: the frame's part of the staging buffer is rewritten
+	void update(uint32_t frame, glm::vec2 cameraPosition);
+
+	// the copies update() staged, with barriers against the draws of earlier frames that read an evicted slot. outside any render pass
+	void recordUploads(VkCommandBuffer commandBuffer) const;
+	// binds the shared index buffer and the chunk vertex buffer, then one indexed draw per chunk. the caller binds the pipeline and set 0
+	void recordBindBuffers(VkCommandBuffer commandBuffer) const;
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t slot) const;
+	// the same for a whole batch of chunks in one indirect draw (multiDrawIndirect): a command per slot, written to the frame's part of a host visible
+	// buffer. once per frame, after the frame's previous submission has finished
+	void recordDraws(VkCommandBuffer commandBuffer, uint32_t frame, const uint32_t* slots, uint32_t count);
+	uint32_t chunkSlots() const { return config.gpuChunkSlots; } // how many chunks can be resident, and drawn, at once
+
+	const std::vector<ResidentChunk>& residentChunks() const { return resident; } // as of the last update()
+	glm::vec4 chunkBounds(const ResidentChunk& chunk) const { // world space sphere around the chunk's square and its height range
+		float halfHeight = 0.5f * header.heightScale;
+		return glm::vec4(chunk.center, config.terrainHeight - halfHeight, glm::length(glm::vec2(header.chunkSize * 0.7072f, halfHeight)));
+	}
+	// changes whenever a chunk comes in or goes out (an eviction always comes with an upload into its slot), for caches of what the terrain looks like
+	uint64_t residencyVersion() const { return uploads; }
+	const Stats& stats() const { return frameStats; }
+	const std::vector<uint32_t>& frameUploads() const { return uploaded; } // the chunks the last update() uploaded, in order. what a frame capture records
+	// replaying a frame capture (see FrameCapture.h): update() uploads exactly these chunks, in this order, instead of whatever has finished decoding,
+	// and waits for their reads and decodes if it has to. the streaming then comes out the same however fast the I/O happens to be. nullptr goes
+	// back to normal, the vector has to stay valid until then
+	void scheduleUploads(const std::vector<uint32_t>* chunks) { uploadSchedule = chunks; }
+	// the device is running out of memory (MemoryTelemetry's budget callbacks). the GPU slots are allocated up front, so what backs off is the rest:
+	// only chunks inside pressureRadiusScale x loadRadius are requested, which keeps fewer CPU buffers, reads and staging uploads going
+	void setMemoryPressure(bool pressure) { memoryPressure = pressure; }
+	std::string summary() const; // for the window title
+
+private:
+	enum class ChunkState : uint32_t { Unloaded, Reading, Read, Decoding, Decoded, Resident, Failed };
+	struct ChunkData {
+		unsigned char payload[CHUNK_PAYLOAD_SIZE];
+		ChunkVertex vertices[CHUNK_VERTICES];
+	};
+	struct Chunk {
+		std::atomic<ChunkState> state{ ChunkState::Unloaded }; // written by the I/O threads and the decode jobs, everything else only by update()
+		ChunkData* data = nullptr; // from reading until the upload
+		int32_t slot = -1; // while resident
+		uint64_t fileOffset = 0;
+		uint32_t fileSize = 0;
+		glm::vec2 center = glm::vec2(0.0f);
+	};
+
+	static void readCompleted(void* context, uint64_t tag, bool success);
+	void startDecode(uint32_t chunk); // on the job system, the chunk is read
+	void decode(uint32_t chunk);
+	bool waitUntilDecoded(uint32_t chunk); // false if it isn't being streamed at all
+	bool upload(uint32_t chunk, VkDeviceSize stagingBase); // false if the frame's budget or the GPU slots are used up
+	void release(uint32_t chunk, ChunkState state); // back to the pool, off the in flight list
+	float distanceTo(uint32_t chunk) const { return glm::length(chunks[chunk].center - camera); }
+	bool acquireSlot(float distance, uint32_t& outSlot); // a free one, or the farthest resident chunk's if that is farther than distance
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& outBuffer, VkDeviceMemory& outMemory);
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	JobSystem* jobs = nullptr;
+	Settings config;
+
+	StreamFile file;
+	WorldFileHeader header{};
+	std::unique_ptr<Chunk[]> chunks; // chunksX * chunksY, row major. atomics don't move, so not a vector
+	uint32_t chunkCount = 0;
+	glm::vec2 worldOrigin = glm::vec2(0.0f); // corner of chunk 0, the world is centered on 0
+	glm::vec2 camera = glm::vec2(0.0f);
+
+	IoThreadPool io;
+	std::unique_ptr<PoolAllocator<ChunkData>> cpuPool;
+	JobCounter decodeJobs;
+
+	// all reserved in init(), update() doesn't allocate
+	std::vector<uint32_t> inFlight; // chunks holding CPU data
+	std::vector<uint32_t> candidates; // scratch for sorting by distance
+	std::vector<uint32_t> cancelled;
+	std::vector<int32_t> slotOwner; // chunk per GPU slot, -1 free
+	std::vector<uint32_t> freeSlots;
+	std::vector<VkBufferCopy> copies; // this frame's
+	std::vector<uint32_t> uploaded; // this frame's chunks, same order
+	const std::vector<uint32_t>* uploadSchedule = nullptr;
+	bool memoryPressure = false;
+	std::vector<ResidentChunk> resident;
+	Stats frameStats;
+	uint64_t uploads = 0; // since init
+
+	VkDeviceSize chunkBytes = 0;
+	VkDeviceSize uploadBudget = 0;
+	VkBuffer vertexBuffer = VK_NULL_HANDLE; // gpuChunkSlots slots of CHUNK_VERTICES
+	VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE; // one chunk's grid, shared by all of them through the draws' vertex offset
+	VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+	VkBuffer stagingBuffer = VK_NULL_HANDLE; // uploadBudget per frame in flight, persistently mapped
+	VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+	unsigned char* stagingData = nullptr;
+	VkBuffer drawBuffer = VK_NULL_HANDLE; // gpuChunkSlots draw commands per frame in flight, persistently mapped
+	VkDeviceMemory drawMemory = VK_NULL_HANDLE;
+	VkDrawIndexedIndirectCommand* drawCommands = nullptr;
+};
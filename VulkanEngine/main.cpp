@@ -5,6 +5,7 @@
 #include <stdexcept>
 #include <cstdlib>
 #include <cstdint>
+#include <cstdio>
 
 #include <vector>
 #include <array>
@@ -12,12 +13,42 @@
 #include <algorithm> // for std::min/max functions
 #include <set>
 #include <chrono>
+#include <cstring>
+#include <cmath>
+#include <string>
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "JobSystem.h"
+#include "RenderGraph.h"
+#include "GpuTimeline.h"
+#include "AsyncCompute.h"
+#include "DeletionQueue.h"
+#include "PresentPolicy.h"
+#include "FrameStats.h"
+#include "DynamicResolution.h"
+#include "ParticleSystem.h"
+#include "MeshletRenderer.h"
+#include "LodSelector.h"
+#include "DrawList.h"
+#include "LinearArena.h"
+#include "AllocationCounter.h"
+#include "DeviceSelector.h"
+#include "MultiGpuOffscreen.h"
+#include "Benchmark.h"
+#include "WorldStreamer.h"
+#include "VirtualFileSystem.h"
+#include "ClusteredLighting.h"
+#include "ShadowCascades.h"
+#include "TemporalUpscaler.h"
+#include "DepthPyramid.h"
+#include "FrameCapture.h"
+#include "MemoryTelemetry.h"
+#include "DescriptorAllocator.h"
+
 struct Vertex {
 	glm::vec2 pos;
 	glm::vec3 color;
@@ -46,26 +77,53 @@ struct Vertex {
 		return attributeDescriptions;
 	}
 };
-const std::vector<Vertex> vertices = {
-	{{-0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-	{{ 0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}},
-	{{ 0.5f,  0.5f}, {0.0f, 0.0f, 1.0f}},
-	{{-0.5f,  0.5f}, {1.0f, 1.0f, 1.0f}}
-};
-const std::vector<uint16_t> indices = {
-	0,1,2, 2,3,0
-};
+// the unit quad, tessellated into a grid so there's something to split into meshlets. the colors are blended between the four corner colors it used to have
+const uint32_t QUAD_SUBDIVISIONS = 128; // per side, 2 * 128 * 128 triangles
+static void buildQuadGrid(std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices) {
+	const glm::vec3 cornerColors[4] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 1.0f, 1.0f } }; // (-,-) (+,-) (+,+) (-,+)
+	const uint32_t side = QUAD_SUBDIVISIONS + 1;
+	outVertices.clear();
+	outIndices.clear();
+	for (uint32_t y = 0; y < side; ++y) {
+		for (uint32_t x = 0; x < side; ++x) {
+			float u = static_cast<float>(x) / QUAD_SUBDIVISIONS;
+			float v = static_cast<float>(y) / QUAD_SUBDIVISIONS;
+			Vertex vertex{};
+			vertex.pos = glm::vec2(u - 0.5f, v - 0.5f);
+			vertex.color = (cornerColors[0] * (1.0f - u) + cornerColors[1] * u) * (1.0f - v) + (cornerColors[3] * (1.0f - u) + cornerColors[2] * u) * v;
+			outVertices.push_back(vertex);
+		}
+	}
+	for (uint32_t y = 0; y < QUAD_SUBDIVISIONS; ++y) {
+		for (uint32_t x = 0; x < QUAD_SUBDIVISIONS; ++x) {
+			uint32_t corner = y * side + x;
+			uint32_t quad[6] = { corner, corner + 1, corner + side + 1, corner + side + 1, corner + side, corner }; // counter clockwise, same as the old 0,1,2, 2,3,0
+			outIndices.insert(outIndices.end(), quad, quad + 6);
+		}
+	}
+}
 
 struct UniformBufferObject {
 	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
-	alignas(16) glm::mat4 projection;
+	alignas(16) glm::mat4 projection; // the CPU side keeps it unjittered, the jitter is only added for the upload
+	alignas(16) glm::mat4 previousModel; // last frame's, for the motion vectors
+	alignas(16) glm::mat4 previousViewProjection; // last frame's, without the jitter
+	alignas(16) glm::mat4 viewProjection; // this frame's, without the jitter
+};
+
+// one per instance of the main pass's instanced draws, indexed by the instance's position in the sorted draw list. mirrors Instance in shader.vert and meshlet.mesh
+struct InstanceData {
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::mat4 previousModel;
 };
 
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t MAX_SCENE_INSTANCES = 1024; // copies of the object a benchmark scene can ask for, they all fit one instanced draw
+const VkPipelineStageFlags2 ACQUIRE_WAIT_STAGE = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT; // the swap chain image is first used by the upscale blit, so the scene can render before it's acquired
 
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
@@ -77,8 +135,6 @@ const bool enableValidationLayers = false;
 const bool enableValidationLayers = true;
 #endif
 
-static std::vector<char> readFile(const std::string& filename);
-
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
 	// have to lookup its address with vkGetInstanceProcAddr because vkCreateDebugUtilsMessengerEXT is an extension function, so it's not automatically loaded.
 	PFN_vkCreateDebugUtilsMessengerEXT func = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
@@ -95,23 +151,73 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 		func(instance, debugMessenger, pAllocator);
 }
 
+// a frame capture to replay, see MainApplication::replayLoop
+struct ReplaySettings {
+	std::string name; // what the results are reported as
+	FrameCapture capture;
+	uint32_t firstFrame = 0; // the frames before it are replayed but not timed, they build up the state the timed ones start from
+	uint32_t frameCount = UINT32_MAX; // timed
+};
+
 class MainApplication {
 public:
+	// a benchmark scene or a replay runs headless (no window, VK_EXT_headless_surface) for its frame count instead of until the window is closed
+	explicit MainApplication(std::string deviceSelector = "", const BenchmarkScene* benchmarkScene = nullptr, const ReplaySettings* replay = nullptr)
+		: benchmarkScene(benchmarkScene), replay(replay), deviceSelector(std::move(deviceSelector)) {}
+
+	// records every frame of the run into a capture file (see FrameCapture.h), or the first maxFrames of them (0 = all)
+	void captureTo(const std::string& path, uint32_t maxFrames) {
+		capturePath = path;
+		captureFrameLimit = maxFrames;
+	}
+
 	void run() {
+		mountAssets();
 		initWindow();
 		initVulkan();
-		mainLoop();
+		if (!capturePath.empty())
+			captureWriter.open(capturePath, physicalDeviceName);
+		if (benchmarkScene != nullptr)
+			benchmarkLoop();
+		else if (replay != nullptr)
+			replayLoop();
+		else
+			mainLoop();
 		cleanup();
 	}
 
+	const BenchmarkResult& benchmarkResult() const { return benchmarkResults; } // a replay's as well
+	const std::string& deviceName() const { return physicalDeviceName; }
+
 private:
-	GLFWwindow* window;
+	const BenchmarkScene* benchmarkScene = nullptr;
+	const ReplaySettings* replay = nullptr;
+	bool headless() const { return benchmarkScene != nullptr || replay != nullptr; }
+	VkExtent2D headlessExtent = { WIDTH, HEIGHT }; // what the "window" size is without a window
+
+	VirtualFileSystem assets;
+	// shaders and the like come out of assets.vpak next to the executable when it's there (--pack-assets writes it), loose files otherwise.
+	// ENGINE_LOOSE_FILES=1 prefers loose files over the archive, for working on shaders without repacking
+	void mountAssets() {
+		const char* looseFiles = std::getenv("ENGINE_LOOSE_FILES");
+		assets.setLooseFilesFirst(looseFiles != nullptr && looseFiles[0] != '\0' && looseFiles[0] != '0');
+		assets.mountArchive("assets.vpak");
+	}
+
+	std::vector<char> readFile(const std::string& filename) {
+		return assets.readFile(filename, &jobSystem); // on the main thread, which is the job system's worker 0
+	}
+
+	GLFWwindow* window = nullptr;
 	void initWindow() {
+		if (headless())
+			return; // GLFW isn't even initialized, it needs a display
 		glfwInit();
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); // GLFW was originally designed to create an OpenGL context, so specifically tell it not to
 		window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan Window", nullptr, nullptr); // 4th param = monitor to open window on, 5th param only relevant to OpenGL
 		glfwSetWindowUserPointer(window, this);
 		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+		glfwSetKeyCallback(window, keyCallback);
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
@@ -119,6 +225,75 @@ private:
 		app->framebufferResized = true;
 	}
 
+	// F1/F2/F3 switch the present policy while running, F4 cycles the MSAA level, F5 toggles between compute culled meshlets and mesh shaders,
+	// F6 cycles the LOD pixel threshold, F7 turns the sun by 15 degrees, F8 toggles temporal upscaling, F9 toggles the occlusion culling of the compute
+	// culled meshlets, F10 prints the memory stats. WASD moves the camera, see updateCamera()
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+		MainApplication* app = reinterpret_cast<MainApplication*>(glfwGetWindowUserPointer(window));
+		if (action != GLFW_PRESS)
+			return;
+		if (key == GLFW_KEY_F1)
+			app->setPresentPolicy(PresentPolicy::LatencyFirst);
+		else if (key == GLFW_KEY_F2)
+			app->setPresentPolicy(PresentPolicy::ThroughputFirst);
+		else if (key == GLFW_KEY_F3)
+			app->setPresentPolicy(PresentPolicy::PowerSaving);
+		else if (key == GLFW_KEY_F4)
+			app->setMsaaSamples(app->requestedMsaaSamples == VK_SAMPLE_COUNT_8_BIT ? VK_SAMPLE_COUNT_1_BIT : static_cast<VkSampleCountFlagBits>(app->requestedMsaaSamples << 1));
+		else if (key == GLFW_KEY_F5)
+			app->setUseMeshShaders(!app->useMeshShaders);
+		else if (key == GLFW_KEY_F6)
+			app->objectLod.settings().pixelThreshold = app->objectLod.settings().pixelThreshold >= 8.0f ? 1.0f : app->objectLod.settings().pixelThreshold * 2.0f; // 1, 2, 4, 8 pixels
+		else if (key == GLFW_KEY_F7)
+			app->rotateSun(); // every cascade is rendered again on the next frame
+		else if (key == GLFW_KEY_F8)
+			app->setUseTemporalUpscaling(!app->requestedTemporalUpscaling);
+		else if (key == GLFW_KEY_F9)
+			app->setUseOcclusionCulling(!app->requestedOcclusionCulling);
+		else if (key == GLFW_KEY_F10)
+			app->printMemoryStats();
+	}
+
+	void printMemoryStats() {
+		memoryTelemetry.dumpStats(std::cout);
+		const DescriptorSetCache::Stats& descriptors = descriptorCache.stats();
+		std::cout << "  descriptor cache: " << descriptors.cached << " sets, " << descriptors.hits << " hits, " << descriptors.misses << " misses ("
+			<< descriptors.reused << " reused a forgotten set)" << std::endl;
+	}
+
+	PresentPolicy presentPolicy = PresentPolicy::LatencyFirst;
+	bool swapChainSettingsChanged = false; // present policy, MSAA level, meshlet path, temporal upscaling or occlusion culling, the swap chain and everything on it is recreated at the end of the frame
+	// takes effect at the end of the current frame, the swap chain is recreated with the new present mode/image count
+	void setPresentPolicy(PresentPolicy policy) {
+		if (policy == presentPolicy)
+			return;
+		presentPolicy = policy;
+		swapChainSettingsChanged = true;
+	}
+
+	VkSampleCountFlagBits requestedMsaaSamples = VK_SAMPLE_COUNT_4_BIT;
+	void setMsaaSamples(VkSampleCountFlagBits samples) { // the render pass and pipelines are rebuilt with the swap chain, so it takes effect the same way
+		requestedMsaaSamples = samples;
+		swapChainSettingsChanged = true;
+	}
+
+	bool useMeshShaders = false; // the compute culling path works everywhere, so it's the default
+	void setUseMeshShaders(bool enable) { // the render graph only has the meshlet cull pass on the compute path, so it's rebuilt with the swap chain
+		if (!meshShadersSupported || enable == useMeshShaders)
+			return;
+		useMeshShaders = enable;
+		swapChainSettingsChanged = true;
+	}
+
+	bool useTemporalUpscaling = true;
+	bool requestedTemporalUpscaling = true;
+	// the passes and history images are part of the render graph, so it takes effect with the swap chain recreation like the MSAA level. until then
+	// the current frame keeps the old setting
+	void setUseTemporalUpscaling(bool enable) {
+		requestedTemporalUpscaling = enable;
+		swapChainSettingsChanged = true;
+	}
+
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debugMessenger;
 	void initVulkan() {
@@ -131,42 +306,265 @@ private:
 		createImageViews();
 		createRenderPass();
 		createDescriptorSetLayout();
+		createTimelines();
+		createAsyncCompute();
+		createDeletionQueue();
+		createDescriptorAllocators(); // before the modules whose sets come from the cache
+		createParticleSystem(); // before the pipelines, the particle pipeline uses its descriptor set layout
+		createClusteredLighting(); // same for the lighting set of the lit pipelines
+		createShadowCascades(); // and their shadow set, the shadow pipelines also need its render pass
 		createGraphicsPipeline();
-		createFrameBuffers();
+		createColorResources();
 		createCommandPool();
+		createDynamicResolution();
+		createTemporalUpscaler();
+		createDepthPyramid(); // before the meshlet renderer, its cull pipeline samples the pyramid
 		createVertexBuffer();
-		createIndexBuffer();
+		createMeshletRenderer();
+		createWorldStreamer();
 		createUniformBuffers();
-		createDescriptorPool();
 		createDescriptorSets();
 		createCommandBuffers();
+		createRenderGraph();
 		createSyncObjects();
+		createFrameTasks();
+		frameArenas.init(MAX_FRAMES_IN_FLIGHT, FRAME_ARENA_CAPACITY);
+		memoryTelemetry.trackCpu(MemoryCategory::CpuArenas, static_cast<int64_t>(FRAME_ARENA_CAPACITY) * MAX_FRAMES_IN_FLIGHT);
+	}
+
+	JobSystem jobSystem;
+	FrameTaskList frameTasks;
+	uint32_t frameImageIndex = 0; // swap chain image the frame tasks are currently working on
+	UniformBufferObject frameUbo{};
+	bool transformsValid = false; // frameUbo holds a previous frame's transforms
+	uint64_t jitterFrame = 0;
+	glm::vec2 frameJitter = glm::vec2(0.0f); // this frame's sub-pixel offset in render pixels, see TemporalUpscaler::jitter()
+	glm::vec2 frameJitterNdc = glm::vec2(0.0f);
+	float frameTime = 0.0f; // seconds, what the transforms were animated with
+	bool objectVisible = true;
+	float objectDepth = 0.0f; // view depth of the object's center over the far plane, for the draw list
+	// the per frame CPU work, as a graph of tasks that the job system spreads over all cores. transforms feed both culling and the uniform upload, and recording
+	// only needs the culling result, so upload and culling/recording run in parallel
+	void createFrameTasks() {
+		mainPassDraws.setBlendedLayer(BLENDED_LAYER, true); // the draw list is filled by the recording task
+		FrameTaskList::TaskId transformUpdate = frameTasks.addTask("transform update", [this]() { updateTransforms(); });
+		FrameTaskList::TaskId culling = frameTasks.addTask("culling", [this]() { cullObjects(); }, { transformUpdate });
+		FrameTaskList::TaskId lightUpdate = frameTasks.addTask("light update", [this]() { updateLights(); }, { transformUpdate });
+		FrameTaskList::TaskId computeRecording = frameTasks.addTask("compute recording", [this]() { recordComputeCommandBuffer(); }, { lightUpdate }); // the light cull bins what the update wrote
+		FrameTaskList::TaskId shadowUpdate = frameTasks.addTask("shadow update", [this]() { updateShadows(); }, { transformUpdate });
+		frameTasks.addTask("command recording", [this]() { recordCommandBuffer(frameImageIndex); }, { culling, computeRecording, shadowUpdate }); // compute has to be recorded first, see AsyncCompute
+		frameTasks.addTask("upload", [this]() { updateUniformBuffer(frameImageIndex); }, { transformUpdate });
+	}
+
+	RenderGraph renderGraph;
+	RenderGraph::ResourceHandle backbuffer;
+	// the frame's passes and what they touch. the graph works out the barriers (the backbuffer's layout transitions included), so the render pass doesn't declare
+	// any subpass dependencies of its own. rebuilt with the swap chain since the backbuffer's format/extent come from it
+	// the scene is rendered into sceneColor at the dynamic resolution scale, then the upscale pass blits it to the swap chain image
+	RenderGraph::ResourceHandle sceneColor;
+	RenderGraph::ResourceHandle meshletIndices;
+	RenderGraph::ResourceHandle meshletDrawArgs;
+	RenderGraph::ResourceHandle shadowMap;
+	RenderGraph::ResourceHandle sceneVelocity;
+	RenderGraph::ResourceHandle historyRead;
+	RenderGraph::ResourceHandle historyWrite;
+	RenderGraph::ResourceHandle postColor;
+	RenderGraph::ResourceHandle sceneDepth;
+	RenderGraph::ResourceHandle meshletOccluded;
+	RenderGraph::ResourceHandle depthPyramidImage;
+	void createRenderGraph() {
+		RenderGraphImageDesc backbufferDesc{};
+		backbufferDesc.format = swapChainImageFormat;
+		backbufferDesc.extent = swapChainExtent;
+
+		RenderGraphResourceState acquired{}; // imageAvailableSemaphore is waited on at ACQUIRE_WAIT_STAGE, the contents don't matter
+		acquired.stage = ACQUIRE_WAIT_STAGE;
+		acquired.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		RenderGraphResourceState presentable{}; // the renderFinishedSemaphore signal waits for everything, including this transition
+		presentable.stage = VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT;
+		presentable.layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		backbuffer = renderGraph.importImage("backbuffer", backbufferDesc, acquired, presentable);
+
+		RenderGraphImageDesc sceneColorDesc{}; // full size, only the top left renderExtent() of it is rendered to
+		sceneColorDesc.format = swapChainImageFormat;
+		sceneColorDesc.extent = swapChainExtent;
+		sceneColor = renderGraph.createImage("scene color", sceneColorDesc);
+		RenderGraphImageDesc sceneVelocityDesc = sceneColorDesc; // the main pass's second attachment, same size
+		sceneVelocityDesc.format = VELOCITY_FORMAT;
+		sceneVelocity = renderGraph.createImage("scene velocity", sceneVelocityDesc);
+		RenderGraphImageDesc sceneDepthDesc = sceneColorDesc; // multisampled like what's drawn to, there's no depth resolve
+		sceneDepthDesc.format = depthFormat;
+		sceneDepthDesc.samples = msaaSamples;
+		sceneDepthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		sceneDepth = renderGraph.createImage("scene depth", sceneDepthDesc);
+
+		// compute culled meshlets: the cull pass fills this frame in flight's index buffer and draw arguments, the main pass draws them. the buffers were last
+		// read by this frame's previous submission, which drawFrame() has waited for, so they start out without anything to wait on. the mesh shader path
+		// culls inside the draw and doesn't need the pass.
+		// with the split main pass the cull is the early phase of the occlusion culling (see MeshletRenderer.h), against the depth pyramid the previous
+		// frame left. the pyramid is shared by all frames in flight and left shader readable between frames like the shadow map. without the split
+		// it's never built and only there for the cull's descriptor set, which doesn't test against it
+		if (meshletCullPassBuilt) {
+			meshletIndices = renderGraph.importBuffer("meshlet indices", meshletRenderer.visibleIndexBufferSize(), RenderGraphResourceState{}, RenderGraphResourceState{});
+			meshletDrawArgs = renderGraph.importBuffer("meshlet draw args", MeshletRenderer::drawArgsBufferSize(), RenderGraphResourceState{}, RenderGraphResourceState{});
+			meshletOccluded = renderGraph.importBuffer("meshlet occlusion flags", meshletRenderer.occludedBufferSize(), RenderGraphResourceState{}, RenderGraphResourceState{});
+			RenderGraphImageDesc pyramidDesc{};
+			pyramidDesc.format = DepthPyramid::FORMAT;
+			pyramidDesc.extent = { 1, 1 }; // created after the graph, with the depth view. the graph doesn't size imported images anyway
+			RenderGraphResourceState pyramidSampled{};
+			pyramidSampled.stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			pyramidSampled.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			pyramidSampled.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			depthPyramidImage = renderGraph.importImage("depth pyramid", pyramidDesc, pyramidSampled, pyramidSampled);
+			RenderGraph::PassHandle meshletCullPass = renderGraph.addPass("meshlet cull", [this](VkCommandBuffer commandBuffer) {
+				meshletRenderer.recordCull(commandBuffer, static_cast<uint32_t>(currentFrame), meshletCullParams, sceneInstanceCount, false, depthPyramid.sampleSet());
+			});
+			renderGraph.read(meshletCullPass, depthPyramidImage, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.write(meshletCullPass, meshletIndices, RenderGraphAccess::ComputeStorageWrite);
+			renderGraph.write(meshletCullPass, meshletDrawArgs, RenderGraphAccess::ComputeStorageWrite);
+			renderGraph.write(meshletCullPass, meshletOccluded, RenderGraphAccess::ComputeStorageWrite);
+		}
+
+		// the light binning isn't a pass here: it runs on the async compute queue (recordComputeCommandBuffer()), and the froxel ranges and index list
+		// the main pass's fragment shaders read are its handoffs, so the acquire at the start of the frame is their barrier
+
+		// the sun's shadow cascades. one image for all frames in flight: the cached cascades have to survive from frame to frame. between frames it's
+		// left shader readable, so the previous frame's sampling is what the first cascade rendered waits for (recordInitialTransition() gets it there)
+		RenderGraphImageDesc shadowMapDesc{};
+		shadowMapDesc.format = shadowCascades.format();
+		shadowMapDesc.extent = shadowCascades.extent();
+		shadowMapDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+		RenderGraphResourceState shadowMapSampled{};
+		shadowMapSampled.stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+		shadowMapSampled.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+		shadowMapSampled.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		shadowMap = renderGraph.importImage("shadow map", shadowMapDesc, shadowMapSampled, shadowMapSampled);
+		renderGraph.setImportedImage(shadowMap, shadowCascades.image(), shadowCascades.arrayView()); // the same every frame
+		RenderGraph::PassHandle shadowPass = renderGraph.addPass("shadow cascades", [this](VkCommandBuffer commandBuffer) { recordShadowPass(commandBuffer); });
+		renderGraph.write(shadowPass, shadowMap, RenderGraphAccess::DepthAttachmentWrite);
+
+		auto addMainPass = [this](const char* name, bool late) {
+			RenderGraph::PassHandle pass = renderGraph.addPass(name, [this, late](VkCommandBuffer commandBuffer) { recordMainPass(commandBuffer, late); });
+			renderGraph.write(pass, sceneColor, RenderGraphAccess::ColorAttachmentWrite);
+			renderGraph.write(pass, sceneVelocity, RenderGraphAccess::ColorAttachmentWrite); // only read with temporal upscaling, but the render pass always has it
+			renderGraph.write(pass, sceneDepth, RenderGraphAccess::DepthAttachmentWrite);
+			renderGraph.read(pass, shadowMap, RenderGraphAccess::FragmentSampledRead);
+			if (meshletCullPassBuilt) {
+				renderGraph.read(pass, meshletIndices, RenderGraphAccess::IndexBufferRead);
+				renderGraph.read(pass, meshletDrawArgs, RenderGraphAccess::IndirectBufferRead);
+			}
+		};
+		addMainPass("main", false);
+
+		// the occlusion culling's late phase: the pyramid is rebuilt from the depth the first half of the main pass left, the meshlets the early cull
+		// found occluded are tested against it again, and the second half draws the ones that are visible after all
+		if (splitMainPass) {
+			RenderGraph::PassHandle pyramidPass = renderGraph.addPass("depth pyramid", [this](VkCommandBuffer commandBuffer) {
+				depthPyramid.recordBuild(commandBuffer, dynamicResolution.renderExtent(swapChainExtent));
+			});
+			renderGraph.read(pyramidPass, sceneDepth, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.write(pyramidPass, depthPyramidImage, RenderGraphAccess::ComputeStorageWrite);
+
+			RenderGraph::PassHandle lateCullPass = renderGraph.addPass("meshlet late cull", [this](VkCommandBuffer commandBuffer) {
+				meshletRenderer.recordCull(commandBuffer, static_cast<uint32_t>(currentFrame), meshletCullParams, sceneInstanceCount, true, depthPyramid.sampleSet());
+			});
+			renderGraph.read(lateCullPass, depthPyramidImage, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.read(lateCullPass, meshletOccluded, RenderGraphAccess::ComputeStorageRead);
+			renderGraph.write(lateCullPass, meshletIndices, RenderGraphAccess::ComputeStorageWrite); // after the early phase's triangles
+			renderGraph.write(lateCullPass, meshletDrawArgs, RenderGraphAccess::ComputeStorageWrite);
+
+			addMainPass("main late", true);
+		}
+
+		// temporal upscaling (see TemporalUpscaler.h): the resolve accumulates the scene into this frame's history at the swap chain's size, the
+		// sharpening writes the result to postColor, which the upscale pass then only has to copy. the histories persist from frame to frame and are
+		// swapped every frame, so they're imported and left shader readable, which is how the next frame expects either of them
+		RenderGraph::ResourceHandle upscaleSource = sceneColor;
+		if (useTemporalUpscaling) {
+			RenderGraphImageDesc historyDesc{};
+			historyDesc.format = TemporalUpscaler::historyFormat();
+			historyDesc.extent = swapChainExtent;
+			RenderGraphResourceState historySampled{};
+			historySampled.stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+			historySampled.access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+			historySampled.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			historyRead = renderGraph.importImage("history read", historyDesc, historySampled, historySampled);
+			historyWrite = renderGraph.importImage("history write", historyDesc, historySampled, historySampled);
+			postColor = renderGraph.createImage("post color", historyDesc);
+
+			RenderGraph::PassHandle resolvePass = renderGraph.addPass("temporal resolve", [this](VkCommandBuffer commandBuffer) {
+				temporalUpscaler.recordResolve(commandBuffer, dynamicResolution.renderExtent(swapChainExtent), frameJitter);
+			});
+			renderGraph.read(resolvePass, sceneColor, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.read(resolvePass, sceneVelocity, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.read(resolvePass, historyRead, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.write(resolvePass, historyWrite, RenderGraphAccess::ComputeStorageWrite);
+
+			RenderGraph::PassHandle sharpenPass = renderGraph.addPass("sharpen", [this](VkCommandBuffer commandBuffer) { temporalUpscaler.recordSharpen(commandBuffer); });
+			renderGraph.read(sharpenPass, historyWrite, RenderGraphAccess::ComputeSampledRead);
+			renderGraph.write(sharpenPass, postColor, RenderGraphAccess::ComputeStorageWrite);
+			upscaleSource = postColor;
+		}
+
+		RenderGraph::PassHandle upscalePass = renderGraph.addPass("upscale", [this](VkCommandBuffer commandBuffer) { recordUpscalePass(commandBuffer); });
+		renderGraph.read(upscalePass, upscaleSource, RenderGraphAccess::TransferRead);
+		renderGraph.write(upscalePass, backbuffer, RenderGraphAccess::TransferWrite);
+
+		renderGraph.compile();
+
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		renderGraph.realize(device, memProperties);
+
+		createSceneFrameBuffer(); // needs the realized scene color view
+		if (meshletCullPassBuilt) { // only the split builds the pyramid from the depth, otherwise the cull just binds it
+			depthPyramid.createTargets(swapChainExtent, splitMainPass ? renderGraph.imageView(sceneDepth) : VK_NULL_HANDLE, msaaSamples);
+			renderGraph.setImportedImage(depthPyramidImage, depthPyramid.image(), depthPyramid.view()); // the same every frame
+		}
+		if (useTemporalUpscaling)
+			temporalUpscaler.createTargets(swapChainExtent, renderGraph.imageView(sceneColor), renderGraph.imageView(sceneVelocity), renderGraph.imageView(postColor));
 	}
 
 
 
+	// the swap chain can only be synchronized with binary semaphores, so acquire/present keep theirs. everything else - frame pacing, which swap chain
+	// image is still in use, uploads - is a value on the graphics timeline (see GpuTimeline)
 	std::vector<VkSemaphore> imageAvailableSemaphores;
 	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
+	std::vector<uint64_t> frameTimelineValues; // graphics timeline value of each frame in flight's last submission
+	std::vector<uint64_t> imageTimelineValues; // same for each swap chain image, 0 if it was never rendered to
+	// with VK_EXT_swapchain_maintenance1, each frame in flight's present signals a fence once the presentation engine is done with it. that's what
+	// retires an old swap chain, see recreateSwapChain()
+	std::vector<VkFence> presentFences;
+	size_t lastPresentFrame = 0; // the frame in flight whose present went to the swap chain last
+	bool swapchainRetirePending = false; // without present fences: an old swap chain waits for the first acquire from the new one
 	size_t currentFrame = 0;
+	VkFence createPresentFence() {
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // nothing to wait for before the first present
+		VkFence fence;
+		if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create a present fence!");
+		}
+		return fence;
+	}
 	void createSyncObjects() {
 		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+		if (presentFencesSupported) {
+			presentFences.resize(MAX_FRAMES_IN_FLIGHT);
+			for (VkFence& fence : presentFences)
+				fence = createPresentFence();
+		}
+		frameTimelineValues.assign(MAX_FRAMES_IN_FLIGHT, 0); // 0 is always reached, so drawFrame() doesn't wait the first time round
+		imageTimelineValues.assign(swapChainImages.size(), 0);
 
 		VkSemaphoreCreateInfo semaphoreInfo{};
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo{};
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // initialize in a signaled state, as if we just rendered an initial frame, so that drawFrame() doesn't wait forever the first time
-
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS)
+				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS)
 			{
 				throw std::runtime_error("Failed to create synchronization objects for a frame!");
 			}
@@ -174,50 +572,95 @@ private:
 	}
 
 
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices; // only used on the CPU, to build the meshlets. the GPU draws from the meshlet renderer's compacted index buffers
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
 	void createVertexBuffer() {
+		buildQuadGrid(vertices, indices);
 		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+		// also a storage buffer, the mesh shaders fetch vertices themselves
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+		uploadBuffer(vertexBuffer, vertices.data(), bufferSize);
+	}
 
+	// fills a device local buffer through a staging buffer. blocks until the copy is done
+	void uploadBuffer(VkBuffer dstBuffer, const void* srcData, VkDeviceSize size) {
 		VkBuffer stagingBuffer;
 		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
 
 		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSize);
+		vkMapMemory(device, stagingBufferMemory, 0, size, 0, &data);
+		memcpy(data, srcData, (size_t)size);
 		vkUnmapMemory(device, stagingBufferMemory);
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-		copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+		copyBuffer(stagingBuffer, dstBuffer, size);
 
 		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		freeDeviceMemory(device, stagingBufferMemory);
 	}
 
-	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-	void createIndexBuffer() {
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+	MeshletRenderer meshletRenderer;
+	MeshletCullParams meshletCullParams{}; // written by the culling task
+	LodSelector objectLod; // only touched by the culling task
+	std::vector<float> lodErrors; // mesh space, finest first
+	VkBuffer shadowIndexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory shadowIndexBufferMemory = VK_NULL_HANDLE;
+	uint32_t shadowIndexCount = 0;
+	// simplifies the mesh into a chain of LODs (see MeshSimplifier.h) and splits every LOD into meshlets (see MeshletBuilder.h). this tree has no asset
+	// pipeline, so the "offline" build runs at load time, it takes a few hundred ms for the quad
+	void createMeshletRenderer() {
+		const uint32_t MAX_LODS = 8;
+		std::vector<glm::vec3> positions(vertices.size());
+		for (size_t i = 0; i < vertices.size(); ++i)
+			positions[i] = glm::vec3(vertices[i].pos, 0.0f);
+		SimplifyOptions simplifyOptions;
+		simplifyOptions.attributeWeight = 1.0f; // the quad is flat, all its detail is in the vertex colors
+		std::vector<MeshLod> lodChain = buildLodChain(positions, indices, MAX_LODS, 0.5f, simplifyOptions);
+		MeshletData meshletData = buildMeshletLods(positions, lodChain);
+		lodErrors.clear();
+		for (const MeshletLod& lod : meshletData.lods)
+			lodErrors.push_back(lod.error);
+
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		VkShaderModule cullShader = createShaderModule(readFile("Shaders/meshlet_cull.spv"));
+		meshletRenderer.init(device, memProperties, meshletData, vertexBuffer, MAX_FRAMES_IN_FLIGHT, cullShader, depthPyramid.sampleSetLayout(), meshShadersSupported,
+			[this](VkBuffer dstBuffer, const void* data, VkDeviceSize size) { uploadBuffer(dstBuffer, data, size); });
+		vkDestroyShaderModule(device, cullShader, nullptr);
+
+		// the shadow cascades draw the quad with its coarsest LOD, the shadow is a few texels across and the silhouette is the same anyway
+		const std::vector<uint32_t>& shadowIndices = lodChain.back().indices;
+		shadowIndexCount = static_cast<uint32_t>(shadowIndices.size());
+		VkDeviceSize shadowIndexSize = sizeof(uint32_t) * shadowIndices.size();
+		createBuffer(shadowIndexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowIndexBuffer, shadowIndexBufferMemory);
+		uploadBuffer(shadowIndexBuffer, shadowIndices.data(), shadowIndexSize);
+	}
 
-		copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+	WorldStreamer worldStreamer;
+	// the terrain around the camera, streamed from world.chunks next to the executable (generated on the first run). update() runs in drawFrame()
+	void createWorldStreamer() {
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		worldStreamer.init(device, memProperties, jobSystem, "world.chunks", MAX_FRAMES_IN_FLIGHT,
+			[this](VkBuffer dstBuffer, const void* data, VkDeviceSize size) { uploadBuffer(dstBuffer, data, size); }, WorldStreamer::Settings{});
+		// a replay streams what the capture did, backing off would only make it diverge
+		if (replay == nullptr)
+			memoryTelemetry.addBudgetCallback([this](const MemoryBudgetEvent& event) {
+				if (event.deviceLocal)
+					worldStreamer.setMemoryPressure(event.exceeded);
+			});
+	}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+	std::vector<VkBuffer> uniformBuffers;
+	std::vector<VkDeviceMemory> uniformBuffersMemory;
+	// the instanced draws' per instance data, next to each uniform buffer. persistently mapped, written while the draw list is built
+	std::vector<VkBuffer> instanceBuffers;
+	std::vector<VkDeviceMemory> instanceBuffersMemory;
+	std::vector<InstanceData*> instanceBuffersMapped;
+
+	// as many instances as the main pass's draw list can hold: every chunk slot, the most copies of the object and the particles
+	VkDeviceSize instanceBufferSize() const {
+		return sizeof(InstanceData) * (worldStreamer.chunkSlots() + MAX_SCENE_INSTANCES + 1);
 	}
 
 	void createUniformBuffers() {
@@ -225,23 +668,120 @@ private:
 
 		uniformBuffers.resize(swapChainImages.size());
 		uniformBuffersMemory.resize(swapChainImages.size());
+		instanceBuffers.resize(swapChainImages.size());
+		instanceBuffersMemory.resize(swapChainImages.size());
+		instanceBuffersMapped.resize(swapChainImages.size());
 
-		for (size_t i = 0; i < swapChainImages.size(); ++i)
+		for (size_t i = 0; i < swapChainImages.size(); ++i) {
 			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
+			createBuffer(instanceBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBuffersMemory[i]);
+			void* mapped;
+			vkMapMemory(device, instanceBuffersMemory[i], 0, instanceBufferSize(), 0, &mapped);
+			instanceBuffersMapped[i] = static_cast<InstanceData*>(mapped);
+		}
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
+	glm::vec3 cameraTarget = glm::vec3(0.0f); // the camera looks at this from (2, 2, 2) above it, the world streams in around it
+	std::chrono::steady_clock::time_point lastCameraUpdate = std::chrono::steady_clock::now();
+	// WASD moves the camera over the ground, forward being where it looks. on the main thread between frames, the transform task reads the result
+	void updateCamera() {
+		const float CAMERA_SPEED = 3.0f; // world units per second
+		auto currentTime = std::chrono::steady_clock::now();
+		float deltaTime = std::min(0.1f, std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastCameraUpdate).count());
+		lastCameraUpdate = currentTime;
+
+		const glm::vec2 forward = glm::normalize(glm::vec2(-1.0f, -1.0f)); // the view direction, flattened
+		const glm::vec2 left = glm::vec2(-forward.y, forward.x);
+		glm::vec2 move(0.0f);
+		if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) move += forward;
+		if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) move -= forward;
+		if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) move += left;
+		if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) move -= left;
+		if (move != glm::vec2(0.0f))
+			cameraTarget += glm::vec3(glm::normalize(move) * CAMERA_SPEED * deltaTime, 0.0f);
+	}
+
+	void updateTransforms() {
 		static auto startTime = std::chrono::high_resolution_clock::now();
 		auto currentTime = std::chrono::high_resolution_clock::now();
 		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count(); // time in seconds since rendering has started (floating point accuracy)
+		if (benchmarkScene != nullptr)
+			time = benchmarkFrame * BENCHMARK_FRAME_SECONDS; // every run sees the same frames
+		else if (replayFrame != nullptr)
+			time = replayFrame->time;
 
 		UniformBufferObject ubo{};
 		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+		ubo.view = glm::lookAt(cameraTarget + glm::vec3(2.0f, 2.0f, 2.0f), cameraTarget, glm::vec3(0.0f, 0.0f, 1.0f));
 		ubo.projection = glm::perspective(glm::radians(45.0f), (float)swapChainExtent.width / swapChainExtent.height, 0.1f, 10.0f);
 		
 		ubo.projection[1][1] *= -1;
+		ubo.viewProjection = ubo.projection * ubo.view;
+		// the motion vectors compare against last frame. the very first frame has nothing to compare against and reports no motion
+		ubo.previousModel = transformsValid ? frameUbo.model : ubo.model;
+		ubo.previousViewProjection = transformsValid ? frameUbo.viewProjection : ubo.viewProjection;
+		transformsValid = true;
+
+		// the next sub-pixel offset for the temporal upscaling. the projection moves the image by whole NDC units, 2 per render extent
+		frameJitter = useTemporalUpscaling ? TemporalUpscaler::jitter(jitterFrame++) : glm::vec2(0.0f);
+		VkExtent2D renderExtent = dynamicResolution.renderExtent(swapChainExtent);
+		frameJitterNdc = glm::vec2(2.0f * frameJitter.x / renderExtent.width, 2.0f * frameJitter.y / renderExtent.height);
+
+		frameUbo = ubo;
+		frameTime = time;
+	}
+
+	// frustum test of the object's bounding sphere and its level of detail. planes are pulled straight out of the view-projection matrix (Gribb/Hartmann)
+	void cullObjects() {
+		glm::mat4 viewProjection = frameUbo.projection * frameUbo.view;
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; ++r)
+			rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+		glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] }; // vulkan clip z is 0..w
+
+		glm::vec4 center = frameUbo.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		const float radius = 0.7072f; // half diagonal of the unit quad
+		glm::vec4 cameraWorld = glm::inverse(frameUbo.view) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		objectDepth = std::min(std::max(-(frameUbo.view * center).z / 10.0f, 0.0f), 1.0f); // 10 = the projection's far plane
+		objectVisible = true;
+		for (const glm::vec4& plane : planes) {
+			float distance = glm::dot(glm::vec3(plane), glm::vec3(center)) + plane.w;
+			if (distance < -radius * glm::length(glm::vec3(plane))) {
+				objectVisible = false;
+				break;
+			}
+		}
+
+		// the selected LOD's meshlets are culled on the GPU, in the mesh's own space. a plane transforms with the transpose of the matrix (dot(p, M * x) = dot(M^T * p, x)),
+		// and the camera is where the inverse view matrix puts the origin
+		glm::mat4 modelTranspose = glm::transpose(frameUbo.model);
+		for (int i = 0; i < 6; ++i) {
+			glm::vec4 plane = modelTranspose * planes[i];
+			meshletCullParams.frustumPlanes[i] = plane / glm::length(glm::vec3(plane)); // normalized, so the shaders can compare against the radius directly
+		}
+		meshletCullParams.cameraPosition = glm::inverse(frameUbo.model) * cameraWorld;
+
+		// level of detail from the projected error, against the swap chain's height since that's what the scene is upscaled to and seen at
+		const MeshletLod& lod = meshletRenderer.lods()[objectLod.select(lodErrors, glm::vec3(cameraWorld), glm::vec3(center), radius, frameUbo.projection, swapChainExtent.height)];
+		meshletCullParams.meshletOffset = lod.meshletOffset;
+		meshletCullParams.meshletCount = lod.meshletCount;
+
+		// the early cull tests against the pyramid last frame built, so with the transforms last frame was rendered with, the late cull with this
+		// frame's. the jitter is left out, the test allows a texel of slack for it
+		if (meshletCullPassBuilt) {
+			MeshletOcclusionParams occlusionParams{};
+			occlusionParams.previousMeshToClip = frameUbo.previousViewProjection * frameUbo.previousModel;
+			occlusionParams.meshToClip = frameUbo.viewProjection * frameUbo.model;
+			occlusionParams.pyramidSize = glm::vec2(static_cast<float>(depthPyramid.extent().width), static_cast<float>(depthPyramid.extent().height));
+			occlusionParams.pyramidLevels = depthPyramid.levelCount();
+			occlusionParams.earlyOcclusion = splitMainPass && depthPyramid.built() ? 1 : 0; // never built without the split
+			meshletRenderer.setOcclusionParams(static_cast<uint32_t>(currentFrame), occlusionParams); // drawFrame() has waited for the frame's previous submission
+		}
+	}
 
+	void updateUniformBuffer(uint32_t currentImage) {
+		UniformBufferObject ubo = frameUbo;
+		ubo.projection = glm::translate(glm::mat4(1.0f), glm::vec3(frameJitterNdc, 0.0f)) * ubo.projection; // only what's rasterized is jittered
 		void* data;
 		vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
 		memcpy(data, &ubo, sizeof(ubo));
@@ -267,7 +807,7 @@ private:
 		allocInfo.allocationSize = memReqs.size;
 		allocInfo.memoryTypeIndex = findMemoryType(memReqs.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &outBufferMemory) != VK_SUCCESS) {
+		if (allocateDeviceMemory(device, allocInfo, bufferMemoryCategory(usage), outBufferMemory) != VK_SUCCESS) {
 			throw std::runtime_error("Failed to allocate buffer memory!");
 		}
 
@@ -296,33 +836,23 @@ private:
 
 		vkEndCommandBuffer(commandBuffer); // only contains the copy command, we we can stop recording now
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
+		TimelineSubmit submit;
+		submit.addCommandBuffer(commandBuffer);
+		uint64_t uploadValue = graphicsTimeline.submit(submit);
+		graphicsTimeline.wait(uploadValue); // only this copy, not whatever else is on the queue
 
 		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 	}
 
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i)
-			if ((typeFilter & (1 << i)) && ((memProperties.memoryTypes[i].propertyFlags & properties) == properties))
-				return i;
-
-		throw std::runtime_error("Failed to find suitable memory type!");
+		return memoryTelemetry.findMemoryType(typeFilter, properties); // from the properties it cached when the device was created
 	}
 
 
 	std::vector<VkCommandBuffer> commandBuffers;
-	// allocates and records the commands for each swap chain image
+	// allocates a command buffer for each swap chain image. they're re-recorded every frame by recordCommandBuffer()
 	void createCommandBuffers() {
-		commandBuffers.resize(swapChainFrameBuffers.size());
+		commandBuffers.resize(swapChainImages.size());
 
 		VkCommandBufferAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -333,102 +863,434 @@ private:
 		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate command buffers!");
 		}
+	}
+
+	// runs as a frame task, possibly on a worker thread. that's fine as long as nothing else is recording into a buffer from commandPool at the same time
+	void recordCommandBuffer(uint32_t imageIndex) {
+		VkCommandBuffer commandBuffer = commandBuffers[imageIndex];
+		vkResetCommandBuffer(commandBuffer, 0); // the pool was created with RESET_COMMAND_BUFFER_BIT. the image's previous frame has finished, drawFrame waited for its timeline value
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+
+		dynamicResolution.writeFrameStart(commandBuffer, static_cast<uint32_t>(currentFrame));
+		asyncCompute.recordGraphicsAcquire(commandBuffer, static_cast<uint32_t>(currentFrame)); // take over whatever this frame's compute work produced
+		worldStreamer.recordUploads(commandBuffer); // the chunks update() staged this frame, before the main pass draws them
+		renderGraph.setImportedImage(backbuffer, swapChainImages[imageIndex], swapChainImageViews[imageIndex]);
+		if (meshletCullPassBuilt) { // what the graph was built with, useMeshShaders may already have changed for the next one
+			renderGraph.setImportedBuffer(meshletIndices, meshletRenderer.visibleIndexBuffer(static_cast<uint32_t>(currentFrame)));
+			renderGraph.setImportedBuffer(meshletDrawArgs, meshletRenderer.drawArgsBuffer(static_cast<uint32_t>(currentFrame)));
+			renderGraph.setImportedBuffer(meshletOccluded, meshletRenderer.occludedBuffer(static_cast<uint32_t>(currentFrame)));
+			depthPyramid.recordInitialTransition(commandBuffer); // after every swap chain recreation, the graph expects it shader readable
+		}
+		shadowCascades.recordInitialTransition(commandBuffer); // first frame only, the graph expects the shadow map shader readable
+		if (useTemporalUpscaling) {
+			temporalUpscaler.nextFrame();
+			temporalUpscaler.recordInitialTransition(commandBuffer); // same for the histories, after every swap chain recreation
+			renderGraph.setImportedImage(historyRead, temporalUpscaler.historyImage(false), temporalUpscaler.historyView(false));
+			renderGraph.setImportedImage(historyWrite, temporalUpscaler.historyImage(true), temporalUpscaler.historyView(true));
+		}
+		buildMainPassDrawList(); // before the passes, the meshlet cull needs the object's instances
+		renderGraph.execute(commandBuffer); // barriers + every pass, in dependency order
+		asyncCompute.recordGraphicsRelease(commandBuffer, static_cast<uint32_t>(currentFrame));
+		dynamicResolution.writeFrameEnd(commandBuffer, static_cast<uint32_t>(currentFrame));
 
-		// command buffer recording:
-		for (size_t i = 0; i < commandBuffers.size(); ++i) {
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
 
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!");
+	std::chrono::steady_clock::time_point lastSimulationTime = std::chrono::steady_clock::now();
+	float simulationStep = 0.0f; // this frame's, for a capture
+	// this frame's async compute work: the particle simulation and the light binning. only recorded here, drawFrame() submits it before the graphics
+	// work that consumes it
+	void recordComputeCommandBuffer() {
+		auto currentTime = std::chrono::steady_clock::now();
+		float deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastSimulationTime).count();
+		lastSimulationTime = currentTime;
+		deltaTime = std::min(deltaTime, 0.1f); // don't let a hitch (window drag, breakpoint) launch everything at once
+		if (benchmarkScene != nullptr)
+			deltaTime = BENCHMARK_FRAME_SECONDS;
+		else if (replayFrame != nullptr)
+			deltaTime = replayFrame->simulationStep;
+		simulationStep = deltaTime;
+
+		VkCommandBuffer commandBuffer = asyncCompute.begin(static_cast<uint32_t>(currentFrame));
+		particleSystem.recordSimulation(commandBuffer, static_cast<uint32_t>(currentFrame), deltaTime);
+		clusteredLighting.recordCull(commandBuffer, static_cast<uint32_t>(currentFrame)); // after the light update task
+	}
+
+	// the "main" and "main late" render graph passes. without the split (mesh shaders) "main" draws everything. with it "main" clears and draws the
+	// terrain and the meshlets the early cull kept, and "main late" goes on in the same attachments with the meshlets the late cull found visible and
+	// the particles, which blend over all of it
+	// ids the main pass's draw list sorts by
+	enum MainPassPipeline : uint32_t { SCENE_PIPELINE, MESHLET_PIPELINE, PARTICLE_PIPELINE, CHUNK_PIPELINE };
+	enum MainPassMesh : uint32_t { SCENE_MESH, PARTICLE_MESH, CHUNK_MESH };
+	static const uint32_t TERRAIN_LAYER = 0; // the ground goes first, it hides the most and fills the depth buffer for everything after it
+	static const uint32_t OPAQUE_LAYER = 1;
+	static const uint32_t BLENDED_LAYER = 2;
+	DrawList mainPassDraws; // only touched by the recording task, the title reads its stats between frames
+	uint32_t sceneObjectCount = 1;
+	uint32_t sceneInstanceCount = 0; // this frame's instances of the object, 0 when it's culled
+	// the main pass's draws, sorted by state so every pipeline and descriptor set is bound once and each batch is a single instanced draw. the object
+	// has to be drawn before the particles (additive, on top of it), which the blended layer takes care of. the per instance data goes where the sort
+	// put the instance, so a batch's firstInstance is also where its data starts. every copy of the object shares its transform: the meshlets are
+	// culled once for all of them, in the object's space
+	void buildMainPassDrawList() {
+		mainPassDraws.clear();
+		DrawState terrain{};
+		terrain.layer = TERRAIN_LAYER;
+		terrain.pipeline = CHUNK_PIPELINE;
+		terrain.mesh = CHUNK_MESH;
+		for (const WorldStreamer::ResidentChunk& chunk : worldStreamer.residentChunks()) { // front to back inside the one batch, the nearer hills hide the farther ones
+			glm::vec4 bounds = worldStreamer.chunkBounds(chunk);
+			float depth = std::min(std::max(-(frameUbo.view * glm::vec4(glm::vec3(bounds), 1.0f)).z / 10.0f, 0.0f), 1.0f); // 10 = the projection's far plane
+			mainPassDraws.add(terrain, depth, chunk.slot);
+		}
+		if (objectVisible) {
+			DrawState scene{};
+			scene.layer = OPAQUE_LAYER;
+			scene.pipeline = useMeshShaders ? MESHLET_PIPELINE : SCENE_PIPELINE;
+			scene.mesh = SCENE_MESH;
+			for (uint32_t object = 0; object < sceneObjectCount; ++object) // more than one only in benchmark scenes
+				mainPassDraws.add(scene, objectDepth, object);
+		}
+		DrawState particles{};
+		particles.layer = BLENDED_LAYER;
+		particles.pipeline = PARTICLE_PIPELINE;
+		particles.mesh = PARTICLE_MESH;
+		mainPassDraws.add(particles, 0.0f, 0);
+		mainPassDraws.sort(&jobSystem);
+
+		InstanceData* instances = instanceBuffersMapped[frameImageIndex]; // drawFrame() has waited for the image's previous frame
+		sceneInstanceCount = 0;
+		meshletCullParams.firstInstance = 0;
+		for (const DrawBatch& batch : mainPassDraws.batches()) {
+			if (batch.state.mesh != SCENE_MESH)
+				continue; // the terrain is in world space and the particles have their own buffers
+			for (uint32_t instance = batch.firstInstance; instance < batch.firstInstance + batch.instanceCount; ++instance)
+				instances[instance] = InstanceData{ frameUbo.model, frameUbo.previousModel };
+			meshletCullParams.firstInstance = batch.firstInstance;
+			sceneInstanceCount = batch.instanceCount;
+		}
+	}
+	void recordMainPass(VkCommandBuffer commandBuffer, bool late) {
+		// render pass:
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = late ? lateRenderPass : renderPass;
+		renderPassInfo.framebuffer = sceneFrameBuffer; // attachments to bind, the same for both halves
+
+		VkExtent2D renderExtent = dynamicResolution.renderExtent(swapChainExtent);
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = renderExtent; // only the scaled part is cleared and rendered, the upscale pass only reads that part
+
+		// indexed by attachment, VK_ATTACHMENT_LOAD_OP_CLEAR only reads the ones it clears: color and velocity (the MSAA ones when there are) and the
+		// depth, which is always last. no motion where nothing is drawn. the late half loads everything and clears nothing
+		uint32_t attachmentCount = msaaSamples != VK_SAMPLE_COUNT_1_BIT ? 5 : 3;
+		VkClearValue clearValues[5] = {};
+		clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+		clearValues[1].color = { { 0.0f, 0.0f, 0.0f, 0.0f } };
+		clearValues[attachmentCount - 1].depthStencil = { 1.0f, 0 };
+		renderPassInfo.clearValueCount = late ? 0 : attachmentCount;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // vkCmd prefix = records commands, and returns void. so no error handling until finished recording
+
+		// viewport and scissor are dynamic state, they change with the resolution scale. both pipelines keep them, so set once for the pass
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)renderExtent.width;
+		viewport.height = (float)renderExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0, 0 };
+		scissor.extent = renderExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		// the pass's draws go through a draw list (see buildMainPassDrawList()), a draw per batch. the late half picks its draws out of the same batches
+		const VkPipeline pipelines[] = { graphicsPipeline, meshletPipeline, particlePipeline, chunkPipeline }; // by MainPassPipeline
+		const VkPipelineLayout pipelineLayouts[] = { pipelineLayout, meshletPipelineLayout, particlePipelineLayout, pipelineLayout };
+		const DrawState* previous = nullptr;
+		for (const DrawBatch& batch : mainPassDraws.batches()) {
+			if (splitMainPass) { // early: everything but the blended layer. late: the compute culled meshlets again (their late draw), then the blended layer
+				bool blended = batch.state.layer == BLENDED_LAYER;
+				if (late ? !blended && batch.state.pipeline != SCENE_PIPELINE : blended)
+					continue;
+			}
+			VkPipelineLayout layout = pipelineLayouts[batch.state.pipeline];
+			if (previous == nullptr || previous->pipeline != batch.state.pipeline) { // rebinds set 0 as well, the layouts don't all match
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[batch.state.pipeline]);
+				VkDescriptorSet sets[3] = { descriptorSets[frameImageIndex], clusteredLighting.set(static_cast<uint32_t>(currentFrame)), shadowCascades.set(static_cast<uint32_t>(currentFrame)) };
+				uint32_t setCount = batch.state.pipeline == PARTICLE_PIPELINE ? 1 : 3; // everything but the particles is lit, set 1 is the lighting, set 2 the shadows
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, setCount, sets, 0, nullptr);
+			}
+			previous = &batch.state;
+
+			if (batch.state.mesh == CHUNK_MESH) { // one batch for the whole terrain: bind once, then one indirect draw with a command per chunk
+				worldStreamer.recordBindBuffers(commandBuffer);
+				worldStreamer.recordDraws(commandBuffer, static_cast<uint32_t>(currentFrame), &mainPassDraws.instances()[batch.firstInstance], batch.instanceCount);
+			} else if (batch.state.mesh == PARTICLE_MESH) {
+				particleSystem.recordDraw(commandBuffer, static_cast<uint32_t>(currentFrame), layout); // instance count comes from the compute shaders
+			} else if (batch.state.pipeline == MESHLET_PIPELINE) {
+				MeshletCullParams params = meshletCullParams;
+				params.firstInstance = batch.firstInstance;
+				meshletRenderer.recordMeshShaderDraw(commandBuffer, layout, params, batch.instanceCount); // the batch's instances are the task shaders' z
+			} else {
+				VkBuffer vertexBuffers[] = { vertexBuffer };
+				VkDeviceSize offsets[] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+				meshletRenderer.recordDraw(commandBuffer, static_cast<uint32_t>(currentFrame), late); // the phase's visible meshlets' triangles, the batch's instances come with the draw arguments
+			}
+		}
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	// the "shadow cascades" render graph pass. only the cascades update() decided need it, the others keep what an earlier frame rendered
+	void recordShadowPass(VkCommandBuffer commandBuffer) {
+		for (uint32_t cascade = 0; cascade < shadowCascades.cascadeCount(); ++cascade) {
+			if (!shadowCascades.needsRender(cascade))
+				continue;
+			shadowCascades.beginCascade(commandBuffer, cascade);
+
+			ShadowPushConstants push{};
+			push.lightViewProjection = shadowCascades.lightViewProjection(cascade);
+			push.model = glm::mat4(1.0f); // the chunks are in world space already
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, chunkShadowPipeline);
+			vkCmdPushConstants(commandBuffer, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+			worldStreamer.recordBindBuffers(commandBuffer);
+			for (const WorldStreamer::ResidentChunk& chunk : worldStreamer.residentChunks()) {
+				if (shadowCascades.casterVisible(cascade, worldStreamer.chunkBounds(chunk)))
+					worldStreamer.recordDraw(commandBuffer, chunk.slot);
 			}
 
-			// render pass:
-			VkRenderPassBeginInfo renderPassInfo{};
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFrameBuffers[i]; // attachments to bind - a framebuffer for each swap chain image that specifies it as color attachment
-
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
-
-			VkClearValue clearColor = { 0.0f, 0.0f, 0.0f, 1.0f }; // for VK_ATTACHMENT_LOAD_OP_CLEAR
-			renderPassInfo.clearValueCount = 1;
-			renderPassInfo.pClearValues = &clearColor;
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE); // vkCmd prefix = records commands, and returns void. so no error handling until finished recording
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-			VkBuffer vertexBuffers[] = { vertexBuffer };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffer, 0, VK_INDEX_TYPE_UINT16); // can only have a single index buffer
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-			vkCmdEndRenderPass(commandBuffers[i]);
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
+			if (shadowCascades.includesDynamic(cascade)) {
+				push.model = frameUbo.model;
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sceneShadowPipeline);
+				vkCmdPushConstants(commandBuffer, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+				VkBuffer vertexBuffers[] = { vertexBuffer };
+				VkDeviceSize offsets[] = { 0 };
+				vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+				vkCmdBindIndexBuffer(commandBuffer, shadowIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+				vkCmdDrawIndexed(commandBuffer, shadowIndexCount, 1, 0, 0, 0);
 			}
+			shadowCascades.endCascade(commandBuffer);
 		}
 	}
 
-	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
-	void createDescriptorPool() {
-		VkDescriptorPoolSize poolSize{};
-		poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSize.descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+	// the "upscale" render graph pass. stretches the rendered part of the scene color over the whole swap chain image with a linear filter. with temporal
+	// upscaling the sharpened result is already at the swap chain's size, and this only copies it into the swap chain's format
+	void recordUpscalePass(VkCommandBuffer commandBuffer) {
+		VkExtent2D renderExtent = useTemporalUpscaling ? swapChainExtent : dynamicResolution.renderExtent(swapChainExtent); // the temporal resolve has upscaled already
+		VkImage source = renderGraph.image(useTemporalUpscaling ? postColor : sceneColor);
+
+		VkImageBlit blit{};
+		blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+		blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { static_cast<int32_t>(swapChainExtent.width), static_cast<int32_t>(swapChainExtent.height), 1 };
+		VkFilter filter = renderExtent.width == swapChainExtent.width && renderExtent.height == swapChainExtent.height ? VK_FILTER_NEAREST : VK_FILTER_LINEAR; // 1:1 is a plain copy
+		vkCmdBlitImage(commandBuffer, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, renderGraph.image(backbuffer), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, filter);
+	}
 
-		VkDescriptorPoolCreateInfo poolInfo{};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = 1;
-		poolInfo.pPoolSizes = &poolSize;
-		poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+	DynamicResolution dynamicResolution;
+	void createDynamicResolution() {
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+		uint32_t queueFamilyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+		uint32_t timestampValidBits = queueFamilies[findQueueFamilies(physicalDevice).graphicsFamily.value()].timestampValidBits;
 
-		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
-			throw std::runtime_error("Failed to create descriptor pool!");
+		dynamicResolution.init(device, deviceProperties.limits.timestampPeriod, timestampValidBits, MAX_FRAMES_IN_FLIGHT);
+		dynamicResolution.setMaxScale(useTemporalUpscaling ? TEMPORAL_RENDER_SCALE : 1.0f);
 	}
 
-	void createDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
-		VkDescriptorSetAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-		allocInfo.pSetLayouts = layouts.data();
+	TemporalUpscaler temporalUpscaler;
+	static const VkFormat VELOCITY_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+	static constexpr float TEMPORAL_RENDER_SCALE = 0.71f; // per axis, about half the pixels. the dynamic resolution can still go below it
+	// the pipelines only, the history images are sized for the swap chain and created with the render graph
+	void createTemporalUpscaler() {
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		VkShaderModule resolveShader = createShaderModule(readFile("Shaders/taa_resolve.spv"));
+		VkShaderModule sharpenShader = createShaderModule(readFile("Shaders/sharpen.spv"));
+		temporalUpscaler.init(device, memProperties, descriptorCache, resolveShader, sharpenShader, TemporalUpscaler::Settings{});
+		vkDestroyShaderModule(device, sharpenShader, nullptr);
+		vkDestroyShaderModule(device, resolveShader, nullptr);
+	}
 
-		descriptorSets.resize(swapChainImages.size());
-		if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
-			throw std::runtime_error("Failed to allocate descriptor sets!");
+	DepthPyramid depthPyramid;
+	bool useOcclusionCulling = true;
+	bool requestedOcclusionCulling = true;
+	// the split main pass and the late phase are part of the render pass and the render graph, so it takes effect with the swap chain recreation like
+	// the temporal upscaling. only the compute culled meshlets are occlusion culled
+	void setUseOcclusionCulling(bool enable) {
+		requestedOcclusionCulling = enable;
+		swapChainSettingsChanged = true;
+	}
+	// the Hi-Z pyramid the compute culled meshlets are occlusion tested against (see DepthPyramid.h and MeshletRenderer.h). the pipelines only, the
+	// pyramid is sized for the swap chain and created with the render graph
+	void createDepthPyramid() {
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		VkShaderModule buildShader = createShaderModule(readFile("Shaders/depth_pyramid.spv"));
+		VkShaderModule multisampledShader = createShaderModule(readFile("Shaders/depth_pyramid_ms.spv"));
+		depthPyramid.init(device, memProperties, descriptorCache, buildShader, multisampledShader);
+		vkDestroyShaderModule(device, multisampledShader, nullptr);
+		vkDestroyShaderModule(device, buildShader, nullptr);
+	}
 
-		for (size_t i = 0; i < swapChainImages.size(); ++i) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
+	// sets that don't change, by layout and bindings (see DescriptorAllocator.h): the frame's uniform buffers and the swap chain sized targets of the
+	// temporal upscaler and the depth pyramid. the modules that create their sets once at init keep their own pools, sized exactly for them
+	DescriptorSetCache descriptorCache;
+	// once, not with the swap chain: the pools grow as needed, and the cache's sets outlive the resources they were written for (see forget())
+	void createDescriptorAllocators() {
+		descriptorCache.init(device, graphicsTimeline);
+	}
 
-			VkWriteDescriptorSet descriptorWrite{};
-			descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrite.dstSet = descriptorSets[i];
-			descriptorWrite.dstBinding = 0;
-			descriptorWrite.dstArrayElement = 0;
-			descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrite.descriptorCount = 1;
-			descriptorWrite.pBufferInfo = &bufferInfo;
-			
-			vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	std::vector<VkDescriptorSet> descriptorSets;
+	void createDescriptorSets() { // the uniform buffers are new with every swap chain, their sets come from the cache's free list after the first one
+		descriptorSets.resize(swapChainImages.size());
+		for (size_t i = 0; i < swapChainImages.size(); ++i) {
+			DescriptorBinding bindings[2] = {
+				DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffers[i], 0, sizeof(UniformBufferObject)),
+				DescriptorBinding::buffer(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, instanceBuffers[i], 0, instanceBufferSize()),
+			};
+			descriptorSets[i] = descriptorCache.get(descriptorSetLayout, bindings, 2);
 		}
 	}
 
 	VkCommandPool commandPool;
+	GpuTimeline graphicsTimeline; // signaled by every graphics queue submission. the compute queue's is in asyncCompute
+	void createTimelines() {
+		graphicsTimeline.init(device, graphicsQueue);
+	}
+
+	AsyncCompute asyncCompute;
+	void createAsyncCompute() {
+		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+		asyncCompute.init(device, computeQueue, queueFamilyIndices.computeFamily.value(), queueFamilyIndices.graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT, graphicsTimeline);
+	}
+
+	ParticleSystem particleSystem;
+	void createParticleSystem() {
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+
+		std::vector<std::vector<char>> code = assets.readFiles({ "Shaders/particle_begin.spv", "Shaders/particle_emit.spv", "Shaders/particle_simulate.spv",
+			"Shaders/particle_compact.spv" }, jobSystem); // decompressed side by side
+		ParticleSystem::Shaders shaders{};
+		shaders.begin = createShaderModule(code[0]);
+		shaders.emit = createShaderModule(code[1]);
+		shaders.simulate = createShaderModule(code[2]);
+		shaders.compact = createShaderModule(code[3]);
+		particleSystem.init(device, memProperties, 1u << 20, MAX_FRAMES_IN_FLIGHT, shaders);
+		vkDestroyShaderModule(device, shaders.begin, nullptr);
+		vkDestroyShaderModule(device, shaders.emit, nullptr);
+		vkDestroyShaderModule(device, shaders.simulate, nullptr);
+		vkDestroyShaderModule(device, shaders.compact, nullptr);
+
+		// a fountain under the quad. 250k/s living ~4s keeps roughly a million particles alive
+		ParticleEmitter fountain{};
+		fountain.position = glm::vec3(0.0f, 0.0f, -0.5f);
+		fountain.radius = 0.05f;
+		fountain.velocity = glm::vec3(0.0f, 0.0f, 2.0f);
+		fountain.velocitySpread = 0.6f;
+		fountain.colorStart = glm::vec4(1.0f, 0.6f, 0.2f, 1.0f);
+		fountain.colorEnd = glm::vec4(0.2f, 0.1f, 0.8f, 0.0f);
+		fountain.lifetime = 4.0f;
+		fountain.size = 0.004f;
+		fountain.rate = 250000.0f;
+		particleSystem.addEmitter(fountain);
+
+		particleSystem.registerHandoffs(asyncCompute);
+	}
+
+	ClusteredLighting clusteredLighting;
+	std::vector<GpuLight> sceneLights; // the animated lights, rewritten by the light update task. sized once, frames don't allocate
+	std::vector<glm::vec4> lightOrbits; // per light: xy the center it circles, z its height, w its phase
+	// a few thousand small point lights drifting in circles over the terrain around the origin. light_cull.comp bins them every frame (see ClusteredLighting.h)
+	void createClusteredLighting() {
+		const uint32_t LIGHTS_PER_SIDE = 64;
+		const float LIGHT_SPACING = 0.25f;
+
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		VkShaderModule cullShader = createShaderModule(readFile("Shaders/light_cull.spv"));
+		clusteredLighting.init(device, memProperties, LIGHTS_PER_SIDE * LIGHTS_PER_SIDE, MAX_FRAMES_IN_FLIGHT, cullShader);
+		vkDestroyShaderModule(device, cullShader, nullptr);
+		clusteredLighting.registerHandoffs(asyncCompute); // the cull runs on the compute queue, see recordComputeCommandBuffer()
+
+		sceneLights.resize(LIGHTS_PER_SIDE * LIGHTS_PER_SIDE);
+		lightOrbits.resize(sceneLights.size());
+		uint32_t seed = 12345;
+		auto random = [&seed]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) / 16777216.0f; }; // LCG, 0..1
+		for (uint32_t y = 0; y < LIGHTS_PER_SIDE; ++y) {
+			for (uint32_t x = 0; x < LIGHTS_PER_SIDE; ++x) {
+				uint32_t i = y * LIGHTS_PER_SIDE + x;
+				glm::vec2 center = (glm::vec2(static_cast<float>(x), static_cast<float>(y)) - (LIGHTS_PER_SIDE - 1) * 0.5f) * LIGHT_SPACING;
+				lightOrbits[i] = glm::vec4(center, -0.55f + random() * 0.5f, random() * 6.2831853f); // from just above the terrain to around the quad
+				glm::vec3 hue = glm::vec3(random(), random(), random());
+				sceneLights[i].color = glm::vec4(hue / std::max(hue.x, std::max(hue.y, hue.z)) * 1.5f, 0.0f); // saturated, brightest channel 1.5
+				sceneLights[i].positionRadius.w = 0.2f + random() * 0.25f;
+			}
+		}
+	}
+
+	// the light update frame task. moves the lights and hands them to the clustered lighting with this frame's camera, after the transform update
+	void updateLights() {
+		const float ORBIT_RADIUS = 0.1f;
+		for (size_t i = 0; i < sceneLights.size(); ++i) {
+			const glm::vec4& orbit = lightOrbits[i];
+			float angle = orbit.w + frameTime * 1.5f;
+			sceneLights[i].positionRadius = glm::vec4(orbit.x + std::cos(angle) * ORBIT_RADIUS, orbit.y + std::sin(angle) * ORBIT_RADIUS, orbit.z, sceneLights[i].positionRadius.w);
+		}
+		clusteredLighting.update(static_cast<uint32_t>(currentFrame), frameUbo.view, frameUbo.projection, dynamicResolution.renderExtent(swapChainExtent),
+			sceneLights.data(), static_cast<uint32_t>(sceneLights.size()));
+	}
+
+	ShadowCascades shadowCascades;
+	glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -0.25f, -1.0f)); // where the sunlight travels, low enough for long shadows. F7 turns it
+	glm::vec3 sunColor = glm::vec3(0.9f, 0.85f, 0.7f);
+	// the sun's shadow: the terrain is the static caster, the quad the dynamic one. the particles don't cast (see ShadowCascades.h)
+	void createShadowCascades() {
+		shadowCascades.init(device, physicalDevice, MAX_FRAMES_IN_FLIGHT, ShadowCascades::Settings{});
+	}
+
+	// the shadow update frame task. refits the cascades to this frame's camera, after the transform update. the terrain only changes when a chunk
+	// streams in or out, so its residency version is what invalidates the cached cascades
+	void updateShadows() {
+		glm::vec4 center = frameUbo.model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		glm::vec4 quadSphere = glm::vec4(center.x, center.y, center.z, 0.7072f); // same bounds as cullObjects()
+		shadowCascades.update(static_cast<uint32_t>(currentFrame), frameUbo.view, frameUbo.projection, sunDirection, sunColor, worldStreamer.residencyVersion(), &quadSphere, 1);
+	}
+
+	void rotateSun() {
+		sunDirection = glm::vec3(glm::rotate(glm::mat4(1.0f), glm::radians(15.0f), glm::vec3(0.0f, 0.0f, 1.0f)) * glm::vec4(sunDirection, 0.0f));
+	}
+
+	DeletionQueue deletionQueue; // anything the GPU might still be using is destroyed through this, see cleanupSwapChain()
+	void createDeletionQueue() {
+		deletionQueue.init(device, graphicsTimeline, asyncCompute.timeline());
+	}
+
 	void createCommandPool() {
 		QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
 		VkCommandPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value(); // record commands for drawing
-		poolInfo.flags = 0;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // command buffers are re-recorded every frame
 
 		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
@@ -436,25 +1298,31 @@ private:
 	}
 
 
-	std::vector<VkFramebuffer> swapChainFrameBuffers;
-	void createFrameBuffers() {
-		swapChainFrameBuffers.resize(swapChainImageViews.size());
-
-		for (size_t i = 0; i < swapChainImageViews.size(); ++i) {
-			VkImageView attachments[1] = { swapChainImageViews[i] }; // only 1 for now, the color attachment
-
-			VkFramebufferCreateInfo frameBufferInfo{};
-			frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			frameBufferInfo.renderPass = renderPass;
-			frameBufferInfo.attachmentCount = 1;
-			frameBufferInfo.pAttachments = attachments;
-			frameBufferInfo.width = swapChainExtent.width;
-			frameBufferInfo.height = swapChainExtent.height;
-			frameBufferInfo.layers = 1;
+	VkFramebuffer sceneFrameBuffer; // the scene color target. only one, the render graph's transient image is the same every frame
+	void createSceneFrameBuffer() {
+		// same order as the render pass: what's drawn to, then the resolve targets if there are any, then the depth
+		VkImageView attachments[5] = { renderGraph.imageView(sceneColor), renderGraph.imageView(sceneVelocity), renderGraph.imageView(sceneDepth), VK_NULL_HANDLE, VK_NULL_HANDLE };
+		uint32_t attachmentCount = 3;
+		if (msaaSamples != VK_SAMPLE_COUNT_1_BIT) {
+			attachments[0] = msaaColorImageView;
+			attachments[1] = msaaVelocityImageView;
+			attachments[2] = renderGraph.imageView(sceneColor);
+			attachments[3] = renderGraph.imageView(sceneVelocity);
+			attachments[4] = renderGraph.imageView(sceneDepth);
+			attachmentCount = 5;
+		}
 
-			if (vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &swapChainFrameBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create framebuffer!");
-			}
+		VkFramebufferCreateInfo frameBufferInfo{};
+		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferInfo.renderPass = renderPass;
+		frameBufferInfo.attachmentCount = attachmentCount;
+		frameBufferInfo.pAttachments = attachments;
+		frameBufferInfo.width = swapChainExtent.width; // full size, the render area picks the scaled part of it
+		frameBufferInfo.height = swapChainExtent.height;
+		frameBufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(device, &frameBufferInfo, nullptr, &sceneFrameBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create framebuffer!");
 		}
 	}
 
@@ -464,64 +1332,58 @@ private:
 	VkRenderPass renderPass;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	void createGraphicsPipeline() {
-		std::vector<char> vertShaderCode = readFile("Shaders/vert.spv");
-		std::vector<char> fragShaderCode = readFile("Shaders/frag.spv");
-		//std::cout << "vertShaderCode.size: " << vertShaderCode.size() << ", fragShaderCode.size: " << fragShaderCode.size() << std::endl;
+	// the parts that differ between the graphics pipelines, the rest of the fixed function setup in buildGraphicsPipeline() is shared
+	struct GraphicsPipelineDesc {
+		const char* vertShaderPath; // or, for a mesh shader pipeline, taskShaderPath (optional) + meshShaderPath and no vertex shader
+		const char* fragShaderPath;
+		const VkPipelineVertexInputStateCreateInfo* vertexInput;
+		VkPipelineLayout layout;
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		bool additiveBlend = false;
+		const char* taskShaderPath = nullptr;
+		const char* meshShaderPath = nullptr;
+		const VkSpecializationInfo* meshSpecialization = nullptr;
+		VkRenderPass renderPass = VK_NULL_HANDLE; // null for the main render pass
+		bool depthOnly = false; // shadow casters: single sampled, depth test and write with a bias, no color attachment. fragShaderPath can be null
+		float depthBiasConstant = 0.0f; // depthOnly only
+		float depthBiasSlope = 0.0f;
+	};
 
+	VkPipeline buildGraphicsPipeline(const GraphicsPipelineDesc& desc) {
 		// the compilation and the linking of SPIR-V bytecode to machine code for execution by the GPU doesn't happen until the graphics pipeline is created, so we can create these as
 		// local variables because we're allowed to destroy the shader modules as soon as the pipeline creation is finished. we Destroy them at the end of this function.
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-		// Shader Stage Creation:
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main"; // the name of the entrypoint function to invoke
-		//vertShaderStageInfo.pSpecializationInfo = nullptr; // done automatically anyway from struct initialization. same with for fragment shader below.
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main"; // the name of the entrypoint function to invoke
-
-		VkPipelineShaderStageCreateInfo shaderStages[2] = { vertShaderStageInfo, fragShaderStageInfo };
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+		auto addStage = [&](VkShaderStageFlagBits stage, const char* path, const VkSpecializationInfo* specialization) {
+			VkPipelineShaderStageCreateInfo stageInfo{};
+			stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stageInfo.stage = stage;
+			stageInfo.module = createShaderModule(readFile(path));
+			stageInfo.pName = "main"; // the name of the entrypoint function to invoke
+			stageInfo.pSpecializationInfo = specialization;
+			shaderStages.push_back(stageInfo);
+		};
+		bool meshPipeline = desc.meshShaderPath != nullptr;
+		if (meshPipeline) {
+			if (desc.taskShaderPath != nullptr)
+				addStage(VK_SHADER_STAGE_TASK_BIT_EXT, desc.taskShaderPath, nullptr);
+			addStage(VK_SHADER_STAGE_MESH_BIT_EXT, desc.meshShaderPath, desc.meshSpecialization);
+		} else {
+			addStage(VK_SHADER_STAGE_VERTEX_BIT, desc.vertShaderPath, nullptr);
+		}
+		if (desc.fragShaderPath != nullptr) // a depth only pipeline doesn't need one
+			addStage(VK_SHADER_STAGE_FRAGMENT_BIT, desc.fragShaderPath, nullptr);
 
 		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
 		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST; // triangle from every 3 vertices without reuse
 		inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
 		VkPipelineViewportStateCreateInfo viewportState{};
 		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
+		viewportState.pViewports = nullptr; // dynamic, set per frame from the dynamic resolution scale
 		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
+		viewportState.pScissors = nullptr;
 
 		VkPipelineRasterizationStateCreateInfo rasterizer{};
 		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -529,95 +1391,274 @@ private:
 		rasterizer.rasterizerDiscardEnable = VK_FALSE; // false to allow geometry to pass through the rasterizer stage
 		rasterizer.polygonMode = VK_POLYGON_MODE_FILL; // how the fragments are generated for geo: _FILL to fill the area with fragments, _LINE for only polygon edges (wireframe), _POINT for just the points. (last 2 req enable GPU feature)
 		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+		rasterizer.cullMode = desc.cullMode;
 		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-		rasterizer.depthBiasConstantFactor = 0.0f;
+		rasterizer.depthBiasEnable = desc.depthOnly ? VK_TRUE : VK_FALSE; // pushes the shadow casters back a little, against acne on the surfaces facing the light
+		rasterizer.depthBiasConstantFactor = desc.depthBiasConstant;
 		rasterizer.depthBiasClamp = 0.0f;
-		rasterizer.depthBiasSlopeFactor = 0.0f;
+		rasterizer.depthBiasSlopeFactor = desc.depthBiasSlope;
 
 		VkPipelineMultisampleStateCreateInfo multisampling{};
 		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
 		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		multisampling.rasterizationSamples = desc.depthOnly ? VK_SAMPLE_COUNT_1_BIT : msaaSamples; // has to match the render pass
 		multisampling.minSampleShading = 1.0f;
 		multisampling.pSampleMask = nullptr;
 		multisampling.alphaToCoverageEnable = VK_FALSE;
 		multisampling.alphaToOneEnable = VK_FALSE;
 
-		// DEPTH/STENCIL BUFFER TODO - VkPipelineDepthStencilStateCreateInfo depth{}; - just leave as nullptr for now
+		// everything tests depth. the additive particles don't write it, they'd cut holes into each other's glow depending on the draw order
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = desc.additiveBlend ? VK_FALSE : VK_TRUE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthStencil.depthBoundsTestEnable = VK_FALSE;
+		depthStencil.stencilTestEnable = VK_FALSE;
 
 		// specify how to combine the old value already in the frame buffer with the new returned color from the fragment shader:
 		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
 		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_FALSE;
+		colorBlendAttachment.blendEnable = desc.additiveBlend ? VK_TRUE : VK_FALSE;
 		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; //VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; //VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = desc.additiveBlend ? VK_BLEND_FACTOR_ONE : VK_BLEND_FACTOR_ZERO; //VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
 		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
 		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
 		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
 		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
+		// the motion vectors are written as they are. a blended pipeline leaves them to what's behind it: particles don't output any, and the
+		// temporal resolve's neighborhood clipping takes care of their ghosting
+		VkPipelineColorBlendAttachmentState velocityBlendAttachment{};
+		velocityBlendAttachment.colorWriteMask = desc.additiveBlend ? 0 : VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+		velocityBlendAttachment.blendEnable = VK_FALSE;
+		VkPipelineColorBlendAttachmentState blendAttachments[2] = { colorBlendAttachment, velocityBlendAttachment };
+
 		VkPipelineColorBlendStateCreateInfo colorBlending{};
 		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 		colorBlending.logicOpEnable = VK_FALSE;
 		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
+		colorBlending.attachmentCount = desc.depthOnly ? 0 : 2;
+		colorBlending.pAttachments = blendAttachments;
 		colorBlending.blendConstants[0] = colorBlending.blendConstants[1] = colorBlending.blendConstants[2] = colorBlending.blendConstants[3] = 0.0f;
 
 		VkDynamicState dynamicStates[2] = {
 			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_LINE_WIDTH
+			VK_DYNAMIC_STATE_SCISSOR
 		};
 		VkPipelineDynamicStateCreateInfo dynamicState{};
 		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
 		dynamicState.dynamicStateCount = 2;
 		dynamicState.pDynamicStates = dynamicStates;
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create pipeline layout!");
-		}
-
-
-
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages; // reference the earlier array of VkPipelineShaderStageCreateInfo structs
+		pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+		pipelineInfo.pStages = shaderStages.data(); // reference the earlier array of VkPipelineShaderStageCreateInfo structs
 
 		//reference all of the structures describing the fixed function stage:
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pVertexInputState = meshPipeline ? nullptr : desc.vertexInput; // mesh shaders fetch their own vertices and output assembled primitives
+		pipelineInfo.pInputAssemblyState = meshPipeline ? nullptr : &inputAssembly;
 		pipelineInfo.pViewportState = &viewportState;
 		pipelineInfo.pRasterizationState = &rasterizer;
 		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = nullptr; // optional
+		pipelineInfo.pDepthStencilState = &depthStencil;
 		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.pDynamicState = nullptr; // optional
+		pipelineInfo.pDynamicState = &dynamicState;
 
-		pipelineInfo.layout = pipelineLayout; // vulkan handle from earlier
+		pipelineInfo.layout = desc.layout;
 
-		pipelineInfo.renderPass = renderPass;
+		pipelineInfo.renderPass = desc.renderPass != VK_NULL_HANDLE ? desc.renderPass : renderPass;
 		pipelineInfo.subpass = 0; // index of the subpass where this graphics pipeline will be used
 
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // optional, but good to be explicit since we're not creating a new pipeline by deriving from an existing one.
 		pipelineInfo.basePipelineIndex = -1; // ^ also these values are only used if VK_PIPELINE_CREATE_DERIVATIVE_BIT is also set in this pipelineInfo.flags (VkGraphicsPipelineCreateInfo)
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline!");
 		}
 
 
 
-		vkDestroyShaderModule(device, fragShaderModule, nullptr);
-		vkDestroyShaderModule(device, vertShaderModule, nullptr);
+		for (const VkPipelineShaderStageCreateInfo& stage : shaderStages)
+			vkDestroyShaderModule(device, stage.module, nullptr);
+		return pipeline;
+	}
+
+	void createGraphicsPipeline() {
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		auto bindingDescription = Vertex::getBindingDescription();
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		VkDescriptorSetLayout setLayouts[3] = { descriptorSetLayout, clusteredLighting.setLayout(), shadowCascades.setLayout() }; // the camera UBO, the lights and the sun's shadow for shader.frag
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 3;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 0;
+		pipelineLayoutInfo.pPushConstantRanges = nullptr;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+
+		GraphicsPipelineDesc desc{};
+		desc.vertShaderPath = "Shaders/vert.spv";
+		desc.fragShaderPath = "Shaders/frag.spv";
+		desc.vertexInput = &vertexInputInfo;
+		desc.layout = pipelineLayout;
+		graphicsPipeline = buildGraphicsPipeline(desc);
+
+		createParticlePipeline();
+		createChunkPipeline();
+		createShadowPipelines();
+		if (meshShadersSupported)
+			createMeshletPipeline();
+	}
+
+	VkPipelineLayout meshletPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline meshletPipeline = VK_NULL_HANDLE;
+	// the mesh shader path of the meshlet renderer: task shader culls, mesh shader emits the triangles. set 0 is the camera UBO, sets 1 and 2 the lighting and
+	// shadows like the other lit pipelines, set 3 the meshlet buffers, and the cull parameters are push constants like in the compute path
+	void createMeshletPipeline() {
+		VkDescriptorSetLayout setLayouts[4] = { descriptorSetLayout, clusteredLighting.setLayout(), shadowCascades.setLayout(), meshletRenderer.meshSetLayout() };
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT; // both include the block from meshlet_common.glsl
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(MeshletCullParams);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 4;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &meshletPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create meshlet pipeline layout!");
+		}
+
+		// the mesh shader reads the vertex buffer as plain floats, tell it where the fields of Vertex are
+		uint32_t vertexLayout[2] = { sizeof(Vertex) / sizeof(float), offsetof(Vertex, color) / sizeof(float) };
+		VkSpecializationMapEntry mapEntries[2] = { { 0, 0, sizeof(uint32_t) }, { 1, sizeof(uint32_t), sizeof(uint32_t) } };
+		VkSpecializationInfo specialization{};
+		specialization.mapEntryCount = 2;
+		specialization.pMapEntries = mapEntries;
+		specialization.dataSize = sizeof(vertexLayout);
+		specialization.pData = vertexLayout;
+
+		GraphicsPipelineDesc desc{};
+		desc.taskShaderPath = "Shaders/meshlet_task.spv";
+		desc.meshShaderPath = "Shaders/meshlet_mesh.spv";
+		desc.meshSpecialization = &specialization;
+		desc.fragShaderPath = "Shaders/frag.spv"; // same outputs as shader.vert
+		desc.layout = meshletPipelineLayout;
+		meshletPipeline = buildGraphicsPipeline(desc);
+	}
+
+	VkPipeline chunkPipeline;
+	// the streamed terrain. same layout and fragment shader as the scene, chunk.vert takes world space positions and leaves out the model matrix
+	void createChunkPipeline() {
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		auto bindingDescription = ChunkVertex::getBindingDescription();
+		auto attributeDescriptions = ChunkVertex::getAttributeDescriptions();
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+		GraphicsPipelineDesc desc{};
+		desc.vertShaderPath = "Shaders/chunk_vert.spv";
+		desc.fragShaderPath = "Shaders/frag.spv";
+		desc.vertexInput = &vertexInputInfo;
+		desc.layout = pipelineLayout;
+		desc.cullMode = VK_CULL_MODE_NONE; // a ground plane, only ever seen from above anyway
+		chunkPipeline = buildGraphicsPipeline(desc);
+	}
+
+	// what the shadow pipelines push per draw, see Shaders/shadow.vert
+	struct ShadowPushConstants {
+		glm::mat4 lightViewProjection;
+		glm::mat4 model;
+	};
+	VkPipelineLayout shadowPipelineLayout;
+	VkPipeline sceneShadowPipeline;
+	VkPipeline chunkShadowPipeline;
+	// depth only variants of the scene and chunk pipelines for the shadow cascades. only the position attribute, shadow.vert takes it through the model and
+	// the cascade's matrix from push constants and nothing else, so there are no descriptor sets. no culling, the quad casts from both sides
+	void createShadowPipelines() {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ShadowPushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 0;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &shadowPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create shadow pipeline layout!");
+		}
+
+		GraphicsPipelineDesc desc{};
+		desc.vertShaderPath = "Shaders/shadow_vert.spv";
+		desc.fragShaderPath = nullptr;
+		desc.layout = shadowPipelineLayout;
+		desc.cullMode = VK_CULL_MODE_NONE;
+		desc.renderPass = shadowCascades.renderPass();
+		desc.depthOnly = true;
+		desc.depthBiasConstant = 1.25f; // in units of the D16 format's resolution
+		desc.depthBiasSlope = 1.75f;
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputInfo.vertexBindingDescriptionCount = 1;
+		vertexInputInfo.vertexAttributeDescriptionCount = 1; // the position comes first in both vertex formats
+		desc.vertexInput = &vertexInputInfo;
+
+		auto sceneBinding = Vertex::getBindingDescription();
+		auto sceneAttributes = Vertex::getAttributeDescriptions();
+		vertexInputInfo.pVertexBindingDescriptions = &sceneBinding;
+		vertexInputInfo.pVertexAttributeDescriptions = sceneAttributes.data();
+		sceneShadowPipeline = buildGraphicsPipeline(desc);
+
+		auto chunkBinding = ChunkVertex::getBindingDescription();
+		auto chunkAttributes = ChunkVertex::getAttributeDescriptions();
+		vertexInputInfo.pVertexBindingDescriptions = &chunkBinding;
+		vertexInputInfo.pVertexAttributeDescriptions = chunkAttributes.data();
+		chunkShadowPipeline = buildGraphicsPipeline(desc);
+	}
+
+	VkPipelineLayout particlePipelineLayout;
+	VkPipeline particlePipeline;
+	// billboards for the particle system. no vertex input, particle.vert builds the quads from the instance buffer. set 0 is the same camera UBO as the main pipeline
+	void createParticlePipeline() {
+		VkDescriptorSetLayout setLayouts[2] = { descriptorSetLayout, particleSystem.renderSetLayout() };
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &particlePipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create particle pipeline layout!");
+		}
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		GraphicsPipelineDesc desc{};
+		desc.vertShaderPath = "Shaders/particle_vert.spv";
+		desc.fragShaderPath = "Shaders/particle_frag.spv";
+		desc.vertexInput = &vertexInputInfo;
+		desc.layout = particlePipelineLayout;
+		desc.cullMode = VK_CULL_MODE_NONE;
+		desc.additiveBlend = true;
+		particlePipeline = buildGraphicsPipeline(desc);
 	}
 
 
@@ -626,61 +1667,232 @@ private:
 		uboLayoutBinding.binding = 0;
 		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | (meshShadersSupported ? VK_SHADER_STAGE_MESH_BIT_EXT : 0);
+
+		VkDescriptorSetLayoutBinding instanceLayoutBinding = uboLayoutBinding; // the instanced draws' per instance data
+		instanceLayoutBinding.binding = 1;
+		instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		VkDescriptorSetLayoutBinding bindings[] = { uboLayoutBinding, instanceLayoutBinding };
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = 1;
-		layoutInfo.pBindings = &uboLayoutBinding;
+		layoutInfo.bindingCount = 2;
+		layoutInfo.pBindings = bindings;
 
 		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
 			throw std::runtime_error("Failed to create descriptor set layout!");
 	}
 
 
+	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
+	// the highest sample count up to requestedMsaaSamples that the device can render color and depth with, and sample the depth with (the depth
+	// pyramid reads it)
+	VkSampleCountFlagBits chooseMsaaSamples() {
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		VkSampleCountFlags supported = deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts &
+			deviceProperties.limits.sampledImageDepthSampleCounts;
+		for (VkSampleCountFlagBits samples : { VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT })
+			if (samples <= requestedMsaaSamples && (supported & samples))
+				return samples;
+		return VK_SAMPLE_COUNT_1_BIT;
+	}
+
+	VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+	// D32_SFLOAT where it can be both the main pass's depth attachment and sampled by the depth pyramid, D16_UNORM (which always can) otherwise
+	VkFormat chooseDepthFormat() {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, VK_FORMAT_D32_SFLOAT, &properties);
+		VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+		return (properties.optimalTilingFeatures & needed) == needed ? VK_FORMAT_D32_SFLOAT : VK_FORMAT_D16_UNORM;
+	}
+
+	// with MSAA the scene is drawn into a multisampled attachment and resolved into the scene color at the end of the subpass. the multisampled image
+	// is only ever needed inside the render pass (cleared on load, not stored), so on tile based GPUs it never has to leave tile memory: it's a
+	// TRANSIENT_ATTACHMENT on LAZILY_ALLOCATED memory where there is some, which may never get physical memory at all. that's lost with the split main
+	// pass, where the late half has to continue in what the first half left: a resolve would throw away the samples the late half draws on top of, so
+	// the multisampled color and depth are stored between the halves. the occlusion culling (F9) is what costs that, turning it off gets the single
+	// transient pass back
+	bool splitMainPass = false; // occlusion culled meshlets, see recordMainPass()
+	bool meshletCullPassBuilt = false; // the render graph has the meshlet cull pass, the compute path
+	VkRenderPass lateRenderPass = VK_NULL_HANDLE; // null without the split. only the load/store ops differ from renderPass, so it's compatible with its pipelines and framebuffer
 	void createRenderPass() {
+		msaaSamples = chooseMsaaSamples();
+		depthFormat = chooseDepthFormat();
+		splitMainPass = !useMeshShaders && useOcclusionCulling; // the mesh shader path only culls against the frustum, in its task shader
+		meshletCullPassBuilt = !useMeshShaders;
+		renderPass = buildMainRenderPass(false);
+		lateRenderPass = splitMainPass ? buildMainRenderPass(true) : VK_NULL_HANDLE;
+	}
+
+	VkRenderPass buildMainRenderPass(bool late) {
+		bool multisampled = msaaSamples != VK_SAMPLE_COUNT_1_BIT;
+
 		VkAttachmentDescription colorAttachment{};
 		colorAttachment.format = swapChainImageFormat;
 		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; // clear the existing values in the attachment to a constant before the start of render
+		colorAttachment.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR; // clear the existing values in the attachment to a constant before the start of render. the resolve overwrites all of it
 		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE; // store rendered contents in memory to be read later (at the end of render)
 
 		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // layout the image will have before the render pass, using UNDEFINED as it doesn't matter what the previous layout the image was in
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // the layout to automatically transition to when the render pass finishes
+		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // the render graph's barriers transition the image before and after the pass, so the render pass itself doesn't change layouts
+		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentDescription msaaAttachment{};
+		msaaAttachment.format = swapChainImageFormat;
+		msaaAttachment.samples = msaaSamples;
+		msaaAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		msaaAttachment.storeOp = splitMainPass && !late ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE; // only the resolved result is kept, past the late half
+		msaaAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		msaaAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		msaaAttachment.initialLayout = late ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED; // not in the render graph, the render pass does its layout itself. contents are cleared anyway
+		msaaAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		// the motion vectors for the temporal upscaling (see TemporalUpscaler.h), next to the color and the same way: cleared, and resolved with MSAA
+		VkAttachmentDescription velocityAttachment = colorAttachment;
+		velocityAttachment.format = VELOCITY_FORMAT;
+		VkAttachmentDescription msaaVelocityAttachment = msaaAttachment;
+		msaaVelocityAttachment.format = VELOCITY_FORMAT;
+
+		// in the render graph like the scene color, with as many samples as what's drawn. kept for the depth pyramid when the main pass is split
+		VkAttachmentDescription depthAttachment{};
+		depthAttachment.format = depthFormat;
+		depthAttachment.samples = msaaSamples;
+		depthAttachment.loadOp = late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = splitMainPass && !late ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		// attachments 0 and 1 are what gets drawn to (color, velocity), 2 and 3 (MSAA only) the scene color and velocity they resolve into. the depth is last
+		VkAttachmentDescription attachments[5] = { msaaAttachment, msaaVelocityAttachment, colorAttachment, velocityAttachment, depthAttachment };
+		uint32_t depthIndex = 4;
+		if (!multisampled) {
+			attachments[0] = colorAttachment;
+			attachments[1] = velocityAttachment;
+			attachments[2] = depthAttachment;
+			depthIndex = 2;
+		}
 
-		VkAttachmentReference colorAttachmentRef{};
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference colorAttachmentRefs[2] = {};
+		colorAttachmentRefs[0].attachment = 0;
+		colorAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachmentRefs[1].attachment = 1;
+		colorAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-		VkSubpassDescription subpass{};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttachmentRef;
+		VkAttachmentReference resolveAttachmentRefs[2] = {};
+		resolveAttachmentRefs[0].attachment = 2;
+		resolveAttachmentRefs[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		resolveAttachmentRefs[1].attachment = 3;
+		resolveAttachmentRefs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-		VkRenderPassCreateInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = &colorAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
+		VkAttachmentReference depthAttachmentRef{};
+		depthAttachmentRef.attachment = depthIndex;
+		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 2;
+		subpass.pColorAttachments = colorAttachmentRefs;
+		subpass.pResolveAttachments = multisampled ? resolveAttachmentRefs : nullptr;
+		subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+		// the multisampled image is reused every frame and the render graph doesn't know about it, so the previous frame's writes to it have to be
+		// done before this frame's layout transition/clear (or, for the late half, the first half's writes before it goes on). the scene color's and
+		// the depth's barriers still come from the render graph
 		VkSubpassDependency dependency{};
 		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 		dependency.dstSubpass = 0;
 		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.srcAccessMask = 0;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-		renderPassInfo.dependencyCount = 1;
+		VkRenderPassCreateInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+		renderPassInfo.attachmentCount = depthIndex + 1;
+		renderPassInfo.pAttachments = attachments;
+		renderPassInfo.subpassCount = 1;
+		renderPassInfo.pSubpasses = &subpass;
+
+		renderPassInfo.dependencyCount = multisampled ? 1 : 0; // otherwise no subpass dependencies, the render graph records the barriers around the pass
 		renderPassInfo.pDependencies = &dependency;
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		VkRenderPass result;
+		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &result) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create render pass!");
 		}
+		return result;
+	}
+
+	VkImage msaaColorImage = VK_NULL_HANDLE;
+	VkDeviceMemory msaaColorImageMemory = VK_NULL_HANDLE;
+	VkImageView msaaColorImageView = VK_NULL_HANDLE;
+	VkImage msaaVelocityImage = VK_NULL_HANDLE; // the motion vectors get resolved like the color
+	VkDeviceMemory msaaVelocityImageMemory = VK_NULL_HANDLE;
+	VkImageView msaaVelocityImageView = VK_NULL_HANDLE;
+	void createColorResources() {
+		msaaColorImage = VK_NULL_HANDLE;
+		msaaColorImageMemory = VK_NULL_HANDLE;
+		msaaColorImageView = VK_NULL_HANDLE;
+		msaaVelocityImage = VK_NULL_HANDLE;
+		msaaVelocityImageMemory = VK_NULL_HANDLE;
+		msaaVelocityImageView = VK_NULL_HANDLE;
+		if (msaaSamples == VK_SAMPLE_COUNT_1_BIT)
+			return;
+
+		createMsaaTarget(swapChainImageFormat, msaaColorImage, msaaColorImageMemory, msaaColorImageView);
+		createMsaaTarget(VELOCITY_FORMAT, msaaVelocityImage, msaaVelocityImageMemory, msaaVelocityImageView);
+	}
+
+	void createMsaaTarget(VkFormat format, VkImage& outImage, VkDeviceMemory& outMemory, VkImageView& outView) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = format;
+		imageInfo.extent = { swapChainExtent.width, swapChainExtent.height, 1 }; // full size like the scene color, dynamic resolution only renders part of it
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = msaaSamples;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (splitMainPass ? 0 : VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT); // never read outside the render pass (or its two halves)
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (vkCreateImage(device, &imageInfo, nullptr, &outImage) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create MSAA color image!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(device, outImage, &memRequirements);
+
+		// lazily allocated memory only exists on (mostly tile based) GPUs that can back it on demand, desktop GPUs get ordinary device local memory
+		const VkPhysicalDeviceMemoryProperties& memProperties = memoryTelemetry.properties();
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount && !splitMainPass; ++i)
+			if ((memRequirements.memoryTypeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+				properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		if (allocateDeviceMemory(device, allocInfo, MemoryCategory::Images, outMemory) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate MSAA color image memory!");
+		}
+		vkBindImageMemory(device, outImage, outMemory, 0);
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = outImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		if (vkCreateImageView(device, &viewInfo, nullptr, &outView) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create MSAA color image view!");
+		}
 	}
 
 	// have to wrap shader code in a VkShaderModule before we can pass it into the pipeline, they're just a thin wrapper around the shader bytecode.
@@ -734,18 +1946,19 @@ private:
 	std::vector<VkImage> swapChainImages; // for storing the handles of the VkImage's in it. images were created by the implementation for the swap chain itself, so they'll get cleaned up with swapChain, without needing to clean up this
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
-	void createSwapChain() {
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+	VkPresentModeKHR swapChainPresentMode;
+	void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
+		ScratchScope scratch;
+		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice, scratch.arena());
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-		VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 		VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-		// specify how many images we want to have in the swap chain: .minImageCount is the minimum the implementation requires to functions
-		uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1; // +1 (at least) more than the minimum so that we don't have to wait on the driver to complete internal operations before we can acquire another image to render to
-		if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) { // make sure we don't exceed the maximum number of images though. 0 is special value that means there is no maximum
-			imageCount = swapChainSupport.capabilities.maxImageCount;
-		}
+		// the present mode and how many images we want in the swap chain (.minImageCount is the minimum the implementation requires to function) both
+		// come from the present policy, see PresentPolicy.h
+		PresentConfig presentConfig = choosePresentConfig(presentPolicy, swapChainSupport.presentModes.data(), static_cast<uint32_t>(swapChainSupport.presentModes.size()), swapChainSupport.capabilities);
+		VkPresentModeKHR presentMode = presentConfig.presentMode;
+		uint32_t imageCount = presentConfig.imageCount;
 
 		VkSwapchainCreateInfoKHR createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -756,8 +1969,15 @@ private:
 		createInfo.imageColorSpace = surfaceFormat.colorSpace;
 		createInfo.imageExtent = extent;
 		createInfo.imageArrayLayers = 1; // the amount of layers each image consists of. is always 1 unless developing a stereoscopic 3D application
-		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; // imageUsage specifies what kind of operations we'll use the images in the swap chain for. rendering directly to them so they're used as a color attachment
-		// if we wanted to use post processing, we would use VK_IMAGE_USAGE_TRANSFER_DST_BIT to render images to a separate image first. and use a memory operation to xfer the rendered image to a swap chain image
+		// imageUsage specifies what kind of operations we'll use the images in the swap chain for. the scene is rendered to a separate image first (dynamic
+		// resolution) and blitted into the swap chain image, so it needs TRANSFER_DST
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, surfaceFormat.format, &formatProperties);
+		VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || (formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+			throw std::runtime_error("Swap chain images can't be blitted to!");
+		}
+		createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
 
 		// specify how to handle swap chain images that will be used across different/same queue families:
@@ -780,7 +2000,7 @@ private:
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE; // true means that we don't care about the colour of pixels that are obscured (eg another window is in front of them). clipping gives best perf. false only if we really need to read those pixels back and get predictable results
 
-		createInfo.oldSwapchain = VK_NULL_HANDLE; // TODO: old swap chain can become invalid/unoptimized while app is running (eg if window is resized). swap chain needs to be remade from scratch, with a reference to the old one assigned here. for now assume we only ever create 1
+		createInfo.oldSwapchain = oldSwapChain; // when resizing. the old one is retired: images already acquired from it can still be presented, and the driver can hand its resources over to the new one
 
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
@@ -794,67 +2014,119 @@ private:
 
 		swapChainImageFormat = surfaceFormat.format;
 		swapChainExtent = extent;
+		swapChainPresentMode = presentMode;
 	}
 
+	// everything here is queued on the deletion queue instead of destroyed, it's freed once the frames that used it have retired
 	void cleanupSwapChain() {
-		for (VkFramebuffer framebuffer : swapChainFrameBuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
+		renderGraph.destroy(deletionQueue);
+		renderGraph.reset();
+
+		deletionQueue.destroyFramebuffer(sceneFrameBuffer);
+		deletionQueue.destroyImageView(msaaColorImageView); // null without MSAA, which the queue ignores
+		deletionQueue.destroyImage(msaaColorImage);
+		deletionQueue.freeMemory(msaaColorImageMemory);
+		deletionQueue.destroyImageView(msaaVelocityImageView);
+		deletionQueue.destroyImage(msaaVelocityImage);
+		deletionQueue.freeMemory(msaaVelocityImageMemory);
+		temporalUpscaler.destroyTargets(deletionQueue); // no-op with temporal upscaling off
+		depthPyramid.destroyTargets(deletionQueue); // no-op on the mesh shader path
+
+		for (VkCommandBuffer commandBuffer : commandBuffers) {
+			deletionQueue.freeCommandBuffer(commandPool, commandBuffer);
 		}
 
-		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
-		vkDestroyPipeline(device, graphicsPipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyRenderPass(device, renderPass, nullptr);
+		deletionQueue.destroyPipeline(particlePipeline);
+		deletionQueue.destroyPipelineLayout(particlePipelineLayout);
+		deletionQueue.destroyPipeline(chunkPipeline);
+		deletionQueue.destroyPipeline(chunkShadowPipeline);
+		deletionQueue.destroyPipeline(sceneShadowPipeline);
+		deletionQueue.destroyPipelineLayout(shadowPipelineLayout);
+		deletionQueue.destroyPipeline(meshletPipeline); // null without mesh shaders
+		deletionQueue.destroyPipelineLayout(meshletPipelineLayout);
+		deletionQueue.destroyPipeline(graphicsPipeline);
+		deletionQueue.destroyPipelineLayout(pipelineLayout);
+		deletionQueue.destroyRenderPass(renderPass);
+		deletionQueue.destroyRenderPass(lateRenderPass); // null without the split
 
 		for (VkImageView imageView : swapChainImageViews) {
-			vkDestroyImageView(device, imageView, nullptr); // unlike images, the image views were explicitly created by us, so have to cleanup
+			deletionQueue.destroyImageView(imageView); // unlike images, the image views were explicitly created by us, so have to cleanup
 		}
 
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
-
 		for (size_t i = 0; i < swapChainImages.size(); ++i) {
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
+			descriptorCache.forget(uniformBuffers[i]); // its set (with the instance buffer in it too) is reused for the new swap chain's buffers once the GPU is done with it
+			deletionQueue.destroyBuffer(uniformBuffers[i]);
+			deletionQueue.freeMemory(uniformBuffersMemory[i]);
+			deletionQueue.destroyBuffer(instanceBuffers[i]);
+			deletionQueue.freeMemory(instanceBuffersMemory[i]); // unmapped with it
 		}
-
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 	}
 
-	void recreateSwapChain() {
-		{ // Handle if minimized:
-			int width = 0, height = 0;
+	void getFramebufferSize(int& width, int& height) {
+		if (headless()) {
+			width = static_cast<int>(headlessExtent.width);
+			height = static_cast<int>(headlessExtent.height);
+		} else {
 			glfwGetFramebufferSize(window, &width, &height);
-			while (width == 0 || height == 0) { // while Minimized (framebuffer size has special value of 0)
-				glfwGetFramebufferSize(window, &width, &height);
-				glfwWaitEvents();
-			}
 		}
+	}
 
-		vkDeviceWaitIdle(device);
+	bool isMinimized() {
+		int width = 0, height = 0;
+		getFramebufferSize(width, height);
+		return width == 0 || height == 0; // framebuffer size has special value of 0 while minimized
+	}
+
+	// doesn't wait for the GPU. frames still in flight keep using the old swap chain's resources, which are retired through the deletion queue
+	void recreateSwapChain() {
+		if (isMinimized()) { // can't create a 0x0 swap chain. keep the old one, mainLoop() retries once the window is restored
+			framebufferResized = true;
+			return;
+		}
 
+		swapChainSettingsChanged = false; // picked up by createSwapChain() and createRenderPass()
+		++swapChainRecreations;
+		VkSwapchainKHR oldSwapChain = swapChain;
 		cleanupSwapChain();
+		useTemporalUpscaling = requestedTemporalUpscaling;
+		useOcclusionCulling = requestedOcclusionCulling;
+		dynamicResolution.setMaxScale(useTemporalUpscaling ? TEMPORAL_RENDER_SCALE : 1.0f);
+
+		createSwapChain(oldSwapChain);
+		// presents aren't on any timeline. with present fences the old swap chain goes once its last present's fence is signaled (presents on a queue
+		// finish in order, so that covers the ones before it too), and the frame gets a fresh fence for its next present. without them, it's retired
+		// by drawFrame() after the first acquire from the new swap chain: the presentation engine has moved on by then, and the frame that acquired
+		// comes round again only after the frames in flight have finished
+		if (presentFencesSupported) {
+			deletionQueue.destroySwapchain(oldSwapChain, presentFences[lastPresentFrame]);
+			presentFences[lastPresentFrame] = createPresentFence();
+		} else {
+			deletionQueue.destroySwapchain(oldSwapChain);
+			swapchainRetirePending = true;
+		}
 
-		createSwapChain();
 		createImageViews();
 		createRenderPass();
 		createGraphicsPipeline();
-		createFrameBuffers();
+		createColorResources();
 		createUniformBuffers();
-		createDescriptorPool();
 		createDescriptorSets();
 		//createCommandPool(); // not necessary, vkFreeCommandBuffers function will reuse the existing pool rather than recreating it
 		createCommandBuffers();
+		createRenderGraph();
+		imageTimelineValues.assign(swapChainImages.size(), 0); // the image count can change, and the new images haven't been used yet
 	}
 
 	VkDevice device; // logical device handle to interface with physicalDevice
 	VkQueue graphicsQueue; // queues are automatically created along with the logical device, but still need a handle to interface with the graphics queue. device queues implicitly cleaned up when device is destroyed, so no cleanup necessary
 	VkQueue presentQueue;
+	VkQueue computeQueue; // async compute, see AsyncCompute.h
+	MemoryTelemetry memoryTelemetry; // what the engine holds and the device's budgets, every allocation is accounted to it
 	void createLogicalDevice() { // sets up logical device and queue handles so that we can actually use the GPU
 		QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value() };
 
 		float queuePriority = 1.0f; // influences the scheduling of command buffer execution (from 0.0f to 1.0f) - required even if there is only a single queue
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -866,17 +2138,58 @@ private:
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
-		VkPhysicalDeviceFeatures deviceFeatures{}; // atm we don't need anything special, so just define it
+		VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{}; // optional, only chained in when the device has it
+		meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+		meshShaderFeatures.taskShader = VK_TRUE;
+		meshShaderFeatures.meshShader = VK_TRUE;
+
+		VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swapchainMaintenanceFeatures{}; // same, for the present fences
+		swapchainMaintenanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT;
+		swapchainMaintenanceFeatures.swapchainMaintenance1 = VK_TRUE;
+
+		void* optionalFeatures = nullptr;
+		if (presentFencesSupported) {
+			swapchainMaintenanceFeatures.pNext = optionalFeatures;
+			optionalFeatures = &swapchainMaintenanceFeatures;
+		}
+		if (meshShadersSupported) {
+			meshShaderFeatures.pNext = optionalFeatures;
+			optionalFeatures = &meshShaderFeatures;
+		}
+
+		VkPhysicalDeviceVulkan12Features vulkan12Features{};
+		vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		vulkan12Features.pNext = optionalFeatures;
+		vulkan12Features.timelineSemaphore = VK_TRUE; // VK_KHR_timeline_semaphore, core since 1.2. all the queue synchronization goes through GpuTimeline
+
+		VkPhysicalDeviceVulkan13Features vulkan13Features{};
+		vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+		vulkan13Features.pNext = &vulkan12Features;
+		vulkan13Features.synchronization2 = VK_TRUE; // vkCmdPipelineBarrier2 and vkQueueSubmit2, used by the render graph and GpuTimeline
+
+		VkPhysicalDeviceFeatures2 deviceFeatures{}; // features are chained through pNext now, so they go in a VkPhysicalDeviceFeatures2 instead of pEnabledFeatures
+		deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		deviceFeatures.pNext = &vulkan13Features;
+		deviceFeatures.features.multiDrawIndirect = VK_TRUE; // the terrain is one indirect draw with a command per chunk
+		deviceFeatures.features.drawIndirectFirstInstance = VK_TRUE; // the meshlet draw arguments start at their batch's instance data
 
 		VkDeviceCreateInfo createInfo{}; // with queueCreateInfo and deviceFeatures now declared, we can start filling out DeviceCreateInfo
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
-		createInfo.pEnabledFeatures = &deviceFeatures;
+		createInfo.pNext = &deviceFeatures;
+		createInfo.pEnabledFeatures = nullptr; // must be null when VkPhysicalDeviceFeatures2 is chained
 
 		// similar to VkInstanceCreateInfo - we must specify extensions and validation layers.
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()); // enable the "VK_KHR_swapchain" extension
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		if (meshShadersSupported)
+			enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		if (memoryBudgetSupported)
+			enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (presentFencesSupported)
+			enabledExtensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size()); // enable the "VK_KHR_swapchain" extension, and the optional ones the device has
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size()); // newer versions of Vulkan = there is no longer a distinction between instance and device specific validation layers,
 			createInfo.ppEnabledLayerNames = validationLayers.data(); // so these 2 fields of VkDeviceCreateInfo are ignored, but set them anyway to be compatible with older implementations
@@ -890,9 +2203,14 @@ private:
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue); // retrieves queue handles for each queue family. passing in 0 for queue index because we're only creating a single queue from this family
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue); // if the queue families are the same, the two queue handles likely have the same value now
+		vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue); // same as graphicsQueue when there's no dedicated compute family
+		memoryTelemetry.init(physicalDevice, device, memoryBudgetSupported); // before anything is allocated, so it all gets accounted
 	}
 
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; // implicitly destroyed when the VkInstance instance is destroyed, so don't need to do anything in cleanup()
+	std::string deviceSelector; // --device/VULKAN_ENGINE_DEVICE, empty picks the highest scoring device
+	std::string physicalDeviceName;
+	// every device that has what we need is scored (type, VRAM, queues, optional features) and the best one is used, unless the user picked one
 	void pickPhysicalDevice() {
 		uint32_t deviceCount = 0;
 		vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
@@ -902,21 +2220,41 @@ private:
 
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()); // allocate array to hold all the VkPhysicalDevice handles
-		for (const auto& device : devices) {
-			if (isDeviceSuitable(device)) {
-				physicalDevice = device;
-				break;
+		std::vector<DeviceCapabilities> candidates;
+		for (uint32_t i = 0; i < deviceCount; ++i) {
+			if (isDeviceSuitable(devices[i])) {
+				candidates.push_back(queryDeviceCapabilities(devices[i], i));
 			}
 		}
 
-		if (physicalDevice == VK_NULL_HANDLE) {
+		if (candidates.empty()) {
 			throw std::runtime_error("failed to find any suitable!"); // GPU had vulkan support, but didn't support all Vulkan features that we use
 		}
+		rankDevices(candidates);
+
+		auto chosen = std::find_if(candidates.begin(), candidates.end(), [&](const DeviceCapabilities& candidate) { return matchesDeviceSelector(candidate, deviceSelector); });
+		if (chosen == candidates.end()) { // the device may exist but be missing something we need, the ranking only lists suitable ones
+			throw std::runtime_error("no suitable GPU matches the requested device \"" + deviceSelector + "\"!");
+		}
+		std::cout << "suitable GPUs:" << std::endl;
+		printDeviceRanking(candidates, &*chosen, std::cout);
+
+		physicalDevice = chosen->device;
+		physicalDeviceName = chosen->name;
+		meshShadersSupported = chosen->meshShaders;
+		memoryBudgetSupported = chosen->memoryBudget;
+		presentFencesSupported = surfaceMaintenanceSupported && chosen->swapchainMaintenance;
 	}
 
+	bool meshShadersSupported = false; // VK_EXT_mesh_shader with task shaders. optional, the meshlets fall back to compute culling without it
+	bool memoryBudgetSupported = false; // VK_EXT_memory_budget. optional, the memory telemetry estimates the budgets without it
+	bool surfaceMaintenanceSupported = false; // VK_EXT_surface_maintenance1 on the instance
+	bool presentFencesSupported = false; // VK_EXT_swapchain_maintenance1 as well. optional, see recreateSwapChain() for what happens without it
+
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;	// can't use uint32_t, because in theory any value could be a valid queue family index, so no special value to determine the nonexistence of a queue family works
 		std::optional<uint32_t> presentFamily; // vulkan implementation may support WSI, but doesn't necessarily mean that every device in the system supports it
+		std::optional<uint32_t> computeFamily; // a compute-only family if there is one (async compute), otherwise the graphics family
 
 		bool isComplete() { // generic check to the struct itself for convenience
 			return graphicsFamily.has_value() && presentFamily.has_value(); // && because it is possible that the queue families supporting drawing commands and ones supporting presentation do not overlap
@@ -930,7 +2268,7 @@ private:
 		VkPhysicalDeviceFeatures deviceFeatures;
 		vkGetPhysicalDeviceFeatures(device, &deviceFeatures); // many more optional features like texture compression 64 bit floats, multi viewport rendering, etc
 		std::cout << deviceProperties.deviceName;*/
-		// could sort all GPUs by some score and pick best one, or allow user to choose.
+		// only the hard requirements here, pickPhysicalDevice ranks the devices that pass (DeviceSelector)
 
 
 		QueueFamilyIndices indices = findQueueFamilies(device);
@@ -940,11 +2278,30 @@ private:
 		// swap chain is sufficient enough for us if there is at least one supported image format and one supported presentation mode given the window surface we have:
 		bool swapChainAdequate = false;
 		if (extensionsSupported) { // important to only query for swap chain support after verifying the extension is available
-			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
+			ScratchScope scratch;
+			SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, scratch.arena());
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
 
-		return indices.isComplete() && extensionsSupported && swapChainAdequate;
+		// the render graph records synchronization2 barriers, which are core in 1.3, and every submission signals a timeline semaphore
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+		bool featuresSupported = false;
+		if (deviceProperties.apiVersion >= VK_API_VERSION_1_3) {
+			VkPhysicalDeviceVulkan12Features vulkan12Features{};
+			vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+			VkPhysicalDeviceVulkan13Features vulkan13Features{};
+			vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+			vulkan13Features.pNext = &vulkan12Features;
+			VkPhysicalDeviceFeatures2 deviceFeatures{};
+			deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			deviceFeatures.pNext = &vulkan13Features;
+			vkGetPhysicalDeviceFeatures2(device, &deviceFeatures);
+			featuresSupported = vulkan13Features.synchronization2 == VK_TRUE && vulkan12Features.timelineSemaphore == VK_TRUE &&
+				deviceFeatures.features.multiDrawIndirect == VK_TRUE && deviceFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+		}
+
+		return indices.isComplete() && extensionsSupported && swapChainAdequate && featuresSupported;
 	}
 
 	const std::vector<const char*> deviceExtensions = { // list of required device extensions, similar to the list of validation layers we want to enable
@@ -955,26 +2312,31 @@ private:
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		ScratchScope scratch;
+		ArenaVector<VkExtensionProperties> availableExtensions = scratch.vector<VkExtensionProperties>(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-		for (const auto& extension : availableExtensions) {
-			requiredExtensions.erase(extension.extensionName); // enumerate the extensions and check if all of the requied extensions are amongst them
+		for (const char* required : deviceExtensions) { // every required extension has to be amongst the enumerated ones
+			bool found = false;
+			for (const VkExtensionProperties& extension : availableExtensions)
+				found = found || strcmp(extension.extensionName, required) == 0;
+			if (!found)
+				return false;
 		}
-		return requiredExtensions.empty();
+		return true;
 	}
 
-	struct SwapChainSupportDetails {
+	struct SwapChainSupportDetails { // the lists live in the arena they were queried into, usually a ScratchScope's
+		explicit SwapChainSupportDetails(LinearArena& arena) : formats(ArenaAllocator<VkSurfaceFormatKHR>(arena)), presentModes(ArenaAllocator<VkPresentModeKHR>(arena)) {}
+
 		VkSurfaceCapabilitiesKHR capabilities; // basic surface capabilities - min/max number of images in a swap chain, min/max width and height of images
-		std::vector<VkSurfaceFormatKHR> formats; // surface formats - pixel format, color space
-		std::vector<VkPresentModeKHR> presentModes; // available presentation modes
+		ArenaVector<VkSurfaceFormatKHR> formats; // surface formats - pixel format, color space
+		ArenaVector<VkPresentModeKHR> presentModes; // available presentation modes
 	};
 
 	// populates and returns SwapChainSupportDetails struct with supported image formats/supported presentation modes (if any)
-	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device) {
-		SwapChainSupportDetails details;
+	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, LinearArena& arena) {
+		SwapChainSupportDetails details(arena);
 		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities); // takes the VkPhysicalDevice and VkSurfaceKHR into account when determining the supported capabilites. all support querying functions have these 2 params as they're core components of the swap chain
 
 		// query supported surface formats:
@@ -997,27 +2359,13 @@ private:
 	}
 
 	// Find the best possible surface format (color depth) for the swap chain when swapChainAdequate is true in isDeviceSuitable()
-	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const ArenaVector<VkSurfaceFormatKHR>& availableFormats) {
 		for (const auto& availableFormat : availableFormats)
 			if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) // preferred combo
 				return availableFormat;
 		return availableFormats[0]; // if preffered combo doesn't exit, just return first one. could add ranking logic, TODO
 	}
 
-	// Find the best possible presentation mode (conditions for "swapping" images to the screen) for the swap chain when swapChainAdequate is true in isDeviceSuitable()
-	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-		/* possible values are:
-		* VK_PRESENT_MODE_IMMEDIATE_KHR - images submitted to app are transferred to the screen right away. may cause tearing
-		* VK_PRESENT_MODE_FIFO_KHR - this is v sync, when the display is refreshed it takes an image from the front of the queue and the program inserts rendered images at the back of the queue (if queue is full, program must wait)
-		* VK_PRESENT_MODE_RELAXED_KHR - similar to FIFO, but if the application was late and the queue is empty at the last v blank, the image is transferred when it finally arrives. may cause tearing
-		* VK_PRESENT_MODE_MAILBOX_KHR - similar to FIFO, but instead of blocking the app when the queue is full, the images that are already queued are replaced with the newer ones. can be used to implement triple buffering
-		*/
-		for (const auto& availablePresentMode : availablePresentModes)
-			if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) // triple buffering to avoid tearing and have low latency by rendering new images that are as up to date as possible at the v blank
-				return availablePresentMode;
-		return VK_PRESENT_MODE_FIFO_KHR; // this is the only mode guaranteed to be available, so return it as a last resort
-	}
-
 	// Find the best possible swap extent (resolution of images in the swap chain) for the swap chain when swapChainAdequate is true in isDeviceSuitable()
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 		if (capabilities.currentExtent.width != UINT32_MAX) { // the resolution of the swap chain images is almost always exactly equal to the resolution of the window that we're drawing to
@@ -1026,7 +2374,7 @@ private:
 		// width is == to UINT32_MAX here, which is a special value for some window managers that allow us to differ the res of the swap chain images and res of the window.
 		// so clamp WIDTH and HEIGHT to the min/max extents that are supported by the implementation by picking the res that best matches the window within the minImageExtent and maxImageExtent bounds
 		int width, height;
-		glfwGetFramebufferSize(window, &width, &height);
+		getFramebufferSize(width, height); // a headless surface always ends up here
 		VkExtent2D actualExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
 		actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
 		actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -1048,22 +2396,27 @@ private:
 		//VkQueueFamilyProperties struct contains some details about the queue family, including the type of operations that are supported, and number of queues that can be created based on that family
 		int i = 0;
 		for (const auto& queueFamily : queueFamilies) {
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { // we need to find at least one queue family that supports VK_QUEUE_GRAPHICS_BIT
+			if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) { // we need to find at least one queue family that supports VK_QUEUE_GRAPHICS_BIT
 				indices.graphicsFamily = i;
 			}
 
+			// a family with compute but no graphics maps to the GPU's async compute engines, so work submitted there can run alongside rendering
+			if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.computeFamily.has_value()) {
+				indices.computeFamily = i;
+			}
+
 			// present and graphics are very likely to be the same queue family, but treat them as separate queues for a uniform approach. could make this only prefer a physical device that supports
 			// both drawing and presentation in the same queue for improved perf, but meh
 			VkBool32 presentSupport = false;
 			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport); // look for a queue family that has the capability of presenting to our window surface
-			if (presentSupport) {
+			if (presentSupport && !indices.presentFamily.has_value()) {
 				indices.presentFamily = i;
 			}
+			++i; // no early out, a dedicated compute family usually comes after the graphics one
+		}
 
-			if (indices.isComplete()) {
-				break;
-			}
-			++i;
+		if (!indices.computeFamily.has_value()) {
+			indices.computeFamily = indices.graphicsFamily; // every graphics family supports compute too
 		}
 		return indices;
 	}
@@ -1104,7 +2457,7 @@ private:
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_3; // synchronization2 (render graph barriers) is core from 1.3
 
 
 		VkInstanceCreateInfo createInfo{}; // this struct is not optional and tells the Vulkan driver which global extensions and validation layers we want to use.
@@ -1180,16 +2533,34 @@ private:
 		return true;
 	}
 
+	bool instanceExtensionSupported(const char* name) {
+		uint32_t extensionCount = 0;
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+		std::vector<VkExtensionProperties> extensions(extensionCount);
+		vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+		return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+	}
+
 	// returns the required list of extensions based on whether validation layers are enabled or not
 	std::vector<const char*> getRequiredExtensions() {
-		uint32_t glfwExtensionsCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
-
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionsCount); // the extensions specified by GLFW are always required
+		std::vector<const char*> extensions;
+		if (headless()) { // nothing is shown, the swap chain images just go nowhere
+			extensions = { VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME };
+		} else {
+			uint32_t glfwExtensionsCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionsCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionsCount); // the extensions specified by GLFW are always required
+		}
 
 		if (enableValidationLayers) { // not required, conditionally adds the debug messenger extension
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); // macro is equivalent to the literal "VK_EXT_debug_utils" - but this avoids typos
 		}
+		// optional, the device side (VK_EXT_swapchain_maintenance1) needs it for the present fences that retire old swap chains
+		surfaceMaintenanceSupported = instanceExtensionSupported(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) && instanceExtensionSupported(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+		if (surfaceMaintenanceSupported) {
+			extensions.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+			extensions.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+		}
 		return extensions;
 	}
 
@@ -1208,23 +2579,277 @@ private:
 
 	VkSurfaceKHR surface;
 	void createSurface() {
+		if (headless()) {
+			VkHeadlessSurfaceCreateInfoEXT createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+			PFN_vkCreateHeadlessSurfaceEXT func = (PFN_vkCreateHeadlessSurfaceEXT)vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"); // extension function, same as the debug messenger
+			if (func == nullptr || func(instance, &createInfo, nullptr, &surface) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create headless surface!");
+			}
+			return;
+		}
 		if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create window surface - glfw!");
 		}
 	}
 
+	// the hot path check: in builds with allocation counting (see AllocationCounter.h) every frame's heap allocations are counted, and once the first
+	// reporting interval has warmed everything up, a frame that allocates is an error, like a failed check in FrameAllocationTests. frames that recreate
+	// the swap chain are left out, that path allocates
+	uint64_t swapChainRecreations = 0;
+	uint64_t maxFrameAllocations = 0; // over the current interval
+	bool hotPathWarm = false;
+	void checkFrameAllocations(uint64_t allocationsBefore, uint64_t recreationsBefore) {
+		if (!allocationCountingEnabled() || swapChainRecreations != recreationsBefore)
+			return;
+		uint64_t allocations = heapAllocationCount() - allocationsBefore;
+		maxFrameAllocations = std::max(maxFrameAllocations, allocations);
+		if (hotPathWarm && allocations > 0)
+			throw std::runtime_error("a frame made " + std::to_string(allocations) + " heap allocations on the hot path!");
+	}
+
 	void mainLoop() {
 		while (!glfwWindowShouldClose(window)) { // run app until either error occurs or window is closed
 			glfwPollEvents();
+			updateCamera();
+			if (isMinimized()) { // nothing to present to. sleep until something happens instead of spinning, but wake up now and then so retired resources still get freed
+				glfwWaitEventsTimeout(0.1);
+				deletionQueue.collect();
+				continue;
+			}
+			uint64_t allocationsBefore = heapAllocationCount();
+			uint64_t recreationsBefore = swapChainRecreations;
+			drawFrame();
+			checkFrameAllocations(allocationsBefore, recreationsBefore);
+
+			if (frameStats.intervalElapsed()) { // once a second
+				char resolution[64];
+				snprintf(resolution, sizeof(resolution), " - resolution %.0f%%, gpu %.1f ms", dynamicResolution.scale() * 100.0f, dynamicResolution.gpuTimeMs());
+				std::string title = std::string("Vulkan Window - ") + presentPolicyName(presentPolicy) + " (" + presentModeName(swapChainPresentMode) + ", " +
+					std::to_string(swapChainImages.size()) + " images) - " + frameStats.summary() + resolution + ", " + std::to_string(msaaSamples) + "x MSAA" +
+					(useTemporalUpscaling ? ", TAA" : "") + (useMeshShaders ? ", mesh shaders" : ", compute culled meshlets") + (splitMainPass ? " + Hi-Z occlusion" : "") + ", LOD " + std::to_string(objectLod.current()) + "/" + std::to_string(lodErrors.size() - 1) +
+					", " + std::to_string(mainPassDraws.stats().stateChanges()) + " state changes, " + worldStreamer.summary() + ", " + std::to_string(clusteredLighting.lightCount()) + " lights, " + shadowCascades.summary() + ", " + memoryTelemetry.summary() +
+					(allocationCountingEnabled() ? ", " + std::to_string(maxFrameAllocations) + " heap allocs/frame" : "");
+				glfwSetWindowTitle(window, title.c_str());
+				maxFrameAllocations = 0;
+				hotPathWarm = true;
+			}
+		}
+
+		vkDeviceWaitIdle(device);
+	}
+
+	// runs the benchmark scene instead of mainLoop(): warm up, then record every frame's wall time, CPU time per frame task and heap allocations
+	static constexpr float BENCHMARK_FRAME_SECONDS = 1.0f / 60.0f; // animation and simulation step, so runs are repeatable
+	uint32_t benchmarkFrame = 0;
+	BenchmarkRecorder benchmarkRecorder;
+	BenchmarkResult benchmarkResults;
+	void benchmarkLoop() {
+		using Clock = std::chrono::steady_clock;
+		const BenchmarkScene& scene = *benchmarkScene;
+		const VkExtent2D RESIZE_EXTENTS[] = { { 1280, 720 }, { 640, 480 }, { 1920, 1080 }, { WIDTH, HEIGHT } }; // the resize storm cycles through these
+		sceneObjectCount = std::min(std::max(1u, scene.objectCount), MAX_SCENE_INSTANCES);
+		dynamicResolution.settings().minScale = dynamicResolution.settings().maxScale; // fixed resolution, a slower GPU shows up in the frame time instead of a lower scale
+
+		VkBuffer uploadTarget = VK_NULL_HANDLE;
+		VkDeviceMemory uploadTargetMemory = VK_NULL_HANDLE;
+		std::vector<unsigned char> uploadData(static_cast<size_t>(scene.uploadBytesPerFrame), 0x5A);
+		if (scene.uploadBytesPerFrame > 0) {
+			createBuffer(scene.uploadBytesPerFrame, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, uploadTarget, uploadTargetMemory);
+		}
+
+		std::vector<std::string> subsystems;
+		for (FrameTaskList::TaskId task = 0; task < frameTasks.taskCount(); ++task)
+			subsystems.push_back(frameTasks.taskName(task));
+		const uint32_t uploadSubsystem = static_cast<uint32_t>(subsystems.size());
+		subsystems.push_back("staging upload");
+		benchmarkRecorder.begin(subsystems, scene.frames);
+
+		uint64_t recreationsAtStart = swapChainRecreations;
+		for (benchmarkFrame = 0; benchmarkFrame < scene.warmupFrames + scene.frames; ++benchmarkFrame) {
+			bool recording = benchmarkFrame >= scene.warmupFrames;
+			if (recording && benchmarkFrame == scene.warmupFrames)
+				recreationsAtStart = swapChainRecreations;
+			if (scene.resizeInterval > 0 && benchmarkFrame > 0 && benchmarkFrame % scene.resizeInterval == 0) {
+				headlessExtent = RESIZE_EXTENTS[(benchmarkFrame / scene.resizeInterval) % 4];
+				framebufferResized = true; // what the GLFW callback would do, picked up after the present
+			}
+
+			uint64_t allocationsBefore = heapAllocationCount();
+			uint64_t recreationsBefore = swapChainRecreations;
+			Clock::time_point frameStart = Clock::now();
+			if (uploadTarget != VK_NULL_HANDLE) { // on this thread, the upload uses the command pool the recording task uses too
+				uploadBuffer(uploadTarget, uploadData.data(), scene.uploadBytesPerFrame);
+			}
+			Clock::time_point uploadEnd = Clock::now();
+			uint64_t drawAllocationsBefore = heapAllocationCount(); // the scripted upload uses the load time path, which allocates. the frame itself mustn't
 			drawFrame();
+			Clock::time_point frameEnd = Clock::now();
+			uint64_t allocations = heapAllocationCount() - allocationsBefore;
+			bool hotPathAllocated = heapAllocationCount() != drawAllocationsBefore && swapChainRecreations == recreationsBefore; // recreation allocates
+
+			if (recording) {
+				benchmarkRecorder.recordFrame(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count(), allocations, hotPathAllocated);
+				for (FrameTaskList::TaskId task = 0; task < frameTasks.taskCount(); ++task)
+					benchmarkRecorder.recordSubsystem(task, frameTasks.taskMilliseconds(task));
+				benchmarkRecorder.recordSubsystem(uploadSubsystem, std::chrono::duration<double, std::milli>(uploadEnd - frameStart).count());
+			}
 		}
+		vkDeviceWaitIdle(device);
+
+		benchmarkResults = benchmarkRecorder.finish(scene.name, swapChainExtent.width, swapChainExtent.height, swapChainRecreations - recreationsAtStart);
+		if (uploadTarget != VK_NULL_HANDLE) {
+			vkDestroyBuffer(device, uploadTarget, nullptr);
+			freeDeviceMemory(device, uploadTargetMemory);
+		}
+	}
 
+	// replays a frame capture instead of mainLoop(): every captured frame is drawn again from its captured inputs (see FrameCapture.h), from the
+	// first one on, since each frame builds on the ones before it. the frames from replay->firstFrame on are timed like a benchmark scene's, and a
+	// frame that doesn't come out the way it was captured is reported, the timings after it aren't the captured session's anymore
+	const CapturedFrame* replayFrame = nullptr; // the one being drawn
+	static const uint32_t MAX_REPLAY_ATTEMPTS = 4; // a frame whose swap chain is still out of date after this many recreations has failed
+	void replayLoop() {
+		using Clock = std::chrono::steady_clock;
+		const std::vector<CapturedFrame>& frames = replay->capture.frames;
+		const uint32_t frameTotal = static_cast<uint32_t>(frames.size());
+		const uint32_t firstTimed = std::min(replay->firstFrame, frameTotal);
+		const uint32_t end = firstTimed + std::min(replay->frameCount, frameTotal - firstTimed);
+		if (!replay->capture.deviceName.empty() && replay->capture.deviceName != physicalDeviceName)
+			std::cerr << "captured on " << replay->capture.deviceName << ", replaying on " << physicalDeviceName << std::endl;
+
+		std::vector<std::string> subsystems;
+		for (FrameTaskList::TaskId task = 0; task < frameTasks.taskCount(); ++task)
+			subsystems.push_back(frameTasks.taskName(task));
+		benchmarkRecorder.begin(subsystems, end - firstTimed);
+
+		uint64_t recreationsAtStart = swapChainRecreations;
+		uint32_t diverged = 0;
+		for (uint32_t index = 0; index < end; ++index) {
+			if (index == firstTimed)
+				recreationsAtStart = swapChainRecreations;
+			applyCapturedFrame(frames[index], index == 0);
+
+			uint64_t allocationsBefore = heapAllocationCount();
+			uint64_t recreationsBefore = swapChainRecreations;
+			Clock::time_point frameStart = Clock::now();
+			uint64_t submitted = submittedFrames;
+			uint32_t attempts = 0;
+			do {
+				drawFrame();
+			} while (submittedFrames == submitted && ++attempts < MAX_REPLAY_ATTEMPTS); // an out of date swap chain is recreated and the frame tried again, as in the captured session
+			Clock::time_point frameEnd = Clock::now();
+			uint64_t allocations = heapAllocationCount() - allocationsBefore;
+
+			if (submittedFrames == submitted) { // nothing to compare or time, capturedFrame is still the frame before's
+				if (diverged++ == 0)
+					std::cerr << "replay diverged from the capture at frame " << index << ": not submitted after " << MAX_REPLAY_ATTEMPTS << " attempts" << std::endl;
+				continue;
+			}
+			std::string difference = compareCapturedFrames(frames[index], capturedFrame);
+			if (!difference.empty() && diverged++ == 0)
+				std::cerr << "replay diverged from the capture at frame " << index << ": " << difference << std::endl;
+			if (index >= firstTimed) {
+				benchmarkRecorder.recordFrame(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count(), allocations, allocations > 0 && swapChainRecreations == recreationsBefore);
+				for (FrameTaskList::TaskId task = 0; task < frameTasks.taskCount(); ++task)
+					benchmarkRecorder.recordSubsystem(task, frameTasks.taskMilliseconds(task));
+			}
+		}
 		vkDeviceWaitIdle(device);
+		replayFrame = nullptr;
+		worldStreamer.scheduleUploads(nullptr);
+		dynamicResolution.forceScale(-1.0f);
+		if (diverged > 0)
+			std::cerr << diverged << " of " << end << " replayed frames differ from the capture" << std::endl;
+
+		benchmarkResults = benchmarkRecorder.finish(replay->name, swapChainExtent.width, swapChainExtent.height, swapChainRecreations - recreationsAtStart);
+	}
+
+	// what the captured session had going into the frame. settings that rebuild the swap chain were requested before the frame and take effect
+	// after it, the same as they did then. a resize happened after the frame before, so the swap chain is recreated before this one
+	void applyCapturedFrame(const CapturedFrame& frame, bool first) {
+		bool resized = frame.width != swapChainExtent.width || frame.height != swapChainExtent.height;
+		headlessExtent = { frame.width, frame.height };
+		if (resized && !first)
+			recreateSwapChain();
+		setPresentPolicy(static_cast<PresentPolicy>(frame.presentPolicy));
+		if (frame.msaaSamples != static_cast<uint32_t>(requestedMsaaSamples))
+			setMsaaSamples(static_cast<VkSampleCountFlagBits>(frame.msaaSamples));
+		setUseMeshShaders(frame.meshShaders != 0); // without mesh shaders on this device the frame diverges, the draws say so
+		if ((frame.temporalUpscaling != 0) != requestedTemporalUpscaling)
+			setUseTemporalUpscaling(frame.temporalUpscaling != 0);
+		if ((frame.occlusionCulling != 0) != requestedOcclusionCulling)
+			setUseOcclusionCulling(frame.occlusionCulling != 0);
+		objectLod.settings().pixelThreshold = frame.lodPixelThreshold;
+		cameraTarget = glm::vec3(frame.cameraTarget[0], frame.cameraTarget[1], frame.cameraTarget[2]);
+		sunDirection = glm::vec3(frame.sunDirection[0], frame.sunDirection[1], frame.sunDirection[2]);
+		dynamicResolution.forceScale(frame.renderScale);
+		worldStreamer.scheduleUploads(&frame.streamedChunks);
+		replayFrame = &frame;
+		if (first && (resized || swapChainSettingsChanged))
+			recreateSwapChain(); // the captured session started out this way
+	}
+
+	std::string capturePath;
+	uint32_t captureFrameLimit = 0;
+	FrameCaptureWriter captureWriter;
+	CapturedFrame capturedFrame; // the last submitted frame's, reused so capturing doesn't allocate once it's warm
+	uint64_t submittedFrames = 0;
+	// after the frame's submission: its inputs and results, for the capture file or to check a replayed frame against
+	void captureFrame() {
+		CapturedFrame& frame = capturedFrame;
+		frame.clear();
+		frame.width = swapChainExtent.width;
+		frame.height = swapChainExtent.height;
+		frame.msaaSamples = static_cast<uint32_t>(requestedMsaaSamples);
+		frame.presentPolicy = static_cast<uint32_t>(presentPolicy);
+		frame.meshShaders = useMeshShaders ? 1 : 0;
+		frame.temporalUpscaling = requestedTemporalUpscaling ? 1 : 0;
+		frame.occlusionCulling = requestedOcclusionCulling ? 1 : 0;
+		frame.lodPixelThreshold = objectLod.settings().pixelThreshold;
+		frame.time = frameTime;
+		frame.simulationStep = simulationStep;
+		frame.renderScale = dynamicResolution.scale();
+		for (int i = 0; i < 3; ++i) {
+			frame.cameraTarget[i] = cameraTarget[i];
+			frame.sunDirection[i] = sunDirection[i];
+		}
+		const std::vector<uint32_t>& streamed = worldStreamer.frameUploads();
+		frame.streamedChunks.insert(frame.streamedChunks.end(), streamed.begin(), streamed.end());
+		const unsigned char* uniforms = reinterpret_cast<const unsigned char*>(&frameUbo);
+		frame.uniforms.insert(frame.uniforms.end(), uniforms, uniforms + sizeof(frameUbo));
+		for (const DrawBatch& batch : mainPassDraws.batches())
+			frame.draws.push_back({ batch.state.layer, batch.state.pipeline, batch.state.descriptorSet, batch.state.material, batch.state.mesh, batch.instanceCount });
+
+		if (captureWriter.isOpen()) {
+			captureWriter.write(frame);
+			if (captureFrameLimit != 0 && captureWriter.frameCount() >= captureFrameLimit)
+				closeCapture();
+		}
+	}
+
+	void closeCapture() {
+		if (!captureWriter.isOpen())
+			return;
+		uint32_t frames = captureWriter.frameCount();
+		captureWriter.close();
+		std::cerr << "captured " << frames << " frames to " << capturePath << std::endl;
 	}
 
+	FrameStats frameStats;
 	bool framebufferResized = false;
+	// per frame CPU data that only has to live until the frame is recorded and submitted. reset with the frame's other resources, after the timeline wait
+	FrameArenas frameArenas;
+	const size_t FRAME_ARENA_CAPACITY = 1024 * 1024;
 	void drawFrame() {
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		frameStats.beginFrame(); // input was just polled, latency is measured from here
+		graphicsTimeline.wait(frameTimelineValues[currentFrame]); // frame pacing: this frame's previous submission has to be done before its resources are reused
+		frameArenas.beginFrame(static_cast<uint32_t>(currentFrame));
+		deletionQueue.collect(); // free whatever the retired frames were the last to use
+		descriptorCache.collect();
+		frameStats.poll(graphicsTimeline);
+		memoryTelemetry.update(); // budgets, watermarks and the budget callbacks, after the collect so what it freed counts
+		dynamicResolution.update(static_cast<uint32_t>(currentFrame)); // the frame's previous timestamps are ready now, pick this frame's resolution
 
 		uint32_t imageIndex;
 		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex); // acquire image from swap chain
@@ -1235,38 +2860,41 @@ private:
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) { // if a previous frame is using this image
-			vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		if (swapchainRetirePending) { // the first image from a new swap chain, the old one can go after this frame
+			deletionQueue.retireSwapchains(deletionQueue.currentRetirePoint());
+			swapchainRetirePending = false;
 		}
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame]; // mark the image as now being in use by this frame
 
-		updateUniformBuffer(imageIndex);
+		graphicsTimeline.wait(imageTimelineValues[imageIndex]); // if a previous frame is still using this image. usually already reached, then it's just a compare
 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-		VkSemaphore waitSemaphores[1] = { imageAvailableSemaphores[currentFrame] };
-		VkPipelineStageFlags waitStages[1] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = waitSemaphores;
-		submitInfo.pWaitDstStageMask = waitStages;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-
-		VkSemaphore signalSemaphores[1] = { renderFinishedSemaphores[currentFrame] };
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = signalSemaphores;
-
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
+		frameImageIndex = imageIndex;
+		worldStreamer.update(static_cast<uint32_t>(currentFrame), glm::vec2(cameraTarget)); // after the acquire, what it stages has to make it into this frame's commands
+		frameTasks.execute(jobSystem); // transforms, culling, the async compute work, command recording and the uniform upload
+		if (asyncCompute.isActive(static_cast<uint32_t>(currentFrame))) {
+			asyncCompute.submit(static_cast<uint32_t>(currentFrame)); // compute goes first, the graphics submission below waits on it
+		}
 
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("Failed to submit draw command buffer!");
+		TimelineSubmit submit;
+		submit.waitFor(imageAvailableSemaphores[currentFrame], 0, ACQUIRE_WAIT_STAGE);
+		AsyncCompute::GraphicsSync computeSync = asyncCompute.graphicsSubmit(static_cast<uint32_t>(currentFrame)); // empty if there was no compute work this frame
+		if (computeSync.waitSemaphore != VK_NULL_HANDLE) {
+			submit.waitFor(computeSync.waitSemaphore, computeSync.waitValue, computeSync.waitStage);
 		}
+		submit.addCommandBuffer(commandBuffers[imageIndex]);
+		submit.signal(renderFinishedSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT); // binary, for present
+
+		uint64_t frameValue = graphicsTimeline.submit(submit); // also signals the graphics timeline
+		frameTimelineValues[currentFrame] = frameValue;
+		frameStats.frameSubmitted(frameValue);
+		imageTimelineValues[imageIndex] = frameValue; // mark the image as now being in use by this frame
+		++submittedFrames;
+		if (captureWriter.isOpen() || replay != nullptr)
+			captureFrame();
 
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = signalSemaphores;
+		presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
 
 		VkSwapchainKHR swapChains[1] = { swapChain };
 		presentInfo.swapchainCount = 1;
@@ -1274,36 +2902,65 @@ private:
 		presentInfo.pImageIndices = &imageIndex;
 		presentInfo.pResults = nullptr;
 
+		VkSwapchainPresentFenceInfoEXT presentFenceInfo{};
+		if (presentFencesSupported) {
+			// the frame's previous present, normally long done. the graphics timeline wait above doesn't cover presents
+			vkWaitForFences(device, 1, &presentFences[currentFrame], VK_TRUE, UINT64_MAX);
+			vkResetFences(device, 1, &presentFences[currentFrame]);
+			presentFenceInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT;
+			presentFenceInfo.swapchainCount = 1;
+			presentFenceInfo.pFences = &presentFences[currentFrame];
+			presentInfo.pNext = &presentFenceInfo;
+		}
+		lastPresentFrame = currentFrame;
+
 		result = vkQueuePresentKHR(presentQueue, &presentInfo); // submit request to present an image to the swap chain
-		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized || swapChainSettingsChanged) {
 			framebufferResized = false;
 			recreateSwapChain();
 		} else if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
-		vkQueueWaitIdle(presentQueue);
+		// no vkQueueWaitIdle here, the frame timeline values already limit how far ahead the CPU gets. waiting for the queue to drain would also stop the next frame's
+		// async compute from overlapping this frame's rendering
 
 		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
 	void cleanup() {
+		closeCapture();
 		cleanupSwapChain();
+		vkDestroySwapchainKHR(device, swapChain, nullptr);
+		deletionQueue.destroy(); // the device is idle, so this frees the last swap chain's resources straight away. before the command pool, it frees command buffers from it
 
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-
-		vkDestroyBuffer(device, indexBuffer, nullptr);
-		vkFreeMemory(device, indexBufferMemory, nullptr);
+		descriptorCache.destroy();
+
+		meshletRenderer.destroy();
+		worldStreamer.destroy();
+		clusteredLighting.destroy();
+		shadowCascades.destroy();
+		temporalUpscaler.destroy(); // its targets went with the swap chain
+		depthPyramid.destroy(); // same
 		vkDestroyBuffer(device, vertexBuffer, nullptr);
-		vkFreeMemory(device, vertexBufferMemory, nullptr);
+		freeDeviceMemory(device, vertexBufferMemory);
+		vkDestroyBuffer(device, shadowIndexBuffer, nullptr);
+		freeDeviceMemory(device, shadowIndexBufferMemory);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
 			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
 			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
 		}
+		for (VkFence fence : presentFences)
+			vkDestroyFence(device, fence, nullptr);
 
 		vkDestroyCommandPool(device, commandPool, nullptr);
+		particleSystem.destroy();
+		dynamicResolution.destroy();
+		asyncCompute.destroy();
+		graphicsTimeline.destroy();
+		memoryTelemetry.destroy(); // last, after everything allocated from the device was freed
 
 		vkDestroyDevice(device, nullptr); // the logical device that was interfacing with the physical device
 
@@ -1314,31 +2971,201 @@ private:
 		vkDestroySurfaceKHR(instance, surface, nullptr); // GLFW doesn't offer a special funtion for destroying the surface - do through original vk
 		vkDestroyInstance(instance, nullptr); // instance should only be destroyed right before the program exits. all other Vulkan resources should be cleaned up before this instance itself!
 
-		glfwDestroyWindow(window); // cleanup resources by destroying window
-		glfwTerminate(); // terminate GLFW itself
+		if (!headless()) {
+			glfwDestroyWindow(window); // cleanup resources by destroying window
+			glfwTerminate(); // terminate GLFW itself
+		}
 	}
 };
 
 #include <fstream>
-static std::vector<char> readFile(const std::string& filename) {
-	std::ifstream file(filename, std::ios::ate | std::ios::binary); // ate: start reading at end of file, binary: read as binary file to avoid text transformations
-	if (!file.is_open()) {
-		throw std::runtime_error("failed to open file!");
+
+static const char* argumentValue(int argc, char** argv, const char* name) { // the value after --name, nullptr if it isn't there
+	for (int i = 1; i + 1 < argc; ++i)
+		if (strcmp(argv[i], name) == 0)
+			return argv[i + 1];
+	return nullptr;
+}
+
+static bool hasArgument(int argc, char** argv, const char* name) {
+	for (int i = 1; i < argc; ++i)
+		if (strcmp(argv[i], name) == 0)
+			return true;
+	return false;
+}
+
+static bool writeBenchmarkFile(const char* path, const std::vector<BenchmarkResult>& results, const std::string& deviceName) {
+	std::ofstream output(path);
+	if (!output.is_open()) {
+		std::cerr << "failed to open " << path << std::endl;
+		return false;
+	}
+	writeBenchmarkJson(results, deviceName, output);
+	return true;
+}
+
+// writes the results as JSON to --output (stdout without it) and compares them against --baseline within --tolerance. a missing baseline fails
+// the run like a regression would, the comparison is the point of it. with --write-baseline the results are stored as the baseline instead of
+// compared. a frame that allocated on the hot path fails the run either way
+static int reportBenchmarkResults(int argc, char** argv, const std::vector<BenchmarkResult>& results, const std::string& deviceName) {
+	if (const char* outputPath = argumentValue(argc, argv, "--output")) {
+		if (!writeBenchmarkFile(outputPath, results, deviceName))
+			return EXIT_FAILURE;
+	} else {
+		writeBenchmarkJson(results, deviceName, std::cout);
 	}
+	bool allocationFree = checkHotPathAllocations(results, std::cerr);
 
-	size_t fileSize = (size_t)file.tellg(); // since we started reading at the end of the file, the read position can be used to determine the size of the file for allocating the buffer
-	std::vector<char> buffer(fileSize);
+	const char* baselinePath = argumentValue(argc, argv, "--baseline");
+	if (hasArgument(argc, argv, "--write-baseline")) {
+		if (baselinePath == nullptr) {
+			std::cerr << "--write-baseline needs --baseline <file.json> to write to" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!allocationFree) { // a baseline that allocates would hide the next run's allocations
+			std::cerr << "not storing a baseline with hot path allocations in it" << std::endl;
+			return EXIT_FAILURE;
+		}
+		if (!writeBenchmarkFile(baselinePath, results, deviceName))
+			return EXIT_FAILURE;
+		std::cerr << "stored the baseline at " << baselinePath << std::endl;
+		return EXIT_SUCCESS;
+	}
+	if (baselinePath != nullptr) {
+		std::ifstream baselineFile(baselinePath);
+		if (!baselineFile.is_open()) {
+			std::cerr << "no baseline at " << baselinePath << " to compare against, store one with the benchmark-baseline target (--write-baseline)" << std::endl;
+			return EXIT_FAILURE;
+		}
+		const char* tolerance = argumentValue(argc, argv, "--tolerance");
+		try {
+			if (!compareWithBaseline(results, readBenchmarkJson(baselineFile), tolerance != nullptr ? std::strtod(tolerance, nullptr) : 0.1, std::cerr))
+				return EXIT_FAILURE;
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	return allocationFree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-	// now we can seek to the beginning and read all bytes at once:
-	file.seekg(0);
-	file.read(buffer.data(), fileSize);
+// --benchmark [--scene <name>] [--frames <n>] [--output <file.json>] [--baseline <file.json> [--write-baseline]] [--tolerance <fraction>]
+// runs the scripted scenes headless one after the other, each with a fresh engine, writes the results as JSON (to stdout without --output) and
+// compares them against the baseline, or stores them as it. the exit code is non zero when something regressed, the baseline is missing or a
+// frame allocated
+static int runBenchmarks(int argc, char** argv, const std::string& deviceSelector) {
+	std::vector<BenchmarkScene> scenes = builtinBenchmarkScenes();
+	if (const char* sceneName = argumentValue(argc, argv, "--scene")) {
+		scenes.erase(std::remove_if(scenes.begin(), scenes.end(), [&](const BenchmarkScene& scene) { return scene.name != sceneName; }), scenes.end());
+		if (scenes.empty()) {
+			std::cerr << "unknown benchmark scene " << sceneName << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	if (const char* frames = argumentValue(argc, argv, "--frames")) {
+		for (BenchmarkScene& scene : scenes)
+			scene.frames = static_cast<uint32_t>(std::strtoul(frames, nullptr, 10));
+	}
 
-	file.close();
-	return buffer;
+	std::vector<BenchmarkResult> results;
+	std::string deviceName;
+	try {
+		for (const BenchmarkScene& scene : scenes) {
+			std::cerr << "benchmark " << scene.name << "..." << std::endl;
+			MainApplication app(deviceSelector, &scene);
+			app.run();
+			results.push_back(app.benchmarkResult());
+			deviceName = app.deviceName();
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return reportBenchmarkResults(argc, argv, results, deviceName);
+}
+
+// --replay <capture.vcap> [--first <n>] [--frames <n>] [--output <file.json>] [--baseline <file.json> [--write-baseline]] [--tolerance <fraction>]
+// replays a frame capture headless (see FrameCapture.h). the frames from --first on (--frames of them, all by default) are timed and reported
+// like a benchmark scene named after the capture, so a capture can be kept next to a baseline and bisected like the scripted scenes
+static int runReplay(int argc, char** argv, const std::string& deviceSelector) {
+	const char* capturePath = argumentValue(argc, argv, "--replay");
+	ReplaySettings settings;
+	std::string fileName = capturePath;
+	settings.name = "replay " + fileName.substr(fileName.find_last_of("/\\") + 1); // find_last_of gives npos without a directory, npos + 1 is 0
+	if (const char* first = argumentValue(argc, argv, "--first"))
+		settings.firstFrame = static_cast<uint32_t>(std::strtoul(first, nullptr, 10));
+	if (const char* frames = argumentValue(argc, argv, "--frames"))
+		settings.frameCount = static_cast<uint32_t>(std::strtoul(frames, nullptr, 10));
+
+	std::vector<BenchmarkResult> results;
+	std::string deviceName;
+	try {
+		settings.capture = readFrameCapture(capturePath);
+		std::cerr << "replaying " << settings.capture.frames.size() << " frames of " << capturePath << "..." << std::endl;
+		MainApplication app(deviceSelector, nullptr, &settings);
+		app.run();
+		results.push_back(app.benchmarkResult());
+		deviceName = app.deviceName();
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+	return reportBenchmarkResults(argc, argv, results, deviceName);
 }
 
-int main() {
-	MainApplication app;
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--benchmark-draw-list") == 0) { // no window or device, just the CPU side sort
+		JobSystem jobSystem;
+		benchmarkDrawList(jobSystem, std::cout);
+		return EXIT_SUCCESS;
+	}
+
+	std::string deviceSelector = deviceSelectorFromCommandLine(argc, argv); // --device <index or name> or VULKAN_ENGINE_DEVICE
+#ifdef ENGINE_BENCHMARK_EXECUTABLE
+	const bool benchmarkExecutable = true; // the VulkanEngineBenchmark target (CMakeLists.txt) only runs the benchmarks
+#else
+	const bool benchmarkExecutable = false;
+#endif
+	if (argumentValue(argc, argv, "--replay") != nullptr) { // either executable, the benchmark one counts the allocations
+		return runReplay(argc, argv, deviceSelector);
+	}
+	if (benchmarkExecutable || (argc > 1 && strcmp(argv[1], "--benchmark") == 0)) {
+		return runBenchmarks(argc, argv, deviceSelector);
+	}
+	if (argc > 1 && strcmp(argv[1], "--pack-assets") == 0) { // --pack-assets <archive> <root> <file or directory>..., named by their path relative to root
+		if (argc < 5) {
+			std::cerr << "usage: --pack-assets <archive> <root> <file or directory>..." << std::endl;
+			return EXIT_FAILURE;
+		}
+		try {
+			std::vector<ArchiveSource> sources = collectArchiveSources(argv[3], std::vector<std::string>(argv + 4, argv + argc));
+			writeArchive(argv[2], sources);
+			std::cout << "packed " << sources.size() << " files into " << argv[2] << std::endl;
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+	if (argc > 1 && strcmp(argv[1], "--multi-gpu-offscreen") == 0) { // no window, independent offscreen jobs spread over every suitable GPU
+		OffscreenSettings settings;
+		settings.deviceSelector = deviceSelector;
+		if (argc > 2 && argv[2][0] != '-')
+			settings.jobCount = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+		try {
+			runMultiGpuOffscreen(settings, std::cout);
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return EXIT_SUCCESS;
+	}
+
+	MainApplication app(deviceSelector);
+	if (const char* capturePath = argumentValue(argc, argv, "--capture")) { // --capture <file.vcap> [--capture-frames <n>], see FrameCapture.h
+		const char* frames = argumentValue(argc, argv, "--capture-frames");
+		app.captureTo(capturePath, frames != nullptr ? static_cast<uint32_t>(std::strtoul(frames, nullptr, 10)) : 0);
+	}
 
 	try {
 		app.run();
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <iostream>
+
+// The CPU tests' checks. No test framework, the engine doesn't depend on one: CHECK reports a failed condition with its location and keeps going,
+// so a run lists everything that's wrong, and main() returns checkResult() for ctest.
+
+inline int& checkFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			++checkFailures(); \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+		} \
+	} while (0)
+
+inline int checkResult(const char* testName) {
+	if (checkFailures() == 0) {
+		std::cout << testName << ": all checks passed" << std::endl;
+		return 0;
+	}
+	std::cerr << testName << ": " << checkFailures() << " checks failed" << std::endl;
+	return 1;
+}
@@ -0,0 +1,220 @@
+#include "DescriptorAllocator.h"
+#include "GpuTimeline.h"
+
+#include "Check.h"
+
+#include <cstring>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+// CPU only test of the descriptor allocator and set cache, against a handful of fake Vulkan entry points defined below (they win over the loader's
+// when linking): the allocator moves on to a new, larger pool when one runs out and keeps its pools over a reset, the cache hands out one set per
+// layout and bindings and writes it only once, the hash covers every field of a binding, and a forgotten set is only reused once the timeline has
+// passed the frame that could still be using it
+
+namespace {
+
+template<typename T>
+T fakeHandle(uint64_t bits) { // non dispatchable handles are pointers on 64 bit builds and integers on 32 bit ones
+	T handle{};
+	std::memcpy(&handle, &bits, sizeof(T));
+	return handle;
+}
+
+struct FakeDevice {
+	uint64_t nextHandle = 0x1000;
+	std::map<VkDescriptorPool, uint32_t> poolCapacity; // sets a pool holds
+	std::map<VkDescriptorPool, uint32_t> poolUsed;
+	std::vector<uint32_t> poolSizes; // maxSets of every pool created, in order
+	uint32_t writes = 0; // descriptor writes, vkUpdateDescriptorSets calls count once per write
+	uint64_t timelineCounter = 0; // what the fake GPU has finished
+	uint64_t timelineSubmitted = 0;
+} fake;
+
+VkDevice device() { return reinterpret_cast<VkDevice>(&fake); }
+
+} // namespace
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo* createInfo, const VkAllocationCallbacks*, VkDescriptorPool* pool) {
+	*pool = fakeHandle<VkDescriptorPool>(fake.nextHandle++);
+	fake.poolCapacity[*pool] = createInfo->maxSets;
+	fake.poolUsed[*pool] = 0;
+	fake.poolSizes.push_back(createInfo->maxSets);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool pool, const VkAllocationCallbacks*) {
+	fake.poolCapacity.erase(pool);
+	fake.poolUsed.erase(pool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(VkDevice, VkDescriptorPool pool, VkDescriptorPoolResetFlags) {
+	fake.poolUsed[pool] = 0;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* allocateInfo, VkDescriptorSet* sets) {
+	uint32_t& used = fake.poolUsed[allocateInfo->descriptorPool];
+	if (used + allocateInfo->descriptorSetCount > fake.poolCapacity[allocateInfo->descriptorPool])
+		return VK_ERROR_OUT_OF_POOL_MEMORY;
+	used += allocateInfo->descriptorSetCount;
+	for (uint32_t i = 0; i < allocateInfo->descriptorSetCount; ++i)
+		sets[i] = fakeHandle<VkDescriptorSet>(fake.nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t writeCount, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*) {
+	fake.writes += writeCount;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore* semaphore) {
+	*semaphore = fakeHandle<VkSemaphore>(fake.nextHandle++);
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks*) {}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit2(VkQueue, uint32_t, const VkSubmitInfo2*, VkFence) {
+	++fake.timelineSubmitted;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue(VkDevice, VkSemaphore, uint64_t* value) {
+	*value = fake.timelineCounter;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores(VkDevice, const VkSemaphoreWaitInfo*, uint64_t) {
+	fake.timelineCounter = fake.timelineSubmitted; // the fake GPU finishes whatever is waited for
+	return VK_SUCCESS;
+}
+
+namespace {
+
+const VkDescriptorSetLayout LAYOUT_A = fakeHandle<VkDescriptorSetLayout>(0xA);
+const VkDescriptorSetLayout LAYOUT_B = fakeHandle<VkDescriptorSetLayout>(0xB);
+
+void testAllocatorGrowth() {
+	fake.poolSizes.clear();
+	DescriptorAllocator allocator;
+	allocator.init(device(), 4);
+	std::set<VkDescriptorSet> sets;
+	for (uint32_t i = 0; i < 4 + 8 + 3; ++i) // fills the first pool and the second, a third is started
+		sets.insert(allocator.allocate(LAYOUT_A));
+	CHECK(sets.size() == 15);
+	CHECK(allocator.poolCount() == 3);
+	CHECK(allocator.setCount() == 15);
+	CHECK(fake.poolSizes.size() == 3 && fake.poolSizes[0] == 4 && fake.poolSizes[1] == 8 && fake.poolSizes[2] == 16); // each twice the one before
+
+	allocator.reset(); // the pools stay, the sets go
+	CHECK(allocator.setCount() == 0);
+	for (uint32_t i = 0; i < 20; ++i)
+		allocator.allocate(LAYOUT_A);
+	CHECK(allocator.poolCount() == 3); // nothing new was needed
+	CHECK(fake.poolSizes.size() == 3);
+	allocator.destroy();
+	CHECK(allocator.poolCount() == 0);
+}
+
+DescriptorBinding uniformBinding(uint64_t buffer, VkDeviceSize offset = 0) {
+	return DescriptorBinding::buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, fakeHandle<VkBuffer>(buffer), offset, 256);
+}
+
+DescriptorBinding imageBinding(uint64_t view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+	return DescriptorBinding::image(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, fakeHandle<VkImageView>(view), fakeHandle<VkSampler>(0x5A), layout);
+}
+
+void testHitsAndMisses(GpuTimeline& timeline) {
+	DescriptorSetCache cache;
+	cache.init(device(), timeline);
+	DescriptorBinding bindings[2] = { uniformBinding(0x100), imageBinding(0x200) };
+	uint32_t writesBefore = fake.writes;
+	VkDescriptorSet set = cache.get(LAYOUT_A, bindings, 2);
+	CHECK(fake.writes - writesBefore == 2);
+	CHECK(cache.get(LAYOUT_A, bindings, 2) == set); // a hit writes nothing
+	CHECK(fake.writes - writesBefore == 2);
+	CHECK(cache.stats().hits == 1 && cache.stats().misses == 1 && cache.stats().cached == 1);
+
+	DescriptorBinding copy[2] = { uniformBinding(0x100), imageBinding(0x200) }; // equal bindings built separately hash the same
+	CHECK(cache.get(LAYOUT_A, copy, 2) == set);
+
+	// any field that differs is another set
+	std::set<VkDescriptorSet> others;
+	DescriptorBinding otherBuffer[2] = { uniformBinding(0x101), imageBinding(0x200) };
+	DescriptorBinding otherOffset[2] = { uniformBinding(0x100, 256), imageBinding(0x200) };
+	DescriptorBinding otherLayout[2] = { uniformBinding(0x100), imageBinding(0x200, VK_IMAGE_LAYOUT_GENERAL) };
+	DescriptorBinding otherType[2] = { uniformBinding(0x100), imageBinding(0x200) };
+	otherType[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	DescriptorBinding otherBinding[2] = { uniformBinding(0x100), imageBinding(0x200) };
+	otherBinding[1].binding = 2;
+	others.insert(cache.get(LAYOUT_A, otherBuffer, 2));
+	others.insert(cache.get(LAYOUT_A, otherOffset, 2));
+	others.insert(cache.get(LAYOUT_A, otherLayout, 2));
+	others.insert(cache.get(LAYOUT_A, otherType, 2));
+	others.insert(cache.get(LAYOUT_A, otherBinding, 2));
+	others.insert(cache.get(LAYOUT_B, bindings, 2)); // same bindings, another layout
+	others.insert(cache.get(LAYOUT_A, bindings, 1)); // a prefix of them
+	CHECK(others.size() == 7 && others.count(set) == 0);
+	CHECK(cache.stats().misses == 8);
+	CHECK(cache.stats().cached == 8);
+
+	DescriptorBinding tooMany[DescriptorSetCache::MAX_BINDINGS + 1];
+	bool threw = false;
+	try {
+		cache.get(LAYOUT_A, tooMany, DescriptorSetCache::MAX_BINDINGS + 1);
+	} catch (const std::exception&) {
+		threw = true;
+	}
+	CHECK(threw);
+	cache.destroy();
+}
+
+// a swap chain recreation: the sets of the old images are forgotten while a frame that uses them may still be in flight, the new images' sets only
+// get them back once the timeline says that frame is done
+void testForgetAndReuse(GpuTimeline& timeline) {
+	DescriptorSetCache cache;
+	cache.init(device(), timeline);
+	DescriptorBinding old[2] = { uniformBinding(0x300), imageBinding(0x400) };
+	DescriptorBinding unrelated[1] = { uniformBinding(0x500) };
+	VkDescriptorSet oldSet = cache.get(LAYOUT_A, old, 2);
+	VkDescriptorSet unrelatedSet = cache.get(LAYOUT_A, unrelated, 1);
+
+	TimelineSubmit submit;
+	timeline.submit(submit); // the frame using oldSet, not finished yet
+	cache.forget(fakeHandle<VkImageView>(0x400));
+	CHECK(cache.stats().cached == 1);
+	CHECK(cache.get(LAYOUT_A, unrelated, 1) == unrelatedSet); // untouched
+
+	cache.collect(); // the GPU isn't there yet, so the next set is a new one
+	DescriptorBinding first[2] = { uniformBinding(0x300), imageBinding(0x401) };
+	VkDescriptorSet firstSet = cache.get(LAYOUT_A, first, 2);
+	CHECK(firstSet != oldSet);
+	CHECK(cache.stats().reused == 0);
+
+	fake.timelineCounter = timeline.nextValue(); // the frame the set was retired at is done as well
+	cache.collect();
+	DescriptorBinding second[2] = { uniformBinding(0x300), imageBinding(0x402) };
+	uint32_t writesBefore = fake.writes;
+	CHECK(cache.get(LAYOUT_B, second, 2) != oldSet); // free sets are per layout
+	CHECK(cache.get(LAYOUT_A, second, 2) == oldSet); // rewritten for the new bindings
+	CHECK(fake.writes - writesBefore == 4);
+	CHECK(cache.stats().reused == 1);
+
+	cache.forget(fakeHandle<VkBuffer>(0x300)); // buffers are resources too, every set binding it goes
+	CHECK(cache.stats().cached == 1);
+	cache.destroy();
+}
+
+} // namespace
+
+int main() {
+	GpuTimeline timeline;
+	timeline.init(device(), VK_NULL_HANDLE);
+	testAllocatorGrowth();
+	testHitsAndMisses(timeline);
+	testForgetAndReuse(timeline);
+	timeline.destroy();
+	return checkResult("DescriptorSetCacheTests");
+}
@@ -0,0 +1,113 @@
+#include "DeviceSelector.h"
+
+#include "Check.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// CPU only test of the device ranking, on hand filled capabilities instead of real devices: the device type outweighs everything else, VRAM and
+// the queue/feature bonuses order devices of one type, ties keep the enumeration order, and --device / VULKAN_ENGINE_DEVICE pick devices by index
+// or name
+
+namespace {
+
+const VkDeviceSize GIB = VkDeviceSize(1) << 30;
+
+DeviceCapabilities device(uint32_t index, const char* name, VkPhysicalDeviceType type, VkDeviceSize memory) {
+	DeviceCapabilities capabilities;
+	capabilities.index = index;
+	capabilities.name = name;
+	capabilities.type = type;
+	capabilities.deviceLocalMemory = memory;
+	capabilities.score = scoreDevice(capabilities);
+	return capabilities;
+}
+
+void testTypeTiers() {
+	// the best integrated GPU there could be still loses to the smallest discrete one
+	DeviceCapabilities integrated = device(0, "integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 4096 * GIB);
+	integrated.asyncCompute = true;
+	integrated.dedicatedTransfer = true;
+	integrated.meshShaders = true;
+	DeviceCapabilities discrete = device(1, "discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 0);
+	CHECK(scoreDevice(discrete) > scoreDevice(integrated));
+
+	DeviceCapabilities virtualGpu = device(2, "virtual", VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU, 8 * GIB);
+	DeviceCapabilities cpu = device(3, "llvmpipe", VK_PHYSICAL_DEVICE_TYPE_CPU, 64 * GIB);
+	CHECK(scoreDevice(integrated) > scoreDevice(virtualGpu));
+	CHECK(scoreDevice(virtualGpu) > scoreDevice(cpu));
+}
+
+void testWithinTier() {
+	DeviceCapabilities small = device(0, "small", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4 * GIB);
+	DeviceCapabilities large = device(1, "large", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8 * GIB);
+	CHECK(scoreDevice(large) > scoreDevice(small));
+	CHECK(scoreDevice(large) - scoreDevice(small) == 4 * 100); // 100 points per GiB
+	CHECK(scoreDevice(device(2, "partial", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 4 * GIB + GIB / 2)) == scoreDevice(small)); // whole GiB only
+
+	DeviceCapabilities async = small;
+	async.asyncCompute = true;
+	DeviceCapabilities transfer = small;
+	transfer.dedicatedTransfer = true;
+	DeviceCapabilities mesh = small;
+	mesh.meshShaders = true;
+	CHECK(scoreDevice(async) > scoreDevice(transfer)); // async compute is worth the most
+	CHECK(scoreDevice(transfer) > scoreDevice(small));
+	CHECK(scoreDevice(mesh) > scoreDevice(small));
+
+	DeviceCapabilities unscored = small;
+	unscored.memoryBudget = true;
+	unscored.swapchainMaintenance = true;
+	CHECK(scoreDevice(unscored) == scoreDevice(small));
+}
+
+void testRanking() {
+	std::vector<DeviceCapabilities> devices = {
+		device(0, "cpu", VK_PHYSICAL_DEVICE_TYPE_CPU, 32 * GIB),
+		device(1, "first", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8 * GIB),
+		device(2, "integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 2 * GIB),
+		device(3, "second", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8 * GIB), // ties with "first"
+	};
+	rankDevices(devices);
+	CHECK(devices[0].index == 1); // the tie keeps the enumeration order
+	CHECK(devices[1].index == 3);
+	CHECK(devices[2].index == 2);
+	CHECK(devices[3].index == 0);
+}
+
+void testSelector() {
+	DeviceCapabilities capabilities = device(2, "NVIDIA GeForce RTX 4070", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 12 * GIB);
+	CHECK(matchesDeviceSelector(capabilities, "")); // no selector, anything goes
+	CHECK(matchesDeviceSelector(capabilities, "2"));
+	CHECK(!matchesDeviceSelector(capabilities, "1"));
+	CHECK(matchesDeviceSelector(capabilities, "geforce")); // case insensitive substring
+	CHECK(matchesDeviceSelector(capabilities, "RTX 4070"));
+	CHECK(!matchesDeviceSelector(capabilities, "radeon"));
+	CHECK(!matchesDeviceSelector(capabilities, "4070 ti"));
+}
+
+// --device wins over VULKAN_ENGINE_DEVICE, whatever the environment running the test has set
+void testCommandLine() {
+	char program[] = "engine";
+	char other[] = "--benchmark";
+	char deviceFlag[] = "--device";
+	char value[] = "llvmpipe";
+	char* withDevice[] = { program, other, deviceFlag, value };
+	CHECK(deviceSelectorFromCommandLine(4, withDevice) == "llvmpipe");
+
+	char* dangling[] = { program, deviceFlag }; // no value after it, falls through to the environment
+	const char* environment = std::getenv("VULKAN_ENGINE_DEVICE");
+	CHECK(deviceSelectorFromCommandLine(2, dangling) == (environment != nullptr ? environment : ""));
+}
+
+} // namespace
+
+int main() {
+	testTypeTiers();
+	testWithinTier();
+	testRanking();
+	testSelector();
+	testCommandLine();
+	return checkResult("DeviceSelectorTests");
+}
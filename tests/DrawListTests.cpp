@@ -0,0 +1,169 @@
+#include "DrawList.h"
+#include "JobSystem.h"
+
+#include "Check.h"
+
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// CPU only test of the draw list: the sort key packs and unpacks the state, layers come out in order, depth sorts front to back inside a state and
+// back to front in blended layers, identical states merge into one batch, and draws with equal keys keep the order they were added in - serially and
+// with the parallel radix sort past PARALLEL_SORT_THRESHOLD. the main pass's instance data relies on that order
+
+namespace {
+
+DrawState makeState(uint32_t layer, uint32_t pipeline, uint32_t descriptorSet, uint32_t material, uint32_t mesh) {
+	DrawState state;
+	state.layer = layer;
+	state.pipeline = pipeline;
+	state.descriptorSet = descriptorSet;
+	state.material = material;
+	state.mesh = mesh;
+	return state;
+}
+
+void testKeyRoundTrip() {
+	DrawList list;
+	list.setBlendedLayer(3, true);
+	const DrawState states[] = {
+		makeState(0, 0, 0, 0, 0),
+		makeState(1, 7, 300, 2000, 4000),
+		makeState(15, 255, 4095, 4095, 4095), // every field full
+		makeState(3, 12, 1, 2, 3), // blended, the fields sit elsewhere in the key
+	};
+	for (const DrawState& state : states) {
+		CHECK(list.stateOf(list.makeKey(state, 0.25f)) == state);
+		CHECK(list.stateOf(list.makeKey(state, 1.0f)) == state);
+	}
+	CHECK(list.makeKey(states[1], -1.0f) == list.makeKey(states[1], 0.0f)); // depth is clamped
+	CHECK(list.makeKey(states[1], 2.0f) == list.makeKey(states[1], 1.0f));
+}
+
+void testLayerAndDepthOrder() {
+	DrawList list;
+	list.setBlendedLayer(2, true);
+	DrawState blended = makeState(2, 0, 0, 0, 0);
+	DrawState opaque = makeState(1, 5, 0, 0, 0);
+	DrawState first = makeState(0, 9, 0, 0, 0);
+	list.add(blended, 0.2f, 0);
+	list.add(blended, 0.8f, 1);
+	list.add(opaque, 0.7f, 2);
+	list.add(opaque, 0.1f, 3);
+	list.add(first, 0.5f, 4);
+	list.sort();
+
+	const std::vector<uint32_t>& order = list.instances();
+	CHECK(order.size() == 5);
+	CHECK(order[0] == 4); // layer 0 before everything, whatever its state ids
+	CHECK(order[1] == 3); // opaque: front to back
+	CHECK(order[2] == 2);
+	CHECK(order[3] == 1); // blended: back to front
+	CHECK(order[4] == 0);
+}
+
+void testBatches() {
+	DrawList list;
+	DrawState a = makeState(0, 1, 2, 3, 4);
+	DrawState b = makeState(0, 1, 2, 3, 5);
+	for (uint32_t i = 0; i < 6; ++i)
+		list.add(i % 2 == 0 ? a : b, 0.5f, i); // interleaved, the sort brings each state together
+	list.sort();
+
+	const std::vector<DrawBatch>& batches = list.batches();
+	CHECK(batches.size() == 2);
+	CHECK(batches[0].state == a);
+	CHECK(batches[0].firstInstance == 0);
+	CHECK(batches[0].instanceCount == 3);
+	CHECK(batches[1].state == b);
+	CHECK(batches[1].firstInstance == 3);
+	CHECK(batches[1].instanceCount == 3);
+	CHECK(list.stats().draws == 6);
+	CHECK(list.stats().batches == 2);
+	CHECK(list.stats().meshChanges == 2); // the first bind counts
+	CHECK(list.stats().materialChanges == 1);
+	CHECK(list.stats().pipelineChanges == 1);
+
+	list.clear();
+	CHECK(list.size() == 0);
+	list.sort();
+	CHECK(list.batches().empty());
+}
+
+// equal keys come out in the order they went in, a value's position then only depends on the values added before it with the same key
+void checkStable(JobSystem* jobSystem, uint32_t count) {
+	DrawList list;
+	std::mt19937 random(7);
+	std::vector<DrawState> states;
+	for (uint32_t i = 0; i < 8; ++i)
+		states.push_back(makeState(random() % 2, random() % 4, 0, 0, random() % 4));
+	for (uint32_t i = 0; i < count; ++i)
+		list.add(states[random() % states.size()], 0.5f, i); // the value is the submission order
+	list.sort(jobSystem);
+
+	CHECK(list.instances().size() == count);
+	uint32_t total = 0;
+	bool ascending = true;
+	for (const DrawBatch& batch : list.batches()) {
+		for (uint32_t i = 1; i < batch.instanceCount; ++i)
+			ascending = ascending && list.instances()[batch.firstInstance + i - 1] < list.instances()[batch.firstInstance + i];
+		total += batch.instanceCount;
+	}
+	CHECK(ascending);
+	CHECK(total == count);
+}
+
+void testStableTies() {
+	checkStable(nullptr, 1000);
+	JobSystem jobSystem;
+	checkStable(&jobSystem, DrawList::PARALLEL_SORT_THRESHOLD * 3);
+}
+
+// the parallel sort puts every draw where the serial one does
+void testParallelMatchesSerial() {
+	std::mt19937 random(3);
+	DrawList serial;
+	DrawList parallel;
+	for (uint32_t i = 0; i < DrawList::PARALLEL_SORT_THRESHOLD * 2; ++i) {
+		DrawState state = makeState(random() % 3, random() % 16, random() % 64, random() % 256, random() % 512);
+		float depth = static_cast<float>(random() % 1000) / 1000.0f;
+		serial.add(state, depth, i);
+		parallel.add(state, depth, i);
+	}
+	serial.sort();
+	JobSystem jobSystem;
+	parallel.sort(&jobSystem);
+	CHECK(serial.instances() == parallel.instances());
+	CHECK(serial.batches().size() == parallel.batches().size());
+}
+
+void testOutOfRange() {
+	DrawList list;
+	bool threw = false;
+	try {
+		list.add(makeState(0, 256, 0, 0, 0), 0.0f, 0); // the pipeline has 8 bits
+	} catch (const std::exception&) {
+		threw = true;
+	}
+	CHECK(threw);
+	threw = false;
+	try {
+		list.add(makeState(16, 0, 0, 0, 0), 0.0f, 0);
+	} catch (const std::exception&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(list.size() == 0);
+}
+
+} // namespace
+
+int main() {
+	testKeyRoundTrip();
+	testLayerAndDepthOrder();
+	testBatches();
+	testStableTies();
+	testParallelMatchesSerial();
+	testOutOfRange();
+	return checkResult("DrawListTests");
+}
@@ -0,0 +1,136 @@
+#include "AllocationCounter.h"
+#include "Benchmark.h"
+#include "DrawList.h"
+#include "JobSystem.h"
+#include "LinearArena.h"
+
+#include "Check.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// The per frame CPU path has to stay off the heap once it is warm. Built with ENGINE_COUNT_ALLOCATIONS, this runs the pieces of a frame that don't
+// need a device headless - draw list sorting (serial and on the job system), the frame arenas and scratch scopes, the frame task list and the
+// benchmark recorder - for a few frames to warm up, then checks that many more frames don't make a single heap allocation. The descriptor set cache
+// and the rest of drawFrame() need a device, the benchmark (--benchmark) fails on those when they allocate
+
+namespace {
+
+const uint32_t WARMUP_FRAMES = 8;
+const uint32_t FRAMES = 200;
+const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+
+struct Frame {
+	JobSystem jobs;
+	DrawList smallList; // sorted serially
+	DrawList largeList; // past PARALLEL_SORT_THRESHOLD, sorted on the workers
+	FrameArenas frameArenas;
+	FrameTaskList tasks;
+	BenchmarkRecorder recorder;
+	std::vector<DrawState> states;
+	std::vector<float> depths;
+	uint64_t checksum = 0; // keeps the work from being optimized away
+};
+
+void fill(DrawList& list, const Frame& frame, uint32_t count, uint32_t frameIndex) {
+	list.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		size_t pick = (i * 7919u + frameIndex * 104729u) % frame.states.size(); // a different order every frame
+		list.add(frame.states[pick], frame.depths[pick], i);
+	}
+}
+
+void runFrame(Frame& frame, uint32_t frameIndex) {
+	LinearArena& arena = frame.frameArenas.beginFrame(frameIndex % MAX_FRAMES_IN_FLIGHT);
+	ArenaVector<uint32_t> visible{ ArenaAllocator<uint32_t>(arena) };
+	visible.reserve(1024);
+	for (uint32_t i = 0; i < 1024; ++i)
+		visible.push_back(i * frameIndex);
+
+	{
+		ScratchScope scratch;
+		ArenaVector<uint64_t> temporary = scratch.vector<uint64_t>(4096);
+		temporary[frameIndex % temporary.size()] = visible.back();
+		frame.checksum += temporary[frameIndex % temporary.size()];
+	}
+
+	fill(frame.smallList, frame, 2000, frameIndex);
+	frame.smallList.sort();
+	fill(frame.largeList, frame, DrawList::PARALLEL_SORT_THRESHOLD * 4, frameIndex);
+	frame.largeList.sort(&frame.jobs);
+	frame.checksum += frame.smallList.stats().batches + frame.largeList.stats().batches + frame.largeList.instances().front();
+
+	frame.tasks.execute(frame.jobs);
+	frame.recorder.recordFrame(1.0, 0);
+	for (FrameTaskList::TaskId task = 0; task < frame.tasks.taskCount(); ++task)
+		frame.recorder.recordSubsystem(task, frame.tasks.taskMilliseconds(task));
+}
+
+void testFrameLoop() {
+	Frame frame;
+	frame.frameArenas.init(MAX_FRAMES_IN_FLIGHT, 1024 * 1024);
+	std::mt19937 random(11);
+	for (uint32_t i = 0; i < 4096; ++i) {
+		DrawState state;
+		state.layer = random() % 2;
+		state.pipeline = random() % 16;
+		state.descriptorSet = random() % 64;
+		state.material = random() % 256;
+		state.mesh = random() % 512;
+		frame.states.push_back(state);
+		frame.depths.push_back(static_cast<float>(random() % 1000) / 1000.0f);
+	}
+	frame.smallList.setBlendedLayer(1, true);
+	frame.largeList.setBlendedLayer(1, true);
+
+	// a small graph like the engine's: two independent tasks, one waiting on both, and a parallelFor inside a task
+	std::vector<uint64_t> sums(frame.jobs.workerCount() * 64);
+	Frame* shared = &frame;
+	FrameTaskList::TaskId update = frame.tasks.addTask("update", [&sums]() {
+		for (size_t i = 0; i < sums.size(); ++i)
+			sums[i] += i;
+	});
+	FrameTaskList::TaskId cull = frame.tasks.addTask("cull", [shared, &sums]() {
+		shared->jobs.parallelFor(static_cast<uint32_t>(sums.size()), 16, [&sums](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i)
+				sums[i] ^= i * 31u;
+		});
+	});
+	frame.tasks.addTask("record", [shared, &sums]() { shared->checksum += sums.front(); }, { update, cull });
+	std::vector<std::string> names;
+	for (FrameTaskList::TaskId task = 0; task < frame.tasks.taskCount(); ++task)
+		names.push_back(frame.tasks.taskName(task));
+	frame.recorder.begin(names, WARMUP_FRAMES + FRAMES);
+
+	for (uint32_t i = 0; i < WARMUP_FRAMES; ++i)
+		runFrame(frame, i);
+
+	uint64_t before = heapAllocationCount();
+	for (uint32_t i = WARMUP_FRAMES; i < WARMUP_FRAMES + FRAMES; ++i)
+		runFrame(frame, i);
+	uint64_t allocations = heapAllocationCount() - before;
+	if (allocations != 0)
+		std::cerr << allocations << " heap allocations in " << FRAMES << " warm frames" << std::endl;
+	CHECK(allocations == 0);
+	CHECK(frame.largeList.size() == DrawList::PARALLEL_SORT_THRESHOLD * 4);
+	CHECK(frame.checksum != 0);
+}
+
+// the check above would pass trivially if nothing was counted
+void testCounting() {
+	CHECK(allocationCountingEnabled());
+	uint64_t before = heapAllocationCount();
+	std::vector<int>* allocated = new std::vector<int>(16);
+	CHECK(heapAllocationCount() - before == 2);
+	delete allocated;
+}
+
+} // namespace
+
+int main() {
+	testCounting();
+	testFrameLoop();
+	return checkResult("FrameAllocationTests");
+}
@@ -0,0 +1,166 @@
+#include "FrameCapture.h"
+
+#include "Check.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// CPU only test of the .vcap frame captures: frames written with FrameCaptureWriter read back field for field (few and many, so through one block
+// and many, empty arrays included), compareCapturedFrames() finds every kind of difference in the results, and reading rejects truncated and corrupt
+// captures. works in a scratch directory under the system's temp directory
+
+namespace {
+
+namespace fs = std::filesystem;
+
+CapturedFrame makeFrame(uint32_t index) {
+	CapturedFrame frame;
+	frame.width = 800 + index;
+	frame.height = 600;
+	frame.msaaSamples = 4;
+	frame.presentPolicy = index % 3;
+	frame.meshShaders = index % 2;
+	frame.temporalUpscaling = 1;
+	frame.occlusionCulling = (index / 2) % 2;
+	frame.lodPixelThreshold = 2.0f;
+	frame.time = 0.016f * static_cast<float>(index);
+	frame.simulationStep = 0.016f;
+	frame.renderScale = 0.75f;
+	for (uint32_t i = 0; i < 3; ++i) {
+		frame.cameraTarget[i] = static_cast<float>(index + i);
+		frame.sunDirection[i] = -0.5f * static_cast<float>(i);
+	}
+	for (uint32_t i = 0; i < index % 5; ++i) // none on some frames
+		frame.streamedChunks.push_back(index * 7 + i);
+	frame.uniforms.resize(256);
+	for (size_t i = 0; i < frame.uniforms.size(); ++i)
+		frame.uniforms[i] = static_cast<unsigned char>(i * 31 + index);
+	for (uint32_t i = 0; i < 1 + index % 4; ++i)
+		frame.draws.push_back({ i, index % 4, 0, i * 2, i * 3, 1 + index });
+	return frame;
+}
+
+bool sameFrame(const CapturedFrame& a, const CapturedFrame& b) {
+	return a.width == b.width && a.height == b.height && a.msaaSamples == b.msaaSamples && a.presentPolicy == b.presentPolicy &&
+		a.meshShaders == b.meshShaders && a.temporalUpscaling == b.temporalUpscaling && a.occlusionCulling == b.occlusionCulling &&
+		a.lodPixelThreshold == b.lodPixelThreshold && a.time == b.time && a.simulationStep == b.simulationStep && a.renderScale == b.renderScale &&
+		std::memcmp(a.cameraTarget, b.cameraTarget, sizeof(a.cameraTarget)) == 0 && std::memcmp(a.sunDirection, b.sunDirection, sizeof(a.sunDirection)) == 0 &&
+		a.streamedChunks == b.streamedChunks && compareCapturedFrames(a, b).empty();
+}
+
+void writeCapture(const fs::path& path, uint32_t frameCount) {
+	FrameCaptureWriter writer;
+	writer.open(path.string(), "Test GPU");
+	for (uint32_t i = 0; i < frameCount; ++i)
+		writer.write(makeFrame(i));
+	CHECK(writer.frameCount() == frameCount);
+	writer.close();
+	CHECK(!writer.isOpen());
+}
+
+void testRoundTrip(const fs::path& directory) {
+	for (uint32_t frameCount : { 0u, 1u, 3u, 2000u }) { // 2000 frames are several blocks
+		fs::path path = directory / ("frames" + std::to_string(frameCount) + ".vcap");
+		writeCapture(path, frameCount);
+		FrameCapture capture = readFrameCapture(path.string());
+		CHECK(capture.deviceName == "Test GPU");
+		CHECK(capture.frames.size() == frameCount);
+		bool same = true;
+		for (uint32_t i = 0; i < capture.frames.size(); ++i)
+			same = same && sameFrame(capture.frames[i], makeFrame(i));
+		CHECK(same);
+	}
+}
+
+void testCompare() {
+	CapturedFrame captured = makeFrame(6);
+	CHECK(compareCapturedFrames(captured, captured).empty());
+
+	CapturedFrame replayed = captured;
+	replayed.time += 1.0f; // inputs aren't results
+	CHECK(compareCapturedFrames(captured, replayed).empty());
+
+	replayed = captured;
+	replayed.streamedChunks.push_back(99);
+	CHECK(!compareCapturedFrames(captured, replayed).empty());
+	replayed = captured;
+	replayed.uniforms[17] ^= 1;
+	CHECK(!compareCapturedFrames(captured, replayed).empty());
+	replayed = captured;
+	replayed.draws.pop_back();
+	CHECK(!compareCapturedFrames(captured, replayed).empty());
+	replayed = captured;
+	replayed.draws[1].instanceCount += 1;
+	CHECK(compareCapturedFrames(captured, replayed) == "draw batch 1 differs");
+}
+
+bool readThrows(const fs::path& path) {
+	try {
+		readFrameCapture(path.string());
+	} catch (const std::exception&) {
+		return true;
+	}
+	return false;
+}
+
+void testInvalidCaptures(const fs::path& directory) {
+	fs::path valid = directory / "frames2000.vcap";
+	std::ifstream file(valid, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+	CHECK(bytes.size() > sizeof(CaptureHeader) + sizeof(CaptureBlock));
+
+	auto patched = [&](const std::vector<char>& contents) {
+		fs::path path = directory / "patched.vcap";
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+		return path;
+	};
+
+	CHECK(readThrows(directory / "missing.vcap"));
+	CHECK(readThrows(patched(std::vector<char>(bytes.begin(), bytes.begin() + sizeof(CaptureHeader) / 2)))); // not even a header
+	CHECK(readThrows(patched(std::vector<char>(bytes.begin(), bytes.end() - 1)))); // the last block cut short
+
+	std::vector<char> badMagic = bytes;
+	badMagic[0] = 'X';
+	CHECK(readThrows(patched(badMagic)));
+
+	std::vector<char> moreFrames = bytes; // claims frames the blocks don't hold
+	CaptureHeader header;
+	std::memcpy(&header, moreFrames.data(), sizeof(header));
+	header.frameCount += 1;
+	std::memcpy(moreFrames.data(), &header, sizeof(header));
+	CHECK(readThrows(patched(moreFrames)));
+
+	std::vector<char> longName = bytes; // the device name runs past the end
+	std::memcpy(&header, longName.data(), sizeof(header));
+	header.deviceNameLength = 0x7FFFFFFF;
+	std::memcpy(longName.data(), &header, sizeof(header));
+	CHECK(readThrows(patched(longName)));
+
+	std::vector<char> largeBlock = bytes; // a block that decompresses to more than a block
+	size_t blockOffset = sizeof(CaptureHeader) + std::strlen("Test GPU");
+	CaptureBlock block;
+	std::memcpy(&block, largeBlock.data() + blockOffset, sizeof(block));
+	block.size = CAPTURE_BLOCK_SIZE * 16;
+	std::memcpy(largeBlock.data() + blockOffset, &block, sizeof(block));
+	CHECK(readThrows(patched(largeBlock)));
+}
+
+} // namespace
+
+int main() {
+	fs::path directory = fs::temp_directory_path() / "FrameCaptureTests";
+	fs::remove_all(directory);
+	fs::create_directories(directory);
+	testRoundTrip(directory);
+	testCompare();
+	testInvalidCaptures(directory);
+	fs::remove_all(directory);
+	return checkResult("FrameCaptureTests");
+}
@@ -0,0 +1,102 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// CPU only job system benchmark, across worker counts from 1 up to one per hardware thread:
+//  empty jobs  - jobs per second through createJob/run/wait, the scheduling overhead itself
+//  nested      - jobs that spawn their own children, the work stealing path
+//  parallelFor - a fixed amount of math split into chunks, the speedup over one worker
+// Not a ctest, the numbers depend on the machine. `VulkanEngineJobBenchmark [max workers]`
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double emptyJobsPerSecond(JobSystem& jobs) {
+	const uint32_t BATCH = 2048; // under the job pool's size, so it's the pool and not the heap being measured
+	const uint32_t BATCHES = 500;
+	Clock::time_point start = Clock::now();
+	for (uint32_t batch = 0; batch < BATCHES; ++batch) {
+		JobCounter counter;
+		for (uint32_t i = 0; i < BATCH; ++i)
+			jobs.run(jobs.createJob([]() {}, &counter));
+		jobs.wait(counter);
+	}
+	return BATCH * BATCHES / secondsSince(start);
+}
+
+struct NestedState {
+	JobSystem* jobs;
+	JobCounter* counter;
+	std::atomic<uint32_t> leaves{ 0 };
+};
+void spawnChildren(NestedState* state, uint32_t depth) {
+	if (depth == 0) {
+		state->leaves.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	for (int i = 0; i < 8; ++i)
+		state->jobs->run(state->jobs->createJob([state, depth]() { spawnChildren(state, depth - 1); }, state->counter));
+}
+
+double nestedJobsPerSecond(JobSystem& jobs) {
+	const uint32_t TREES = 20;
+	const uint32_t JOBS_PER_TREE = 1 + 8 + 64 + 512 + 4096;
+	Clock::time_point start = Clock::now();
+	for (uint32_t tree = 0; tree < TREES; ++tree) {
+		JobCounter counter;
+		NestedState state{ &jobs, &counter };
+		NestedState* statePointer = &state;
+		jobs.run(jobs.createJob([statePointer]() { spawnChildren(statePointer, 4); }, &counter));
+		jobs.wait(counter);
+	}
+	return TREES * JOBS_PER_TREE / secondsSince(start);
+}
+
+double parallelForSeconds(JobSystem& jobs, std::vector<float>& values) {
+	Clock::time_point start = Clock::now();
+	for (int pass = 0; pass < 4; ++pass) {
+		jobs.parallelFor(static_cast<uint32_t>(values.size()), 4096, [&values](uint32_t begin, uint32_t end) {
+			for (uint32_t i = begin; i < end; ++i)
+				values[i] = std::sqrt(values[i] * 0.5f + std::sin(static_cast<float>(i)) * std::cos(values[i]) + 1.0f);
+		});
+	}
+	return secondsSince(start);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	uint32_t maxWorkers = JobSystem::defaultWorkerThreadCount() + 1;
+	if (argc > 1)
+		maxWorkers = std::max(1, std::atoi(argv[1]));
+
+	std::vector<uint32_t> workerCounts;
+	for (uint32_t workers = 1; workers < maxWorkers; workers *= 2)
+		workerCounts.push_back(workers);
+	workerCounts.push_back(maxWorkers);
+
+	std::vector<float> values(1u << 22, 1.0f);
+	double singleWorkerSeconds = 0.0;
+	std::printf("%8s %16s %16s %16s %8s\n", "workers", "empty jobs/s", "nested jobs/s", "parallelFor ms", "speedup");
+	for (uint32_t workers : workerCounts) {
+		JobSystem jobs(workers - 1); // the constructing thread is a worker too
+		double empty = emptyJobsPerSecond(jobs);
+		double nested = nestedJobsPerSecond(jobs);
+		double seconds = parallelForSeconds(jobs, values);
+		if (workers == 1)
+			singleWorkerSeconds = seconds;
+		std::printf("%8u %16.0f %16.0f %16.1f %7.2fx\n", workers, empty, nested, seconds * 1000.0, singleWorkerSeconds / seconds);
+	}
+	return 0;
+}
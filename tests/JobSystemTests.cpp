@@ -0,0 +1,223 @@
+#include "JobSystem.h"
+
+#include "Check.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// CPU only stress test of the job system: dependencies and continuations, jobs spawning jobs, submission from threads that aren't workers, the
+// job pool running out, and FrameTaskList handing a task's exception back to execute(). Every case runs many times, a race shows up as a failed
+// check or a hang rather than only now and then
+
+namespace {
+
+const int ROUNDS = 200;
+
+// a chain of jobs, each depending on the one before. run() in reverse, so every job is submitted before its prerequisite has finished
+void testDependencyChain(JobSystem& jobs) {
+	const uint32_t LENGTH = 256;
+	std::atomic<uint32_t> next{ 0 };
+	std::atomic<bool> outOfOrder{ false };
+	std::vector<Job*> chain(LENGTH);
+	JobCounter counter;
+	for (uint32_t i = 0; i < LENGTH; ++i) {
+		std::atomic<uint32_t>* nextIndex = &next;
+		std::atomic<bool>* wrong = &outOfOrder;
+		chain[i] = jobs.createJob([nextIndex, wrong, i]() {
+			if (nextIndex->fetch_add(1) != i)
+				wrong->store(true);
+		}, &counter);
+		if (i > 0)
+			jobs.addDependency(chain[i], chain[i - 1]);
+	}
+	for (uint32_t i = LENGTH; i-- > 0;)
+		jobs.run(chain[i]);
+	jobs.wait(counter);
+	CHECK(counter.isDone());
+	CHECK(next.load() == LENGTH);
+	CHECK(!outOfOrder.load());
+}
+
+// one job with the most continuations it can have, all of them feeding a last job. the last one has to see every continuation's result
+void testContinuations(JobSystem& jobs) {
+	std::atomic<int> ran{ 0 };
+	std::atomic<int> seenByLast{ -1 };
+	std::atomic<int>* ranCount = &ran;
+	std::atomic<int>* seen = &seenByLast;
+	JobCounter counter;
+	Job* first = jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &counter);
+	Job* last = jobs.createJob([ranCount, seen]() { seen->store(ranCount->load()); }, &counter);
+	std::vector<Job*> middle;
+	for (uint32_t i = 0; i < Job::MAX_CONTINUATIONS; ++i) {
+		middle.push_back(jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &counter));
+		jobs.addDependency(middle.back(), first);
+		jobs.addDependency(last, middle.back());
+	}
+
+	bool threw = false;
+	Job* extra = jobs.createJob([]() {}, &counter);
+	try {
+		jobs.addDependency(extra, first); // one continuation too many
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	jobs.run(last);
+	for (Job* job : middle)
+		jobs.run(job);
+	jobs.run(extra);
+	jobs.run(first);
+	jobs.wait(counter);
+	CHECK(ran.load() == static_cast<int>(Job::MAX_CONTINUATIONS) + 1);
+	CHECK(seenByLast.load() == static_cast<int>(Job::MAX_CONTINUATIONS) + 1);
+}
+
+// jobs that spawn jobs, four levels of eight. the children join the parent's counter before the parent finishes, so the counter can't reach 0 early
+struct SpawnTree {
+	JobSystem* jobs;
+	JobCounter* counter;
+	std::atomic<uint32_t> leaves{ 0 };
+};
+void spawn(SpawnTree* tree, uint32_t depth) {
+	if (depth == 0) {
+		tree->leaves.fetch_add(1);
+		return;
+	}
+	for (int i = 0; i < 8; ++i)
+		tree->jobs->run(tree->jobs->createJob([tree, depth]() { spawn(tree, depth - 1); }, tree->counter));
+}
+void testNestedSpawns(JobSystem& jobs) {
+	JobCounter counter;
+	SpawnTree tree{ &jobs, &counter };
+	SpawnTree* treePointer = &tree;
+	jobs.run(jobs.createJob([treePointer]() { spawn(treePointer, 4); }, &counter));
+	jobs.wait(counter);
+	CHECK(tree.leaves.load() == 8 * 8 * 8 * 8);
+}
+
+// a thread that isn't a worker submits through the injection queue. once it waits itself (it steals like a worker), once the main thread waits for it
+void testExternalSubmission(JobSystem& jobs) {
+	const int COUNT = 2000;
+	std::atomic<int> ran{ 0 };
+	std::atomic<int>* ranCount = &ran;
+
+	JobCounter ownCounter;
+	std::thread waiting([&]() {
+		for (int i = 0; i < COUNT; ++i)
+			jobs.run(jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &ownCounter));
+		jobs.wait(ownCounter);
+	});
+	waiting.join();
+	CHECK(ownCounter.isDone());
+	CHECK(ran.load() == COUNT);
+
+	JobCounter mainCounter;
+	std::thread submitting([&]() {
+		Job* first = jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &mainCounter);
+		Job* second = jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &mainCounter);
+		jobs.addDependency(second, first); // heap jobs take continuations the same way
+		jobs.run(second);
+		jobs.run(first);
+		for (int i = 0; i < COUNT; ++i)
+			jobs.run(jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &mainCounter));
+	});
+	submitting.join();
+	jobs.wait(mainCounter);
+	CHECK(ran.load() == 2 * COUNT + 2);
+}
+
+// more jobs alive at once than a worker's pool holds, the rest come from the heap
+void testPoolExhaustion(JobSystem& jobs) {
+	const uint32_t COUNT = static_cast<uint32_t>(JobSystem::JOB_POOL_SIZE) * 2 + 17;
+	std::atomic<uint32_t> ran{ 0 };
+	std::atomic<uint32_t>* ranCount = &ran;
+	std::vector<Job*> created(COUNT);
+	JobCounter counter;
+	for (uint32_t i = 0; i < COUNT; ++i)
+		created[i] = jobs.createJob([ranCount]() { ranCount->fetch_add(1); }, &counter);
+	for (Job* job : created)
+		jobs.run(job);
+	jobs.wait(counter);
+	CHECK(ran.load() == COUNT);
+}
+
+void testParallelFor(JobSystem& jobs) {
+	const uint32_t COUNT = 100000;
+	std::vector<uint32_t> values(COUNT, 0);
+	jobs.parallelFor(COUNT, 1000, [&values](uint32_t begin, uint32_t end) {
+		for (uint32_t i = begin; i < end; ++i)
+			values[i] += i;
+	});
+	bool everyOnce = true;
+	for (uint32_t i = 0; i < COUNT; ++i)
+		everyOnce = everyOnce && values[i] == i;
+	CHECK(everyOnce);
+}
+
+// a task throws: the tasks after it are skipped, execute() rethrows it, and the next execute() runs normally again
+void testFrameTaskExceptions(JobSystem& jobs) {
+	FrameTaskList list;
+	std::atomic<int> transforms{ 0 }, recordings{ 0 }, uploads{ 0 };
+	bool failCulling = true;
+	FrameTaskList::TaskId transform = list.addTask("transform", [&]() { transforms.fetch_add(1); });
+	FrameTaskList::TaskId cull = list.addTask("cull", [&]() {
+		if (failCulling)
+			throw std::runtime_error("culling failed");
+	}, { transform });
+	FrameTaskList::TaskId record = list.addTask("record", [&]() { recordings.fetch_add(1); }, { cull });
+	list.addTask("upload", [&]() { uploads.fetch_add(1); }, { record, transform });
+
+	bool threw = false;
+	try {
+		list.execute(jobs);
+	} catch (const std::runtime_error& error) {
+		threw = std::string(error.what()) == "culling failed";
+	}
+	CHECK(threw);
+	CHECK(transforms.load() == 1);
+	CHECK(recordings.load() == 0); // depends on the failed task
+	CHECK(uploads.load() == 0);
+
+	failCulling = false;
+	bool threwAgain = false;
+	try {
+		for (int frame = 0; frame < 100; ++frame)
+			list.execute(jobs);
+	} catch (...) {
+		threwAgain = true;
+	}
+	CHECK(!threwAgain);
+	CHECK(transforms.load() == 101);
+	CHECK(recordings.load() == 100);
+	CHECK(uploads.load() == 100);
+
+	bool badDependency = false;
+	try {
+		list.addTask("late", []() {}, { 99 });
+	} catch (const std::runtime_error&) {
+		badDependency = true;
+	}
+	CHECK(badDependency);
+}
+
+} // namespace
+
+int main() {
+	for (uint32_t workerThreads : { 0u, 1u, 3u, JobSystem::defaultWorkerThreadCount() }) {
+		JobSystem jobs(workerThreads);
+		for (int round = 0; round < ROUNDS; ++round) {
+			testDependencyChain(jobs);
+			testContinuations(jobs);
+			testNestedSpawns(jobs);
+			testExternalSubmission(jobs);
+			testPoolExhaustion(jobs);
+			testParallelFor(jobs);
+		}
+		testFrameTaskExceptions(jobs);
+	}
+	return checkResult("JobSystemTests");
+}
@@ -0,0 +1,117 @@
+#include "LodSelector.h"
+
+#include "Check.h"
+
+#include <cmath>
+#include <vector>
+
+// CPU only test of the LOD selector: the coarser LODs are picked as an object's projected error shrinks, the chosen LOD's error stays under the
+// threshold, and the hysteresis keeps an object at a boundary on the LOD it came from
+
+namespace {
+
+const uint32_t VIEWPORT_HEIGHT = 1000;
+const std::vector<float> LOD_ERRORS = { 0.0f, 0.01f, 0.04f, 0.16f, 0.64f };
+
+// cot(fovy / 2) of 1, a 90 degree field of view, negative like the engine's projections with the y flip
+glm::mat4 projection() {
+	glm::mat4 matrix(1.0f);
+	matrix[1][1] = -1.0f;
+	return matrix;
+}
+
+// the selector's choice with the camera `distance` from the surface of a unit sphere at the origin
+uint32_t selectAt(LodSelector& selector, float distance) {
+	return selector.select(LOD_ERRORS, glm::vec3(0.0f, 0.0f, 1.0f + distance), glm::vec3(0.0f), 1.0f, projection(), VIEWPORT_HEIGHT);
+}
+
+void testProjectedSize() {
+	// half the viewport per unit of cot(fovy / 2) at distance 1
+	CHECK(std::abs(LodSelector::projectedSize(2.0f, 10.0f, projection(), VIEWPORT_HEIGHT) - 100.0f) < 1e-3f);
+	glm::mat4 unflipped(1.0f);
+	CHECK(LodSelector::projectedSize(2.0f, 10.0f, unflipped, VIEWPORT_HEIGHT) == LodSelector::projectedSize(2.0f, 10.0f, projection(), VIEWPORT_HEIGHT));
+	CHECK(LodSelector::projectedSize(1.0f, 20.0f, projection(), VIEWPORT_HEIGHT) * 2.0f == LodSelector::projectedSize(1.0f, 10.0f, projection(), VIEWPORT_HEIGHT));
+}
+
+// moving away the projected errors drop and the LODs only ever get coarser, all the way to the last one. never one that's visibly off
+void testCoarserWithDistance() {
+	LodSelector selector;
+	CHECK(selectAt(selector, -0.5f) == 0); // camera inside the bounds
+	uint32_t previous = 0;
+	bool monotonic = true, underThreshold = true;
+	for (float distance = 0.1f; distance < 2000.0f; distance *= 1.05f) {
+		uint32_t lod = selectAt(selector, distance);
+		monotonic = monotonic && lod >= previous;
+		underThreshold = underThreshold && LodSelector::projectedSize(LOD_ERRORS[lod], distance, projection(), VIEWPORT_HEIGHT) <= selector.settings().pixelThreshold;
+		previous = lod;
+	}
+	CHECK(monotonic);
+	CHECK(underThreshold);
+	CHECK(previous == LOD_ERRORS.size() - 1);
+	CHECK(selector.current() == previous);
+
+	// and back: finer again, down to the original up close
+	bool refinesMonotonic = true;
+	for (float distance = 2000.0f; distance > 0.1f; distance /= 1.05f) {
+		uint32_t lod = selectAt(selector, distance);
+		refinesMonotonic = refinesMonotonic && lod <= previous;
+		underThreshold = underThreshold && LodSelector::projectedSize(LOD_ERRORS[lod], distance, projection(), VIEWPORT_HEIGHT) <= selector.settings().pixelThreshold;
+		previous = lod;
+	}
+	CHECK(refinesMonotonic);
+	CHECK(underThreshold);
+	CHECK(previous == 0);
+
+	// a bigger threshold switches earlier
+	LodSelector coarse;
+	coarse.settings().pixelThreshold = 4.0f;
+	LodSelector fine;
+	CHECK(selectAt(coarse, 30.0f) > selectAt(fine, 30.0f));
+}
+
+// LOD 2 (error 0.04) covers 1 pixel at distance 20 and the tightened 0.75 pixels at 26.7. in between it depends on where the object came from
+void testHysteresis() {
+	const float BETWEEN = 23.0f;
+	LodSelector approaching;
+	CHECK(selectAt(approaching, 100.0f) == 2);
+	CHECK(selectAt(approaching, BETWEEN) == 2); // still under the plain threshold, kept
+	CHECK(selectAt(approaching, 19.0f) == 1); // over it, refined straight away
+
+	LodSelector leaving;
+	CHECK(selectAt(leaving, 10.0f) == 1);
+	CHECK(selectAt(leaving, BETWEEN) == 1); // not under the tightened threshold yet
+	CHECK(selectAt(leaving, 27.0f) == 2);
+
+	// sitting at the boundary doesn't flicker
+	bool stable = true;
+	for (int frame = 0; frame < 100; ++frame)
+		stable = stable && selectAt(leaving, BETWEEN + (frame % 2 ? 0.5f : -0.5f)) == 2;
+	CHECK(stable);
+
+	// no hysteresis: the same distance gives the same LOD either way
+	LodSelector plainApproaching, plainLeaving;
+	plainApproaching.settings().hysteresis = 0.0f;
+	plainLeaving.settings().hysteresis = 0.0f;
+	selectAt(plainApproaching, 100.0f);
+	selectAt(plainLeaving, 10.0f);
+	CHECK(selectAt(plainApproaching, BETWEEN) == selectAt(plainLeaving, BETWEEN));
+}
+
+void testEdgeCases() {
+	LodSelector selector;
+	CHECK(selector.select({}, glm::vec3(0.0f, 0.0f, 10.0f), glm::vec3(0.0f), 1.0f, projection(), VIEWPORT_HEIGHT) == 0);
+	CHECK(selectAt(selector, 1000.0f) == LOD_ERRORS.size() - 1);
+	// the mesh changed to one with fewer LODs, the current one is clamped
+	CHECK(selector.select({ 0.0f, 0.01f }, glm::vec3(0.0f, 0.0f, 1001.0f), glm::vec3(0.0f), 1.0f, projection(), VIEWPORT_HEIGHT) == 1);
+	CHECK(selector.select({ 0.0f }, glm::vec3(0.0f, 0.0f, 1001.0f), glm::vec3(0.0f), 1.0f, projection(), VIEWPORT_HEIGHT) == 0);
+}
+
+} // namespace
+
+int main() {
+	testProjectedSize();
+	testCoarserWithDistance();
+	testHysteresis();
+	testEdgeCases();
+	return checkResult("LodSelectorTests");
+}
@@ -0,0 +1,114 @@
+#include "Lz4.h"
+
+#include "Check.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+// CPU only test of the LZ4 block codec: what it compresses decompresses to the same bytes (empty, tiny, incompressible, repetitive and mixed
+// input), the bound holds for incompressible input, and the decoder rejects truncated, wrong sized and corrupt blocks instead of reading or
+// writing out of bounds
+
+namespace {
+
+std::vector<unsigned char> compress(const std::vector<unsigned char>& input) {
+	std::vector<unsigned char> output(lz4CompressBound(input.size()));
+	size_t size = lz4Compress(input.data(), input.size(), output.data(), output.size());
+	output.resize(size);
+	return output;
+}
+
+bool roundTrips(const std::vector<unsigned char>& input) {
+	std::vector<unsigned char> compressed = compress(input);
+	if (compressed.empty()) // even empty input has a token
+		return false;
+	std::vector<unsigned char> output(input.size());
+	return lz4Decompress(compressed.data(), compressed.size(), output.data(), output.size()) && output == input;
+}
+
+std::vector<unsigned char> randomBytes(size_t size, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::vector<unsigned char> bytes(size);
+	for (unsigned char& byte : bytes)
+		byte = static_cast<unsigned char>(random());
+	return bytes;
+}
+
+void testRoundTrip() {
+	CHECK(roundTrips({}));
+	CHECK(roundTrips({ 42 }));
+	CHECK(roundTrips(std::vector<unsigned char>(12, 7))); // shorter than the match finder looks at
+	CHECK(roundTrips(randomBytes(100000, 1)));
+	CHECK(roundTrips(std::vector<unsigned char>(65536, 0)));
+
+	std::vector<unsigned char> text;
+	const char* words[] = { "vertex ", "fragment ", "compute ", "mesh ", "task " };
+	std::mt19937 random(2);
+	while (text.size() < 200000) {
+		const char* word = words[random() % 5];
+		text.insert(text.end(), word, word + std::strlen(word));
+	}
+	std::vector<unsigned char> compressed = compress(text);
+	CHECK(compressed.size() < text.size() / 2); // repetitive input actually gets smaller
+	CHECK(roundTrips(text));
+
+	std::vector<unsigned char> mixed = randomBytes(70000, 3); // long literal runs between long matches, both length encodings past 15
+	std::memset(mixed.data() + 1000, 'a', 5000);
+	std::memcpy(mixed.data() + 40000, mixed.data() + 20000, 8000);
+	CHECK(roundTrips(mixed));
+}
+
+void testBound() {
+	for (size_t size : { size_t(0), size_t(1), size_t(255), size_t(65536), size_t(300000) }) {
+		std::vector<unsigned char> input = randomBytes(size, static_cast<uint32_t>(size));
+		std::vector<unsigned char> output(lz4CompressBound(size));
+		CHECK(lz4Compress(input.data(), input.size(), output.data(), output.size()) != 0);
+	}
+	std::vector<unsigned char> input = randomBytes(1000, 4);
+	std::vector<unsigned char> output(100);
+	CHECK(lz4Compress(input.data(), input.size(), output.data(), output.size()) == 0); // doesn't fit, and says so
+}
+
+void testCorruptInput() {
+	std::vector<unsigned char> text(4096);
+	for (size_t i = 0; i < text.size(); ++i)
+		text[i] = static_cast<unsigned char>("abcabcabd"[i % 9]);
+	std::vector<unsigned char> compressed = compress(text);
+	std::vector<unsigned char> output(text.size());
+
+	CHECK(!lz4Decompress(compressed.data(), compressed.size() - 1, output.data(), output.size())); // truncated
+	CHECK(!lz4Decompress(compressed.data(), 0, output.data(), output.size()));
+	CHECK(!lz4Decompress(compressed.data(), compressed.size(), output.data(), output.size() - 1)); // too small a destination
+	std::vector<unsigned char> larger(text.size() + 1);
+	CHECK(!lz4Decompress(compressed.data(), compressed.size(), larger.data(), larger.size())); // decodes to fewer bytes than expected
+
+	const unsigned char badOffset[] = { 0x10, 'x', 0x05, 0x00, 0x00 }; // one literal, then a match 5 bytes back
+	CHECK(!lz4Decompress(badOffset, sizeof(badOffset), output.data(), output.size()));
+	const unsigned char zeroOffset[] = { 0x10, 'x', 0x00, 0x00, 0x00 };
+	CHECK(!lz4Decompress(zeroOffset, sizeof(zeroOffset), output.data(), output.size()));
+
+	// random garbage never decodes past the destination. the guard bytes around it would show it
+	std::mt19937 random(5);
+	for (uint32_t i = 0; i < 2000; ++i) {
+		std::vector<unsigned char> garbage = randomBytes(1 + random() % 64, i);
+		std::vector<unsigned char> guarded(256 + 32, 0xCD);
+		lz4Decompress(garbage.data(), garbage.size(), guarded.data() + 16, 256);
+		bool intact = true;
+		for (size_t g = 0; g < 16; ++g)
+			intact = intact && guarded[g] == 0xCD && guarded[guarded.size() - 1 - g] == 0xCD;
+		CHECK(intact);
+	}
+
+	const unsigned char empty[] = { 0x00 }; // the block of empty input: a token without literals
+	CHECK(lz4Decompress(empty, sizeof(empty), nullptr, 0));
+}
+
+} // namespace
+
+int main() {
+	testRoundTrip();
+	testBound();
+	testCorruptInput();
+	return checkResult("Lz4Tests");
+}
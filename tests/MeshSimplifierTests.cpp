@@ -0,0 +1,144 @@
+#include "MeshSimplifier.h"
+
+#include "Check.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// CPU only test of the mesh simplifier: LOD chains that get smaller at every step with errors that never go down, simplified meshes that stay valid
+// and as close to the original as the error they report says, maxError being respected, open borders being kept and bad input being refused
+
+namespace {
+
+// indices in range and no triangle that has lost an edge
+bool validTriangles(const std::vector<uint32_t>& indices, size_t vertexCount) {
+	if (indices.size() % 3 != 0)
+		return false;
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+		if (a >= vertexCount || b >= vertexCount || c >= vertexCount || a == b || b == c || c == a)
+			return false;
+	}
+	return true;
+}
+
+// how far the simplified sphere has moved in from the original surface, against its error: measured at every triangle's center, the point of a flat
+// triangle furthest in, less what the original's own chords already lose. the error is a mean over the planes around each vertex rather than a hard
+// bound, the check is that it tracks the real distance (within a factor of two)
+bool withinError(const TestMesh& sphere, const std::vector<uint32_t>& indices, float error) {
+	float originalSag = 0.0f;
+	for (size_t t = 0; t < sphere.indices.size(); t += 3) {
+		glm::vec3 center = (sphere.positions[sphere.indices[t]] + sphere.positions[sphere.indices[t + 1]] + sphere.positions[sphere.indices[t + 2]]) / 3.0f;
+		originalSag = std::max(originalSag, 1.0f - glm::length(center));
+	}
+	for (size_t t = 0; t < indices.size(); t += 3) {
+		glm::vec3 center = (sphere.positions[indices[t]] + sphere.positions[indices[t + 1]] + sphere.positions[indices[t + 2]]) / 3.0f;
+		if (1.0f - glm::length(center) - originalSag > 2.0f * error + 1e-4f)
+			return false;
+	}
+	return true;
+}
+
+void testLodChain() {
+	TestMesh sphere = makeSphere(32, 48);
+	std::vector<MeshLod> lods = buildLodChain(sphere.positions, sphere.indices, 8);
+	CHECK(lods.size() >= 4);
+	CHECK(!lods.empty() && lods[0].indices == sphere.indices && lods[0].error == 0.0f); // the original comes first, untouched
+	for (size_t i = 1; i < lods.size(); ++i) {
+		CHECK(lods[i].indices.size() < lods[i - 1].indices.size()); // triangles go down at every step
+		CHECK(lods[i].indices.size() * 10 <= lods[i - 1].indices.size() * 9); // and by enough to be worth a LOD
+		CHECK(lods[i].error >= lods[i - 1].error); // the error never does
+		CHECK(validTriangles(lods[i].indices, sphere.positions.size()));
+		CHECK(withinError(sphere, lods[i].indices, lods[i].error));
+	}
+	CHECK(lods.back().error > 0.0f); // a sphere can't be simplified for free
+
+	// a gentler reduction gives more, closer spaced LODs
+	std::vector<MeshLod> gentle = buildLodChain(sphere.positions, sphere.indices, 3, 0.75f);
+	CHECK(gentle.size() == 3);
+	if (gentle.size() == 3)
+		CHECK(gentle[1].indices.size() >= sphere.indices.size() / 2);
+
+	// maxError caps the chain: no LOD past it
+	SimplifyOptions capped;
+	capped.maxError = 0.02f;
+	std::vector<MeshLod> cappedLods = buildLodChain(sphere.positions, sphere.indices, 8, 0.5f, capped);
+	CHECK(cappedLods.size() < lods.size());
+	for (const MeshLod& lod : cappedLods)
+		CHECK(lod.error <= capped.maxError);
+
+	bool threw = false;
+	try {
+		buildLodChain(sphere.positions, sphere.indices, 4, 1.0f);
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+void testSimplifyMesh() {
+	TestMesh sphere = makeSphere(24, 32);
+	float error = -1.0f;
+	std::vector<uint32_t> half = simplifyMesh(sphere.positions, sphere.indices, sphere.indices.size() / 2, SimplifyOptions(), &error);
+	CHECK(half.size() <= sphere.indices.size() / 2);
+	CHECK(!half.empty());
+	CHECK(error > 0.0f);
+	CHECK(validTriangles(half, sphere.positions.size()));
+	CHECK(withinError(sphere, half, error));
+
+	// already small enough: nothing happens
+	std::vector<uint32_t> same = simplifyMesh(sphere.positions, sphere.indices, sphere.indices.size(), SimplifyOptions(), &error);
+	CHECK(same == sphere.indices);
+	CHECK(error == 0.0f);
+
+	// a flat grid goes down to two triangles without any geometric error, its open border holds the corners in place
+	TestMesh grid = makeGrid(16);
+	SimplifyOptions exact;
+	exact.maxError = 1e-3f;
+	std::vector<uint32_t> flat = simplifyMesh(grid.positions, grid.indices, 0, exact, &error);
+	CHECK(flat.size() == 6);
+	CHECK(error == 0.0f);
+	CHECK(validTriangles(flat, grid.positions.size()));
+	const uint32_t CORNERS[] = { 0, 16, 17 * 16, 17 * 17 - 1 };
+	for (uint32_t corner : CORNERS)
+		CHECK(std::find(flat.begin(), flat.end(), corner) != flat.end());
+	float area = 0.0f;
+	for (size_t t = 0; t < flat.size(); t += 3)
+		area += 0.5f * glm::cross(grid.positions[flat[t + 1]] - grid.positions[flat[t]], grid.positions[flat[t + 2]] - grid.positions[flat[t]]).z;
+	CHECK(std::abs(area - 256.0f) < 1e-2f); // covers the same square, none of it folded over
+
+	// the attribute weight counts sliding along the surface as error, the flat grid then keeps more of its triangles
+	SimplifyOptions attributes;
+	attributes.attributeWeight = 1.0f;
+	attributes.maxError = 1.5f;
+	std::vector<uint32_t> keptAttributes = simplifyMesh(grid.positions, grid.indices, 0, attributes, &error);
+	CHECK(keptAttributes.size() > flat.size());
+	CHECK(error <= attributes.maxError);
+
+	// empty input, and input that isn't a triangle list over the vertices
+	CHECK(simplifyMesh(sphere.positions, {}, 0).empty());
+	bool notTriangles = false, outOfRange = false;
+	try {
+		simplifyMesh(sphere.positions, { 0, 1 }, 0);
+	} catch (const std::runtime_error&) {
+		notTriangles = true;
+	}
+	try {
+		simplifyMesh(sphere.positions, { 0, 1, static_cast<uint32_t>(sphere.positions.size()) }, 0);
+	} catch (const std::runtime_error&) {
+		outOfRange = true;
+	}
+	CHECK(notTriangles);
+	CHECK(outOfRange);
+}
+
+} // namespace
+
+int main() {
+	testLodChain();
+	testSimplifyMesh();
+	return checkResult("MeshSimplifierTests");
+}
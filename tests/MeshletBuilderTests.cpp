@@ -0,0 +1,230 @@
+#include "MeshletBuilder.h"
+
+#include "Check.h"
+#include "TestMeshes.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// CPU only test of the meshlet builder: the per meshlet limits, every input triangle coming out exactly once with its winding, bounding spheres and
+// normal cones that hold for the triangles in them, and degenerate or empty input
+
+namespace {
+
+using Triangle = std::array<uint32_t, 3>;
+
+// the same triangle always gives the same triple: rotated so the smallest index is first, which keeps the winding
+Triangle canonical(uint32_t a, uint32_t b, uint32_t c) {
+	if (b < a && b < c)
+		return { b, c, a };
+	if (c < a && c < b)
+		return { c, a, b };
+	return { a, b, c };
+}
+
+std::vector<Triangle> inputTriangles(const std::vector<uint32_t>& indices) {
+	std::vector<Triangle> triangles;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+		triangles.push_back(canonical(indices[i], indices[i + 1], indices[i + 2]));
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// mesh vertex indices of a meshlet's triangle
+Triangle meshletTriangle(const MeshletData& data, const Meshlet& meshlet, uint32_t triangle) {
+	uint32_t corners[3];
+	for (uint32_t corner = 0; corner < 3; ++corner)
+		corners[corner] = data.vertices[meshlet.vertexOffset + data.triangles[(meshlet.triangleOffset + triangle) * 3 + corner]];
+	return canonical(corners[0], corners[1], corners[2]);
+}
+
+// limits, local indices in range and the triangles of meshlets [first, first + count) being exactly the input's
+void checkMeshlets(const MeshletData& data, uint32_t first, uint32_t count, const std::vector<uint32_t>& indices, uint32_t maxVertices, uint32_t maxTriangles) {
+	std::vector<Triangle> emitted;
+	bool withinLimits = true, localIndicesValid = true, vertexListsUnique = true;
+	for (uint32_t m = first; m < first + count; ++m) {
+		const Meshlet& meshlet = data.meshlets[m];
+		withinLimits = withinLimits && meshlet.vertexCount <= maxVertices && meshlet.triangleCount <= maxTriangles && meshlet.triangleCount > 0;
+		std::vector<uint32_t> vertices(data.vertices.begin() + meshlet.vertexOffset, data.vertices.begin() + meshlet.vertexOffset + meshlet.vertexCount);
+		std::sort(vertices.begin(), vertices.end());
+		vertexListsUnique = vertexListsUnique && std::adjacent_find(vertices.begin(), vertices.end()) == vertices.end();
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			for (uint32_t corner = 0; corner < 3; ++corner)
+				localIndicesValid = localIndicesValid && data.triangles[(meshlet.triangleOffset + t) * 3 + corner] < meshlet.vertexCount;
+			if (localIndicesValid)
+				emitted.push_back(meshletTriangle(data, meshlet, t));
+		}
+	}
+	CHECK(withinLimits);
+	CHECK(localIndicesValid);
+	CHECK(vertexListsUnique); // a vertex is listed once per meshlet, triangles sharing it share the local index
+	std::sort(emitted.begin(), emitted.end());
+	CHECK(emitted == inputTriangles(indices)); // every triangle once, none made up, winding kept
+}
+
+// every vertex inside the sphere. and wherever the cone says the cluster faces away, every triangle in it really does face away
+void checkBounds(const std::vector<glm::vec3>& positions, const MeshletData& data, std::mt19937& random) {
+	std::uniform_real_distribution<float> coordinate(-20.0f, 20.0f);
+	bool insideSphere = true, coneHolds = true;
+	uint32_t culledTests = 0;
+	for (const Meshlet& meshlet : data.meshlets) {
+		const MeshletBounds& bounds = meshlet.bounds;
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+			insideSphere = insideSphere && glm::length(positions[data.vertices[meshlet.vertexOffset + i]] - bounds.center) <= bounds.radius * 1.0001f + 1e-5f;
+		if (bounds.coneCutoff > 1.0f)
+			continue;
+
+		for (int sample = 0; sample < 200; ++sample) {
+			glm::vec3 camera(coordinate(random), coordinate(random), coordinate(random));
+			if (glm::dot(glm::normalize(bounds.coneApex - camera), bounds.coneAxis) < bounds.coneCutoff)
+				continue;
+			++culledTests;
+			for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+				const uint8_t* local = &data.triangles[(meshlet.triangleOffset + t) * 3];
+				glm::vec3 a = positions[data.vertices[meshlet.vertexOffset + local[0]]];
+				glm::vec3 b = positions[data.vertices[meshlet.vertexOffset + local[1]]];
+				glm::vec3 c = positions[data.vertices[meshlet.vertexOffset + local[2]]];
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				coneHolds = coneHolds && glm::dot(camera - a, normal) <= 1e-4f * glm::length(normal); // camera on the back side of the plane
+			}
+		}
+	}
+	CHECK(insideSphere);
+	CHECK(coneHolds);
+	CHECK(culledTests > 0); // the cone test has actually been exercised
+}
+
+void testLimits() {
+	TestMesh grid = makeGrid(40);
+	TestMesh sphere = makeSphere(24, 32);
+	const uint32_t LIMITS[][2] = { { MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES }, { 32, 40 }, { 256, 512 }, { 3, 1 }, { 4, 2 } };
+	for (const TestMesh* mesh : { &grid, &sphere }) {
+		for (const auto& limit : LIMITS) {
+			MeshletData data = buildMeshlets(mesh->positions, mesh->indices, limit[0], limit[1]);
+			checkMeshlets(data, 0, static_cast<uint32_t>(data.meshlets.size()), mesh->indices, limit[0], limit[1]);
+			CHECK(data.lods.size() == 1);
+			CHECK(data.lods[0].meshletCount == data.meshlets.size());
+			CHECK(data.lods[0].triangleCount == mesh->triangleCount());
+		}
+	}
+
+	// a flat grid fits in few meshlets that are mostly full: 64 vertices hold a patch of 7x7 quads, 98 triangles
+	MeshletData data = buildMeshlets(grid.positions, grid.indices);
+	CHECK(data.meshlets.size() <= grid.triangleCount() / 60);
+	CHECK(data.vertices.size() < grid.positions.size() * 2); // little duplication between neighbours
+}
+
+void testBounds() {
+	std::mt19937 random(7);
+	TestMesh sphere = makeSphere(24, 32);
+	MeshletData sphereData = buildMeshlets(sphere.positions, sphere.indices);
+	checkBounds(sphere.positions, sphereData, random);
+
+	// on a plane every cone is a single direction, the cutoff is 0 and everything below the plane culls
+	TestMesh grid = makeGrid(20);
+	MeshletData gridData = buildMeshlets(grid.positions, grid.indices);
+	checkBounds(grid.positions, gridData, random);
+	bool flatCones = true;
+	for (const Meshlet& meshlet : gridData.meshlets)
+		flatCones = flatCones && meshlet.bounds.coneCutoff < 1e-3f && meshlet.bounds.coneAxis.z > 0.999f;
+	CHECK(flatCones);
+
+	// a meshlet holding the whole sphere faces every way, its cone never culls
+	TestMesh smallSphere = makeSphere(8, 8);
+	MeshletData single = buildMeshlets(smallSphere.positions, smallSphere.indices, 256, 1000);
+	CHECK(single.meshlets.size() == 1);
+	if (single.meshlets.size() == 1)
+		CHECK(single.meshlets[0].bounds.coneCutoff > 1.0f);
+}
+
+void testDegenerateInput() {
+	// nothing to split
+	std::vector<glm::vec3> positions = { glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(2.0f, 0.0f, 0.0f) };
+	MeshletData empty = buildMeshlets(positions, {});
+	CHECK(empty.meshlets.empty());
+	CHECK(empty.vertices.empty());
+	CHECK(empty.triangles.empty());
+	MeshletData noVertices = buildMeshlets({}, {});
+	CHECK(noVertices.meshlets.empty());
+
+	// repeated corners and zero area triangles still come out once each, and don't break the bounds
+	std::vector<uint32_t> indices = {
+		0, 1, 2, // fine
+		0, 0, 1, // two corners the same
+		3, 3, 3, // all three
+		0, 1, 3, // collinear, no area
+		0, 1, 2, // the same triangle twice
+	};
+	MeshletData data = buildMeshlets(positions, indices);
+	checkMeshlets(data, 0, static_cast<uint32_t>(data.meshlets.size()), indices, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES);
+	bool finite = true;
+	for (const Meshlet& meshlet : data.meshlets) {
+		const MeshletBounds& bounds = meshlet.bounds;
+		finite = finite && std::isfinite(bounds.radius) && std::isfinite(bounds.coneCutoff) && std::isfinite(bounds.coneAxis.x) && std::isfinite(bounds.coneApex.x);
+	}
+	CHECK(finite);
+
+	// only degenerate triangles: no normal to build a cone from, it stays the never culled one
+	MeshletData flat = buildMeshlets(positions, { 0, 1, 3, 3, 3, 3 });
+	CHECK(flat.meshlets.size() == 1);
+	if (flat.meshlets.size() == 1)
+		CHECK(flat.meshlets[0].bounds.coneCutoff > 1.0f);
+
+	// with the smallest limits every triangle is a meshlet of its own
+	MeshletData tiny = buildMeshlets(positions, indices, 3, 1);
+	CHECK(tiny.meshlets.size() == indices.size() / 3);
+
+	// input the builder can't take
+	auto throws = [](auto build) {
+		try {
+			build();
+		} catch (const std::runtime_error&) {
+			return true;
+		}
+		return false;
+	};
+	CHECK(throws([&]() { buildMeshlets(positions, { 0, 1 }); })); // not a triangle list
+	CHECK(throws([&]() { buildMeshlets(positions, { 0, 1, 4 }); })); // index past the vertices
+	CHECK(throws([&]() { buildMeshlets(positions, indices, 2, 10); }));
+	CHECK(throws([&]() { buildMeshlets(positions, indices, 257, 10); })); // local indices are bytes
+	CHECK(throws([&]() { buildMeshlets(positions, indices, 64, 0); }));
+}
+
+// several LODs back to back: each LOD's range covers exactly its own triangles
+void testLods() {
+	TestMesh grid = makeGrid(16);
+	std::vector<MeshLod> lods(3);
+	lods[0].indices = grid.indices;
+	lods[1].indices.assign(grid.indices.begin(), grid.indices.begin() + grid.indices.size() / 2);
+	lods[1].error = 0.5f;
+	lods[2].indices = { 0, 16, 16 * 17 + 16, 0, 16 * 17 + 16, 16 * 17 }; // two triangles over the whole grid
+	lods[2].error = 2.0f;
+
+	MeshletData data = buildMeshletLods(grid.positions, lods, 32, 48);
+	CHECK(data.lods.size() == 3);
+	uint32_t nextMeshlet = 0;
+	for (size_t i = 0; i < data.lods.size() && i < lods.size(); ++i) {
+		const MeshletLod& lod = data.lods[i];
+		CHECK(lod.meshletOffset == nextMeshlet); // back to back, finest first
+		CHECK(lod.triangleCount == lods[i].indices.size() / 3);
+		CHECK(lod.error == lods[i].error);
+		checkMeshlets(data, lod.meshletOffset, lod.meshletCount, lods[i].indices, 32, 48);
+		nextMeshlet = lod.meshletOffset + lod.meshletCount;
+	}
+	CHECK(nextMeshlet == data.meshlets.size());
+	CHECK(data.lods.size() == 3 && data.lods[2].meshletCount == 1);
+}
+
+} // namespace
+
+int main() {
+	testLimits();
+	testBounds();
+	testDegenerateInput();
+	testLods();
+	return checkResult("MeshletBuilderTests");
+}
@@ -0,0 +1,94 @@
+#include "PresentPolicy.h"
+
+#include "Check.h"
+
+#include <vector>
+
+// CPU only test of the present policy: which present mode each policy falls back to for a given set of surface modes, and the image counts it asks
+// for staying inside what the surface allows
+
+namespace {
+
+VkSurfaceCapabilitiesKHR capabilities(uint32_t minImageCount, uint32_t maxImageCount) {
+	VkSurfaceCapabilitiesKHR surface{};
+	surface.minImageCount = minImageCount;
+	surface.maxImageCount = maxImageCount; // 0 is no maximum
+	return surface;
+}
+
+PresentConfig choose(PresentPolicy policy, const std::vector<VkPresentModeKHR>& modes, const VkSurfaceCapabilitiesKHR& surface) {
+	return choosePresentConfig(policy, modes.data(), static_cast<uint32_t>(modes.size()), surface);
+}
+
+const std::vector<VkPresentModeKHR> ALL_MODES = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+const std::vector<VkPresentModeKHR> FIFO_ONLY = { VK_PRESENT_MODE_FIFO_KHR };
+
+void testLatencyFirst() {
+	VkSurfaceCapabilitiesKHR surface = capabilities(2, 8);
+	PresentConfig mailbox = choose(PresentPolicy::LatencyFirst, ALL_MODES, surface);
+	CHECK(mailbox.presentMode == VK_PRESENT_MODE_MAILBOX_KHR);
+	CHECK(mailbox.imageCount == 3); // mailbox needs an image to replace
+
+	PresentConfig immediate = choose(PresentPolicy::LatencyFirst, { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }, surface);
+	CHECK(immediate.presentMode == VK_PRESENT_MODE_IMMEDIATE_KHR);
+	CHECK(immediate.imageCount == 2);
+
+	PresentConfig fifo = choose(PresentPolicy::LatencyFirst, FIFO_ONLY, surface);
+	CHECK(fifo.presentMode == VK_PRESENT_MODE_FIFO_KHR);
+	CHECK(fifo.imageCount == 2); // the shortest queue
+
+	CHECK(choose(PresentPolicy::LatencyFirst, ALL_MODES, capabilities(3, 0)).imageCount == 4); // one more than the surface's minimum
+	CHECK(choose(PresentPolicy::LatencyFirst, FIFO_ONLY, capabilities(1, 0)).imageCount == 2); // never a single image
+}
+
+void testThroughputFirst() {
+	VkSurfaceCapabilitiesKHR surface = capabilities(2, 8);
+	PresentConfig relaxed = choose(PresentPolicy::ThroughputFirst, ALL_MODES, surface);
+	CHECK(relaxed.presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+	CHECK(relaxed.imageCount == 4); // an extra image queued
+
+	PresentConfig fifo = choose(PresentPolicy::ThroughputFirst, { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR }, surface);
+	CHECK(fifo.presentMode == VK_PRESENT_MODE_FIFO_KHR); // never mailbox or immediate, those drop or tear frames
+}
+
+void testPowerSaving() {
+	PresentConfig config = choose(PresentPolicy::PowerSaving, ALL_MODES, capabilities(2, 8));
+	CHECK(config.presentMode == VK_PRESENT_MODE_FIFO_KHR);
+	CHECK(config.imageCount == 2);
+	CHECK(choose(PresentPolicy::PowerSaving, ALL_MODES, capabilities(3, 8)).imageCount == 3); // the surface's minimum wins
+}
+
+// whatever the policy wants, the count stays in [minImageCount, maxImageCount]
+void testImageCountLimits() {
+	const PresentPolicy policies[] = { PresentPolicy::LatencyFirst, PresentPolicy::ThroughputFirst, PresentPolicy::PowerSaving };
+	for (PresentPolicy policy : policies) {
+		for (uint32_t minImages = 1; minImages <= 4; ++minImages) {
+			for (uint32_t maxImages = minImages; maxImages <= 6; ++maxImages) {
+				PresentConfig config = choose(policy, ALL_MODES, capabilities(minImages, maxImages));
+				CHECK(config.imageCount >= minImages);
+				CHECK(config.imageCount <= maxImages);
+			}
+			CHECK(choose(policy, ALL_MODES, capabilities(minImages, 0)).imageCount >= minImages);
+		}
+	}
+	CHECK(choose(PresentPolicy::ThroughputFirst, ALL_MODES, capabilities(2, 3)).imageCount == 3);
+	CHECK(choose(PresentPolicy::LatencyFirst, ALL_MODES, capabilities(2, 2)).imageCount == 2); // mailbox with what there is
+}
+
+void testFifoFallback() {
+	// an empty list still gets FIFO, the one mode every surface has
+	PresentConfig config = choosePresentConfig(PresentPolicy::LatencyFirst, nullptr, 0, capabilities(2, 0));
+	CHECK(config.presentMode == VK_PRESENT_MODE_FIFO_KHR);
+	CHECK(choosePresentConfig(PresentPolicy::ThroughputFirst, nullptr, 0, capabilities(2, 0)).presentMode == VK_PRESENT_MODE_FIFO_KHR);
+}
+
+} // namespace
+
+int main() {
+	testLatencyFirst();
+	testThroughputFirst();
+	testPowerSaving();
+	testImageCountLimits();
+	testFifoFallback();
+	return checkResult("PresentPolicyTests");
+}
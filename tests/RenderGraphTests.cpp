@@ -0,0 +1,322 @@
+#include "RenderGraph.h"
+
+#include "Check.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+// CPU only test of RenderGraph::compile(): which passes are culled and the order the rest run in, the barriers for read after write, write after
+// read and layout changes, and which transient resources end up sharing memory. Nothing here needs a device, compile() only looks at the declarations
+
+namespace {
+
+const RenderGraphResourceState SWAP_CHAIN_ACQUIRED = { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED };
+const RenderGraphResourceState SWAP_CHAIN_PRESENT = { VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+
+RenderGraphImageDesc colorDesc(uint32_t width = 1280, uint32_t height = 720) {
+	RenderGraphImageDesc desc;
+	desc.format = VK_FORMAT_R8G8B8A8_UNORM;
+	desc.extent = { width, height };
+	return desc;
+}
+
+void noop(VkCommandBuffer) {}
+
+size_t position(const RenderGraph& graph, RenderGraph::PassHandle pass) {
+	const std::vector<RenderGraph::PassHandle>& order = graph.executionOrder();
+	return static_cast<size_t>(std::find(order.begin(), order.end(), pass) - order.begin());
+}
+
+// the pass's barrier for the resource, nullptr when there is none
+const RenderGraphBarrier* barrierFor(const RenderGraph& graph, RenderGraph::PassHandle pass, RenderGraph::ResourceHandle resource) {
+	for (const RenderGraphBarrier& barrier : graph.passBarriers(pass))
+		if (barrier.resource == resource)
+			return &barrier;
+	return nullptr;
+}
+
+// passes whose results nothing uses are dropped, side effects and imported resources keep theirs, the rest run after what they depend on
+void testCullingAndOrder() {
+	RenderGraph graph;
+	RenderGraph::ResourceHandle swapChain = graph.importImage("swap chain", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::ResourceHandle scene = graph.createImage("scene", colorDesc());
+	RenderGraph::ResourceHandle unused = graph.createImage("unused", colorDesc());
+	RenderGraph::ResourceHandle unusedInput = graph.createImage("unused input", colorDesc());
+	RenderGraph::ResourceHandle debug = graph.createBuffer("debug", 1024);
+
+	// two passes that only feed each other, and a frame that draws the scene and post processes it into the swap chain
+	RenderGraph::PassHandle feedsUnused = graph.addPass("feeds unused", noop);
+	graph.write(feedsUnused, unusedInput, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle writesUnused = graph.addPass("writes unused", noop);
+	graph.read(writesUnused, unusedInput, RenderGraphAccess::FragmentSampledRead);
+	graph.write(writesUnused, unused, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle draw = graph.addPass("draw", noop);
+	graph.write(draw, scene, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle post = graph.addPass("post", noop);
+	graph.read(post, scene, RenderGraphAccess::FragmentSampledRead);
+	graph.write(post, swapChain, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle sideEffects = graph.addPass("side effects", noop);
+	graph.write(sideEffects, debug, RenderGraphAccess::TransferWrite);
+	graph.setSideEffects(sideEffects);
+	graph.compile();
+
+	CHECK(graph.isPassCulled(feedsUnused)); // only feeds a culled pass
+	CHECK(graph.isPassCulled(writesUnused));
+	CHECK(!graph.isPassCulled(draw));
+	CHECK(!graph.isPassCulled(post));
+	CHECK(!graph.isPassCulled(sideEffects));
+	CHECK(graph.executionOrder().size() == 3);
+	CHECK(position(graph, feedsUnused) == graph.executionOrder().size());
+	CHECK(position(graph, draw) < position(graph, post));
+
+	// markOutput() keeps a transient's producers
+	graph.markOutput(unused);
+	graph.compile();
+	CHECK(!graph.isPassCulled(feedsUnused));
+	CHECK(!graph.isPassCulled(writesUnused));
+	CHECK(graph.executionOrder().size() == 5);
+	CHECK(position(graph, feedsUnused) < position(graph, writesUnused));
+
+	// reading a transient nothing has written is a mistake in the graph
+	RenderGraph broken;
+	RenderGraph::ResourceHandle never = broken.createImage("never written", colorDesc());
+	RenderGraph::ResourceHandle target = broken.importImage("target", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::PassHandle reads = broken.addPass("reads", noop);
+	broken.read(reads, never, RenderGraphAccess::FragmentSampledRead);
+	broken.write(reads, target, RenderGraphAccess::ColorAttachmentWrite);
+	bool threw = false;
+	try {
+		broken.compile();
+	} catch (const std::runtime_error&) {
+		threw = true;
+	}
+	CHECK(threw);
+
+	// and so is an access that doesn't fit the resource or the direction
+	bool wrongKind = false;
+	try {
+		graph.read(post, debug, RenderGraphAccess::FragmentSampledRead); // sampling a buffer
+	} catch (const std::runtime_error&) {
+		wrongKind = true;
+	}
+	CHECK(wrongKind);
+	bool wrongDirection = false;
+	try {
+		graph.read(post, scene, RenderGraphAccess::ColorAttachmentWrite);
+	} catch (const std::runtime_error&) {
+		wrongDirection = true;
+	}
+	CHECK(wrongDirection);
+}
+
+// a compute pass writes a buffer, a vertex pass reads it, another compute pass writes it again
+void testBufferBarriers() {
+	RenderGraph graph;
+	RenderGraph::ResourceHandle particles = graph.createBuffer("particles", 65536);
+	RenderGraph::ResourceHandle swapChain = graph.importImage("swap chain", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::PassHandle simulate = graph.addPass("simulate", noop);
+	graph.write(simulate, particles, RenderGraphAccess::ComputeStorageWrite);
+	RenderGraph::PassHandle draw = graph.addPass("draw", noop);
+	graph.read(draw, particles, RenderGraphAccess::VertexStorageRead);
+	graph.write(draw, swapChain, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle compact = graph.addPass("compact", noop);
+	graph.write(compact, particles, RenderGraphAccess::ComputeStorageWrite);
+	graph.markOutput(particles);
+	graph.compile();
+
+	CHECK(graph.executionOrder().size() == 3);
+	CHECK(position(graph, simulate) < position(graph, draw));
+	CHECK(position(graph, draw) < position(graph, compact)); // write after read orders them too
+
+	// the first write waits on the last use of the frame before, the buffer's memory is the same every frame. nothing to make available
+	const RenderGraphBarrier* previousFrame = barrierFor(graph, simulate, particles);
+	CHECK(previousFrame != nullptr);
+	if (previousFrame) {
+		CHECK(previousFrame->srcStage == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT); // compact
+		CHECK(previousFrame->srcAccess == VK_ACCESS_2_NONE);
+	}
+
+	// read after write: the compute shader's writes made visible to the vertex shader
+	const RenderGraphBarrier* raw = barrierFor(graph, draw, particles);
+	CHECK(raw != nullptr);
+	if (raw) {
+		CHECK(raw->srcStage == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+		CHECK((raw->srcAccess & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT) != 0);
+		CHECK(raw->dstStage == VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT);
+		CHECK(raw->dstAccess == VK_ACCESS_2_SHADER_STORAGE_READ_BIT);
+	}
+
+	// write after read: only an execution dependency, the vertex shader has to be done reading. there is nothing to make available
+	const RenderGraphBarrier* war = barrierFor(graph, compact, particles);
+	CHECK(war != nullptr);
+	if (war) {
+		CHECK((war->srcStage & VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT) != 0);
+		CHECK(war->srcAccess == VK_ACCESS_2_NONE);
+		CHECK(war->dstStage == VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+	}
+
+	// a second reader in the same stage needs nothing more, the first one's barrier made the write visible to the stage
+	RenderGraph twoReaders;
+	RenderGraph::ResourceHandle buffer = twoReaders.createBuffer("buffer", 4096);
+	RenderGraph::ResourceHandle target = twoReaders.importImage("target", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::PassHandle write = twoReaders.addPass("write", noop);
+	twoReaders.write(write, buffer, RenderGraphAccess::ComputeStorageWrite);
+	RenderGraph::PassHandle first = twoReaders.addPass("first", noop);
+	twoReaders.read(first, buffer, RenderGraphAccess::VertexStorageRead);
+	twoReaders.write(first, target, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle second = twoReaders.addPass("second", noop);
+	twoReaders.read(second, buffer, RenderGraphAccess::VertexStorageRead);
+	twoReaders.write(second, target, RenderGraphAccess::ColorAttachmentWrite);
+	twoReaders.compile();
+	CHECK(barrierFor(twoReaders, first, buffer) != nullptr);
+	CHECK(barrierFor(twoReaders, second, buffer) == nullptr);
+}
+
+// an image rendered to, then sampled, then the swap chain handed over for presenting
+void testLayoutTransitions() {
+	RenderGraph graph;
+	RenderGraph::ResourceHandle swapChain = graph.importImage("swap chain", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::ResourceHandle scene = graph.createImage("scene", colorDesc());
+	RenderGraph::PassHandle draw = graph.addPass("draw", noop);
+	graph.write(draw, scene, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle post = graph.addPass("post", noop);
+	graph.read(post, scene, RenderGraphAccess::FragmentSampledRead);
+	graph.write(post, swapChain, RenderGraphAccess::ColorAttachmentWrite);
+	graph.compile();
+
+	// transients start out undefined every frame, the contents are never kept
+	const RenderGraphBarrier* toAttachment = barrierFor(graph, draw, scene);
+	CHECK(toAttachment != nullptr);
+	if (toAttachment) {
+		CHECK(toAttachment->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+		CHECK(toAttachment->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+
+	// a read that changes the layout: the transition waits on the attachment writes
+	const RenderGraphBarrier* toSampled = barrierFor(graph, post, scene);
+	CHECK(toSampled != nullptr);
+	if (toSampled) {
+		CHECK(toSampled->oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		CHECK(toSampled->newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		CHECK(toSampled->srcStage == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+		CHECK((toSampled->srcAccess & VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT) != 0);
+		CHECK(toSampled->dstStage == VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT);
+		CHECK(toSampled->dstAccess == VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+	}
+
+	// the imported image starts from its initial state and ends in its final one
+	const RenderGraphBarrier* acquire = barrierFor(graph, post, swapChain);
+	CHECK(acquire != nullptr);
+	if (acquire) {
+		CHECK(acquire->srcStage == VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT); // waits on the acquire semaphore's stage
+		CHECK(acquire->newLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	}
+	CHECK(graph.finalBarriers().size() == 1);
+	if (graph.finalBarriers().size() == 1) {
+		const RenderGraphBarrier& present = graph.finalBarriers()[0];
+		CHECK(present.resource == swapChain);
+		CHECK(present.oldLayout == VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		CHECK(present.newLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+		CHECK((present.srcAccess & VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT) != 0);
+	}
+	CHECK(graph.barrierCount() == 4);
+}
+
+// a chain of full screen passes: a is done before c starts, so they share memory. b overlaps both and gets its own
+void testTransientAliasing() {
+	RenderGraph graph;
+	RenderGraph::ResourceHandle swapChain = graph.importImage("swap chain", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	RenderGraph::ResourceHandle a = graph.createImage("a", colorDesc());
+	RenderGraph::ResourceHandle b = graph.createImage("b", colorDesc());
+	RenderGraph::ResourceHandle c = graph.createImage("c", colorDesc());
+	RenderGraph::PassHandle writeA = graph.addPass("write a", noop);
+	graph.write(writeA, a, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle aToB = graph.addPass("a to b", noop);
+	graph.read(aToB, a, RenderGraphAccess::FragmentSampledRead);
+	graph.write(aToB, b, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle bToC = graph.addPass("b to c", noop);
+	graph.read(bToC, b, RenderGraphAccess::FragmentSampledRead);
+	graph.write(bToC, c, RenderGraphAccess::ColorAttachmentWrite);
+	RenderGraph::PassHandle cToSwapChain = graph.addPass("c to swap chain", noop);
+	graph.read(cToSwapChain, c, RenderGraphAccess::FragmentSampledRead);
+	graph.write(cToSwapChain, swapChain, RenderGraphAccess::ColorAttachmentWrite);
+	graph.compile();
+
+	const RenderGraph::MemoryStats& stats = graph.memoryStats();
+	CHECK(stats.memoryBlocks == 2); // {a, c} and {b}, the imported swap chain isn't the graph's memory
+	CHECK(stats.unaliasedBytes > 0);
+	CHECK(stats.aliasedBytes * 3 == stats.unaliasedBytes * 2); // three images of the same size in the memory of two
+
+	// c takes a's memory, so its first write waits on a's last reader as well as discarding the contents
+	const RenderGraphBarrier* reuse = barrierFor(graph, bToC, c);
+	CHECK(reuse != nullptr);
+	if (reuse) {
+		CHECK((reuse->srcStage & VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT) != 0);
+		CHECK(reuse->oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+	}
+
+	// every transient read in the last pass keeps all three alive at once, nothing can share
+	RenderGraph overlapping;
+	RenderGraph::ResourceHandle target = overlapping.importImage("target", colorDesc(), SWAP_CHAIN_ACQUIRED, SWAP_CHAIN_PRESENT);
+	std::vector<RenderGraph::ResourceHandle> inputs;
+	for (int i = 0; i < 3; ++i) {
+		inputs.push_back(overlapping.createImage("input", colorDesc()));
+		RenderGraph::PassHandle produce = overlapping.addPass("produce", noop);
+		overlapping.write(produce, inputs.back(), RenderGraphAccess::ColorAttachmentWrite);
+	}
+	RenderGraph::PassHandle combine = overlapping.addPass("combine", noop);
+	for (RenderGraph::ResourceHandle input : inputs)
+		overlapping.read(combine, input, RenderGraphAccess::FragmentSampledRead);
+	overlapping.write(combine, target, RenderGraphAccess::ColorAttachmentWrite);
+	overlapping.compile();
+	CHECK(overlapping.memoryStats().memoryBlocks == 3);
+	CHECK(overlapping.memoryStats().aliasedBytes == overlapping.memoryStats().unaliasedBytes);
+}
+
+// planAliasing() on its own: lifetimes are inclusive, memory types have to be compatible, and a block is as big and aligned as its biggest occupant
+void testPlanAliasing() {
+	std::vector<RenderGraph::AliasCandidate> candidates = {
+		{ 0, 1, 4096, 256, ~0u },
+		{ 2, 3, 8192, 1024, ~0u }, // after 0, shares with it
+		{ 1, 2, 1024, 256, ~0u }, // overlaps both, inclusive at each end
+		{ 4, 5, 2048, 256, 0x1 },
+		{ 4, 5, 2048, 256, 0x2 }, // same lifetime as 3, and couldn't share anyway
+	};
+	std::vector<RenderGraph::AliasBlock> blocks = RenderGraph::planAliasing(candidates);
+	auto blockOf = [&blocks](uint32_t candidate) {
+		for (size_t b = 0; b < blocks.size(); ++b)
+			if (std::find(blocks[b].candidates.begin(), blocks[b].candidates.end(), candidate) != blocks[b].candidates.end())
+				return static_cast<int>(b);
+		return -1;
+	};
+
+	for (uint32_t i = 0; i < candidates.size(); ++i)
+		CHECK(blockOf(i) >= 0);
+	CHECK(blockOf(0) == blockOf(1));
+	CHECK(blockOf(2) != blockOf(0));
+	CHECK(blockOf(3) != blockOf(4));
+	const RenderGraph::AliasBlock& shared = blocks[blockOf(0)];
+	CHECK(shared.size == 8192);
+	CHECK(shared.alignment == 1024);
+	CHECK(shared.candidates.size() >= 2 && shared.candidates[0] == 0); // occupants in the order they use the memory
+	for (const RenderGraph::AliasBlock& block : blocks) {
+		for (size_t i = 0; i < block.candidates.size(); ++i) {
+			for (size_t j = i + 1; j < block.candidates.size(); ++j) {
+				const RenderGraph::AliasCandidate& x = candidates[block.candidates[i]];
+				const RenderGraph::AliasCandidate& y = candidates[block.candidates[j]];
+				CHECK(x.lastPass < y.firstPass || y.lastPass < x.firstPass);
+			}
+		}
+	}
+}
+
+} // namespace
+
+int main() {
+	testCullingAndOrder();
+	testBufferBarriers();
+	testLayoutTransitions();
+	testTransientAliasing();
+	testPlanAliasing();
+	return checkResult("RenderGraphTests");
+}
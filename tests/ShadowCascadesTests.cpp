@@ -0,0 +1,100 @@
+#include "ShadowCascades.h"
+
+#include "Check.h"
+
+#include <cmath>
+
+// CPU only test of the shadow cascades' fitting math: the practical splits go from near to far in order and blend the uniform and logarithmic
+// schemes, each slice's sphere holds all 8 corners of its slice, and the texel snapping only ever moves a cascade by whole texels
+
+namespace {
+
+bool near(float a, float b, float epsilon = 1e-4f) {
+	return std::abs(a - b) <= epsilon * std::max(1.0f, std::max(std::abs(a), std::abs(b)));
+}
+
+void testSplits() {
+	const float nearPlane = 0.1f;
+	const float farPlane = 100.0f;
+	for (float lambda : { 0.0f, 0.5f, 0.75f, 1.0f }) {
+		for (uint32_t count = 1; count <= ShadowCascades::MAX_CASCADES; ++count) {
+			float previous = nearPlane;
+			bool ascending = true;
+			for (uint32_t c = 0; c < count; ++c) {
+				float split = ShadowCascades::splitDepth(c, count, nearPlane, farPlane, lambda);
+				ascending = ascending && split > previous;
+				previous = split;
+			}
+			CHECK(ascending);
+			CHECK(near(previous, farPlane)); // the last cascade reaches the far plane
+		}
+	}
+	// the two schemes the blend is between
+	CHECK(near(ShadowCascades::splitDepth(0, 4, nearPlane, farPlane, 0.0f), nearPlane + (farPlane - nearPlane) * 0.25f));
+	CHECK(near(ShadowCascades::splitDepth(1, 4, nearPlane, farPlane, 1.0f), nearPlane * std::pow(farPlane / nearPlane, 0.5f)));
+	// logarithmic splits give the near cascades less depth
+	CHECK(ShadowCascades::splitDepth(0, 4, nearPlane, farPlane, 1.0f) < ShadowCascades::splitDepth(0, 4, nearPlane, farPlane, 0.5f));
+}
+
+// every corner of the slice between the two depths, for a frustum with half angle tangents tanX and tanY, is inside the sphere
+bool holdsCorners(float sliceNear, float sliceFar, float tanX, float tanY) {
+	ShadowCascades::SliceSphere sphere = ShadowCascades::sliceSphere(sliceNear, sliceFar, tanX * tanX + tanY * tanY);
+	bool inside = true;
+	for (float depth : { sliceNear, sliceFar }) {
+		for (float sx : { -1.0f, 1.0f }) {
+			for (float sy : { -1.0f, 1.0f }) {
+				float x = sx * tanX * depth;
+				float y = sy * tanY * depth;
+				float z = depth - sphere.centerDepth;
+				inside = inside && std::sqrt(x * x + y * y + z * z) <= sphere.radius * 1.0001f;
+			}
+		}
+	}
+	return inside;
+}
+
+void testSliceSpheres() {
+	const float tanY = std::tan(0.5f * 0.785398f); // 45 degrees vertically, like the engine's projection
+	for (float aspect : { 0.5f, 1.0f, 4.0f / 3.0f, 16.0f / 9.0f, 3.0f }) {
+		float tanX = tanY * aspect;
+		CHECK(holdsCorners(0.1f, 0.5f, tanX, tanY));
+		CHECK(holdsCorners(0.5f, 3.0f, tanX, tanY));
+		CHECK(holdsCorners(3.0f, 10.0f, tanX, tanY));
+		CHECK(holdsCorners(0.1f, 100.0f, tanX, tanY)); // long thin slices have the center at the far end
+	}
+	// the center stays between the slice's depths, and the sphere is no bigger than the one around the far face and the near plane's center
+	ShadowCascades::SliceSphere sphere = ShadowCascades::sliceSphere(1.0f, 2.0f, 2.0f * tanY * tanY);
+	CHECK(sphere.centerDepth >= 1.0f && sphere.centerDepth <= 2.0f);
+	CHECK(sphere.radius <= std::sqrt(1.0f + 4.0f * 2.0f * tanY * tanY));
+}
+
+void testTexelSnapping() {
+	const float radius = 8.0f;
+	const uint32_t resolution = 1024;
+	const float texel = 2.0f * radius / resolution;
+	glm::vec3 position(3.1234f, -7.5678f, 2.25f);
+	glm::vec3 snapped = ShadowCascades::snapToTexels(position, radius, resolution);
+	for (int axis = 0; axis < 3; ++axis) {
+		float offset = position[axis] - snapped[axis];
+		CHECK(offset >= 0.0f && offset < texel); // rounded down, by less than a texel
+		float texels = snapped[axis] / texel;
+		CHECK(near(texels, std::round(texels))); // a whole number of them
+	}
+
+	// moving inside the texel changes nothing, moving by whole texels moves the projection by exactly as many
+	glm::vec3 base = snapped + glm::vec3(0.25f * texel);
+	CHECK(ShadowCascades::snapToTexels(base + glm::vec3(0.5f * texel, 0.0f, 0.0f), radius, resolution) == snapped);
+	glm::vec3 moved = ShadowCascades::snapToTexels(base + glm::vec3(3.0f * texel, -2.0f * texel, 0.0f), radius, resolution);
+	CHECK(near(moved.x - snapped.x, 3.0f * texel));
+	CHECK(near(moved.y - snapped.y, -2.0f * texel));
+	CHECK(moved.z == snapped.z);
+}
+
+} // namespace
+
+int main() {
+	testSplits();
+	testSliceSpheres();
+	testTexelSnapping();
+	return checkResult("ShadowCascadesTests");
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Meshes for the geometry tests, built in code so there are no asset files to keep around. Counter clockwise triangles facing out, like the engine's
+
+struct TestMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// a flat cells x cells grid of unit quads in the xy plane, facing +z. open on all four sides
+inline TestMesh makeGrid(uint32_t cells) {
+	TestMesh mesh;
+	for (uint32_t y = 0; y <= cells; ++y)
+		for (uint32_t x = 0; x <= cells; ++x)
+			mesh.positions.push_back(glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f));
+	for (uint32_t y = 0; y < cells; ++y) {
+		for (uint32_t x = 0; x < cells; ++x) {
+			uint32_t a = y * (cells + 1) + x, b = a + 1, c = a + cells + 2, d = a + cells + 1;
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+		}
+	}
+	return mesh;
+}
+
+// a closed unit sphere around the origin: a vertex at each pole and rings - 1 rings of segments vertices in between
+inline TestMesh makeSphere(uint32_t rings, uint32_t segments) {
+	const float PI = 3.14159265358979f;
+	TestMesh mesh;
+	mesh.positions.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+	for (uint32_t ring = 1; ring < rings; ++ring) {
+		float theta = PI * ring / rings;
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			float phi = 2.0f * PI * segment / segments;
+			mesh.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)));
+		}
+	}
+	mesh.positions.push_back(glm::vec3(0.0f, 0.0f, -1.0f));
+
+	uint32_t bottom = static_cast<uint32_t>(mesh.positions.size() - 1);
+	auto ringVertex = [segments](uint32_t ring, uint32_t segment) { return 1 + (ring - 1) * segments + segment % segments; };
+	for (uint32_t segment = 0; segment < segments; ++segment) {
+		mesh.indices.insert(mesh.indices.end(), { 0, ringVertex(1, segment), ringVertex(1, segment + 1) });
+		for (uint32_t ring = 1; ring + 1 < rings; ++ring) {
+			uint32_t a = ringVertex(ring, segment), b = ringVertex(ring + 1, segment), c = ringVertex(ring + 1, segment + 1), d = ringVertex(ring, segment + 1);
+			mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+		}
+		mesh.indices.insert(mesh.indices.end(), { ringVertex(rings - 1, segment), bottom, ringVertex(rings - 1, segment + 1) });
+	}
+	return mesh;
+}
@@ -0,0 +1,154 @@
+#include "JobSystem.h"
+#include "VirtualFileSystem.h"
+
+#include "Check.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// CPU only test of the .vpak archives: files packed with writeArchive come back byte for byte out of the mounted archive (stored and LZ4, one
+// block and many, empty files, serially and on the job system), and mounting rejects archives whose table points outside the file or claims
+// sizes its data can't decode to. works in a scratch directory under the system's temp directory
+
+namespace {
+
+namespace fs = std::filesystem;
+
+void writeFile(const fs::path& path, const std::vector<char>& contents) {
+	fs::create_directories(path.parent_path());
+	std::ofstream file(path, std::ios::binary);
+	file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+}
+
+std::vector<char> readBytes(const fs::path& path) {
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+struct Sources {
+	fs::path root;
+	std::vector<std::string> names;
+	std::vector<std::vector<char>> contents;
+};
+
+Sources makeSources(const fs::path& root) {
+	Sources sources;
+	sources.root = root;
+	std::mt19937 random(9);
+	std::vector<char> noise(100000);
+	for (char& byte : noise)
+		byte = static_cast<char>(random());
+	std::string text;
+	while (text.size() < 300000) // several LZ4 blocks
+		text += "layout(location = 0) out vec4 outColor; ";
+
+	sources.names = { "Shaders/a.spv", "Shaders/nested/b.spv", "empty.bin", "noise.bin", "zeros.bin" };
+	sources.contents = { std::vector<char>(text.begin(), text.end()), std::vector<char>{ 'b' }, std::vector<char>(), noise, std::vector<char>(200000, 0) };
+	for (size_t i = 0; i < sources.names.size(); ++i)
+		writeFile(root / sources.names[i], sources.contents[i]);
+	return sources;
+}
+
+void testRoundTrip(const fs::path& directory, const Sources& sources, bool compress) {
+	std::string archivePath = (directory / (compress ? "lz4.vpak" : "stored.vpak")).string();
+	writeArchive(archivePath, collectArchiveSources(sources.root.string(), { "Shaders", "empty.bin", "noise.bin", "zeros.bin" }), compress);
+
+	VirtualFileSystem files;
+	CHECK(files.mountArchive(archivePath));
+	CHECK(files.archivedFileCount() == sources.names.size());
+	JobSystem jobSystem;
+	for (size_t i = 0; i < sources.names.size(); ++i) {
+		CHECK(files.exists(sources.names[i]));
+		CHECK(files.readFile(sources.names[i]) == sources.contents[i]);
+		CHECK(files.readFile("./" + sources.names[i], &jobSystem) == sources.contents[i]);
+	}
+	CHECK(files.readFiles(sources.names, jobSystem) == sources.contents);
+
+	size_t size = 0;
+	const void* mapped = files.mappedFile("noise.bin", size); // never compresses, so it's readable in place
+	CHECK(mapped != nullptr && size == sources.contents[3].size() && std::memcmp(mapped, sources.contents[3].data(), size) == 0);
+	CHECK((files.mappedFile("zeros.bin", size) == nullptr) == compress);
+
+	CHECK(!files.exists("missing.bin"));
+	bool threw = false;
+	try {
+		files.readFile("missing.bin");
+	} catch (const std::exception&) {
+		threw = true;
+	}
+	CHECK(threw);
+}
+
+// patches one entry of a valid archive and expects the mount to refuse it
+bool mountRejects(const fs::path& directory, const std::vector<char>& archive, uint32_t entryIndex, void (*patch)(ArchiveEntry&, uint64_t archiveSize)) {
+	std::vector<char> bytes = archive;
+	ArchiveEntry entry;
+	size_t offset = sizeof(ArchiveHeader) + entryIndex * sizeof(ArchiveEntry);
+	std::memcpy(&entry, bytes.data() + offset, sizeof(entry));
+	patch(entry, bytes.size());
+	std::memcpy(bytes.data() + offset, &entry, sizeof(entry));
+	fs::path path = directory / "patched.vpak";
+	writeFile(path, bytes);
+
+	VirtualFileSystem files;
+	try {
+		files.mountArchive(path.string());
+	} catch (const std::exception&) {
+		return files.archivedFileCount() == 0; // and nothing left half mounted
+	}
+	return false;
+}
+
+void testInvalidArchives(const fs::path& directory) {
+	std::vector<char> archive = readBytes(directory / "lz4.vpak");
+	uint32_t zeros = 4; // sorted by name, "zeros.bin" is last and compressed
+	ArchiveEntry entry;
+	std::memcpy(&entry, archive.data() + sizeof(ArchiveHeader) + zeros * sizeof(ArchiveEntry), sizeof(entry));
+	CHECK(entry.compression == ARCHIVE_LZ4);
+
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t) { e.dataOffset = 0; })); // over the header and table
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t size) { e.dataOffset = (size / ARCHIVE_ALIGNMENT + 1) * ARCHIVE_ALIGNMENT; }));
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t size) { e.storedSize = size; })); // runs past the end
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t) { e.storedSize = ~uint64_t(0); })); // would wrap around
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t) {
+		e.size = uint64_t(1) << 40; // what readFile() would allocate
+		e.blockCount = static_cast<uint32_t>((e.size + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE);
+	}));
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t) { // more than the blocks could ever decode to
+		e.size = e.storedSize * LZ4_MAX_RATIO * 2;
+		e.blockCount = static_cast<uint32_t>((e.size + ARCHIVE_BLOCK_SIZE - 1) / ARCHIVE_BLOCK_SIZE);
+	}));
+	CHECK(mountRejects(directory, archive, zeros, [](ArchiveEntry& e, uint64_t) { e.nameOffset = 1u << 20; }));
+	CHECK(mountRejects(directory, archive, 0, [](ArchiveEntry& e, uint64_t) { e.compression = 7; }));
+	CHECK(mountRejects(directory, archive, 3, [](ArchiveEntry& e, uint64_t) { e.size += 1; })); // stored: the sizes have to agree
+
+	std::vector<char> truncated(archive.begin(), archive.begin() + sizeof(ArchiveHeader) + sizeof(ArchiveEntry)); // the table runs past the end
+	writeFile(directory / "truncated.vpak", truncated);
+	VirtualFileSystem files;
+	bool threw = false;
+	try {
+		files.mountArchive((directory / "truncated.vpak").string());
+	} catch (const std::exception&) {
+		threw = true;
+	}
+	CHECK(threw);
+	CHECK(!files.mountArchive((directory / "missing.vpak").string())); // no file is not an error
+}
+
+} // namespace
+
+int main() {
+	fs::path directory = fs::temp_directory_path() / "VirtualFileSystemTests";
+	fs::remove_all(directory);
+	Sources sources = makeSources(directory / "sources");
+	testRoundTrip(directory, sources, false);
+	testRoundTrip(directory, sources, true);
+	testInvalidArchives(directory);
+	fs::remove_all(directory);
+	return checkResult("VirtualFileSystemTests");
+}